@@ -3,12 +3,23 @@
 #include "Buffer.hpp"
 
 #include "Types.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <cstring>
-#include <iostream>
 #include <stdexcept>
 
 // Implementation of HelloTriangleApplication methods
 void HelloTriangleApplication::run() {
+  if (options.headless && options.frameCount == 0) {
+    throw std::runtime_error("Headless runs need a frame count!");
+  }
+
+#ifdef VALKEON_ENABLE_PROFILER
+  PROFILE_THREAD("Main");
+  CpuProfiler::start();
+#endif
   initWindow();
   initVulkan();
   mainLoop();
@@ -16,6 +27,10 @@ void HelloTriangleApplication::run() {
 }
 
 void HelloTriangleApplication::initWindow() {
+  // Headless runs never touch GLFW, so they need no display
+  if (options.headless)
+    return;
+
   if (!glfwInit()) {
     throw std::runtime_error("Failed to initialize GLFW!");
   }
@@ -23,207 +38,412 @@ void HelloTriangleApplication::initWindow() {
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
   glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-  window = glfwCreateWindow(800, 600, "Hello Triangle", nullptr, nullptr);
+  window = glfwCreateWindow(static_cast<int>(options.width),
+                            static_cast<int>(options.height), "Hello Triangle",
+                            nullptr, nullptr);
   if (!window) {
     throw std::runtime_error("Failed to create GLFW window!");
   }
 }
 
 void HelloTriangleApplication::initVulkan() {
-  // Step 1: Get required extensions from GLFW
-  std::vector<const char *> extensions = vulkanContext.getRequiredExtensions();
+  PROFILE_ZONE("initVulkan");
+  using Stage = StartupScheduler::Stage;
 
-  // Step 2: Create Vulkan instance with the required extensions
-  try {
-    vulkanContext.createInstance(extensions);
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create Vulkan instance: ") +
-                             e.what());
-  }
+  // Each step is a stage started once the stages it uses have finished, so
+  // independent ones overlap: shader files are read while the device is
+  // created, lighting and command pools are set up beside the swapchain.
+  // Occlusion culling and the GPU profiler are not needed for the first
+  // frame and are deferred until after it (runDeferredStartup)
 
-  // Step 3: Create window surface
-  VkSurfaceKHR surface;
-  try {
-    vulkanContext.createSurface(vulkanContext.getInstance(), window, &surface);
-    std::cout << "Window Surface Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create window surface: ") +
-                             e.what());
-  }
+  // Decided up front, since several stages depend on it
+  useDynamicResolution = options.frameBudgetMs > 0.0f;
+  useDepthPrePass = options.depthPrePass;
+
+  // Step 1: Read the SPIR-V files of every pipeline
+  Stage shaderFiles = startup.addStage("Shader files", [] {
+    Pipeline::prefetchShaderFiles(
+        {"Shaders/triangle.vert.spv", "Shaders/triangle.frag.spv",
+         "Shaders/light_cull.comp.spv", "Shaders/downsample.comp.spv",
+         "Shaders/occlusion_cull.comp.spv", "Shaders/skinning.comp.spv",
+         "Shaders/upscale.comp.spv"});
+  });
+
+  // Step 2: Create Vulkan instance with the extensions GLFW requires
+  Stage instance = startup.addStage("Vulkan instance", [this] {
+    vulkanContext.setValidationLayers(options.validation);
+    vulkanContext.setDeviceSelector(options.device);
+    vulkanContext.createInstance(
+        vulkanContext.getRequiredExtensions(options.headless));
+  });
+
+  // Step 3: Create window surface (none when headless)
+  Stage surface = startup.addStage(
+      "Window surface",
+      [this] {
+        if (!options.headless) {
+          vulkanContext.createSurface(vulkanContext.getInstance(), window,
+                                      &windowSurface);
+        }
+      },
+      {instance});
 
   // Step 4: Pick physical device based on the surface
-  try {
-    vulkanContext.pickPhysicalDevice(surface);
-    std::cout << "Physical Device Selected Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to pick physical device: ") +
-                             e.what());
-  }
+  Stage physicalDevice = startup.addStage(
+      "Physical device",
+      [this] { vulkanContext.pickPhysicalDevice(windowSurface); }, {surface});
 
   // Step 5: Create logical device
-  try {
-    vulkanContext.createLogicalDevice();
-    std::cout << "Logical Device Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create logical device: ") +
-                             e.what());
-  }
+  Stage device = startup.addStage(
+      "Logical device",
+      [this] {
+        vulkanContext.createLogicalDevice();
+        deletionQueue.create(vulkanContext.getDevice());
+        resourceCache.create(vulkanContext.getDevice(), deletionQueue);
+        descriptorLayouts.create(vulkanContext.getDevice());
+        persistentDescriptors.create(vulkanContext.getDevice());
+        frameDescriptors.resize(MAX_FRAMES_IN_FLIGHT);
+        for (DescriptorAllocator &descriptors : frameDescriptors) {
+          descriptors.create(vulkanContext.getDevice());
+        }
+      },
+      {physicalDevice});
 
-  // Step 6: Create Swapchain (Assuming you have a Swapchain class)
-  try {
-    swapchain.create(vulkanContext, surface, 800, 600);
-    std::cout << "Swapchain Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create swapchain: ") +
-                             e.what());
-  }
+  // Step 6: Create Swapchain, or the offscreen images standing in for it
+  Stage target = startup.addStage(
+      "Swapchain",
+      [this] {
+        // Written by the upscaler when rendering below full resolution
+        VkImageUsageFlags extraUsage =
+            useDynamicResolution ? Upscaler::kTargetUsage : 0;
+        if (options.headless) {
+          offscreenTarget.create(vulkanContext, options.width, options.height,
+                                 MAX_FRAMES_IN_FLIGHT, extraUsage);
+        } else {
+          swapchain.create(vulkanContext, windowSurface, options.width,
+                           options.height, &resourceCache, extraUsage);
+        }
+      },
+      {device});
+  startup.addStage(
+      "Frame readback",
+      [this] {
+        if (options.capturePath.empty())
+          return;
+        if (!options.headless) {
+          LOG_WARNING("Frame capture needs headless mode; not capturing");
+          return;
+        }
+        frameReadback.create(vulkanContext, getTargetExtent(),
+                             getTargetFormat(), MAX_FRAMES_IN_FLIGHT,
+                             CAPTURE_RING_SIZE, options.capturePath,
+                             options.captureFormat);
+        capturing = true;
+      },
+      {target});
+  // Scene images rendered below full size, and their upscaling
+  Stage resolution = startup.addStage(
+      "Dynamic resolution",
+      [this] {
+        if (!useDynamicResolution)
+          return;
+        dynamicResolution.create(options.frameBudgetMs, MAX_FRAMES_IN_FLIGHT,
+                                 options.minRenderScale);
+        upscaler.create(vulkanContext, getTargetExtent(), getTargetFormat(),
+                        getTargetUsage(), MAX_FRAMES_IN_FLIGHT,
+                        options.upscaleSharpness, descriptorLayouts,
+                        resourceCache);
+      },
+      {target, shaderFiles});
 
-  // Step 7: Create Render Pass
-  try {
-    renderPass.create(vulkanContext.getDevice(), swapchain.getFormat());
-    std::cout << "Render Pass Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create render pass: ") +
-                             e.what());
-  }
+  // Step 7: Create Depth Buffer and Render Pass
+  Stage passes = startup.addStage(
+      "Render pass",
+      [this] {
+        depthBuffer.create(vulkanContext, getTargetExtent());
+        renderPass.create(vulkanContext.getDevice(), getTargetFormat(),
+                          depthBuffer.getFormat(), useDepthPrePass, false,
+                          getSceneColorLayout(), &resourceCache);
+      },
+      {target});
 
   // Step 8: Create Framebuffers
-  try {
-    framebuffer.create(vulkanContext.getDevice(), renderPass.getRenderPass(),
-                       swapchain.getImageViews(), swapchain.getExtent());
-    std::cout << "Framebuffers Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create framebuffers: ") +
-                             e.what());
-  }
-
-  // Step 9: Create Graphics Pipeline
-  VkPipelineLayout pipelineLayout;
-  VkPipeline graphicsPipeline;
-  try {
-    pipeline.createBasicPipeline(
-        vulkanContext.getDevice(), renderPass.getRenderPass(),
-        swapchain.getExtent(), pipelineLayout, graphicsPipeline);
-    std::cout << "Graphics Pipeline Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(
-        std::string("Failed to create graphics pipeline: ") + e.what());
-  }
-
-  // Step 10: Create Command Pool
-  try {
-    commandPool.create(vulkanContext.getDevice(),
-                       vulkanContext.getGraphicsQueueFamilyIndex());
-    std::cout << "Command Pool Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create command pool: ") +
-                             e.what());
-  }
-
-  // Step 11: Allocate Command Buffers
-  try {
-    commandPool.allocateCommandBuffers(vulkanContext.getDevice(),
-                                       swapchain.getImageViews().size(),
-                                       commandBuffers);
-    std::cout << "Command Buffers Allocated Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(
-        std::string("Failed to allocate command buffers: ") + e.what());
-  }
+  startup.addStage(
+      "Framebuffers",
+      [this] {
+        framebuffer.create(vulkanContext.getDevice(),
+                           renderPass.getRenderPass(), getSceneImageViews(),
+                           getTargetExtent(), depthBuffer.getImageView(),
+                           &resourceCache);
+      },
+      {passes, resolution});
+
+  // Step 9: Create Clustered Lighting and the Graphics Pipeline using its
+  // descriptor set
+  Stage lighting = startup.addStage(
+      "Clustered lighting",
+      [this] {
+        clusteredLights.create(vulkanContext, MAX_LIGHTS,
+                               MAX_FRAMES_IN_FLIGHT, descriptorLayouts,
+                               persistentDescriptors);
+      },
+      {device, shaderFiles});
+  startup.addStage(
+      "Graphics pipeline",
+      [this] {
+        // After a pre-pass depth is final, so the main pass only tests it
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkPipeline handle = VK_NULL_HANDLE;
+        pipeline.createBasicPipeline(
+            vulkanContext.getDevice(), renderPass.getRenderPass(), layout,
+            handle, renderPass.getColorSubpass(), true, !useDepthPrePass,
+            {clusteredLights.getDescriptorSetLayout()});
+        pipelineLayout = QueuedHandle<VkPipelineLayout>(deletionQueue, layout);
+        graphicsPipeline = QueuedHandle<VkPipeline>(deletionQueue, handle);
+        if (useDepthPrePass) {
+          pipeline.createDepthOnlyPipeline(
+              vulkanContext.getDevice(), renderPass.getRenderPass(), layout,
+              handle, renderPass.getDepthPrePassSubpass());
+          depthPrePassPipeline =
+              QueuedHandle<VkPipeline>(deletionQueue, handle);
+        }
+        drawBindings.pipelines = {graphicsPipeline.get(),
+                                  depthPrePassPipeline.get()};
+      },
+      {passes, lighting, shaderFiles});
+
+  // Step 10: Create Command Pools for the graphics and compute queues
+  Stage pools = startup.addStage(
+      "Command pools",
+      [this] {
+        commandPool.create(vulkanContext.getDevice(),
+                           vulkanContext.getGraphicsQueueFamilyIndex());
+        computeCommandPool.create(vulkanContext.getDevice(),
+                                  vulkanContext.getComputeQueueFamilyIndex());
+      },
+      {device});
+
+  // Step 11: Allocate Command Buffers (one per frame in flight, re-recorded
+  // every frame)
+  Stage buffers = startup.addStage(
+      "Command buffers",
+      [this] {
+        commandPool.allocateCommandBuffers(
+            vulkanContext.getDevice(), MAX_FRAMES_IN_FLIGHT, commandBuffers);
+        computeCommandPool.allocateCommandBuffers(vulkanContext.getDevice(),
+                                                  MAX_FRAMES_IN_FLIGHT,
+                                                  computeCommandBuffers);
+      },
+      {pools});
 
   // Step 12: Create Synchronization Objects
-  try {
-    synchronization.create(vulkanContext.getDevice(),
-                           2); // Assuming MAX_FRAMES_IN_FLIGHT = 2
-    std::cout << "Synchronization Objects Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(
-        std::string("Failed to create synchronization objects: ") + e.what());
-  }
-
-  // Step 13: Create Vertex Buffer
-  try {
-    createVertexBuffer();
-    std::cout << "Vertex Buffer Created Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to create vertex buffer: ") +
-                             e.what());
-  }
-
-  // Step 14: Record Command Buffers
-  try {
-    for (size_t i = 0; i < commandBuffers.size(); i++) {
-      VkCommandBufferBeginInfo beginInfo{
-          VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-      beginInfo.flags = 0;
-      beginInfo.pInheritanceInfo = nullptr;
-
-      if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to begin recording command buffer!");
-      }
+  startup.addStage(
+      "Synchronization objects",
+      [this] {
+        synchronization.create(vulkanContext.getDevice(),
+                               MAX_FRAMES_IN_FLIGHT);
+      },
+      {device});
 
-      VkRenderPassBeginInfo renderPassInfo{
-          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-      renderPassInfo.renderPass = renderPass.getRenderPass();
-      renderPassInfo.framebuffer = framebuffer.getFramebuffers()[i];
-      renderPassInfo.renderArea.offset = {0, 0};
-      renderPassInfo.renderArea.extent = swapchain.getExtent();
+  // Step 13: Create Mesh. Its upload uses the graphics command pool and
+  // queue, so it follows the command buffer allocation
+  Stage meshStage =
+      startup.addStage("Mesh", [this] { createMesh(); }, {buffers});
 
-      VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-      renderPassInfo.clearValueCount = 1;
-      renderPassInfo.pClearValues = &clearColor;
+  // Step 14: Load the animated model and set up its skinning. Follows the
+  // mesh upload and lighting, which share its command pool and descriptor
+  // allocator
+  startup.addStage("Skinned model", [this] { createSkinnedModel(); },
+                   {meshStage, lighting, shaderFiles});
 
-      vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo,
-                           VK_SUBPASS_CONTENTS_INLINE);
+  // Step 15: Set up the demo camera, two units in front of the mesh, and
+  // LOD selection for it
+  Stage camera = startup.addStage(
+      "Camera",
+      [this] {
+        VkExtent2D extent = getTargetExtent();
+        view = glm::mat4(1.0f);
+        view[3][2] = -2.0f;
+        projection = DepthBuffer::perspective(
+            glm::radians(45.0f),
+            static_cast<float>(extent.width) /
+                static_cast<float>(extent.height),
+            NEAR_PLANE);
+        viewProjection = projection * view;
+        lodSelector.setCamera(glm::vec3(0.0f, 0.0f, 2.0f),
+                              glm::radians(45.0f),
+                              static_cast<float>(extent.height));
+        lights.resize(DEMO_LIGHT_COUNT);
+      },
+      {target});
 
-      vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        graphicsPipeline);
+  // Step 16: Create the scene and set up frustum culling
+  Stage sceneStage = startup.addStage(
+      "Scene",
+      [this] {
+        threadPool.create();
+        sceneCapacity = std::max(MAX_SCENE_NODES,
+                                 options.objectCount * options.instanceCount);
+        scene.createInstanceBuffer(vulkanContext, sceneCapacity,
+                                   MAX_FRAMES_IN_FLIGHT);
+        createSceneNodes();
+        frustumCuller.setFrustum(viewProjection);
+      },
+      {meshStage, camera});
 
-      // Bind vertex buffer
-      VkBuffer vertexBuffers[] = {vertexBuffer.getBuffer()};
-      VkDeviceSize offsets[] = {0};
-      vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+  // Step 17 (deferred): Set up occlusion culling against a depth pyramid.
+  // Frames draw everything until it is enabled
+  startup.addStage(
+      "Occlusion culling",
+      [this] {
+        if (!options.occlusionCulling)
+          return;
+        lateRenderPass.create(vulkanContext.getDevice(), getTargetFormat(),
+                              depthBuffer.getFormat(), useDepthPrePass, true,
+                              getSceneColorLayout(), &resourceCache);
+        mipGenerator.create(vulkanContext);
+        occlusionCuller.create(vulkanContext, commandPool, mipGenerator,
+                               depthBuffer, sceneCapacity,
+                               MAX_FRAMES_IN_FLIGHT, descriptorLayouts,
+                               persistentDescriptors);
+      },
+      {passes, buffers, sceneStage}, true);
 
-      vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
+  // Step 18 (deferred): Create the GPU Profiler
+  startup.addStage(
+      "GPU profiler",
+      [this] {
+        gpuProfiler.create(vulkanContext, MAX_FRAMES_IN_FLIGHT);
+        if (!gpuProfiler.isEnabled()) {
+          LOG_WARNING("GPU Profiler unavailable: no host query reset or "
+                      "timestamp support.");
+          if (useDynamicResolution) {
+            LOG_WARNING("Dynamic resolution has no GPU timings; rendering "
+                        "at full scale.");
+          }
+        }
+      },
+      {device}, true);
 
-      vkCmdEndRenderPass(commandBuffers[i]);
+  startup.run();
+  LOG_INFO("Vulkan initialized in %.2f ms.", startup.getElapsedMs());
+}
 
-      if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to record command buffer!");
-      }
-    }
-    std::cout << "Command Buffers Recorded Successfully." << std::endl;
-  } catch (const std::runtime_error &e) {
-    throw std::runtime_error(std::string("Failed to record command buffers: ") +
-                             e.what());
-  }
+void HelloTriangleApplication::runDeferredStartup() {
+  LOG_INFO("First frame submitted after %.2f ms.", startup.getElapsedMs());
+  // Between frames, so nothing else records or submits meanwhile
+  startup.runDeferred();
+  useOcclusionCulling = options.occlusionCulling;
+  Pipeline::releaseShaderFiles();
+  startup.logTimings();
 }
 
 void HelloTriangleApplication::mainLoop() {
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point frameStart = Clock::now();
+  startTime = frameStart;
+
+  for (uint32_t frame = 0;
+       options.frameCount == 0 || frame < options.frameCount; frame++) {
+    if (window) {
+      if (glfwWindowShouldClose(window))
+        break;
+      glfwPollEvents();
+    }
     drawFrame();
+    if (frame == 0) {
+      runDeferredStartup();
+    }
+
+    Clock::time_point frameEnd = Clock::now();
+    frameTimings.cpuMs.push_back(
+        std::chrono::duration<double, std::milli>(frameEnd - frameStart)
+            .count());
+    frameStart = frameEnd;
   }
 
   vkDeviceWaitIdle(vulkanContext.getDevice());
 }
 
 void HelloTriangleApplication::drawFrame() {
+  PROFILE_FRAME();
+  PROFILE_ZONE("drawFrame");
+
   // Wait for the current frame's fence to be signaled
-  vkWaitForFences(vulkanContext.getDevice(), 1,
-                  &synchronization.inFlightFence(currentFrame), VK_TRUE,
-                  UINT64_MAX);
+  {
+    PROFILE_ZONE("Wait for frame fence");
+    vkWaitForFences(vulkanContext.getDevice(), 1,
+                    &synchronization.inFlightFence(currentFrame), VK_TRUE,
+                    UINT64_MAX);
+  }
 
-  // Reset the fence for the next frame
-  vkResetFences(vulkanContext.getDevice(), 1,
-                &synchronization.inFlightFence(currentFrame));
+  // The fence covers every submission up to this slot's previous frame, so
+  // objects dropped during that frame or earlier are no longer in use
+  if (frameNumber >= MAX_FRAMES_IN_FLIGHT) {
+    deletionQueue.collect(frameNumber - MAX_FRAMES_IN_FLIGHT);
+  }
+  deletionQueue.setCurrentValue(frameNumber++);
 
-  // Acquire the next image from the swapchain
-  uint32_t imageIndex;
-  VkResult result = vkAcquireNextImageKHR(
-      vulkanContext.getDevice(), swapchain.getSwapchain(), UINT64_MAX,
-      synchronization.acquireSemaphore(currentFrame), VK_NULL_HANDLE,
-      &imageIndex);
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  frameDescriptors[frame].reset();
+  if (capturing) {
+    frameReadback.onFrameComplete(frame);
+  }
+
+  // Counts and timings from the last submission of this frame slot
+  if (occlusionRecorded[frame]) {
+    OcclusionStats stats = occlusionCuller.getStats(frame);
+    frameTimings.occlusionFrames++;
+    frameTimings.occlusionVisible += stats.visible;
+    frameTimings.occlusionCulled += stats.occluded;
+    occlusionRecorded[frame] = false;
+  }
+  bool resolved = gpuProfiler.beginFrame(frame);
+  if (resolved) {
+    frameTimings.gpuMs.push_back(gpuProfiler.getLastFrameMs());
+  }
+
+  // This frame's render size, from the GPU time of the slot's last frame
+  renderExtent = getTargetExtent();
+  if (useDynamicResolution) {
+    dynamicResolution.update(frame,
+                             resolved ? gpuProfiler.getLastFrameMs() : -1.0);
+    renderExtent = dynamicResolution.getRenderExtent(renderExtent);
+    frameTimings.renderScale.push_back(dynamicResolution.getScale());
+  }
+
+  // This frame's lighting inputs are no longer read by the GPU
+  float time = std::chrono::duration<float>(
+                   std::chrono::steady_clock::now() - startTime)
+                   .count();
+  updateLights(time);
+  clusteredLights.setLights(frame, lights);
+  clusteredLights.setCamera(frame, view, projection, NEAR_PLANE,
+                            LIGHT_CLUSTER_FAR, renderExtent);
+
+  // Neither is its instance region
+  scene.update(frame, &threadPool, &frustumCuller);
+
+  // Nor its joint palettes
+  if (useSkinning) {
+    for (size_t i = 0; i < skinnedInstances.size(); i++) {
+      skinnedInstances[i].time = time + i * SKINNED_PHASE_STEP;
+    }
+    frameTimings.animationTime.push_back(time);
+    skinning.update(frame, skinnedInstances, &threadPool);
+  }
+
+  // Acquire the next image from the swapchain; offscreen images are used
+  // one per frame in flight
+  uint32_t imageIndex = frame;
+  VkResult result = VK_SUCCESS;
+  if (!options.headless) {
+    PROFILE_ZONE("Acquire image");
+    result = vkAcquireNextImageKHR(
+        vulkanContext.getDevice(), swapchain.getSwapchain(), UINT64_MAX,
+        synchronization.acquireSemaphore(currentFrame), VK_NULL_HANDLE,
+        &imageIndex);
+  }
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     // Handle swapchain recreation if window is resized (not handled in this
@@ -233,30 +453,60 @@ void HelloTriangleApplication::drawFrame() {
     throw std::runtime_error("Failed to acquire swap chain image!");
   }
 
+  // Reset the fence only once work is guaranteed to be submitted
+  vkResetFences(vulkanContext.getDevice(), 1,
+                &synchronization.inFlightFence(currentFrame));
+
+  // Record this frame's commands
+  vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+  recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+
+  // Async compute runs alongside this frame's graphics work, which waits
+  // for it only at the stages consuming its results
+  submitCompute();
+
   // Submit the command buffer
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {
-      synchronization.acquireSemaphore(currentFrame)};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
+  std::vector<VkSemaphore> waitSemaphores;
+  std::vector<VkPipelineStageFlags> waitStages;
+  if (!options.headless) {
+    waitSemaphores.push_back(synchronization.acquireSemaphore(currentFrame));
+    waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  }
+  waitSemaphores.push_back(synchronization.computeSemaphore(currentFrame));
+  waitStages.push_back(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  submitInfo.waitSemaphoreCount =
+      static_cast<uint32_t>(waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
 
   submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+  submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
+  // Signaled for presentation only
   VkSemaphore signalSemaphores[] = {
       synchronization.renderSemaphore(currentFrame)};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.signalSemaphoreCount = options.headless ? 0 : 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  if (vkQueueSubmit(vulkanContext.getGraphicsQueue(), 1, &submitInfo,
-                    synchronization.inFlightFence(currentFrame)) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("Failed to submit draw command buffer!");
+  {
+    PROFILE_ZONE("Graphics submit");
+    if (vkQueueSubmit(vulkanContext.getGraphicsQueue(), 1, &submitInfo,
+                      synchronization.inFlightFence(currentFrame)) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to submit draw command buffer!");
+    }
+  }
+
+  // Offscreen images are simply rendered over again
+  if (options.headless) {
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    return;
   }
 
   // Present the image
@@ -270,7 +520,10 @@ void HelloTriangleApplication::drawFrame() {
   presentInfo.pSwapchains = swapChains;
   presentInfo.pImageIndices = &imageIndex;
 
-  result = vkQueuePresentKHR(vulkanContext.getPresentQueue(), &presentInfo);
+  {
+    PROFILE_ZONE("Present");
+    result = vkQueuePresentKHR(vulkanContext.getPresentQueue(), &presentInfo);
+  }
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
     // Handle swapchain recreation if window is resized (not handled in this
@@ -279,113 +532,535 @@ void HelloTriangleApplication::drawFrame() {
     throw std::runtime_error("Failed to present swap chain image!");
   }
 
-  currentFrame = (currentFrame + 1) % 2; // Assuming MAX_FRAMES_IN_FLIGHT = 2
+  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void HelloTriangleApplication::createVertexBuffer() {
-  // Define vertices of the triangle
-  // Vertex data
-  const std::vector<Vertex> vertices = {
-      {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}}, // Bottom vertex (Red)
-      {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},  // Top right vertex (Green)
-      {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}, // Top left vertex (Blue)
-  };
-
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-  // Create a staging buffer (host-visible)
-  Buffer stagingBuffer;
-  stagingBuffer.create(vulkanContext, bufferSize,
-                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-  // Map memory and copy vertex data
-  void *data;
-  vkMapMemory(vulkanContext.getDevice(), stagingBuffer.getMemory(), 0,
-              bufferSize, 0, &data);
-  memcpy(data, vertices.data(), (size_t)bufferSize);
-  vkUnmapMemory(vulkanContext.getDevice(), stagingBuffer.getMemory());
-
-  // Create the actual vertex buffer (device local)
-  vertexBuffer.create(vulkanContext, bufferSize,
-                      VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  // Copy data from staging buffer to vertex buffer
-  copyBuffer(stagingBuffer.getBuffer(), vertexBuffer.getBuffer(), bufferSize);
-
-  // Cleanup staging buffer
-  stagingBuffer.cleanup(vulkanContext.getDevice());
-}
+void HelloTriangleApplication::recordCommandBuffer(
+    VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  PROFILE_ZONE("Record commands");
 
-void HelloTriangleApplication::copyBuffer(VkBuffer srcBuffer,
-                                          VkBuffer dstBuffer,
-                                          VkDeviceSize size) {
-  // Allocate a temporary command buffer
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool.getCommandPool();
-  allocInfo.commandBufferCount = 1;
-
-  VkCommandBuffer commandBuffer;
-  if (vkAllocateCommandBuffers(vulkanContext.getDevice(), &allocInfo,
-                               &commandBuffer) != VK_SUCCESS) {
-    throw std::runtime_error(
-        "Failed to allocate command buffer for buffer copy!");
-  }
-
-  // Begin recording
-  VkCommandBufferBeginInfo beginInfo{};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  VkCommandBufferBeginInfo beginInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
   if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-    throw std::runtime_error(
-        "Failed to begin recording buffer copy command buffer!");
+    throw std::runtime_error("Failed to begin recording command buffer!");
+  }
+
+  // Only objects intersecting the frustum are drawn
+  frustumCuller.cull(visibleObjects, &threadPool);
+
+  // Pick each LOD once from the mesh's projected screen-space error, so
+  // every pass draws the same geometry
+  const std::vector<MeshLod> &lods = mesh.getLods();
+  visibleLods.resize(visibleObjects.size());
+  for (size_t i = 0; i < visibleObjects.size(); i++) {
+    const glm::vec4 &bounds = scene.getWorldBounds(visibleObjects[i]);
+    visibleLods[i] =
+        lodSelector.select(lods, glm::vec3(bounds), bounds.w, 1.0f,
+                           scene.getCurrentLod(visibleObjects[i]));
+    frameTimings.visibleTriangles +=
+        lods[std::min<size_t>(visibleLods[i], lods.size() - 1)].indexCount /
+        3;
   }
+  buildDrawList();
+
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  if (!useOcclusionCulling) {
+    uint32_t scope =
+        gpuProfiler.beginScope(commandBuffer, frame, "Scene pass");
+    recordScenePass(commandBuffer, renderPass.getRenderPass(), imageIndex,
+                    DrawPhase::All);
+    gpuProfiler.endScope(commandBuffer, frame, scope);
+  } else {
+    // Frustum-visible objects become draw candidates for the GPU, in draw
+    // list order so the indirect draws keep its front-to-back order
+    const std::vector<DrawItem> &items = drawList.getItems();
+    occlusionCandidates.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+      const glm::vec4 &bounds = scene.getWorldBounds(items[i].firstInstance);
+      const MeshLod &lod =
+          lods[std::min<size_t>(DrawList::unpackKey(items[i].key).lod,
+                                lods.size() - 1)];
+      OcclusionCandidate &candidate = occlusionCandidates[i];
+      candidate = {{bounds.x, bounds.y, bounds.z, bounds.w},
+                   lod.indexCount,
+                   lod.indexOffset,
+                   0,
+                   items[i].firstInstance};
+    }
+    occlusionCuller.setCandidates(frame, occlusionCandidates);
+    occlusionRecorded[frame] = true;
+
+    // Last frame's visible set, then whatever the pyramid built from it
+    // reveals
+    uint32_t scope =
+        gpuProfiler.beginScope(commandBuffer, frame, "Early cull");
+    occlusionCuller.recordEarlyCull(commandBuffer, frame);
+    gpuProfiler.endScope(commandBuffer, frame, scope);
 
-  // Copy buffer
-  VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0;
-  copyRegion.dstOffset = 0;
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    scope = gpuProfiler.beginScope(commandBuffer, frame, "Early pass");
+    recordScenePass(commandBuffer, renderPass.getRenderPass(), imageIndex,
+                    DrawPhase::OcclusionEarly);
+    gpuProfiler.endScope(commandBuffer, frame, scope);
+
+    scope = gpuProfiler.beginScope(commandBuffer, frame, "Hi-Z + late cull");
+    occlusionCuller.recordLateCull(commandBuffer, frame, viewProjection,
+                                   renderExtent);
+    gpuProfiler.endScope(commandBuffer, frame, scope);
+
+    scope = gpuProfiler.beginScope(commandBuffer, frame, "Late pass");
+    recordScenePass(commandBuffer, lateRenderPass.getRenderPass(), imageIndex,
+                    DrawPhase::OcclusionLate);
+    gpuProfiler.endScope(commandBuffer, frame, scope);
+  }
+
+  if (useDynamicResolution) {
+    uint32_t scope = gpuProfiler.beginScope(commandBuffer, frame, "Upscale");
+    recordUpscale(commandBuffer, imageIndex);
+    gpuProfiler.endScope(commandBuffer, frame, scope);
+  }
+
+  // The render pass's final layout, for barriers recorded against the
+  // image later; the upscaler tracks its own transitions
+  if (options.headless) {
+    Image &target = offscreenTarget.getImage(imageIndex);
+    if (!useDynamicResolution) {
+      target.assumeState({OffscreenTarget::kFinalLayout,
+                          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT});
+    }
+    if (capturing) {
+      frameReadback.recordCapture(commandBuffer, frame, target,
+                                  vulkanContext);
+    }
+  }
 
-  // End recording
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to record buffer copy command buffer!");
+    throw std::runtime_error("Failed to record command buffer!");
   }
+}
 
-  // Submit the command buffer
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+void HelloTriangleApplication::recordScenePass(VkCommandBuffer commandBuffer,
+                                               VkRenderPass pass,
+                                               uint32_t imageIndex,
+                                               DrawPhase phase) {
+  // Scene images are per frame in flight with dynamic resolution
+  uint32_t framebufferIndex =
+      useDynamicResolution ? static_cast<uint32_t>(currentFrame) : imageIndex;
+
+  VkRenderPassBeginInfo renderPassInfo{
+      VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  renderPassInfo.renderPass = pass;
+  renderPassInfo.framebuffer = framebuffer.getFramebuffers()[framebufferIndex];
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = renderExtent;
+
+  std::array<VkClearValue, 2> clearValues{};
+  clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  clearValues[1].depthStencil = {DepthBuffer::kClearDepth, 0};
+  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+  renderPassInfo.pClearValues = clearValues.data();
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  // Only the top-left renderExtent of the images is drawn to
+  VkViewport viewport{0.0f, 0.0f, static_cast<float>(renderExtent.width),
+                      static_cast<float>(renderExtent.height), 0.0f, 1.0f};
+  VkRect2D scissor{{0, 0}, renderExtent};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  // Shared by the pre-pass and main pipelines through their common layout
+  CameraConstants camera;
+  std::memcpy(camera.viewProj, &viewProjection[0][0], sizeof(camera.viewProj));
+  std::memcpy(camera.view, &view[0][0], sizeof(camera.view));
+  vkCmdPushConstants(commandBuffer, pipelineLayout.get(),
+                     VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(camera), &camera);
+  VkDescriptorSet lightingSet =
+      clusteredLights.getDescriptorSet(static_cast<uint32_t>(currentFrame));
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout.get(), 0, 1, &lightingSet, 0,
+                          nullptr);
+
+  if (renderPass.hasDepthPrePass()) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      depthPrePassPipeline.get());
+    drawVisibleObjects(commandBuffer, phase, DRAW_PASS_DEPTH,
+                       depthPrePassPipeline.get());
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  }
 
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    graphicsPipeline.get());
+  drawVisibleObjects(commandBuffer, phase, DRAW_PASS_MAIN,
+                     graphicsPipeline.get());
+
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void HelloTriangleApplication::recordUpscale(VkCommandBuffer commandBuffer,
+                                             uint32_t imageIndex) {
+  UpscaleTarget target;
+  target.view = getTargetImageViews()[imageIndex];
+  target.extent = getTargetExtent();
+  if (options.headless) {
+    // Read by captures
+    target.trackedImage = &offscreenTarget.getImage(imageIndex);
+    target.image = target.trackedImage->getImage();
+    target.finalState = {OffscreenTarget::kFinalLayout,
+                         VK_PIPELINE_STAGE_2_COPY_BIT,
+                         VK_ACCESS_2_TRANSFER_READ_BIT};
+  } else {
+    target.image = swapchain.getImages()[imageIndex];
+  }
+
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  upscaler.record(commandBuffer, frame, renderExtent, target,
+                  frameDescriptors[frame], vulkanContext);
+}
+
+void HelloTriangleApplication::buildDrawList() {
+  PROFILE_ZONE("Sort draws");
+
+  // The occlusion culling path only takes the main pass's order
+  bool depthPass = renderPass.hasDepthPrePass() && !useOcclusionCulling;
+  drawList.clear();
+  for (size_t i = 0; i < visibleObjects.size(); i++) {
+    const glm::vec4 &bounds = scene.getWorldBounds(visibleObjects[i]);
+    float viewDepth = -(view * glm::vec4(glm::vec3(bounds), 1.0f)).z;
+
+    DrawKeyFields fields;
+    fields.pass = DRAW_PASS_MAIN;
+    fields.pipeline = DRAW_PIPELINE_MAIN;
+    fields.mesh = visibleObjects[i] / options.instanceCount;
+    fields.lod = visibleLods[i];
+    fields.depth =
+        DrawList::depthBucket(viewDepth, NEAR_PLANE, LIGHT_CLUSTER_FAR);
+    drawList.add(fields, visibleObjects[i]);
+    if (depthPass) {
+      fields.pass = DRAW_PASS_DEPTH;
+      fields.pipeline = DRAW_PIPELINE_DEPTH;
+      drawList.add(fields, visibleObjects[i]);
+    }
+  }
+  drawList.sort(&threadPool);
+}
+
+void HelloTriangleApplication::drawVisibleObjects(
+    VkCommandBuffer commandBuffer, DrawPhase phase, uint32_t drawPass,
+    VkPipeline pipeline) {
+  VkBuffer instanceBuffer = scene.getInstanceBuffer();
+  VkDeviceSize instanceOffset =
+      scene.getInstanceBufferOffset(static_cast<uint32_t>(currentFrame));
+  vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer,
+                         &instanceOffset);
+
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  switch (phase) {
+  case DrawPhase::All: {
+    DrawBindState bound;
+    bound.pipeline = pipeline;
+    frameTimings.drawCalls +=
+        drawList.record(commandBuffer, drawPass, drawBindings, bound);
+    break;
+  }
+  case DrawPhase::OcclusionEarly:
+    mesh.bind(commandBuffer);
+    occlusionCuller.drawEarly(commandBuffer, frame);
+    break;
+  case DrawPhase::OcclusionLate:
+    mesh.bind(commandBuffer);
+    occlusionCuller.drawLate(commandBuffer, frame);
+    break;
+  }
+
+  // Skinned instances are not culled; the first pass of a frame draws them
+  if (useSkinning && phase != DrawPhase::OcclusionLate) {
+    skinning.draw(commandBuffer, frame, skinnedMesh, 0);
+  }
+}
+
+void HelloTriangleApplication::submitCompute() {
+  PROFILE_ZONE("Compute submit");
+
+  VkCommandBuffer commandBuffer = computeCommandBuffers[currentFrame];
+  vkResetCommandBuffer(commandBuffer, 0);
+
+  VkCommandBufferBeginInfo beginInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording compute commands!");
+  }
+  recordComputeCommands(commandBuffer);
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record compute commands!");
+  }
+
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores =
+      &synchronization.computeSemaphore(currentFrame);
 
-  // No semaphores to wait on or signal in this case
-  if (vkQueueSubmit(vulkanContext.getGraphicsQueue(), 1, &submitInfo,
+  // The frame fence covers this submission too, since the graphics
+  // submission waits on it
+  if (vkQueueSubmit(vulkanContext.getComputeQueue(), 1, &submitInfo,
                     VK_NULL_HANDLE) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to submit buffer copy command buffer!");
+    throw std::runtime_error("Failed to submit compute command buffer!");
+  }
+}
+
+void HelloTriangleApplication::recordComputeCommands(
+    VkCommandBuffer commandBuffer) {
+  // Compute passes (culling, skinning, light assignment) record here.
+  // Buffers they hand to graphics are shared CONCURRENT between the
+  // compute and graphics families, so no ownership transfer is recorded
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  uint32_t scope;
+  if (useSkinning) {
+    scope = gpuProfiler.beginScope(commandBuffer, frame, "Skinning",
+                                   GpuProfiler::Queue::Compute);
+    skinning.recordSkinning(commandBuffer, frame);
+    gpuProfiler.endScope(commandBuffer, frame, scope);
+  }
+
+  scope = gpuProfiler.beginScope(commandBuffer, frame, "Light culling",
+                                 GpuProfiler::Queue::Compute);
+  clusteredLights.recordCulling(commandBuffer, frame);
+  gpuProfiler.endScope(commandBuffer, frame, scope);
+}
+
+void HelloTriangleApplication::updateLights(float time) {
+  // Lights orbiting the mesh on a few rings at different speeds
+  for (uint32_t i = 0; i < lights.size(); i++) {
+    float t = static_cast<float>(i) / static_cast<float>(lights.size());
+    float ring = static_cast<float>(i % 4);
+    float angle = t * 6.2831853f * 8.0f + time * (0.5f + 0.25f * ring);
+    float distance = 0.2f + 0.15f * ring;
+
+    PointLight &light = lights[i];
+    light.position[0] = distance * std::cos(angle);
+    light.position[1] = distance * std::sin(angle);
+    light.position[2] = 0.1f + 0.05f * ring;
+    light.radius = 0.3f;
+    light.color[0] = 0.5f + 0.5f * std::cos(t * 6.2831853f);
+    light.color[1] = 0.5f + 0.5f * std::cos(t * 6.2831853f + 2.094f);
+    light.color[2] = 0.5f + 0.5f * std::cos(t * 6.2831853f + 4.189f);
+    light.intensity = 0.05f;
+  }
+}
+
+void HelloTriangleApplication::createMesh() {
+  MeshData data;
+  if (options.vertexCount <= 3) {
+    // Define vertices of the triangle
+    data.vertices = {
+        // Bottom vertex (Red)
+        {{0.0f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+        // Top right vertex (Green)
+        {{0.5f, 0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+        // Top left vertex (Blue)
+        {{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
+    };
+    data.indices = {0, 1, 2};
+  } else {
+    // A grid over the same unit square with at least vertexCount vertices
+    uint32_t side = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(options.vertexCount))));
+    float step = 1.0f / static_cast<float>(side - 1);
+    for (uint32_t y = 0; y < side; y++) {
+      for (uint32_t x = 0; x < side; x++) {
+        float u = x * step;
+        float v = y * step;
+        data.vertices.push_back(
+            {{u - 0.5f, v - 0.5f, 0.0f}, {u, v, 1.0f - u}, {0.0f, 0.0f, 1.0f}});
+      }
+    }
+    for (uint32_t y = 0; y + 1 < side; y++) {
+      for (uint32_t x = 0; x + 1 < side; x++) {
+        uint32_t i = y * side + x;
+        data.indices.insert(data.indices.end(), {i, i + 1, i + side,
+                                                 i + 1, i + side + 1,
+                                                 i + side});
+      }
+    }
   }
 
-  // Wait for the queue to finish
-  vkQueueWaitIdle(vulkanContext.getGraphicsQueue());
+  // Run the same import-time stage as loaded models (fills bounds and LODs)
+  MeshImporter importer;
+  importer.optimize(data, MeshImportOptions{});
 
-  // Free the command buffer
-  vkFreeCommandBuffers(vulkanContext.getDevice(), commandPool.getCommandPool(),
-                       1, &commandBuffer);
+  mesh.create(vulkanContext, commandPool, data);
 }
+
+void HelloTriangleApplication::createSkinnedModel() {
+  if (options.skinnedModel.empty() || options.skinnedInstances == 0)
+    return;
+
+  MeshImportOptions importOptions;
+  importOptions.importSkin = true;
+  MeshImporter importer;
+  MeshData data = importer.load(options.skinnedModel, importOptions);
+  skinnedMesh.create(vulkanContext, commandPool, data);
+  skinning.create(vulkanContext, commandPool, data, options.skinnedInstances,
+                  MAX_FRAMES_IN_FLIGHT, descriptorLayouts,
+                  persistentDescriptors);
+
+  // Instances 0.2 units across in a row in front of the synthetic scene;
+  // drawFrame puts each out of step with its neighbours
+  glm::vec3 center(data.boundsCenter[0], data.boundsCenter[1],
+                   data.boundsCenter[2]);
+  float scale = 0.1f / std::max(data.boundsRadius, 1e-6f);
+  uint32_t count = options.skinnedInstances;
+  skinnedInstances.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec3 position((i + 0.5f) / count - 0.5f, 0.0f, 0.2f);
+    glm::mat4 &world = skinnedInstances[i].world;
+    world = glm::mat4(scale);
+    world[3] = glm::vec4(position - center * scale, 1.0f);
+  }
+  useSkinning = true;
+}
+
+void HelloTriangleApplication::createSceneNodes() {
+  const float *center = mesh.getBoundsCenter();
+  glm::vec3 boundsCenter(center[0], center[1], center[2]);
+  uint32_t nodeCount = options.objectCount * options.instanceCount;
+
+  // A single node keeps the demo mesh where the camera looks; larger
+  // scenes fill a square grid of the same size
+  uint32_t side = static_cast<uint32_t>(
+      std::ceil(std::sqrt(static_cast<double>(nodeCount))));
+  float spacing = 1.0f / static_cast<float>(side);
+  float scale = nodeCount > 1 ? 0.8f * spacing : 1.0f;
+
+  for (uint32_t i = 0; i < nodeCount; i++) {
+    glm::mat4 transform(scale);
+    transform[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    if (nodeCount > 1) {
+      transform[3].x = ((i % side) + 0.5f) * spacing - 0.5f;
+      transform[3].y = ((i / side) + 0.5f) * spacing - 0.5f;
+    }
+    uint32_t node = scene.addNode(Scene::kNoParent, transform);
+    scene.setBounds(node, boundsCenter, mesh.getBoundsRadius());
+  }
+  drawBindings.meshes.assign(options.objectCount, &mesh);
+}
+
+VkExtent2D HelloTriangleApplication::getTargetExtent() const {
+  return options.headless ? offscreenTarget.getExtent()
+                          : swapchain.getExtent();
+}
+
+VkFormat HelloTriangleApplication::getTargetFormat() const {
+  return options.headless ? offscreenTarget.getFormat()
+                          : swapchain.getFormat();
+}
+
+VkImageLayout HelloTriangleApplication::getTargetColorLayout() const {
+  return options.headless ? OffscreenTarget::kFinalLayout
+                          : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
+VkImageUsageFlags HelloTriangleApplication::getTargetUsage() const {
+  return options.headless ? offscreenTarget.getUsage() : swapchain.getUsage();
+}
+
+const std::vector<VkImageView> &
+HelloTriangleApplication::getTargetImageViews() const {
+  return options.headless ? offscreenTarget.getImageViews()
+                          : swapchain.getImageViews();
+}
+
+VkImageLayout HelloTriangleApplication::getSceneColorLayout() const {
+  return useDynamicResolution ? Upscaler::kSourceLayout
+                              : getTargetColorLayout();
+}
+
+const std::vector<VkImageView> &
+HelloTriangleApplication::getSceneImageViews() const {
+  return useDynamicResolution ? upscaler.getSourceViews()
+                              : getTargetImageViews();
+}
+
 void HelloTriangleApplication::cleanup() {
+  for (const GpuScopeTiming &timing : gpuProfiler.getTimings()) {
+    LOG_INFO("GPU %s: %.3f ms average", timing.name.c_str(),
+             timing.averageMs);
+  }
+  if (frameTimings.occlusionFrames > 0) {
+    LOG_INFO("Occlusion culling: %.1f visible, %.1f culled per frame",
+             static_cast<double>(frameTimings.occlusionVisible) /
+                 frameTimings.occlusionFrames,
+             static_cast<double>(frameTimings.occlusionCulled) /
+                 frameTimings.occlusionFrames);
+  }
+  if (!options.gpuTracePath.empty() &&
+      !gpuProfiler.writeTrace(options.gpuTracePath)) {
+    LOG_ERROR("Failed to write %s", options.gpuTracePath.c_str());
+  }
+  gpuProfiler.cleanup(vulkanContext.getDevice());
+
+#ifdef VALKEON_ENABLE_PROFILER
+  CpuProfiler::stop();
+  FrameTimeStats frameStats = CpuProfiler::getFrameStats();
+  LOG_INFO("CPU frame time over %u frames: p50 %.3f ms, p95 %.3f ms, "
+           "p99 %.3f ms",
+           frameStats.frameCount, frameStats.p50Ms, frameStats.p95Ms,
+           frameStats.p99Ms);
+  if (!options.cpuTracePath.empty() &&
+      !CpuProfiler::writeTrace(options.cpuTracePath)) {
+    LOG_ERROR("Failed to write %s", options.cpuTracePath.c_str());
+  }
+  if (!options.frameHistogramPath.empty() &&
+      !CpuProfiler::writeHistogram(options.frameHistogramPath)) {
+    LOG_ERROR("Failed to write %s", options.frameHistogramPath.c_str());
+  }
+#endif
+  clusteredLights.cleanup(vulkanContext.getDevice());
+  occlusionCuller.cleanup(vulkanContext.getDevice());
+  mipGenerator.cleanup(vulkanContext.getDevice());
+  threadPool.cleanup();
+  scene.cleanup(vulkanContext.getDevice());
+  skinning.cleanup(vulkanContext.getDevice());
+  skinnedMesh.cleanup(vulkanContext.getDevice());
+  mesh.cleanup(vulkanContext.getDevice());
   synchronization.cleanup(vulkanContext.getDevice());
+  computeCommandPool.cleanup(vulkanContext.getDevice());
   commandPool.cleanup(vulkanContext.getDevice());
   framebuffer.cleanup(vulkanContext.getDevice());
+  upscaler.cleanup(vulkanContext.getDevice());
+  lateRenderPass.cleanup(vulkanContext.getDevice());
   renderPass.cleanup(vulkanContext.getDevice());
+  depthBuffer.cleanup(vulkanContext.getDevice());
+  if (capturing) {
+    frameReadback.cleanup(vulkanContext.getDevice());
+    frameTimings.capturedFrames = frameReadback.getWrittenCount();
+    frameTimings.captureStalls = frameReadback.getStallCount();
+  }
+  offscreenTarget.cleanup(vulkanContext.getDevice());
   swapchain.cleanup(vulkanContext.getDevice());
+  depthPrePassPipeline.reset();
+  graphicsPipeline.reset();
+  pipelineLayout.reset();
+  resourceCache.cleanup();
+  deletionQueue.cleanup();
+  for (DescriptorAllocator &descriptors : frameDescriptors) {
+    descriptors.cleanup();
+  }
+  persistentDescriptors.cleanup();
+  descriptorLayouts.cleanup();
+  if (windowSurface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(vulkanContext.getInstance(), windowSurface, nullptr);
+  }
   vulkanContext.cleanup();
-  glfwDestroyWindow(window);
-  glfwTerminate();
+  if (window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
 }
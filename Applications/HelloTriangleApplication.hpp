@@ -5,50 +5,266 @@
 
 // Core components
 #include "Buffer.hpp"
+#include "ClusteredLights.hpp"
 #include "CommandPool.hpp"
+#include "CpuProfiler.hpp"
+#include "DeletionQueue.hpp"
+#include "DepthBuffer.hpp"
+#include "DescriptorAllocator.hpp"
+#include "DrawList.hpp"
+#include "DynamicResolution.hpp"
 #include "Framebuffer.hpp"
+#include "FrameReadback.hpp"
+#include "FrustumCuller.hpp"
+#include "GpuProfiler.hpp"
+#include "LodSelector.hpp"
+#include "Mesh.hpp"
+#include "MipGenerator.hpp"
+#include "OcclusionCuller.hpp"
+#include "OffscreenTarget.hpp"
 #include "Pipeline.hpp"
 #include "RenderPass.hpp"
+#include "ResourceCache.hpp"
+#include "Scene.hpp"
+#include "Skinning.hpp"
+#include "StartupScheduler.hpp"
 #include "Swapchain.hpp"
 #include "Synchronization.hpp"
+#include "ThreadPool.hpp"
+#include "Upscaler.hpp"
 #include "VulkanContext.hpp"
 
 #include "Utils.hpp"
 
+#include <array>
+#include <chrono>
+#include <string>
 #include <vector>
 
+// How the application runs; the defaults open a window on the demo scene
+struct AppOptions {
+  // Render into offscreen images, with no window, surface or swapchain
+  bool headless = false;
+  uint32_t width = 800;
+  uint32_t height = 600;
+  // Frames to render before returning; 0 runs until the window is closed
+  uint32_t frameCount = 0;
+  bool validation = true;
+  // GPU index or part of its name; empty picks the best scoring one
+  std::string device;
+  bool occlusionCulling = true;
+  // Depth-only subpass before the color subpass; without occlusion culling
+  // it lays down the depth the color subpass tests against
+  bool depthPrePass = false;
+  // Synthetic scene: objectCount objects of instanceCount instances each,
+  // sharing one grid mesh of about vertexCount vertices. The defaults give
+  // the single demo triangle
+  uint32_t objectCount = 1;
+  uint32_t instanceCount = 1;
+  uint32_t vertexCount = 3;
+  // Animated model drawn skinnedInstances times in a row across the view,
+  // looping its first clip; none when empty
+  std::string skinnedModel;
+  uint32_t skinnedInstances = 1;
+  // Headless only: writes every frame to capturePath, a printf pattern
+  // given the frame number for PPM and PNG, or one file for raw
+  std::string capturePath;
+  CaptureFormat captureFormat = CaptureFormat::Png;
+  // GPU time per frame that dynamic resolution aims for; 0 renders at full
+  // resolution. The scene is rendered at minRenderScale to 1 times the
+  // target size per axis and upscaled, sharpened by upscaleSharpness (0 is
+  // plain bilinear, 1 the strongest)
+  float frameBudgetMs = 0.0f;
+  float minRenderScale = 0.5f;
+  float upscaleSharpness = 0.3f;
+  // Chrome trace of the last GPU profiler frames, written at exit; none
+  // when empty
+  std::string gpuTracePath;
+  // VALKEON_PROFILER builds: Chrome trace of the CPU zones and histogram
+  // of frame times, written at exit; none when empty
+  std::string cpuTracePath;
+  std::string frameHistogramPath;
+};
+
+// Measurements of one run
+struct FrameTimings {
+  std::vector<double> cpuMs; // drawFrame to drawFrame
+  std::vector<double> gpuMs; // GPU profiler, for frames that resolved
+  // Triangles of the frustum-visible objects, summed over every frame
+  uint64_t visibleTriangles = 0;
+  // Draw calls recorded from the draw list, summed over every frame; the
+  // occlusion culling path draws indirectly instead
+  uint64_t drawCalls = 0;
+  // Occlusion culling results summed over occlusionFrames, the frames whose
+  // counts were read back
+  uint32_t occlusionFrames = 0;
+  uint64_t occlusionVisible = 0;
+  uint64_t occlusionCulled = 0;
+  // Frames written to disk and captures that waited for a free buffer
+  uint32_t capturedFrames = 0;
+  uint32_t captureStalls = 0;
+  // Render scale per axis of every frame, with dynamic resolution
+  std::vector<double> renderScale;
+  // Animation time in seconds of every frame, with skinned instances
+  std::vector<double> animationTime;
+};
+
 class HelloTriangleApplication {
 public:
-  HelloTriangleApplication() = default;
+  explicit HelloTriangleApplication(const AppOptions &options = {})
+      : options(options) {}
   void run();
 
+  const FrameTimings &getFrameTimings() const { return frameTimings; }
+
   void initWindow();
   void initVulkan();
   void mainLoop();
   void cleanup();
 
 private:
-  GLFWwindow *window;
+  static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+  static constexpr uint32_t MAX_SCENE_NODES = 1024;
+  static constexpr uint32_t MAX_LIGHTS = 1024;
+  static constexpr uint32_t DEMO_LIGHT_COUNT = 256;
+  static constexpr float NEAR_PLANE = 0.1f;
+  static constexpr float LIGHT_CLUSTER_FAR = 100.0f;
+
+  AppOptions options;
+  FrameTimings frameTimings;
+  GLFWwindow *window = nullptr;
+  VkSurfaceKHR windowSurface = VK_NULL_HANDLE;
 
+  // Initialization stages; the deferred ones run after the first frame
+  StartupScheduler startup;
   VulkanContext vulkanContext;
+  // Destroys objects once the frames that used them have completed;
+  // declared before the handles it owns
+  DeletionQueue deletionQueue;
+  // Shared views, render passes and framebuffers
+  ResourceCache resourceCache;
+  // Set layouts shared by every subsystem; long-lived sets, and transient
+  // sets reset with their frame
+  DescriptorLayoutCache descriptorLayouts;
+  DescriptorAllocator persistentDescriptors;
+  std::vector<DescriptorAllocator> frameDescriptors;
   Swapchain swapchain;
+  OffscreenTarget offscreenTarget; // replaces the swapchain when headless
+  FrameReadback frameReadback;     // when capturing offscreen frames
+  bool capturing = false;
+  // Captures in flight or being written before recording waits
+  static constexpr uint32_t CAPTURE_RING_SIZE = MAX_FRAMES_IN_FLIGHT + 3;
+  // Renders the scene below full resolution when frames miss
+  // options.frameBudgetMs, then scales it up into the target
+  bool useDynamicResolution = false;
+  DynamicResolution dynamicResolution;
+  Upscaler upscaler;
+  VkExtent2D renderExtent{}; // this frame's part of the scene images
   RenderPass renderPass;
+  RenderPass lateRenderPass; // loads the first pass's results
+  DepthBuffer depthBuffer;
   Framebuffer framebuffer;
   Pipeline pipeline;
+  QueuedHandle<VkPipelineLayout> pipelineLayout;
+  QueuedHandle<VkPipeline> graphicsPipeline;
+  // Lays down depth first so the main pass shades each pixel once; pays off
+  // when overdraw and fragment cost are high
+  bool useDepthPrePass = false;
+  QueuedHandle<VkPipeline> depthPrePassPipeline;
   CommandPool commandPool;
   std::vector<VkCommandBuffer> commandBuffers;
+  CommandPool computeCommandPool;
+  std::vector<VkCommandBuffer> computeCommandBuffers;
   Synchronization synchronization;
 
-  // Vertex Buffer
-  Buffer vertexBuffer;
-  VkDeviceMemory vertexBufferMemory;
+  // Geometry and LOD selection; each object's current LOD lives in the
+  // scene
+  Mesh mesh;
+  LodSelector lodSelector;
+
+  // Animated instances, skinned on the compute queue and drawn by every
+  // pass from the skinned vertices
+  bool useSkinning = false;
+  Mesh skinnedMesh;
+  Skinning skinning;
+  std::vector<SkinnedInstance> skinnedInstances;
+  static constexpr float SKINNED_PHASE_STEP = 0.37f; // seconds
+
+  // Scene objects and visibility. Nodes are added object by object, so an
+  // object's instances have consecutive instance indices
+  Scene scene;
+  uint32_t sceneCapacity = MAX_SCENE_NODES;
+  ThreadPool threadPool;
+  FrustumCuller frustumCuller;
+  std::vector<uint32_t> visibleObjects;
+  std::vector<uint32_t> visibleLods;
+
+  // Visible draws sorted by state and depth. Each object is its own mesh
+  // in the keys, so objects stay separate draws while their shared
+  // buffers are bound once
+  DrawList drawList;
+  DrawBindings drawBindings;
+  static constexpr uint32_t DRAW_PASS_DEPTH = 0;
+  static constexpr uint32_t DRAW_PASS_MAIN = 1;
+  static constexpr uint32_t DRAW_PIPELINE_MAIN = 0;
+  static constexpr uint32_t DRAW_PIPELINE_DEPTH = 1;
+
+  // Demo camera
+  glm::mat4 view{1.0f};
+  glm::mat4 projection{1.0f};
+  glm::mat4 viewProjection{1.0f};
+
+  // Dynamic point lights, assigned to clusters on the compute queue
+  ClusteredLights clusteredLights;
+  std::vector<PointLight> lights;
+
+  // Two-phase occlusion culling on the GPU; follows options once its
+  // deferred startup stage has run
+  bool useOcclusionCulling = false;
+  MipGenerator mipGenerator;
+  OcclusionCuller occlusionCuller;
+  std::vector<OcclusionCandidate> occlusionCandidates;
+  // Frame slots whose last submission was culled, so their counts are
+  // this run's
+  std::array<bool, MAX_FRAMES_IN_FLIGHT> occlusionRecorded{};
+
+  // GPU pass timings
+  GpuProfiler gpuProfiler;
 
   // Frame tracking
   size_t currentFrame = 0;
+  uint64_t frameNumber = 0; // value of the deletion queue
+  // Animation time origin; glfwGetTime needs GLFW, which headless runs
+  // never initialize
+  std::chrono::steady_clock::time_point startTime;
 
+  void runDeferredStartup();
   void drawFrame();
-  void createVertexBuffer();
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-  void recordCommandBuffers(VkPipeline vk_pipeline,
-                            VkPipelineLayout pipeline_layout);
+  void createMesh();
+  void createSceneNodes();
+  void createSkinnedModel();
+  VkExtent2D getTargetExtent() const;
+  VkFormat getTargetFormat() const;
+  VkImageLayout getTargetColorLayout() const;
+  VkImageUsageFlags getTargetUsage() const;
+  const std::vector<VkImageView> &getTargetImageViews() const;
+  // What the scene passes render into: the target, or the upscaler's
+  // sources with dynamic resolution
+  VkImageLayout getSceneColorLayout() const;
+  const std::vector<VkImageView> &getSceneImageViews() const;
+  void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+  void updateLights(float time);
+  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+  enum class DrawPhase { All, OcclusionEarly, OcclusionLate };
+
+  void recordScenePass(VkCommandBuffer commandBuffer, VkRenderPass pass,
+                       uint32_t imageIndex, DrawPhase phase);
+  void buildDrawList();
+  // pipeline is the one the caller bound for the subpass, drawing drawPass
+  void drawVisibleObjects(VkCommandBuffer commandBuffer, DrawPhase phase,
+                          uint32_t drawPass, VkPipeline pipeline);
+  // Light culling runs every frame, so there is always a submission for
+  // the graphics submission to wait on
+  void submitCompute();
+  void recordComputeCommands(VkCommandBuffer commandBuffer);
 };
@@ -0,0 +1,254 @@
+#include "Animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// SSE is part of every x86-64 target, so no runtime check is needed
+#if defined(__SSE2__) || defined(_M_X64) ||                                 \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_SSE
+#include <xmmintrin.h>
+#endif
+
+void Skeleton::computePalette(glm::mat4 *joints, const glm::mat4 &world,
+                              glm::mat4 *palette) const {
+  for (size_t joint = 0; joint < parents.size(); joint++) {
+    if (parents[joint] != kNoParent) {
+      joints[joint] = joints[parents[joint]] * joints[joint];
+    }
+    palette[joint] = world * joints[joint] * inverseBindMatrices[joint];
+  }
+}
+
+void AnimationClip::create(const std::string &name, float duration,
+                           const Skeleton &skeleton) {
+  if (skeleton.getJointCount() == 0) {
+    throw std::runtime_error("Cannot animate a skeleton without joints!");
+  }
+
+  this->name = name;
+  this->duration = std::max(duration, 0.0f);
+  // One more frame than intervals, so the last one lands on the end
+  frameCount =
+      static_cast<uint32_t>(std::ceil(this->duration * kSampleRate)) + 1;
+  jointCount = skeleton.getJointCount();
+  groupCount = (jointCount + 3) / 4;
+
+  JointGroup identity{};
+  for (int lane = 0; lane < 4; lane++) {
+    identity.rotation[3][lane] = 1.0f;
+    for (int k = 0; k < 3; k++) {
+      identity.scale[k][lane] = 1.0f;
+    }
+  }
+  groups.assign(size_t(frameCount) * groupCount, identity);
+
+  for (uint32_t frame = 0; frame < frameCount; frame++) {
+    for (uint32_t joint = 0; joint < jointCount; joint++) {
+      setPose(frame, joint, skeleton.bindPose[joint]);
+    }
+  }
+}
+
+void AnimationClip::setPose(uint32_t frame, uint32_t joint,
+                            const JointPose &pose) {
+  JointGroup &group = groups[size_t(frame) * groupCount + joint / 4];
+  uint32_t lane = joint % 4;
+  for (int k = 0; k < 3; k++) {
+    group.translation[k][lane] = pose.translation[k];
+    group.scale[k][lane] = pose.scale[k];
+  }
+  for (int k = 0; k < 4; k++) {
+    group.rotation[k][lane] = pose.rotation[k];
+  }
+}
+
+void AnimationClip::alignRotations() {
+  for (uint32_t frame = 1; frame < frameCount; frame++) {
+    for (uint32_t g = 0; g < groupCount; g++) {
+      const JointGroup &previous = groups[size_t(frame - 1) * groupCount + g];
+      JointGroup &current = groups[size_t(frame) * groupCount + g];
+      for (int lane = 0; lane < 4; lane++) {
+        float dot = 0.0f;
+        for (int k = 0; k < 4; k++) {
+          dot += previous.rotation[k][lane] * current.rotation[k][lane];
+        }
+        if (dot < 0.0f) {
+          for (int k = 0; k < 4; k++) {
+            current.rotation[k][lane] = -current.rotation[k][lane];
+          }
+        }
+      }
+    }
+  }
+}
+
+void AnimationClip::sample(float time, bool loop,
+                           glm::mat4 *localTransforms) const {
+  if (loop && duration > 0.0f) {
+    time = std::fmod(time, duration);
+    if (time < 0.0f) {
+      time += duration;
+    }
+  } else {
+    time = std::clamp(time, 0.0f, duration);
+  }
+
+  float position = time * kSampleRate;
+  uint32_t frame0 =
+      std::min(static_cast<uint32_t>(position), frameCount - 1);
+  uint32_t frame1 = std::min(frame0 + 1, frameCount - 1);
+  float alpha = std::min(position - static_cast<float>(frame0), 1.0f);
+
+#ifdef ANIMATION_SSE
+  if (simdEnabled) {
+    sampleGroups(frame0, frame1, alpha, localTransforms);
+    return;
+  }
+#endif
+  sampleGroupsScalar(frame0, frame1, alpha, localTransforms);
+}
+
+// Scale, then rotate, then translate
+static void composeMatrix(const float translation[3], const float rotation[4],
+                          const float scale[3], glm::mat4 &matrix) {
+  float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+  float xx = x * x, yy = y * y, zz = z * z;
+  float xy = x * y, xz = x * z, yz = y * z;
+  float wx = w * x, wy = w * y, wz = w * z;
+
+  matrix[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz),
+                        2.0f * (xz - wy), 0.0f) *
+              scale[0];
+  matrix[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz),
+                        2.0f * (yz + wx), 0.0f) *
+              scale[1];
+  matrix[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx),
+                        1.0f - 2.0f * (xx + yy), 0.0f) *
+              scale[2];
+  matrix[3] = glm::vec4(translation[0], translation[1], translation[2], 1.0f);
+}
+
+void AnimationClip::sampleGroupsScalar(uint32_t frame0, uint32_t frame1,
+                                       float alpha,
+                                       glm::mat4 *localTransforms) const {
+  const JointGroup *from = &groups[size_t(frame0) * groupCount];
+  const JointGroup *to = &groups[size_t(frame1) * groupCount];
+
+  for (uint32_t joint = 0; joint < jointCount; joint++) {
+    const JointGroup &a = from[joint / 4];
+    const JointGroup &b = to[joint / 4];
+    uint32_t lane = joint % 4;
+
+    float translation[3], rotation[4], scale[3];
+    for (int k = 0; k < 3; k++) {
+      translation[k] = a.translation[k][lane] +
+                       (b.translation[k][lane] - a.translation[k][lane]) *
+                           alpha;
+      scale[k] =
+          a.scale[k][lane] + (b.scale[k][lane] - a.scale[k][lane]) * alpha;
+    }
+    float lengthSquared = 0.0f;
+    for (int k = 0; k < 4; k++) {
+      rotation[k] = a.rotation[k][lane] +
+                    (b.rotation[k][lane] - a.rotation[k][lane]) * alpha;
+      lengthSquared += rotation[k] * rotation[k];
+    }
+    float inverseLength = 1.0f / std::sqrt(lengthSquared);
+    for (float &component : rotation) {
+      component *= inverseLength;
+    }
+
+    composeMatrix(translation, rotation, scale, localTransforms[joint]);
+  }
+}
+
+#ifdef ANIMATION_SSE
+static inline __m128 lerp(__m128 a, __m128 b, __m128 alpha) {
+  return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), alpha));
+}
+
+void AnimationClip::sampleGroups(uint32_t frame0, uint32_t frame1,
+                                 float alpha,
+                                 glm::mat4 *localTransforms) const {
+  const JointGroup *from = &groups[size_t(frame0) * groupCount];
+  const JointGroup *to = &groups[size_t(frame1) * groupCount];
+  const __m128 weight = _mm_set1_ps(alpha);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+
+  for (uint32_t g = 0; g < groupCount; g++) {
+    const JointGroup &a = from[g];
+    const JointGroup &b = to[g];
+
+    __m128 t[3], q[4], s[3];
+    for (int k = 0; k < 3; k++) {
+      t[k] = lerp(_mm_load_ps(a.translation[k]), _mm_load_ps(b.translation[k]),
+                  weight);
+      s[k] = lerp(_mm_load_ps(a.scale[k]), _mm_load_ps(b.scale[k]), weight);
+    }
+    for (int k = 0; k < 4; k++) {
+      q[k] = lerp(_mm_load_ps(a.rotation[k]), _mm_load_ps(b.rotation[k]),
+                  weight);
+    }
+
+    __m128 lengthSquared = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(q[0], q[0]), _mm_mul_ps(q[1], q[1])),
+        _mm_add_ps(_mm_mul_ps(q[2], q[2]), _mm_mul_ps(q[3], q[3])));
+    __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+    __m128 x = _mm_mul_ps(q[0], inverseLength);
+    __m128 y = _mm_mul_ps(q[1], inverseLength);
+    __m128 z = _mm_mul_ps(q[2], inverseLength);
+    __m128 w = _mm_mul_ps(q[3], inverseLength);
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    // Component c of column k for the four joints, as in composeMatrix
+    __m128 columns[4][4] = {
+        {_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))),
+         _mm_mul_ps(two, _mm_add_ps(xy, wz)),
+         _mm_mul_ps(two, _mm_sub_ps(xz, wy)), zero},
+        {_mm_mul_ps(two, _mm_sub_ps(xy, wz)),
+         _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))),
+         _mm_mul_ps(two, _mm_add_ps(yz, wx)), zero},
+        {_mm_mul_ps(two, _mm_add_ps(xz, wy)),
+         _mm_mul_ps(two, _mm_sub_ps(yz, wx)),
+         _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), zero},
+        {t[0], t[1], t[2], one},
+    };
+    for (int k = 0; k < 3; k++) {
+      for (int c = 0; c < 3; c++) {
+        columns[k][c] = _mm_mul_ps(columns[k][c], s[k]);
+      }
+    }
+
+    // Turns each column from one component per register into one joint
+    // per register
+    glm::mat4 partial[4];
+    uint32_t first = g * 4;
+    glm::mat4 *out =
+        first + 4 <= jointCount ? localTransforms + first : partial;
+    for (int k = 0; k < 4; k++) {
+      _MM_TRANSPOSE4_PS(columns[k][0], columns[k][1], columns[k][2],
+                        columns[k][3]);
+      for (int lane = 0; lane < 4; lane++) {
+        _mm_storeu_ps(&out[lane][k][0], columns[k][lane]);
+      }
+    }
+    if (out == partial) {
+      std::copy(partial, partial + (jointCount - first),
+                localTransforms + first);
+    }
+  }
+}
+#else
+void AnimationClip::sampleGroups(uint32_t frame0, uint32_t frame1,
+                                 float alpha,
+                                 glm::mat4 *localTransforms) const {
+  sampleGroupsScalar(frame0, frame1, alpha, localTransforms);
+}
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Transform of a joint relative to its parent. rotation is a unit
+// quaternion stored as (x, y, z, w)
+struct JointPose {
+  glm::vec3 translation{0.0f};
+  glm::vec4 rotation{0.0f, 0.0f, 0.0f, 1.0f};
+  glm::vec3 scale{1.0f};
+};
+
+// Joint hierarchy of a skinned mesh. Parents precede their children, so a
+// single pass in order turns local transforms into model-space ones
+struct Skeleton {
+  static constexpr int32_t kNoParent = -1;
+
+  std::vector<std::string> names;
+  std::vector<int32_t> parents;
+  std::vector<glm::mat4> inverseBindMatrices; // model space to joint space
+  std::vector<JointPose> bindPose;
+
+  uint32_t getJointCount() const {
+    return static_cast<uint32_t>(parents.size());
+  }
+
+  // joints holds local transforms on entry and model-space ones on return.
+  // palette receives world * joint * inverse bind matrix for every joint
+  void computePalette(glm::mat4 *joints, const glm::mat4 &world,
+                      glm::mat4 *palette) const;
+};
+
+// An animation resampled at a fixed rate and stored four joints at a time,
+// component by component. Sampling blends two frames with no key search and
+// builds the matrices of four joints per SIMD operation. Rotations of
+// consecutive frames are kept in one hemisphere, so the normalized lerp
+// between them never takes the long way round
+class AnimationClip {
+
+public:
+  static constexpr float kSampleRate = 30.0f;
+
+  // Every frame starts out in the skeleton's bind pose
+  void create(const std::string &name, float duration,
+              const Skeleton &skeleton);
+  void setPose(uint32_t frame, uint32_t joint, const JointPose &pose);
+  // Call once every pose is set
+  void alignRotations();
+
+  // Writes the local transform of every joint at time, in seconds. Looping
+  // clips wrap time around, others hold their first and last frames
+  void sample(float time, bool loop, glm::mat4 *localTransforms) const;
+
+  // Scalar evaluation, for comparing against the SIMD path
+  void setSimdEnabled(bool enabled) { simdEnabled = enabled; }
+
+  const std::string &getName() const { return name; }
+  float getDuration() const { return duration; }
+  uint32_t getFrameCount() const { return frameCount; }
+  uint32_t getJointCount() const { return jointCount; }
+
+private:
+  // Four joints of one frame; padding joints hold the identity
+  struct alignas(16) JointGroup {
+    float translation[3][4];
+    float rotation[4][4];
+    float scale[3][4];
+  };
+
+  std::string name;
+  float duration = 0.0f;
+  uint32_t frameCount = 0;
+  uint32_t jointCount = 0;
+  uint32_t groupCount = 0;
+  std::vector<JointGroup> groups; // frame-major
+  bool simdEnabled = true;
+
+  void sampleGroups(uint32_t frame0, uint32_t frame1, float alpha,
+                    glm::mat4 *localTransforms) const;
+  void sampleGroupsScalar(uint32_t frame0, uint32_t frame1, float alpha,
+                          glm::mat4 *localTransforms) const;
+};
@@ -1,6 +1,8 @@
 #include "Buffer.hpp"
 #include "VulkanContext.hpp"
 
+#include <algorithm>
+
 Buffer::Buffer(Buffer &&other) noexcept
     : buffer(other.buffer), bufferMemory(other.bufferMemory) {
   other.buffer = VK_NULL_HANDLE;
@@ -20,7 +22,8 @@ Buffer &Buffer::operator=(Buffer &&other) noexcept {
 
 void Buffer::create(VulkanContext &context, VkDeviceSize size,
                     VkBufferUsageFlags usage,
-                    VkMemoryPropertyFlags properties) {
+                    VkMemoryPropertyFlags properties,
+                    const std::vector<uint32_t> &queueFamilies) {
   // Create buffer
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -29,6 +32,16 @@ void Buffer::create(VulkanContext &context, VkDeviceSize size,
   bufferInfo.sharingMode =
       VK_SHARING_MODE_EXCLUSIVE; // Assume exclusive for simplicity
 
+  std::vector<uint32_t> families(queueFamilies);
+  std::sort(families.begin(), families.end());
+  families.erase(std::unique(families.begin(), families.end()),
+                 families.end());
+  if (families.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+    bufferInfo.pQueueFamilyIndices = families.data();
+  }
+
   if (vkCreateBuffer(context.getDevice(), &bufferInfo, nullptr, &buffer) !=
       VK_SUCCESS) {
     throw std::runtime_error("Failed to create buffer!");
@@ -54,6 +67,45 @@ void Buffer::create(VulkanContext &context, VkDeviceSize size,
   vkBindBufferMemory(context.getDevice(), buffer, bufferMemory, 0);
 }
 
+void Buffer::createDeviceLocal(VulkanContext &context,
+                               CommandPool &commandPool, const void *data,
+                               VkDeviceSize size, VkBufferUsageFlags usage,
+                               const std::vector<uint32_t> &queueFamilies) {
+  // Create a staging buffer (host-visible)
+  Buffer stagingBuffer;
+  stagingBuffer.create(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  void *mapped;
+  vkMapMemory(context.getDevice(), stagingBuffer.getMemory(), 0, size, 0,
+              &mapped);
+  memcpy(mapped, data, static_cast<size_t>(size));
+  vkUnmapMemory(context.getDevice(), stagingBuffer.getMemory());
+
+  create(context, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilies);
+
+  copy(context, commandPool, stagingBuffer.getBuffer(), buffer, size);
+
+  stagingBuffer.cleanup(context.getDevice());
+}
+
+void Buffer::copy(VulkanContext &context, CommandPool &commandPool,
+                  VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+  VkCommandBuffer commandBuffer =
+      commandPool.beginSingleTimeCommands(context.getDevice());
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = 0;
+  copyRegion.dstOffset = 0;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+  commandPool.endSingleTimeCommands(context.getDevice(),
+                                    context.getGraphicsQueue(), commandBuffer);
+}
+
 void Buffer::cleanup(VkDevice device) {
   if (buffer != VK_NULL_HANDLE) {
     vkDestroyBuffer(device, buffer, nullptr);
@@ -63,11 +115,17 @@ void Buffer::cleanup(VkDevice device) {
   }
 }
 
+void Buffer::cleanup(DeletionQueue &deletionQueue) {
+  deletionQueue.destroy(buffer);
+  deletionQueue.destroy(bufferMemory);
+  buffer = VK_NULL_HANDLE;
+  bufferMemory = VK_NULL_HANDLE;
+}
+
 uint32_t Buffer::findMemoryType(VulkanContext &context, uint32_t typeFilter,
                                 VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(context.getPhysicalDevice(),
-                                      &memProperties);
+  const VkPhysicalDeviceMemoryProperties &memProperties =
+      context.getCapabilities().memory;
 
   for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
     if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
@@ -1,9 +1,13 @@
 #pragma once
 
-#include <VulkanContext.hpp>
+#include "CommandPool.hpp"
+#include "DeletionQueue.hpp"
+#include "VulkanContext.hpp"
+
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
+#include <vector>
 #include <vulkan/vulkan.h>
 
 class Buffer {
@@ -20,12 +24,29 @@ public:
   Buffer(Buffer &&other) noexcept;
   Buffer &operator=(Buffer &&other) noexcept;
 
-  // Creates a buffer and allocates memory
+  // Creates a buffer and allocates memory. With more than one distinct
+  // queue family the buffer is shared concurrently, so queues can use it
+  // without ownership transfers
   void create(VulkanContext &context, VkDeviceSize size,
-              VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+              VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+              const std::vector<uint32_t> &queueFamilies = {});
+
+  // Creates a device-local buffer and fills it through a staging buffer;
+  // queueFamilies as for create
+  void createDeviceLocal(VulkanContext &context, CommandPool &commandPool,
+                         const void *data, VkDeviceSize size,
+                         VkBufferUsageFlags usage,
+                         const std::vector<uint32_t> &queueFamilies = {});
+
+  // Copies size bytes between buffers and waits for the copy to complete
+  static void copy(VulkanContext &context, CommandPool &commandPool,
+                   VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
   // Cleans up the buffer and frees memory
   void cleanup(VkDevice device);
+  // Hands the buffer and its memory to the queue, for buffers that frames
+  // in flight may still read
+  void cleanup(DeletionQueue &deletionQueue);
 
   // Returns the buffer handle
   VkBuffer getBuffer() const { return buffer; }
@@ -33,11 +54,11 @@ public:
   // Returns the memory handle
   VkDeviceMemory getMemory() const { return bufferMemory; }
 
+  // Finds a memory type index matching typeFilter and properties
+  static uint32_t findMemoryType(VulkanContext &context, uint32_t typeFilter,
+                                 VkMemoryPropertyFlags properties);
+
 private:
   VkBuffer buffer = VK_NULL_HANDLE;
   VkDeviceMemory bufferMemory = VK_NULL_HANDLE;
-
-  // Helper functions
-  uint32_t findMemoryType(VulkanContext &context, uint32_t typeFilter,
-                          VkMemoryPropertyFlags properties);
 };
@@ -0,0 +1,195 @@
+#include "ClusteredLights.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static constexpr uint32_t kGroupSize = 128;
+
+// Matches LightingUniforms in Shaders/clusters.glsl (std140)
+struct LightingUniforms {
+  glm::mat4 view;
+  glm::mat4 inverseProjection;
+  float screenSize[2];
+  float nearPlane;
+  float farPlane;
+  float sliceScale;
+  float sliceBias;
+  uint32_t lightCount;
+};
+
+void ClusteredLights::create(VulkanContext &context, uint32_t maxLights,
+                             uint32_t framesInFlight,
+                             DescriptorLayoutCache &layoutCache,
+                             DescriptorAllocator &descriptors) {
+  VkDevice device = context.getDevice();
+
+  const VkPhysicalDeviceSubgroupProperties &subgroupProperties =
+      context.getCapabilities().subgroup;
+
+  VkSubgroupFeatureFlags required =
+      VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+  if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) ||
+      (subgroupProperties.supportedOperations & required) != required) {
+    throw std::runtime_error(
+        "Light culling requires subgroup arithmetic and ballot in compute!");
+  }
+
+  this->maxLights = maxLights;
+  std::vector<uint32_t> queueFamilies = {
+      context.getGraphicsQueueFamilyIndex(),
+      context.getComputeQueueFamilyIndex()};
+
+  frames.resize(framesInFlight);
+  for (Frame &frame : frames) {
+    frame.uniforms.create(context, sizeof(LightingUniforms),
+                          VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          queueFamilies);
+    if (vkMapMemory(device, frame.uniforms.getMemory(), 0,
+                    sizeof(LightingUniforms), 0,
+                    &frame.mappedUniforms) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map lighting uniforms!");
+    }
+    *static_cast<LightingUniforms *>(frame.mappedUniforms) = {};
+
+    VkDeviceSize lightsSize = VkDeviceSize(maxLights) * sizeof(PointLight);
+    frame.lights.create(context, lightsSize,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        queueFamilies);
+    void *data;
+    if (vkMapMemory(device, frame.lights.getMemory(), 0, lightsSize, 0,
+                    &data) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map light buffer!");
+    }
+    frame.mappedLights = static_cast<PointLight *>(data);
+
+    frame.clusters.create(context,
+                          VkDeviceSize(kClusterCount) * 2 * sizeof(uint32_t),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilies);
+
+    // Counter, then the lists of every cluster back to back
+    frame.lightIndices.create(
+        context,
+        (1 + VkDeviceSize(kClusterCount) * kAverageLightsPerCluster) *
+            sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilies);
+  }
+
+  createDescriptors(device, layoutCache, descriptors);
+  cullPipeline.create(device, "Shaders/light_cull.comp.spv",
+                      {descriptorSetLayout});
+}
+
+void ClusteredLights::createDescriptors(VkDevice device,
+                                        DescriptorLayoutCache &layoutCache,
+                                        DescriptorAllocator &descriptors) {
+  // Shared with the graphics pipeline, whose fragment stage reads the
+  // lights and the cluster lists
+  std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+  for (uint32_t i = 0; i < 4; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags =
+        VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  }
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorSetLayout = layoutCache.getLayout(bindings);
+
+  for (Frame &frame : frames) {
+    frame.descriptorSet = descriptors.allocate(descriptorSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[4] = {
+        {frame.uniforms.getBuffer(), 0, VK_WHOLE_SIZE},
+        {frame.lights.getBuffer(), 0, VK_WHOLE_SIZE},
+        {frame.clusters.getBuffer(), 0, VK_WHOLE_SIZE},
+        {frame.lightIndices.getBuffer(), 0, VK_WHOLE_SIZE},
+    };
+
+    VkWriteDescriptorSet writes[4]{};
+    for (uint32_t binding = 0; binding < 4; binding++) {
+      writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[binding].dstSet = frame.descriptorSet;
+      writes[binding].dstBinding = binding;
+      writes[binding].descriptorCount = 1;
+      writes[binding].descriptorType = bindings[binding].descriptorType;
+      writes[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+  }
+}
+
+void ClusteredLights::cleanup(VkDevice device) {
+  cullPipeline.cleanup(device);
+  descriptorSetLayout = VK_NULL_HANDLE;
+
+  for (Frame &frame : frames) {
+    if (frame.mappedUniforms) {
+      vkUnmapMemory(device, frame.uniforms.getMemory());
+    }
+    if (frame.mappedLights) {
+      vkUnmapMemory(device, frame.lights.getMemory());
+    }
+    frame.uniforms.cleanup(device);
+    frame.lights.cleanup(device);
+    frame.clusters.cleanup(device);
+    frame.lightIndices.cleanup(device);
+  }
+  frames.clear();
+}
+
+void ClusteredLights::setLights(uint32_t frameIndex,
+                                const std::vector<PointLight> &lights) {
+  if (lights.size() > maxLights) {
+    throw std::runtime_error("Too many lights for the light buffer!");
+  }
+  Frame &frame = frames[frameIndex];
+  std::copy(lights.begin(), lights.end(), frame.mappedLights);
+  static_cast<LightingUniforms *>(frame.mappedUniforms)->lightCount =
+      static_cast<uint32_t>(lights.size());
+}
+
+void ClusteredLights::setCamera(uint32_t frameIndex, const glm::mat4 &view,
+                                const glm::mat4 &projection, float nearPlane,
+                                float farPlane, VkExtent2D extent) {
+  LightingUniforms *uniforms =
+      static_cast<LightingUniforms *>(frames[frameIndex].mappedUniforms);
+  uniforms->view = view;
+  uniforms->inverseProjection = glm::inverse(projection);
+  uniforms->screenSize[0] = static_cast<float>(extent.width);
+  uniforms->screenSize[1] = static_cast<float>(extent.height);
+  uniforms->nearPlane = nearPlane;
+  uniforms->farPlane = farPlane;
+
+  // slice = log(depth / near) / log(far / near) * slices
+  float logRatio = std::log(farPlane / nearPlane);
+  uniforms->sliceScale = kClustersZ / logRatio;
+  uniforms->sliceBias = kClustersZ * std::log(nearPlane) / logRatio;
+}
+
+void ClusteredLights::recordCulling(VkCommandBuffer commandBuffer,
+                                    uint32_t frameIndex) {
+  const Frame &frame = frames[frameIndex];
+
+  vkCmdFillBuffer(commandBuffer, frame.lightIndices.getBuffer(), 0,
+                  sizeof(uint32_t), 0);
+
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  cullPipeline.bind(commandBuffer);
+  cullPipeline.bindDescriptorSet(commandBuffer, frame.descriptorSet);
+  vkCmdDispatch(commandBuffer,
+                ComputePipeline::groupCount(kClusterCount, kGroupSize), 1, 1);
+}
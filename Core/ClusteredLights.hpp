@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "ComputePipeline.hpp"
+#include "DescriptorAllocator.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Matches PointLight in Shaders/clusters.glsl
+struct PointLight {
+  float position[3]; // world space
+  float radius;      // no influence beyond this distance
+  float color[3];
+  float intensity;
+};
+
+// Clustered forward lighting. The view frustum is split into a grid of
+// screen tiles and exponential depth slices; a compute pass assigns the
+// lights to the clusters they touch every frame, and fragment shaders read
+// only their own cluster's compact light list. The descriptor set (set 0)
+// is shared by the compute pass and the graphics pipeline
+class ClusteredLights {
+
+public:
+  // Keep in sync with Shaders/clusters.glsl
+  static constexpr uint32_t kClustersX = 16;
+  static constexpr uint32_t kClustersY = 9;
+  static constexpr uint32_t kClustersZ = 24;
+  static constexpr uint32_t kClusterCount =
+      kClustersX * kClustersY * kClustersZ;
+  // Average list length the shared index list is sized for
+  static constexpr uint32_t kAverageLightsPerCluster = 32;
+
+  // The buffers are shared by the graphics and compute queue families, so
+  // the light assignment can run on either queue. The set layout comes
+  // from layoutCache and the per-frame sets from descriptors, which must
+  // not be reset while the sets are in use
+  void create(VulkanContext &context, uint32_t maxLights,
+              uint32_t framesInFlight, DescriptorLayoutCache &layoutCache,
+              DescriptorAllocator &descriptors);
+  void cleanup(VkDevice device);
+
+  // Per-frame inputs; the frame's fence must have signaled. Lights beyond
+  // farPlane are not assigned to any cluster
+  void setLights(uint32_t frameIndex, const std::vector<PointLight> &lights);
+  void setCamera(uint32_t frameIndex, const glm::mat4 &view,
+                 const glm::mat4 &projection, float nearPlane, float farPlane,
+                 VkExtent2D extent);
+
+  // Records the light assignment. Submitted to another queue, the graphics
+  // submission must wait for it at the fragment shader stage
+  void recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+  VkDescriptorSetLayout getDescriptorSetLayout() const {
+    return descriptorSetLayout;
+  }
+  VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const {
+    return frames[frameIndex].descriptorSet;
+  }
+
+private:
+  struct Frame {
+    Buffer uniforms;
+    void *mappedUniforms = nullptr;
+    Buffer lights;
+    PointLight *mappedLights = nullptr;
+    Buffer clusters;     // offset and count per cluster
+    Buffer lightIndices; // counter followed by the compact lists
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  };
+
+  uint32_t maxLights = 0;
+  std::vector<Frame> frames;
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE; // cached
+  ComputePipeline cullPipeline;
+
+  void createDescriptors(VkDevice device, DescriptorLayoutCache &layoutCache,
+                         DescriptorAllocator &descriptors);
+};
@@ -11,6 +11,14 @@ public:
                               std::vector<VkCommandBuffer> &commandBuffers);
   void cleanup(VkDevice device);
 
+  // Allocates and begins a one-time-submit command buffer
+  VkCommandBuffer beginSingleTimeCommands(VkDevice device);
+
+  // Ends and submits a one-time command buffer, waits for the queue to finish
+  // and frees it
+  void endSingleTimeCommands(VkDevice device, VkQueue queue,
+                             VkCommandBuffer commandBuffer);
+
   VkCommandPool getCommandPool() const { return commandPool; }
 
 private:
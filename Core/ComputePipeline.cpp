@@ -0,0 +1,77 @@
+#include "ComputePipeline.hpp"
+
+#include "Pipeline.hpp"
+
+#include <stdexcept>
+
+void ComputePipeline::create(
+    VkDevice device, const std::string &shaderFile,
+    const std::vector<VkDescriptorSetLayout> &setLayouts,
+    uint32_t pushConstantSize, const VkSpecializationInfo *specialization) {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.size = pushConstantSize;
+
+  VkPipelineLayoutCreateInfo layoutInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+  layoutInfo.pSetLayouts = setLayouts.data();
+  if (pushConstantSize > 0) {
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+  }
+
+  if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create compute pipeline layout!");
+  }
+
+  VkShaderModule shaderModule = Pipeline::loadShaderModule(device, shaderFile);
+
+  VkComputePipelineCreateInfo pipelineInfo{
+      VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.pSpecializationInfo = specialization;
+  pipelineInfo.layout = pipelineLayout;
+
+  VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1,
+                                             &pipelineInfo, nullptr, &pipeline);
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create compute pipeline!");
+  }
+}
+
+void ComputePipeline::cleanup(VkDevice device) {
+  if (pipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+    pipeline = VK_NULL_HANDLE;
+  }
+  if (pipelineLayout != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    pipelineLayout = VK_NULL_HANDLE;
+  }
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer) const {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+}
+
+void ComputePipeline::bindDescriptorSet(VkCommandBuffer commandBuffer,
+                                        VkDescriptorSet descriptorSet,
+                                        uint32_t setIndex) const {
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, setIndex, 1, &descriptorSet, 0,
+                          nullptr);
+}
+
+void ComputePipeline::pushConstants(VkCommandBuffer commandBuffer,
+                                    const void *data, uint32_t size) const {
+  vkCmdPushConstants(commandBuffer, pipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, size, data);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// A compute shader with its pipeline layout. Push constants, when used, are
+// a single range visible to the compute stage
+class ComputePipeline {
+
+public:
+  void create(VkDevice device, const std::string &shaderFile,
+              const std::vector<VkDescriptorSetLayout> &setLayouts,
+              uint32_t pushConstantSize = 0,
+              const VkSpecializationInfo *specialization = nullptr);
+  void cleanup(VkDevice device);
+
+  void bind(VkCommandBuffer commandBuffer) const;
+  void bindDescriptorSet(VkCommandBuffer commandBuffer,
+                         VkDescriptorSet descriptorSet,
+                         uint32_t setIndex = 0) const;
+  void pushConstants(VkCommandBuffer commandBuffer, const void *data,
+                     uint32_t size) const;
+
+  // Workgroups needed to cover threadCount invocations
+  static uint32_t groupCount(uint32_t threadCount, uint32_t groupSize) {
+    return (threadCount + groupSize - 1) / groupSize;
+  }
+
+  VkPipeline getPipeline() const { return pipeline; }
+  VkPipelineLayout getLayout() const { return pipelineLayout; }
+
+private:
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+};
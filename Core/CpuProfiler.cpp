@@ -0,0 +1,278 @@
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+static void writeJsonString(std::ostream &out, const char *text) {
+  out << '"';
+  for (; *text; text++) {
+    if (*text == '"' || *text == '\\')
+      out << '\\';
+    out << *text;
+  }
+  out << '"';
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double> &sorted, double p) {
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+CpuProfiler::~CpuProfiler() { shutdown(); }
+
+CpuProfiler &CpuProfiler::instance() {
+  static CpuProfiler profiler;
+  return profiler;
+}
+
+CpuProfiler::ThreadBuffer &CpuProfiler::threadBuffer() {
+  // The profiler owns the ring, so zones of a finished thread can still be
+  // collected
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (!buffer) {
+    CpuProfiler &profiler = instance();
+    std::lock_guard<std::mutex> lock(profiler.buffersMutex);
+    profiler.buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffer = profiler.buffers.back().get();
+    buffer->threadIndex = static_cast<uint32_t>(profiler.buffers.size() - 1);
+  }
+  return *buffer;
+}
+
+void CpuProfiler::start() {
+  CpuProfiler &profiler = instance();
+  std::lock_guard<std::mutex> lock(profiler.collectorMutex);
+  if (profiler.running)
+    return;
+
+  // The collector is stopped, so the rings' tails are ours
+  profiler.session.fetch_add(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> buffersLock(profiler.buffersMutex);
+    for (const std::unique_ptr<ThreadBuffer> &buffer : profiler.buffers) {
+      buffer->tail.store(buffer->head.load(std::memory_order_acquire),
+                         std::memory_order_release);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> framesLock(profiler.framesMutex);
+    profiler.currentZones.clear();
+    profiler.frames.clear();
+    profiler.frameTimes.clear();
+  }
+
+  profiler.running = true;
+  profiler.collector = std::thread(&CpuProfiler::collectorLoop, &profiler);
+}
+
+void CpuProfiler::stop() { instance().shutdown(); }
+
+void CpuProfiler::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(collectorMutex);
+    if (!running)
+      return;
+    running = false;
+  }
+  collectorCondition.notify_one();
+  collector.join();
+
+  // Whatever was recorded after the last pass
+  collect();
+}
+
+void CpuProfiler::setThreadName(const char *name) {
+  ThreadBuffer &buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(instance().buffersMutex);
+  buffer.name = name;
+}
+
+void CpuProfiler::record(const char *name, uint64_t begin, uint64_t end) {
+  ThreadBuffer &buffer = threadBuffer();
+  uint32_t head = buffer.head.load(std::memory_order_relaxed);
+  if (head - buffer.tail.load(std::memory_order_acquire) >= kRingSize)
+    return;
+
+  buffer.zones[head & (kRingSize - 1)] = {name, begin, end};
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::markFrame() {
+  ThreadBuffer &buffer = threadBuffer();
+  uint64_t time = now();
+  // The first mark of a session only opens a frame
+  uint32_t session = instance().session.load(std::memory_order_relaxed);
+  if (buffer.lastFrameMark != 0 && buffer.markSession == session) {
+    record(nullptr, buffer.lastFrameMark, time);
+  }
+  buffer.lastFrameMark = time;
+  buffer.markSession = session;
+}
+
+void CpuProfiler::collectorLoop() {
+  std::unique_lock<std::mutex> lock(collectorMutex);
+  while (running) {
+    collectorCondition.wait_for(lock, std::chrono::milliseconds(1),
+                                [this] { return !running; });
+    lock.unlock();
+    collect();
+    lock.lock();
+  }
+}
+
+void CpuProfiler::collect() {
+  std::vector<ThreadBuffer *> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    snapshot.reserve(buffers.size());
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers) {
+      snapshot.push_back(buffer.get());
+    }
+  }
+
+  std::vector<TraceZone> zones;
+  std::vector<Zone> frameMarks;
+  for (ThreadBuffer *buffer : snapshot) {
+    uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+    uint32_t head = buffer->head.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+      const Zone &zone = buffer->zones[tail & (kRingSize - 1)];
+      if (zone.name) {
+        zones.push_back({zone.name, buffer->threadIndex, zone.begin,
+                         zone.end});
+      } else {
+        frameMarks.push_back(zone);
+      }
+    }
+    buffer->tail.store(head, std::memory_order_release);
+  }
+
+  std::lock_guard<std::mutex> lock(framesMutex);
+  currentZones.insert(currentZones.end(), zones.begin(), zones.end());
+
+  // Every zone that began before a frame's end belongs to it
+  std::sort(frameMarks.begin(), frameMarks.end(),
+            [](const Zone &a, const Zone &b) { return a.end < b.end; });
+  for (const Zone &mark : frameMarks) {
+    Frame frame{mark.begin, mark.end, {}};
+    auto split = std::partition(
+        currentZones.begin(), currentZones.end(),
+        [&](const TraceZone &zone) { return zone.begin < mark.end; });
+    frame.zones.assign(currentZones.begin(), split);
+    currentZones.erase(currentZones.begin(), split);
+
+    frameTimes.push_back((mark.end - mark.begin) * 1e-6);
+    if (frameTimes.size() > kMaxFrameTimes) {
+      frameTimes.pop_front();
+    }
+    frames.push_back(std::move(frame));
+    if (frames.size() > kRetainedFrames) {
+      frames.pop_front();
+    }
+  }
+}
+
+FrameTimeStats CpuProfiler::getFrameStats() {
+  CpuProfiler &profiler = instance();
+  std::vector<double> sorted;
+  {
+    std::lock_guard<std::mutex> lock(profiler.framesMutex);
+    sorted.assign(profiler.frameTimes.begin(), profiler.frameTimes.end());
+  }
+
+  FrameTimeStats stats;
+  if (sorted.empty())
+    return stats;
+
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0.0;
+  for (double time : sorted) {
+    sum += time;
+  }
+  stats.frameCount = static_cast<uint32_t>(sorted.size());
+  stats.averageMs = sum / sorted.size();
+  stats.p50Ms = percentile(sorted, 0.50);
+  stats.p95Ms = percentile(sorted, 0.95);
+  stats.p99Ms = percentile(sorted, 0.99);
+  stats.maxMs = sorted.back();
+  return stats;
+}
+
+bool CpuProfiler::writeTrace(const std::string &path) {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+
+  CpuProfiler &profiler = instance();
+  std::lock_guard<std::mutex> framesLock(profiler.framesMutex);
+  std::lock_guard<std::mutex> buffersLock(profiler.buffersMutex);
+
+  // Thread tracks, then one for the frames themselves
+  uint32_t frameTrack = static_cast<uint32_t>(profiler.buffers.size());
+  out << "{\"traceEvents\":[\n";
+  for (const std::unique_ptr<ThreadBuffer> &buffer : profiler.buffers) {
+    std::string name = buffer->name.empty()
+                           ? "Thread " + std::to_string(buffer->threadIndex)
+                           : buffer->name;
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+        << buffer->threadIndex << ",\"args\":{\"name\":";
+    writeJsonString(out, name.c_str());
+    out << "}},\n";
+  }
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+      << frameTrack << ",\"args\":{\"name\":\"Frames\"}}";
+
+  // Microseconds since the first retained frame
+  uint64_t origin = profiler.frames.empty() ? 0 : profiler.frames[0].begin;
+  auto writeEvent = [&](const char *name, uint32_t track, uint64_t begin,
+                        uint64_t end) {
+    out << ",\n{\"name\":";
+    writeJsonString(out, name);
+    out << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << track
+        << ",\"ts\":" << static_cast<int64_t>(begin - origin) * 1e-3
+        << ",\"dur\":" << (end - begin) * 1e-3 << "}";
+  };
+
+  out << std::fixed << std::setprecision(3);
+  for (const Frame &frame : profiler.frames) {
+    writeEvent("Frame", frameTrack, frame.begin, frame.end);
+    for (const TraceZone &zone : frame.zones) {
+      writeEvent(zone.name, zone.threadIndex, zone.begin, zone.end);
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return static_cast<bool>(out);
+}
+
+bool CpuProfiler::writeHistogram(const std::string &path) {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+
+  FrameTimeStats stats = getFrameStats();
+  std::vector<uint32_t> buckets;
+  {
+    CpuProfiler &profiler = instance();
+    std::lock_guard<std::mutex> lock(profiler.framesMutex);
+    for (double time : profiler.frameTimes) {
+      size_t bucket = static_cast<size_t>(time / kHistogramBucketMs);
+      if (bucket >= buckets.size()) {
+        buckets.resize(bucket + 1, 0);
+      }
+      buckets[bucket]++;
+    }
+  }
+
+  out << std::fixed << std::setprecision(3);
+  out << "# frames " << stats.frameCount << ", average " << stats.averageMs
+      << " ms, p50 " << stats.p50Ms << " ms, p95 " << stats.p95Ms
+      << " ms, p99 " << stats.p99Ms << " ms, max " << stats.maxMs << " ms\n";
+  out << "bucket_ms,frames\n";
+  for (size_t i = 0; i < buckets.size(); i++) {
+    out << i * kHistogramBucketMs << "," << buckets[i] << "\n";
+  }
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scoped CPU zones. PROFILE_ZONE("name") times the rest of the enclosing
+// block, PROFILE_FRAME() starts a new frame and PROFILE_THREAD("name") names
+// the calling thread's track. All compile to nothing unless the build
+// defines VALKEON_ENABLE_PROFILER (CMake option VALKEON_PROFILER).
+#ifdef VALKEON_ENABLE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() CpuProfiler::markFrame()
+#define PROFILE_THREAD(name) CpuProfiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+// Frame times since the collector started
+struct FrameTimeStats {
+  uint32_t frameCount = 0;
+  double averageMs = 0.0;
+  double p50Ms = 0.0;
+  double p95Ms = 0.0;
+  double p99Ms = 0.0;
+  double maxMs = 0.0;
+};
+
+// Every thread records its zones into its own fixed-size ring, written only
+// by that thread and read only by the collector, so recording is a couple
+// of clock reads and one release store. A collector thread drains the rings
+// every millisecond and merges them into the retained frames. Zones are
+// dropped, not blocked on, when a ring is full.
+class CpuProfiler {
+
+public:
+  static constexpr uint32_t kRingSize = 1u << 14; // zones per thread
+  static constexpr uint32_t kRetainedFrames = 512; // kept for the trace
+  static constexpr double kHistogramBucketMs = 0.5;
+  static constexpr size_t kMaxFrameTimes = 1u << 20;
+
+  // Starts and stops the collector thread. Starting begins a new session:
+  // the frames of earlier ones and zones recorded while stopped are
+  // dropped, and each thread's next frame mark only opens a frame
+  static void start();
+  static void stop();
+
+  // Names this thread's track in the trace
+  static void setThreadName(const char *name);
+
+  static uint64_t now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+  // name must be a string literal or otherwise outlive the profiler
+  static void record(const char *name, uint64_t begin, uint64_t end);
+  static void markFrame();
+
+  static FrameTimeStats getFrameStats();
+
+  // Chrome trace event JSON of the retained frames, one track per thread
+  static bool writeTrace(const std::string &path);
+  // Percentiles, then the count of frames in each kHistogramBucketMs bucket
+  static bool writeHistogram(const std::string &path);
+
+private:
+  struct Zone {
+    const char *name; // nullptr marks a frame boundary
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  // Single producer, single consumer
+  struct ThreadBuffer {
+    Zone zones[kRingSize];
+    std::atomic<uint32_t> head{0}; // written by the owning thread
+    std::atomic<uint32_t> tail{0}; // written by the collector
+    uint64_t lastFrameMark = 0;
+    uint32_t markSession = 0; // session of lastFrameMark
+    uint32_t threadIndex = 0;
+    std::string name;
+  };
+
+  struct TraceZone {
+    const char *name;
+    uint32_t threadIndex;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  struct Frame {
+    uint64_t begin;
+    uint64_t end;
+    std::vector<TraceZone> zones;
+  };
+
+  std::mutex buffersMutex; // guards the list, not the rings
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+  std::thread collector;
+  std::mutex collectorMutex;
+  std::condition_variable collectorCondition;
+  bool running = false;
+  std::atomic<uint32_t> session{0};
+
+  // Owned by the collector while it runs; guarded by framesMutex
+  std::mutex framesMutex;
+  std::vector<TraceZone> currentZones; // not yet in a finished frame
+  std::deque<Frame> frames;
+  std::deque<double> frameTimes; // milliseconds
+
+  ~CpuProfiler();
+
+  static CpuProfiler &instance();
+  static ThreadBuffer &threadBuffer();
+
+  void shutdown();
+  void collectorLoop();
+  void collect();
+};
+
+// Records the enclosing scope as a zone; used through PROFILE_ZONE
+class CpuZone {
+
+public:
+  explicit CpuZone(const char *name)
+      : name(name), begin(CpuProfiler::now()) {}
+  ~CpuZone() { CpuProfiler::record(name, begin, CpuProfiler::now()); }
+
+  CpuZone(const CpuZone &) = delete;
+  CpuZone &operator=(const CpuZone &) = delete;
+
+private:
+  const char *name;
+  uint64_t begin;
+};
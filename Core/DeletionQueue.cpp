@@ -0,0 +1,87 @@
+#include "DeletionQueue.hpp"
+
+// Inverse of the conversion in push
+template <typename Handle> static Handle toHandle(uint64_t bits) {
+  return reinterpret_cast<Handle>(static_cast<uintptr_t>(bits));
+}
+
+void DeletionQueue::create(VkDevice device) { this->device = device; }
+
+void DeletionQueue::cleanup() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const Entry &entry : entries) {
+    destroyEntry(entry);
+  }
+  entries.clear();
+}
+
+void DeletionQueue::setCurrentValue(uint64_t value) {
+  std::lock_guard<std::mutex> lock(mutex);
+  currentValue = value;
+}
+
+uint64_t DeletionQueue::getCurrentValue() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return currentValue;
+}
+
+size_t DeletionQueue::getPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+void DeletionQueue::collect(uint64_t completedValue) {
+  std::lock_guard<std::mutex> lock(mutex);
+  while (!entries.empty() && entries.front().value <= completedValue) {
+    destroyEntry(entries.front());
+    entries.pop_front();
+  }
+}
+
+void DeletionQueue::destroyEntry(const Entry &entry) {
+  switch (entry.type) {
+  case VK_OBJECT_TYPE_BUFFER:
+    vkDestroyBuffer(device, toHandle<VkBuffer>(entry.handle), nullptr);
+    break;
+  case VK_OBJECT_TYPE_IMAGE:
+    vkDestroyImage(device, toHandle<VkImage>(entry.handle), nullptr);
+    break;
+  case VK_OBJECT_TYPE_IMAGE_VIEW:
+    vkDestroyImageView(device, toHandle<VkImageView>(entry.handle), nullptr);
+    break;
+  case VK_OBJECT_TYPE_SAMPLER:
+    vkDestroySampler(device, toHandle<VkSampler>(entry.handle), nullptr);
+    break;
+  case VK_OBJECT_TYPE_PIPELINE:
+    vkDestroyPipeline(device, toHandle<VkPipeline>(entry.handle), nullptr);
+    break;
+  case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+    vkDestroyPipelineLayout(device, toHandle<VkPipelineLayout>(entry.handle),
+                            nullptr);
+    break;
+  case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+    vkDestroyDescriptorPool(device, toHandle<VkDescriptorPool>(entry.handle),
+                            nullptr);
+    break;
+  case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+    vkDestroyDescriptorSetLayout(
+        device, toHandle<VkDescriptorSetLayout>(entry.handle), nullptr);
+    break;
+  case VK_OBJECT_TYPE_FRAMEBUFFER:
+    vkDestroyFramebuffer(device, toHandle<VkFramebuffer>(entry.handle),
+                         nullptr);
+    break;
+  case VK_OBJECT_TYPE_RENDER_PASS:
+    vkDestroyRenderPass(device, toHandle<VkRenderPass>(entry.handle),
+                        nullptr);
+    break;
+  case VK_OBJECT_TYPE_QUERY_POOL:
+    vkDestroyQueryPool(device, toHandle<VkQueryPool>(entry.handle), nullptr);
+    break;
+  case VK_OBJECT_TYPE_DEVICE_MEMORY:
+    vkFreeMemory(device, toHandle<VkDeviceMemory>(entry.handle), nullptr);
+    break;
+  default:
+    break;
+  }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vulkan/vulkan.h>
+
+// The destroy overloads need every non-dispatchable handle to be a type of
+// its own, which Vulkan only guarantees on 64-bit platforms; elsewhere they
+// are all uint64_t
+static_assert(sizeof(void *) == 8,
+              "DeletionQueue needs 64-bit non-dispatchable handles");
+
+// Vulkan objects destroyed once the GPU can no longer be using them. Each
+// is queued with the current value (a frame number, or a timeline
+// semaphore value to signal) and destroyed by collect once the completed
+// value has reached it, so resources can be dropped mid-run without
+// vkDeviceWaitIdle. Values must not decrease. Thread-safe.
+class DeletionQueue {
+
+public:
+  void create(VkDevice device);
+  // Destroys everything still queued; the device must be idle
+  void cleanup();
+
+  // Value objects queued from now on are tagged with
+  void setCurrentValue(uint64_t value);
+  uint64_t getCurrentValue() const;
+
+  // Destroys every object queued with a value <= completedValue
+  void collect(uint64_t completedValue);
+  size_t getPendingCount() const;
+
+  void destroy(VkBuffer buffer) { push(VK_OBJECT_TYPE_BUFFER, buffer); }
+  void destroy(VkImage image) { push(VK_OBJECT_TYPE_IMAGE, image); }
+  void destroy(VkImageView view) { push(VK_OBJECT_TYPE_IMAGE_VIEW, view); }
+  void destroy(VkSampler sampler) { push(VK_OBJECT_TYPE_SAMPLER, sampler); }
+  void destroy(VkPipeline pipeline) {
+    push(VK_OBJECT_TYPE_PIPELINE, pipeline);
+  }
+  void destroy(VkPipelineLayout layout) {
+    push(VK_OBJECT_TYPE_PIPELINE_LAYOUT, layout);
+  }
+  void destroy(VkDescriptorPool pool) {
+    push(VK_OBJECT_TYPE_DESCRIPTOR_POOL, pool);
+  }
+  void destroy(VkDescriptorSetLayout layout) {
+    push(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, layout);
+  }
+  void destroy(VkFramebuffer framebuffer) {
+    push(VK_OBJECT_TYPE_FRAMEBUFFER, framebuffer);
+  }
+  void destroy(VkRenderPass renderPass) {
+    push(VK_OBJECT_TYPE_RENDER_PASS, renderPass);
+  }
+  void destroy(VkQueryPool pool) { push(VK_OBJECT_TYPE_QUERY_POOL, pool); }
+  // Frees the memory
+  void destroy(VkDeviceMemory memory) {
+    push(VK_OBJECT_TYPE_DEVICE_MEMORY, memory);
+  }
+
+private:
+  struct Entry {
+    uint64_t value;
+    VkObjectType type;
+    uint64_t handle;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  mutable std::mutex mutex;
+  std::deque<Entry> entries; // in value order
+  uint64_t currentValue = 0;
+
+  template <typename Handle>
+  void push(VkObjectType type, Handle handle) {
+    if (handle == VK_NULL_HANDLE)
+      return;
+    uint64_t bits = reinterpret_cast<uintptr_t>(handle);
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back({currentValue, type, bits});
+  }
+
+  void destroyEntry(const Entry &entry);
+};
+
+// Owns one handle and hands it to a DeletionQueue when reset, replaced or
+// destroyed, e.g. a pipeline that can be rebuilt while frames in flight
+// still use the old one
+template <typename Handle> class QueuedHandle {
+
+public:
+  QueuedHandle() = default;
+  QueuedHandle(DeletionQueue &queue, Handle handle)
+      : queue(&queue), handle(handle) {}
+  ~QueuedHandle() { reset(); }
+
+  QueuedHandle(const QueuedHandle &) = delete;
+  QueuedHandle &operator=(const QueuedHandle &) = delete;
+
+  QueuedHandle(QueuedHandle &&other) noexcept
+      : queue(other.queue), handle(other.release()) {}
+  QueuedHandle &operator=(QueuedHandle &&other) noexcept {
+    if (this != &other) {
+      reset();
+      queue = other.queue;
+      handle = other.release();
+    }
+    return *this;
+  }
+
+  void reset() {
+    if (handle != VK_NULL_HANDLE) {
+      queue->destroy(handle);
+      handle = VK_NULL_HANDLE;
+    }
+  }
+  // Gives up ownership without queueing
+  Handle release() { return std::exchange(handle, Handle(VK_NULL_HANDLE)); }
+
+  Handle get() const { return handle; }
+  explicit operator bool() const { return handle != VK_NULL_HANDLE; }
+
+private:
+  DeletionQueue *queue = nullptr;
+  Handle handle = VK_NULL_HANDLE;
+};
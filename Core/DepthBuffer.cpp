@@ -0,0 +1,116 @@
+#include "DepthBuffer.hpp"
+
+#include "Buffer.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+VkFormat DepthBuffer::findDepthFormat(VkPhysicalDevice physicalDevice) {
+  // Float formats first: reversed-Z gains nothing with fixed-point depth
+  const VkFormat candidates[] = {
+      VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+      VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM};
+
+  for (VkFormat candidate : candidates) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, candidate,
+                                        &properties);
+    if (properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return candidate;
+    }
+  }
+  throw std::runtime_error("Failed to find a supported depth format!");
+}
+
+bool DepthBuffer::hasStencil(VkFormat format) {
+  return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+glm::mat4 DepthBuffer::perspective(float fovY, float aspect,
+                                   float nearPlane) {
+  // Column-major; z_clip = near and w_clip = -z_view, so depth = near / -z
+  float f = 1.0f / std::tan(fovY * 0.5f);
+  glm::mat4 result(0.0f);
+  result[0][0] = f / aspect;
+  result[1][1] = -f;
+  result[2][3] = -1.0f;
+  result[3][2] = nearPlane;
+  return result;
+}
+
+void DepthBuffer::create(VulkanContext &context, VkExtent2D extent) {
+  VkDevice device = context.getDevice();
+  this->extent = extent;
+  format = findDepthFormat(context.getPhysicalDevice());
+
+  VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = format;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth image!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+      Buffer::findMemoryType(context, memRequirements.memoryTypeBits,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate depth image memory!");
+  }
+  vkBindImageMemory(device, image, memory, 0);
+
+  VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+  if (hasStencil(format)) {
+    viewInfo.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth image view!");
+  }
+
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (vkCreateImageView(device, &viewInfo, nullptr, &depthView) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth sampling view!");
+  }
+}
+
+void DepthBuffer::cleanup(VkDevice device) {
+  if (depthView != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, depthView, nullptr);
+    depthView = VK_NULL_HANDLE;
+  }
+  if (view != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, view, nullptr);
+    view = VK_NULL_HANDLE;
+  }
+  if (image != VK_NULL_HANDLE) {
+    vkDestroyImage(device, image, nullptr);
+    image = VK_NULL_HANDLE;
+  }
+  if (memory != VK_NULL_HANDLE) {
+    vkFreeMemory(device, memory, nullptr);
+    memory = VK_NULL_HANDLE;
+  }
+}
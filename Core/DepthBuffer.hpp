@@ -0,0 +1,44 @@
+#pragma once
+
+#include "VulkanContext.hpp"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+// Depth attachment using the reversed-Z convention: the near plane maps to
+// 1 and infinity to 0, which spreads floating-point precision evenly over
+// distance. Clear to kClearDepth and test with kCompareOp
+class DepthBuffer {
+
+public:
+  static constexpr float kClearDepth = 0.0f;
+  static constexpr VkCompareOp kCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+
+  // The image is also sampleable, e.g. for building a depth pyramid
+  void create(VulkanContext &context, VkExtent2D extent);
+  void cleanup(VkDevice device);
+
+  // First format usable as a depth attachment, floating point preferred
+  static VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
+  static bool hasStencil(VkFormat format);
+
+  // Reversed-Z perspective with an infinite far plane, for Vulkan clip space
+  // (y down, depth 0..1). fovY in radians
+  static glm::mat4 perspective(float fovY, float aspect, float nearPlane);
+
+  VkImage getImage() const { return image; }
+  // Attachment view covering every aspect of the format
+  VkImageView getImageView() const { return view; }
+  // Depth-only view for sampling
+  VkImageView getDepthView() const { return depthView; }
+  VkFormat getFormat() const { return format; }
+  VkExtent2D getExtent() const { return extent; }
+
+private:
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkImageView depthView = VK_NULL_HANDLE;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent{};
+};
@@ -0,0 +1,193 @@
+#include "DescriptorAllocator.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+void DescriptorAllocator::create(
+    VkDevice device, uint32_t initialSets,
+    const std::vector<DescriptorPoolRatio> &ratios) {
+  this->device = device;
+  this->ratios = ratios;
+  setsPerPool = std::max(initialSets, 1u);
+}
+
+void DescriptorAllocator::cleanup() {
+  for (VkDescriptorPool pool : fullPools) {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+  for (VkDescriptorPool pool : readyPools) {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+  fullPools.clear();
+  readyPools.clear();
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+  VkDescriptorSetAllocateInfo allocInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  // A full pool is retired and the allocation retried once in a new one
+  for (int attempt = 0; attempt < 2; attempt++) {
+    allocInfo.descriptorPool = takePool();
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+    if (result == VK_SUCCESS)
+      return set;
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+        result != VK_ERROR_FRAGMENTED_POOL) {
+      break;
+    }
+    fullPools.push_back(readyPools.back());
+    readyPools.pop_back();
+  }
+  throw std::runtime_error("Failed to allocate descriptor set!");
+}
+
+void DescriptorAllocator::reset() {
+  for (VkDescriptorPool pool : readyPools) {
+    vkResetDescriptorPool(device, pool, 0);
+  }
+  for (VkDescriptorPool pool : fullPools) {
+    vkResetDescriptorPool(device, pool, 0);
+    readyPools.push_back(pool);
+  }
+  fullPools.clear();
+}
+
+const std::vector<DescriptorPoolRatio> &
+DescriptorAllocator::getDefaultRatios() {
+  static const std::vector<DescriptorPoolRatio> ratios = {
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+  };
+  return ratios;
+}
+
+VkDescriptorPool DescriptorAllocator::takePool() {
+  if (readyPools.empty()) {
+    readyPools.push_back(createPool(setsPerPool));
+    setsPerPool = std::min(setsPerPool + setsPerPool / 2, kMaxSetsPerPool);
+  }
+  return readyPools.back();
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) {
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  poolSizes.reserve(ratios.size());
+  for (const DescriptorPoolRatio &ratio : ratios) {
+    uint32_t count = static_cast<uint32_t>(ratio.perSet * setCount);
+    poolSizes.push_back({ratio.type, std::max(count, 1u)});
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  poolInfo.maxSets = setCount;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor pool!");
+  }
+  return pool;
+}
+
+bool DescriptorLayoutCache::Key::operator==(const Key &other) const {
+  if (flags != other.flags || bindings.size() != other.bindings.size() ||
+      immutableSamplers != other.immutableSamplers) {
+    return false;
+  }
+  for (size_t i = 0; i < bindings.size(); i++) {
+    const VkDescriptorSetLayoutBinding &a = bindings[i];
+    const VkDescriptorSetLayoutBinding &b = other.bindings[i];
+    if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+        a.descriptorCount != b.descriptorCount ||
+        a.stageFlags != b.stageFlags ||
+        (a.pImmutableSamplers == nullptr) !=
+            (b.pImmutableSamplers == nullptr)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void hashCombine(size_t &seed, uint64_t value) {
+  seed ^= std::hash<uint64_t>()(value) + 0x9e3779b97f4a7c15ull +
+          (seed << 6) + (seed >> 2);
+}
+
+size_t
+DescriptorLayoutCache::KeyHash::operator()(const Key &key) const {
+  size_t seed = key.bindings.size();
+  hashCombine(seed, key.flags);
+  for (const VkDescriptorSetLayoutBinding &binding : key.bindings) {
+    // Binding index, type, count and stages packed into one word
+    hashCombine(seed, uint64_t(binding.binding) |
+                          uint64_t(binding.descriptorType) << 16 |
+                          uint64_t(binding.descriptorCount) << 32 |
+                          uint64_t(binding.stageFlags) << 48);
+  }
+  return seed;
+}
+
+void DescriptorLayoutCache::create(VkDevice device) { this->device = device; }
+
+void DescriptorLayoutCache::cleanup() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto &[key, layout] : layouts) {
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+  }
+  layouts.clear();
+}
+
+size_t DescriptorLayoutCache::getLayoutCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return layouts.size();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::getLayout(
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+    VkDescriptorSetLayoutCreateFlags flags) {
+  Key key;
+  key.flags = flags;
+  key.bindings = bindings;
+  std::sort(key.bindings.begin(), key.bindings.end(),
+            [](const VkDescriptorSetLayoutBinding &a,
+               const VkDescriptorSetLayoutBinding &b) {
+              return a.binding < b.binding;
+            });
+  for (const VkDescriptorSetLayoutBinding &binding : key.bindings) {
+    if (binding.pImmutableSamplers) {
+      key.immutableSamplers.insert(key.immutableSamplers.end(),
+                                   binding.pImmutableSamplers,
+                                   binding.pImmutableSamplers +
+                                       binding.descriptorCount);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = layouts.find(key);
+  if (found != layouts.end())
+    return found->second;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  layoutInfo.flags = flags;
+  layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+  layoutInfo.pBindings = key.bindings.data();
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor set layout!");
+  }
+  layouts.emplace(std::move(key), layout);
+  return layout;
+}
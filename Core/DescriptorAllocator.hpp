@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Descriptors of one type a pool holds per set it can allocate
+struct DescriptorPoolRatio {
+  VkDescriptorType type;
+  float perSet;
+};
+
+// Allocates descriptor sets from a list of pools, adding a pool whenever
+// the current one runs out, so allocation never fails for lack of space.
+// Sets are never freed one by one: reset() returns every pool at once,
+// which keeps allocation O(1) and the pools free of fragmentation. One
+// allocator per frame in flight gives transient sets, reset once the
+// frame's fence has signaled; an allocator that is never reset holds
+// long-lived sets. Not thread-safe
+class DescriptorAllocator {
+
+public:
+  static constexpr uint32_t kMaxSetsPerPool = 4096;
+
+  // Each new pool holds 1.5 times the sets of the previous one, up to
+  // kMaxSetsPerPool
+  void create(VkDevice device, uint32_t initialSets = 64,
+              const std::vector<DescriptorPoolRatio> &ratios =
+                  getDefaultRatios());
+  void cleanup();
+
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+  // Every set allocated so far becomes invalid
+  void reset();
+
+  size_t getPoolCount() const { return fullPools.size() + readyPools.size(); }
+
+  // Mix for general material and compute use
+  static const std::vector<DescriptorPoolRatio> &getDefaultRatios();
+
+private:
+  VkDevice device = VK_NULL_HANDLE;
+  std::vector<DescriptorPoolRatio> ratios;
+  uint32_t setsPerPool = 0;
+  std::vector<VkDescriptorPool> fullPools;
+  std::vector<VkDescriptorPool> readyPools; // back() is allocated from
+
+  VkDescriptorPool takePool();
+  VkDescriptorPool createPool(uint32_t setCount);
+};
+
+// One VkDescriptorSetLayout per distinct set of bindings, so subsystems
+// describing the same set share a layout and the sets are compatible.
+// Layouts live until cleanup. Thread-safe
+class DescriptorLayoutCache {
+
+public:
+  void create(VkDevice device);
+  void cleanup();
+
+  // Binding order does not matter. Immutable samplers are compared by
+  // handle
+  VkDescriptorSetLayout
+  getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+            VkDescriptorSetLayoutCreateFlags flags = 0);
+
+  size_t getLayoutCount() const;
+
+private:
+  struct Key {
+    VkDescriptorSetLayoutCreateFlags flags = 0;
+    std::vector<VkDescriptorSetLayoutBinding> bindings; // sorted
+    std::vector<VkSampler> immutableSamplers;
+
+    bool operator==(const Key &other) const;
+  };
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  mutable std::mutex mutex;
+  std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> layouts;
+};
@@ -0,0 +1,178 @@
+#include "DrawList.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+struct KeyField {
+  uint32_t shift;
+  uint32_t bits;
+
+  uint64_t pack(uint32_t value) const {
+    return (static_cast<uint64_t>(value) & ((1ull << bits) - 1)) << shift;
+  }
+  uint32_t unpack(uint64_t key) const {
+    return static_cast<uint32_t>((key >> shift) & ((1ull << bits) - 1));
+  }
+};
+
+constexpr KeyField kPassField{60, 4};
+constexpr KeyField kPipelineField{52, 8};
+constexpr KeyField kMaterialField{36, 16};
+constexpr KeyField kMeshField{16, 20};
+constexpr KeyField kLodField{8, 8};
+constexpr KeyField kDepthField{0, 8};
+
+} // namespace
+
+uint64_t DrawList::packKey(const DrawKeyFields &fields) {
+  return kPassField.pack(fields.pass) | kPipelineField.pack(fields.pipeline) |
+         kMaterialField.pack(fields.material) |
+         kMeshField.pack(fields.mesh) | kLodField.pack(fields.lod) |
+         kDepthField.pack(fields.depth);
+}
+
+DrawKeyFields DrawList::unpackKey(uint64_t key) {
+  DrawKeyFields fields;
+  fields.pass = kPassField.unpack(key);
+  fields.pipeline = kPipelineField.unpack(key);
+  fields.material = kMaterialField.unpack(key);
+  fields.mesh = kMeshField.unpack(key);
+  fields.lod = kLodField.unpack(key);
+  fields.depth = kDepthField.unpack(key);
+  return fields;
+}
+
+uint32_t DrawList::depthBucket(float viewDepth, float nearPlane,
+                               float farPlane) {
+  float position = std::log(std::max(viewDepth, nearPlane) / nearPlane) /
+                   std::log(farPlane / nearPlane);
+  position = std::clamp(position, 0.0f, 1.0f);
+  return std::min(static_cast<uint32_t>(position * kDepthBuckets),
+                  kDepthBuckets - 1);
+}
+
+void DrawList::add(const DrawKeyFields &fields, uint32_t firstInstance,
+                   uint32_t instanceCount) {
+  items.push_back({packKey(fields), firstInstance, instanceCount});
+}
+
+void DrawList::sort(ThreadPool *threadPool) {
+  size_t count = items.size();
+  if (count < 2) {
+    return;
+  }
+
+  size_t chunkSize = count;
+  if (threadPool && count > kMinChunkSize) {
+    size_t threads = threadPool->getThreadCount();
+    chunkSize = std::max(kMinChunkSize, (count + threads - 1) / threads);
+  }
+  size_t chunks = (count + chunkSize - 1) / chunkSize;
+  histograms.resize(chunks * kRadix);
+  scratch.resize(count);
+
+  auto run = [&](const std::function<void(size_t, size_t)> &job) {
+    if (chunks > 1) {
+      threadPool->parallelFor(count, chunkSize, job);
+    } else {
+      job(0, count);
+    }
+  };
+
+  for (uint32_t shift = 0; shift < 64; shift += kDigitBits) {
+    auto digit = [shift](uint64_t key) {
+      return static_cast<uint32_t>(key >> shift) & (kRadix - 1);
+    };
+
+    // Digit counts of every chunk
+    run([&](size_t begin, size_t end) {
+      uint32_t *counts = histograms.data() + begin / chunkSize * kRadix;
+      std::fill(counts, counts + kRadix, 0u);
+      for (size_t i = begin; i < end; i++) {
+        counts[digit(items[i].key)]++;
+      }
+    });
+
+    // Turn counts into each chunk's first output slot per digit, digit by
+    // digit and chunk by chunk so equal digits keep their order. Digits all
+    // keys share leave the order as it is
+    uint32_t offset = 0;
+    bool shared = false;
+    for (uint32_t d = 0; d < kRadix && !shared; d++) {
+      uint32_t start = offset;
+      for (size_t chunk = 0; chunk < chunks; chunk++) {
+        uint32_t &slot = histograms[chunk * kRadix + d];
+        uint32_t digitCount = slot;
+        slot = offset;
+        offset += digitCount;
+      }
+      shared = offset - start == count;
+    }
+    if (shared) {
+      continue;
+    }
+
+    run([&](size_t begin, size_t end) {
+      uint32_t *slots = histograms.data() + begin / chunkSize * kRadix;
+      for (size_t i = begin; i < end; i++) {
+        scratch[slots[digit(items[i].key)]++] = items[i];
+      }
+    });
+    items.swap(scratch);
+  }
+}
+
+uint32_t DrawList::record(VkCommandBuffer commandBuffer, uint32_t pass,
+                          const DrawBindings &bindings,
+                          DrawBindState &state) const {
+  // Passes are the most significant field, so a pass's draws are adjacent
+  uint64_t passKey = kPassField.pack(pass);
+  auto begin = std::partition_point(
+      items.begin(), items.end(),
+      [passKey](const DrawItem &item) { return item.key < passKey; });
+
+  uint32_t drawCount = 0;
+  for (auto it = begin;
+       it != items.end() && kPassField.unpack(it->key) == pass;) {
+    // Draws continuing this one's instances with the same state join it
+    uint64_t stateKey = it->key >> kDepthField.bits;
+    uint32_t instanceCount = it->instanceCount;
+    auto next = it + 1;
+    while (next != items.end() && next->key >> kDepthField.bits == stateKey &&
+           next->firstInstance == it->firstInstance + instanceCount) {
+      instanceCount += next->instanceCount;
+      ++next;
+    }
+
+    DrawKeyFields fields = unpackKey(it->key);
+    VkPipeline pipeline = bindings.pipelines[fields.pipeline];
+    if (pipeline != state.pipeline) {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline);
+      state.pipeline = pipeline;
+    }
+    if (!bindings.materials.empty()) {
+      VkDescriptorSet material = bindings.materials[fields.material];
+      if (material != state.material) {
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                bindings.layout, bindings.materialSet, 1,
+                                &material, 0, nullptr);
+        state.material = material;
+      }
+    }
+    const Mesh *mesh = bindings.meshes[fields.mesh];
+    if (mesh != state.mesh) {
+      mesh->bind(commandBuffer);
+      state.mesh = mesh;
+    }
+
+    mesh->draw(commandBuffer, fields.lod, instanceCount, it->firstInstance);
+    drawCount++;
+    it = next;
+  }
+  return drawCount;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Mesh.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Fields of a draw's 64-bit sort key. Wider values are truncated to their
+// bits
+struct DrawKeyFields {
+  uint32_t pass = 0;     // 4 bits, most significant
+  uint32_t pipeline = 0; // 8 bits
+  uint32_t material = 0; // 16 bits
+  uint32_t mesh = 0;     // 20 bits
+  uint32_t lod = 0;      // 8 bits
+  uint32_t depth = 0;    // 8 bits, from DrawList::depthBucket
+};
+
+// One draw: instanceCount instances from firstInstance in the bound
+// instance buffer
+struct DrawItem {
+  uint64_t key = 0;
+  uint32_t firstInstance = 0;
+  uint32_t instanceCount = 1;
+};
+
+// What the pipeline, material and mesh fields of keys refer to
+struct DrawBindings {
+  std::vector<VkPipeline> pipelines;
+  // Bound at materialSet of layout; without any, sets are left to the
+  // caller
+  std::vector<VkDescriptorSet> materials;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  uint32_t materialSet = 0;
+  std::vector<const Mesh *> meshes;
+};
+
+// What a command buffer has bound, so binding it again can be skipped.
+// Callers set what they bound themselves and reset it when it is lost
+struct DrawBindState {
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkDescriptorSet material = VK_NULL_HANDLE;
+  const Mesh *mesh = nullptr;
+};
+
+// A frame's draws ordered by a 64-bit key: pass first, then the state
+// they bind from the most to the least expensive to change, then front to
+// back. Keys are sorted with an LSD radix sort, 8 bits per pass, in
+// parallel chunks on a thread pool. Recording walks a pass's draws in key
+// order, binding only what changes and merging draws that differ in depth
+// alone and continue each other's instances into one instanced draw
+class DrawList {
+
+public:
+  static constexpr uint32_t kDepthBuckets = 256;
+
+  static uint64_t packKey(const DrawKeyFields &fields);
+  static DrawKeyFields unpackKey(uint64_t key);
+  // Logarithmic bucket of a view-space depth between the planes, so near
+  // draws get finer buckets than far ones
+  static uint32_t depthBucket(float viewDepth, float nearPlane,
+                              float farPlane);
+
+  void clear() { items.clear(); }
+  void add(const DrawKeyFields &fields, uint32_t firstInstance,
+           uint32_t instanceCount = 1);
+
+  // Orders the draws by key; equal keys keep the order they were added in.
+  // threadPool may be null to sort on the calling thread
+  void sort(ThreadPool *threadPool = nullptr);
+
+  // In key order once sorted
+  const std::vector<DrawItem> &getItems() const { return items; }
+
+  // Records the sorted draws of pass inside a render pass. Returns the
+  // number of draw calls
+  uint32_t record(VkCommandBuffer commandBuffer, uint32_t pass,
+                  const DrawBindings &bindings, DrawBindState &state) const;
+
+private:
+  static constexpr uint32_t kDigitBits = 8;
+  static constexpr uint32_t kRadix = 1u << kDigitBits;
+  // Below this many draws per thread the sort stays on one thread
+  static constexpr size_t kMinChunkSize = 4096;
+
+  std::vector<DrawItem> items;
+  std::vector<DrawItem> scratch;
+  std::vector<uint32_t> histograms; // kRadix per chunk
+};
@@ -0,0 +1,45 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void DynamicResolution::create(float budgetMs, uint32_t framesInFlight,
+                               float minScale, float maxScale) {
+  if (budgetMs <= 0.0f || minScale <= 0.0f || minScale > maxScale) {
+    throw std::runtime_error("Invalid dynamic resolution settings!");
+  }
+  this->budgetMs = budgetMs;
+  this->minScale = minScale;
+  this->maxScale = std::min(maxScale, 1.0f);
+  scale = this->maxScale;
+  frameScales.assign(framesInFlight, scale);
+}
+
+void DynamicResolution::update(uint32_t frameIndex, double gpuMs) {
+  if (gpuMs > 0.0) {
+    // Pixel ratio the measured frame would have needed, assuming GPU time
+    // scales with it
+    float rendered = frameScales[frameIndex];
+    float ratio = scale * scale;
+    float target = rendered * rendered * budgetMs * kHeadroom /
+                   static_cast<float>(gpuMs);
+    target = std::clamp(target, minScale * minScale, maxScale * maxScale);
+
+    if (std::abs(target - ratio) > kDeadband * ratio) {
+      float rate = target < ratio ? kDownRate : kUpRate;
+      ratio += (target - ratio) * rate;
+      scale = std::clamp(std::sqrt(ratio), minScale, maxScale);
+    }
+  }
+  frameScales[frameIndex] = scale;
+}
+
+VkExtent2D DynamicResolution::getRenderExtent(VkExtent2D fullExtent) const {
+  auto scaled = [this](uint32_t full) {
+    uint32_t size = static_cast<uint32_t>(
+        std::lround(full * scale / kAlignment) * kAlignment);
+    return std::clamp(size, std::min(kAlignment, full), full);
+  };
+  return {scaled(fullExtent.width), scaled(fullExtent.height)};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Picks the render resolution for a GPU frame time budget. GPU time is
+// taken as proportional to the pixel count, so every measured frame moves
+// the pixel ratio towards the one that would have met the budget. Drops
+// are followed quickly and rises slowly, so one cheap frame does not bring
+// back a resolution the scene cannot hold. Per frame, once its fence has
+// signaled:
+//   update(frameIndex, GPU time of the slot's last frame) -> getRenderExtent
+class DynamicResolution {
+
+public:
+  // Fraction of the budget aimed for, leaving room for spikes
+  static constexpr float kHeadroom = 0.9f;
+  // Share of the way to the target pixel ratio covered per frame
+  static constexpr float kDownRate = 0.3f;
+  static constexpr float kUpRate = 0.05f;
+  // Relative pixel ratio changes smaller than this are ignored
+  static constexpr float kDeadband = 0.02f;
+  // Render sizes are multiples of this many pixels
+  static constexpr uint32_t kAlignment = 8;
+
+  // Scales apply to each axis. Starts at maxScale
+  void create(float budgetMs, uint32_t framesInFlight, float minScale = 0.5f,
+              float maxScale = 1.0f);
+
+  // gpuMs is the GPU time of the last frame recorded with frameIndex, or
+  // negative when none resolved. Picks the scale for the frame about to be
+  // recorded with frameIndex
+  void update(uint32_t frameIndex, double gpuMs);
+
+  float getScale() const { return scale; }
+  float getBudgetMs() const { return budgetMs; }
+  // Part of fullExtent to render at the current scale, at least one
+  // alignment step and at most fullExtent
+  VkExtent2D getRenderExtent(VkExtent2D fullExtent) const;
+
+private:
+  float budgetMs = 0.0f;
+  float minScale = 1.0f;
+  float maxScale = 1.0f;
+  float scale = 1.0f;
+  // Scale each frame slot was last recorded with, for reading its timing
+  std::vector<float> frameScales;
+};
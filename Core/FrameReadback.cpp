@@ -0,0 +1,368 @@
+#include "FrameReadback.hpp"
+
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// PNG chunk checksum (CRC-32, ISO 3309)
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> entries{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; bit++) {
+        value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+      }
+      entries[i] = value;
+    }
+    return entries;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static void putBigEndian(std::vector<uint8_t> &out, uint32_t value) {
+  out.push_back(static_cast<uint8_t>(value >> 24));
+  out.push_back(static_cast<uint8_t>(value >> 16));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeChunk(std::ofstream &file, const char *type,
+                       const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> header;
+  putBigEndian(header, static_cast<uint32_t>(data.size()));
+  header.insert(header.end(), type, type + 4);
+  uint32_t crc = crc32(0, header.data() + 4, 4);
+  crc = crc32(crc, data.data(), data.size());
+  std::vector<uint8_t> footer;
+  putBigEndian(footer, crc);
+
+  file.write(reinterpret_cast<const char *>(header.data()), header.size());
+  file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  file.write(reinterpret_cast<const char *>(footer.data()), footer.size());
+}
+
+// Whether pattern is safe to give snprintf with one unsigned int: exactly
+// one integer conversion, without a length modifier, besides any "%%"
+static bool isCapturePattern(const std::string &pattern) {
+  if (pattern.find('\0') != std::string::npos)
+    return false;
+  size_t i = 0;
+  auto skipDigits = [&] {
+    while (i < pattern.size() &&
+           std::isdigit(static_cast<unsigned char>(pattern[i])))
+      i++;
+  };
+
+  int conversions = 0;
+  for (; i < pattern.size(); i++) {
+    if (pattern[i] != '%')
+      continue;
+    if (++i < pattern.size() && pattern[i] == '%')
+      continue;
+    while (i < pattern.size() && std::strchr("-+ #0", pattern[i]))
+      i++;
+    skipDigits();
+    if (i < pattern.size() && pattern[i] == '.') {
+      i++;
+      skipDigits();
+    }
+    if (i == pattern.size() || !std::strchr("diouxX", pattern[i]))
+      return false;
+    conversions++;
+  }
+  return conversions == 1;
+}
+
+void FrameReadback::create(VulkanContext &context, VkExtent2D extent,
+                           VkFormat format, uint32_t framesInFlight,
+                           uint32_t ringSize, const std::string &path,
+                           CaptureFormat captureFormat) {
+  switch (format) {
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    swapRedBlue = true;
+    break;
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+    swapRedBlue = false;
+    break;
+  default:
+    throw std::runtime_error("Unsupported format for frame readback!");
+  }
+
+  if (captureFormat != CaptureFormat::Raw && !isCapturePattern(path)) {
+    throw std::runtime_error("Capture path " + path +
+                             " needs one integer conversion, e.g. %05u!");
+  }
+
+  device = context.getDevice();
+  this->extent = extent;
+  this->path = path;
+  this->captureFormat = captureFormat;
+  frameSize = VkDeviceSize(extent.width) * extent.height * 4;
+
+  // Cached memory makes the CPU reads fast; it may need invalidating
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  const VkPhysicalDeviceMemoryProperties &memory =
+      context.getCapabilities().memory;
+  for (uint32_t i = 0; i < memory.memoryTypeCount; i++) {
+    VkMemoryPropertyFlags flags = memory.memoryTypes[i].propertyFlags;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+      properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+      break;
+    }
+  }
+
+  slots.resize(std::max(ringSize, framesInFlight));
+  for (Slot &slot : slots) {
+    slot.buffer.create(context, frameSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       properties);
+    void *data;
+    if (vkMapMemory(device, slot.buffer.getMemory(), 0, frameSize, 0,
+                    &data) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map readback buffer!");
+    }
+    slot.mapped = static_cast<const uint8_t *>(data);
+  }
+  pendingByFrame.assign(framesInFlight, -1);
+  nextSlot = 0;
+  captureCount = 0;
+  stallCount = 0;
+  writtenCount = 0;
+
+  if (captureFormat == CaptureFormat::Raw) {
+    rawStream.open(path, std::ios::binary | std::ios::trunc);
+    if (!rawStream) {
+      throw std::runtime_error("Failed to open capture file " + path + "!");
+    }
+  }
+  stopping = false;
+  writer = std::thread(&FrameReadback::writerLoop, this);
+}
+
+void FrameReadback::cleanup(VkDevice device) {
+  if (writer.joinable()) {
+    for (uint32_t frame = 0; frame < pendingByFrame.size(); frame++) {
+      onFrameComplete(frame);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    writer.join();
+  }
+  if (writtenCount > 0) {
+    LOG_INFO("Captured %u frames (%u waited for a free buffer)", writtenCount,
+             stallCount);
+  }
+
+  for (Slot &slot : slots) {
+    if (slot.mapped) {
+      vkUnmapMemory(device, slot.buffer.getMemory());
+    }
+    slot.buffer.cleanup(device);
+  }
+  slots.clear();
+  pendingByFrame.clear();
+  rawStream.close();
+}
+
+void FrameReadback::recordCapture(VkCommandBuffer commandBuffer,
+                                  uint32_t frameIndex, Image &image,
+                                  const VulkanContext &context) {
+  if (pendingByFrame[frameIndex] >= 0) {
+    throw std::runtime_error("Frame captured twice before completing!");
+  }
+
+  // Only a writer a full ring behind makes recording wait
+  Slot &slot = slots[nextSlot];
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (slot.busy) {
+      stallCount++;
+      condition.wait(lock, [&] { return !slot.busy; });
+    }
+    slot.busy = true;
+  }
+  slot.captureNumber = captureCount++;
+  pendingByFrame[frameIndex] = static_cast<int32_t>(nextSlot);
+  nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+
+  ImageBarrierBatch barriers;
+  barriers.transition(image, {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                              VK_PIPELINE_STAGE_2_COPY_BIT,
+                              VK_ACCESS_2_TRANSFER_READ_BIT});
+  barriers.record(commandBuffer, context);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {extent.width, extent.height, 1};
+  vkCmdCopyImageToBuffer(commandBuffer, image.getImage(),
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         slot.buffer.getBuffer(), 1, &region);
+
+  // The fence wait then makes the copy visible to the host
+  VkBufferMemoryBarrier toHost{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer = slot.buffer.getBuffer();
+  toHost.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost,
+                       0, nullptr);
+}
+
+void FrameReadback::onFrameComplete(uint32_t frameIndex) {
+  int32_t slotIndex = pendingByFrame[frameIndex];
+  if (slotIndex < 0)
+    return;
+  pendingByFrame[frameIndex] = -1;
+
+  VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+  range.memory = slots[slotIndex].buffer.getMemory();
+  range.size = VK_WHOLE_SIZE;
+  vkInvalidateMappedMemoryRanges(device, 1, &range);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeQueue.push_back(static_cast<uint32_t>(slotIndex));
+  }
+  condition.notify_all();
+}
+
+uint32_t FrameReadback::getWrittenCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return writtenCount;
+}
+
+void FrameReadback::writerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    condition.wait(lock, [&] { return !writeQueue.empty() || stopping; });
+    if (writeQueue.empty())
+      return;
+    uint32_t slotIndex = writeQueue.front();
+    writeQueue.pop_front();
+    lock.unlock();
+
+    writeSlot(slots[slotIndex]);
+
+    lock.lock();
+    slots[slotIndex].busy = false;
+    writtenCount++;
+    condition.notify_all();
+  }
+}
+
+void FrameReadback::writeSlot(const Slot &slot) {
+  if (captureFormat == CaptureFormat::Raw) {
+    rawStream.write(reinterpret_cast<const char *>(slot.mapped),
+                    static_cast<std::streamsize>(frameSize));
+    return;
+  }
+
+  char fileName[512];
+  std::snprintf(fileName, sizeof(fileName), path.c_str(), slot.captureNumber);
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    LOG_ERROR("Failed to open capture file %s", fileName);
+    return;
+  }
+
+  // Rows as RGB, behind PNG's filter type byte (none) when encoding PNG
+  bool png = captureFormat == CaptureFormat::Png;
+  size_t rowSize = size_t(extent.width) * 3 + (png ? 1 : 0);
+  uint32_t red = swapRedBlue ? 2 : 0;
+  uint32_t blue = swapRedBlue ? 0 : 2;
+  auto convertRow = [&](uint32_t y, uint8_t *out) {
+    const uint8_t *texel = slot.mapped + size_t(y) * extent.width * 4;
+    if (png) {
+      *out++ = 0;
+    }
+    for (uint32_t x = 0; x < extent.width; x++, texel += 4) {
+      *out++ = texel[red];
+      *out++ = texel[1];
+      *out++ = texel[blue];
+    }
+  };
+
+  if (!png) {
+    char header[64];
+    int headerSize = std::snprintf(header, sizeof(header), "P6\n%u %u\n255\n",
+                                   extent.width, extent.height);
+    file.write(header, headerSize);
+    rowBuffer.resize(rowSize);
+    for (uint32_t y = 0; y < extent.height; y++) {
+      convertRow(y, rowBuffer.data());
+      file.write(reinterpret_cast<const char *>(rowBuffer.data()),
+                 static_cast<std::streamsize>(rowSize));
+    }
+    return;
+  }
+
+  // Stored (uncompressed) deflate blocks keep encoding at memory speed;
+  // the files are about as large as PPM
+  static const uint8_t signature[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1a, '\n'};
+  file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+  std::vector<uint8_t> header;
+  putBigEndian(header, extent.width);
+  putBigEndian(header, extent.height);
+  header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB
+  writeChunk(file, "IHDR", header);
+
+  rowBuffer.resize(rowSize * extent.height);
+  for (uint32_t y = 0; y < extent.height; y++) {
+    convertRow(y, rowBuffer.data() + rowSize * y);
+  }
+
+  static constexpr size_t kMaxBlock = 65535;
+  size_t blockCount = (rowBuffer.size() + kMaxBlock - 1) / kMaxBlock;
+  std::vector<uint8_t> zlib;
+  zlib.reserve(rowBuffer.size() + blockCount * 5 + 6);
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  uint32_t adlerA = 1;
+  uint32_t adlerB = 0;
+  for (size_t offset = 0; offset < rowBuffer.size(); offset += kMaxBlock) {
+    size_t size = std::min(kMaxBlock, rowBuffer.size() - offset);
+    bool last = offset + size == rowBuffer.size();
+    zlib.push_back(last ? 1 : 0);
+    zlib.push_back(static_cast<uint8_t>(size));
+    zlib.push_back(static_cast<uint8_t>(size >> 8));
+    zlib.push_back(static_cast<uint8_t>(~size));
+    zlib.push_back(static_cast<uint8_t>(~size >> 8));
+    const uint8_t *data = rowBuffer.data() + offset;
+    zlib.insert(zlib.end(), data, data + size);
+    // Sums stay below 2^32 for 5552 bytes between reductions
+    for (size_t start = 0; start < size; start += 5552) {
+      size_t end = std::min(size, start + 5552);
+      for (size_t i = start; i < end; i++) {
+        adlerA += data[i];
+        adlerB += adlerA;
+      }
+      adlerA %= 65521;
+      adlerB %= 65521;
+    }
+  }
+  putBigEndian(zlib, (adlerB << 16) | adlerA);
+  writeChunk(file, "IDAT", zlib);
+  writeChunk(file, "IEND", {});
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Image.hpp"
+#include "VulkanContext.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum class CaptureFormat {
+  Ppm, // binary RGB, one file per frame
+  Png, // RGB, uncompressed deflate, one file per frame
+  Raw  // the image's own texels, every frame appended to one file
+};
+
+// Copies rendered frames into a ring of host-visible buffers and writes
+// them to disk on a worker thread. A copy recorded with a frame is read
+// back once that frame's fence has signaled, so the GPU never waits for
+// the CPU; only a writer falling a whole ring behind holds up recording.
+// 8-bit RGBA and BGRA images are supported
+class FrameReadback {
+
+public:
+  // path is a printf pattern given the capture number (e.g.
+  // "frame_%05u.png") for PPM and PNG, and the output file for raw.
+  // Patterns need exactly one integer conversion; other '%' must be "%%"
+  // ringSize must exceed the frames in flight to overlap writing
+  void create(VulkanContext &context, VkExtent2D extent, VkFormat format,
+              uint32_t framesInFlight, uint32_t ringSize,
+              const std::string &path, CaptureFormat captureFormat);
+  // Writes every capture still queued; the device must be idle
+  void cleanup(VkDevice device);
+
+  // Records copying image, left by earlier commands in its tracked state,
+  // into the next free buffer. frameIndex is the frame in flight whose
+  // submission the commands belong to
+  void recordCapture(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                     Image &image, const VulkanContext &context);
+  // Once frameIndex's fence has signaled: queues the capture recorded with
+  // it for writing
+  void onFrameComplete(uint32_t frameIndex);
+
+  uint32_t getWrittenCount() const;
+  // Captures that had to wait for a free buffer
+  uint32_t getStallCount() const { return stallCount; }
+
+private:
+  struct Slot {
+    Buffer buffer;
+    const uint8_t *mapped = nullptr;
+    uint32_t captureNumber = 0;
+    bool busy = false; // copying or being written
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  VkExtent2D extent{};
+  bool swapRedBlue = false;
+  std::string path;
+  CaptureFormat captureFormat = CaptureFormat::Ppm;
+  VkDeviceSize frameSize = 0;
+  std::vector<Slot> slots;
+  std::vector<int32_t> pendingByFrame; // slot copied by each frame, or -1
+  uint32_t nextSlot = 0;
+  uint32_t captureCount = 0;
+  uint32_t stallCount = 0;
+
+  // Writer thread and the slots queued for it
+  std::thread writer;
+  mutable std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<uint32_t> writeQueue;
+  uint32_t writtenCount = 0;
+  bool stopping = false;
+  std::ofstream rawStream;
+  std::vector<uint8_t> rowBuffer;
+
+  void writerLoop();
+  void writeSlot(const Slot &slot);
+};
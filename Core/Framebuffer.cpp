@@ -1,23 +1,30 @@
 #include "Framebuffer.hpp"
+#include "ResourceCache.hpp"
 #include <stdexcept>
 
 void Framebuffer::create(VkDevice device, VkRenderPass renderPass,
                          const std::vector<VkImageView> &swapChainImageViews,
-                         VkExtent2D extent) {
+                         VkExtent2D extent, VkImageView depthView,
+                         ResourceCache *cache) {
+  this->cache = cache;
   framebuffers.resize(swapChainImageViews.size());
 
   for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-    VkImageView attachments[] = {swapChainImageViews[i]};
+    VkImageView attachments[] = {swapChainImageViews[i], depthView};
 
     VkFramebufferCreateInfo framebufferInfo{
         VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
     framebufferInfo.renderPass = renderPass;
-    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.attachmentCount = depthView != VK_NULL_HANDLE ? 2 : 1;
     framebufferInfo.pAttachments = attachments;
     framebufferInfo.width = extent.width;
     framebufferInfo.height = extent.height;
     framebufferInfo.layers = 1;
 
+    if (cache) {
+      framebuffers[i] = cache->acquireFramebuffer(framebufferInfo);
+      continue;
+    }
     if (vkCreateFramebuffer(device, &framebufferInfo, nullptr,
                             &framebuffers[i]) != VK_SUCCESS) {
       throw std::runtime_error("Failed to create framebuffer!");
@@ -27,7 +34,11 @@ void Framebuffer::create(VkDevice device, VkRenderPass renderPass,
 
 void Framebuffer::cleanup(VkDevice device) {
   for (auto framebuffer : framebuffers) {
-    vkDestroyFramebuffer(device, framebuffer, nullptr);
+    if (cache) {
+      cache->release(framebuffer);
+    } else {
+      vkDestroyFramebuffer(device, framebuffer, nullptr);
+    }
   }
   framebuffers.clear();
 }
\ No newline at end of file
@@ -2,12 +2,17 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 
+class ResourceCache; // forward declaration
+
 class Framebuffer {
 
 public:
+  // depthView is shared by every framebuffer. With a cache, framebuffers
+  // of the same pass and attachments are shared
   void create(VkDevice device, VkRenderPass renderPass,
               const std::vector<VkImageView> &swapChainImageViews,
-              VkExtent2D extent);
+              VkExtent2D extent, VkImageView depthView = VK_NULL_HANDLE,
+              ResourceCache *cache = nullptr);
   void cleanup(VkDevice device);
 
   const std::vector<VkFramebuffer> &getFramebuffers() const {
@@ -16,4 +21,5 @@ public:
 
 private:
   std::vector<VkFramebuffer> framebuffers;
+  ResourceCache *cache = nullptr;
 };
\ No newline at end of file
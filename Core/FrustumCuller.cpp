@@ -0,0 +1,308 @@
+#include "FrustumCuller.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||          \
+    defined(_M_IX86)
+#define FRUSTUM_CULLER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 inside functions marked for it; MSVC accepts
+// the intrinsics anywhere
+#if defined(FRUSTUM_CULLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Radius of padding objects; fails every plane test
+static constexpr float kNeverVisible = -1e30f;
+
+FrustumCuller::FrustumCuller() : avx2(isAvx2Supported()) {
+  // Until a frustum is set, every plane passes everything
+  for (float *plane : planes) {
+    plane[3] = 1.0f;
+  }
+}
+
+bool FrustumCuller::isAvx2Supported() {
+#if !defined(FRUSTUM_CULLER_X86)
+  return false;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  // AVX needs OS support for saving the YMM registers
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+uint32_t FrustumCuller::addSphere(const glm::vec3 &center, float radius) {
+  uint32_t object = objectCount++;
+  set(object, center, glm::vec3(0.0f), radius);
+  return object;
+}
+
+uint32_t FrustumCuller::addBox(const glm::vec3 &minimum,
+                               const glm::vec3 &maximum) {
+  uint32_t object = objectCount++;
+  set(object, (minimum + maximum) * 0.5f, (maximum - minimum) * 0.5f, 0.0f);
+  return object;
+}
+
+void FrustumCuller::setSphere(uint32_t object, const glm::vec3 &center,
+                              float radius) {
+  set(object, center, glm::vec3(0.0f), radius);
+}
+
+void FrustumCuller::setBox(uint32_t object, const glm::vec3 &minimum,
+                           const glm::vec3 &maximum) {
+  set(object, (minimum + maximum) * 0.5f, (maximum - minimum) * 0.5f, 0.0f);
+}
+
+void FrustumCuller::clear() {
+  centerX.clear(), centerY.clear(), centerZ.clear();
+  extentX.clear(), extentY.clear(), extentZ.clear();
+  radius.clear();
+  objectCount = 0;
+}
+
+void FrustumCuller::resize(uint32_t count) {
+  size_t padded = (size_t(count) + kLaneCount - 1) / kLaneCount * kLaneCount;
+  centerX.resize(padded, 0.0f), centerY.resize(padded, 0.0f);
+  centerZ.resize(padded, 0.0f);
+  extentX.resize(padded, 0.0f), extentY.resize(padded, 0.0f);
+  extentZ.resize(padded, 0.0f);
+  radius.resize(padded, kNeverVisible);
+  std::fill(radius.begin() + count, radius.end(), kNeverVisible);
+  objectCount = count;
+}
+
+void FrustumCuller::set(uint32_t object, const glm::vec3 &center,
+                        const glm::vec3 &extent, float sphereRadius) {
+  if (object >= radius.size()) {
+    size_t padded = (size_t(object) + kLaneCount) / kLaneCount * kLaneCount;
+    centerX.resize(padded, 0.0f), centerY.resize(padded, 0.0f);
+    centerZ.resize(padded, 0.0f);
+    extentX.resize(padded, 0.0f), extentY.resize(padded, 0.0f);
+    extentZ.resize(padded, 0.0f);
+    radius.resize(padded, kNeverVisible);
+  }
+
+  centerX[object] = center.x, centerY[object] = center.y;
+  centerZ[object] = center.z;
+  extentX[object] = extent.x, extentY[object] = extent.y;
+  extentZ[object] = extent.z;
+  radius[object] = sphereRadius;
+}
+
+void FrustumCuller::setFrustum(const glm::mat4 &viewProjection) {
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                        viewProjection[2][i], viewProjection[3][i]);
+  }
+
+  // Left, right, bottom, top, z >= 0 and z <= w
+  glm::vec4 extracted[6] = {rows[3] + rows[0], rows[3] - rows[0],
+                            rows[3] + rows[1], rows[3] - rows[1],
+                            rows[2],           rows[3] - rows[2]};
+
+  for (int p = 0; p < 6; p++) {
+    glm::vec4 plane = extracted[p];
+    float length = glm::length(glm::vec3(plane));
+    // The far plane of an infinite projection degenerates; let it pass
+    plane = length > 1e-6f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    for (int k = 0; k < 4; k++) {
+      planes[p][k] = plane[k];
+    }
+    for (int k = 0; k < 3; k++) {
+      absPlanes[p][k] = std::fabs(plane[k]);
+    }
+  }
+}
+
+void FrustumCuller::cull(std::vector<uint32_t> &visible,
+                         ThreadPool *threadPool) {
+  uint32_t paddedCount = static_cast<uint32_t>(radius.size());
+  // Kernels write into scratch space sized for the worst case, so only the
+  // visible indices are copied out
+  if (scratch.size() < paddedCount) {
+    scratch.resize(paddedCount);
+  }
+
+  if (!threadPool || paddedCount <= kChunkSize) {
+    uint32_t count = cullRange(0, paddedCount, scratch.data());
+    visible.assign(scratch.begin(), scratch.begin() + count);
+    return;
+  }
+
+  // Each chunk writes its indices at its own offset, then the results are
+  // packed together in chunk order
+  size_t chunks = (paddedCount + kChunkSize - 1) / kChunkSize;
+  chunkCounts.resize(chunks);
+
+  threadPool->parallelFor(paddedCount, kChunkSize,
+                          [&](size_t begin, size_t end) {
+                            chunkCounts[begin / kChunkSize] = cullRange(
+                                static_cast<uint32_t>(begin),
+                                static_cast<uint32_t>(end),
+                                scratch.data() + begin);
+                          });
+
+  visible.clear();
+  for (size_t chunk = 0; chunk < chunks; chunk++) {
+    const uint32_t *indices = scratch.data() + chunk * kChunkSize;
+    visible.insert(visible.end(), indices, indices + chunkCounts[chunk]);
+  }
+}
+
+uint32_t FrustumCuller::cullRange(uint32_t begin, uint32_t end,
+                                  uint32_t *output) const {
+#ifdef FRUSTUM_CULLER_X86
+  if (simdEnabled) {
+    return avx2 ? cullAvx2(begin, end, output) : cullSse(begin, end, output);
+  }
+#endif
+  return cullScalar(begin, end, output);
+}
+
+// An object is outside when its center lies further behind a plane than
+// its projected extent: dot(n, c) + w + dot(|n|, e) + r < 0
+
+uint32_t FrustumCuller::cullScalar(uint32_t begin, uint32_t end,
+                                   uint32_t *output) const {
+  uint32_t count = 0;
+  for (uint32_t i = begin; i < end; i++) {
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; p++) {
+      float distance = planes[p][0] * centerX[i] + planes[p][1] * centerY[i] +
+                       planes[p][2] * centerZ[i] + planes[p][3];
+      float extent = absPlanes[p][0] * extentX[i] +
+                     absPlanes[p][1] * extentY[i] +
+                     absPlanes[p][2] * extentZ[i] + radius[i];
+      inside = distance + extent >= 0.0f;
+    }
+    if (inside) {
+      output[count++] = i;
+    }
+  }
+  return count;
+}
+
+#ifdef FRUSTUM_CULLER_X86
+
+uint32_t FrustumCuller::cullSse(uint32_t begin, uint32_t end,
+                                uint32_t *output) const {
+  __m128 plane[6][4], absPlane[6][3];
+  for (int p = 0; p < 6; p++) {
+    for (int k = 0; k < 4; k++) {
+      plane[p][k] = _mm_set1_ps(planes[p][k]);
+    }
+    for (int k = 0; k < 3; k++) {
+      absPlane[p][k] = _mm_set1_ps(absPlanes[p][k]);
+    }
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+  uint32_t count = 0;
+
+  for (uint32_t i = begin; i < end; i += 4) {
+    __m128 cx = _mm_loadu_ps(&centerX[i]);
+    __m128 cy = _mm_loadu_ps(&centerY[i]);
+    __m128 cz = _mm_loadu_ps(&centerZ[i]);
+    __m128 ex = _mm_loadu_ps(&extentX[i]);
+    __m128 ey = _mm_loadu_ps(&extentY[i]);
+    __m128 ez = _mm_loadu_ps(&extentZ[i]);
+    __m128 r = _mm_loadu_ps(&radius[i]);
+
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(plane[p][0], cx), _mm_mul_ps(plane[p][1], cy)),
+          _mm_add_ps(_mm_mul_ps(plane[p][2], cz), plane[p][3]));
+      __m128 extent = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(absPlane[p][0], ex),
+                     _mm_mul_ps(absPlane[p][1], ey)),
+          _mm_add_ps(_mm_mul_ps(absPlane[p][2], ez), r));
+      inside = _mm_and_ps(inside,
+                          _mm_cmpge_ps(_mm_add_ps(distance, extent), zero));
+    }
+
+    unsigned mask = static_cast<unsigned>(_mm_movemask_ps(inside));
+    while (mask) {
+      output[count++] = i + std::countr_zero(mask);
+      mask &= mask - 1;
+    }
+  }
+  return count;
+}
+
+TARGET_AVX2 uint32_t FrustumCuller::cullAvx2(uint32_t begin, uint32_t end,
+                                             uint32_t *output) const {
+  __m256 plane[6][4], absPlane[6][3];
+  for (int p = 0; p < 6; p++) {
+    for (int k = 0; k < 4; k++) {
+      plane[p][k] = _mm256_set1_ps(planes[p][k]);
+    }
+    for (int k = 0; k < 3; k++) {
+      absPlane[p][k] = _mm256_set1_ps(absPlanes[p][k]);
+    }
+  }
+
+  const __m256 zero = _mm256_setzero_ps();
+  uint32_t count = 0;
+
+  for (uint32_t i = begin; i < end; i += 8) {
+    __m256 cx = _mm256_loadu_ps(&centerX[i]);
+    __m256 cy = _mm256_loadu_ps(&centerY[i]);
+    __m256 cz = _mm256_loadu_ps(&centerZ[i]);
+    __m256 ex = _mm256_loadu_ps(&extentX[i]);
+    __m256 ey = _mm256_loadu_ps(&extentY[i]);
+    __m256 ez = _mm256_loadu_ps(&extentZ[i]);
+    __m256 r = _mm256_loadu_ps(&radius[i]);
+
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (int p = 0; p < 6; p++) {
+      __m256 distance =
+          _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane[p][0], cx),
+                                      _mm256_mul_ps(plane[p][1], cy)),
+                        _mm256_add_ps(_mm256_mul_ps(plane[p][2], cz),
+                                      plane[p][3]));
+      __m256 extent =
+          _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absPlane[p][0], ex),
+                                      _mm256_mul_ps(absPlane[p][1], ey)),
+                        _mm256_add_ps(_mm256_mul_ps(absPlane[p][2], ez), r));
+      inside = _mm256_and_ps(
+          inside,
+          _mm256_cmp_ps(_mm256_add_ps(distance, extent), zero, _CMP_GE_OQ));
+    }
+
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(inside));
+    while (mask) {
+      output[count++] = i + std::countr_zero(mask);
+      mask &= mask - 1;
+    }
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// CPU visibility test of object bounds against the view frustum. Bounds are
+// kept in structure-of-arrays form (center, half extents, radius) so the
+// SSE/AVX2 kernels test 4 or 8 objects per instruction; a sphere has zero
+// extents and a box zero radius
+class FrustumCuller {
+
+public:
+  FrustumCuller();
+
+  uint32_t addSphere(const glm::vec3 &center, float radius);
+  uint32_t addBox(const glm::vec3 &minimum, const glm::vec3 &maximum);
+  void setSphere(uint32_t object, const glm::vec3 &center, float radius);
+  void setBox(uint32_t object, const glm::vec3 &minimum,
+              const glm::vec3 &maximum);
+  void clear();
+  // Objects beyond the previous count never pass until they are set
+  void resize(uint32_t count);
+  uint32_t getObjectCount() const { return objectCount; }
+
+  // Extracts the six planes from a Vulkan (0..1 depth) view-projection
+  // matrix; works for reversed and infinite-far projections as well
+  void setFrustum(const glm::mat4 &viewProjection);
+
+  // Fills visible with the indices of the objects intersecting the frustum,
+  // in ascending order. threadPool may be null to cull on the calling thread
+  void cull(std::vector<uint32_t> &visible, ThreadPool *threadPool = nullptr);
+
+  // Forces the scalar kernel, e.g. for comparing results and timings
+  void setSimdEnabled(bool enabled) { simdEnabled = enabled; }
+  static bool isAvx2Supported();
+
+private:
+  static constexpr uint32_t kLaneCount = 8;
+  static constexpr size_t kChunkSize = 4096;
+
+  // Padded to a multiple of kLaneCount with objects that never pass
+  std::vector<float> centerX, centerY, centerZ;
+  std::vector<float> extentX, extentY, extentZ;
+  std::vector<float> radius;
+  uint32_t objectCount = 0;
+  std::vector<uint32_t> chunkCounts;
+  std::vector<uint32_t> scratch;
+
+  float planes[6][4] = {};
+  float absPlanes[6][3] = {};
+  bool simdEnabled = true;
+  bool avx2 = false;
+
+  void set(uint32_t object, const glm::vec3 &center, const glm::vec3 &extent,
+           float sphereRadius);
+  uint32_t cullRange(uint32_t begin, uint32_t end, uint32_t *output) const;
+  uint32_t cullScalar(uint32_t begin, uint32_t end, uint32_t *output) const;
+  uint32_t cullSse(uint32_t begin, uint32_t end, uint32_t *output) const;
+  uint32_t cullAvx2(uint32_t begin, uint32_t end, uint32_t *output) const;
+};
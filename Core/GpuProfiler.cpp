@@ -0,0 +1,247 @@
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+// Bits of a timestamp that carry the counter; zero when unsupported
+static uint64_t timestampMask(uint32_t validBits) {
+  if (validBits == 0)
+    return 0;
+  return validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+}
+
+static void writeJsonString(std::ostream &out, const std::string &text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out << '\\';
+    out << c;
+  }
+  out << '"';
+}
+
+void GpuProfiler::create(VulkanContext &context, uint32_t framesInFlight,
+                         uint32_t maxScopes) {
+  device = context.getDevice();
+  this->maxScopes = maxScopes;
+
+  const DeviceCapabilities &capabilities = context.getCapabilities();
+  const std::vector<VkQueueFamilyProperties> &families =
+      capabilities.queueFamilies;
+  graphicsMask = timestampMask(
+      families[context.getGraphicsQueueFamilyIndex()].timestampValidBits);
+  computeMask = timestampMask(
+      families[context.getComputeQueueFamilyIndex()].timestampValidBits);
+  nsPerTick = capabilities.properties.limits.timestampPeriod;
+
+  enabled = context.hasHostQueryReset() && graphicsMask != 0 &&
+            nsPerTick > 0.0;
+  if (!enabled)
+    return;
+
+  VkQueryPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = 2 * maxScopes;
+
+  frames.resize(framesInFlight);
+  for (Frame &frame : frames) {
+    if (vkCreateQueryPool(device, &poolInfo, nullptr, &frame.queryPool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to create timestamp query pool!");
+    }
+    // Queries must be reset before their first write
+    vkResetQueryPool(device, frame.queryPool, 0, poolInfo.queryCount);
+    frame.scopes.reserve(maxScopes);
+  }
+}
+
+void GpuProfiler::cleanup(VkDevice device) {
+  for (Frame &frame : frames) {
+    if (frame.queryPool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(device, frame.queryPool, nullptr);
+    }
+  }
+  frames.clear();
+  enabled = false;
+}
+
+bool GpuProfiler::beginFrame(uint32_t frameIndex) {
+  if (!enabled)
+    return false;
+
+  Frame &frame = frames[frameIndex];
+  uint32_t queryCount = 2 * static_cast<uint32_t>(frame.scopes.size());
+  if (queryCount == 0)
+    return false;
+
+  // Value and availability of every query. Without the wait flag, queries
+  // never submitted (a skipped compute submission) report unavailable
+  // instead of blocking
+  std::vector<uint64_t> results(2 * queryCount);
+  VkResult result = vkGetQueryPoolResults(
+      device, frame.queryPool, 0, queryCount,
+      results.size() * sizeof(uint64_t), results.data(),
+      2 * sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+  bool resolved = false;
+  if (result == VK_SUCCESS || result == VK_NOT_READY) {
+    for (History &history : histories) {
+      history.frameMs = 0.0;
+      history.seen = false;
+    }
+
+    // Queue families need not share a time domain, so each queue's
+    // timestamps are only compared with its own
+    std::vector<TraceEvent> events;
+    std::array<uint64_t, 2> queueBegin = {UINT64_MAX, UINT64_MAX};
+    uint64_t frameEnd = 0;
+    for (size_t i = 0; i < frame.scopes.size(); i++) {
+      const Scope &scope = frame.scopes[i];
+      const uint64_t *begin = &results[4 * i];
+      const uint64_t *end = &results[4 * i + 2];
+      if (!scope.ended || begin[1] == 0 || end[1] == 0)
+        continue;
+
+      // Masking the difference keeps it correct across a counter wrap
+      uint64_t mask =
+          scope.queue == Queue::Compute ? computeMask : graphicsMask;
+      uint64_t start = begin[0] & mask;
+      uint64_t duration = (end[0] - begin[0]) & mask;
+
+      uint32_t index = findHistory(scope.name);
+      histories[index].frameMs += duration * nsPerTick * 1e-6;
+      histories[index].seen = true;
+      events.push_back({index, scope.queue, start, duration});
+
+      size_t track = static_cast<size_t>(scope.queue);
+      queueBegin[track] = std::min(queueBegin[track], start);
+      if (scope.queue == Queue::Graphics) {
+        frameEnd = std::max(frameEnd, start + duration);
+      }
+    }
+
+    for (History &history : histories) {
+      if (!history.seen)
+        continue;
+      history.samples[history.next] = history.frameMs;
+      history.next = (history.next + 1) % kAverageFrames;
+      history.sampleCount = std::min(history.sampleCount + 1, kAverageFrames);
+    }
+
+    // The frame time spans the graphics scopes only
+    uint64_t frameBegin = queueBegin[static_cast<size_t>(Queue::Graphics)];
+    if (frameBegin != UINT64_MAX) {
+      resolved = true;
+      lastFrameMs = (frameEnd - frameBegin) * nsPerTick * 1e-6;
+    }
+    if (!events.empty()) {
+      for (size_t track = 0; track < queueBegin.size(); track++) {
+        if (!hasTraceOrigin[track] && queueBegin[track] != UINT64_MAX) {
+          traceOrigins[track] = queueBegin[track];
+          hasTraceOrigin[track] = true;
+        }
+      }
+      trace.push_back(std::move(events));
+      if (trace.size() > kTraceFrames) {
+        trace.pop_front();
+      }
+    }
+  }
+
+  vkResetQueryPool(device, frame.queryPool, 0, queryCount);
+  frame.scopes.clear();
+  return resolved;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer,
+                                 uint32_t frameIndex, const char *name,
+                                 Queue queue) {
+  if (!enabled || (queue == Queue::Compute && computeMask == 0))
+    return kInvalidScope;
+
+  Frame &frame = frames[frameIndex];
+  if (frame.scopes.size() >= maxScopes)
+    return kInvalidScope;
+
+  uint32_t scope = static_cast<uint32_t>(frame.scopes.size());
+  frame.scopes.push_back({name, queue, false});
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      frame.queryPool, 2 * scope);
+  return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                           uint32_t scope) {
+  if (scope == kInvalidScope)
+    return;
+
+  Frame &frame = frames[frameIndex];
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      frame.queryPool, 2 * scope + 1);
+  frame.scopes[scope].ended = true;
+}
+
+std::vector<GpuScopeTiming> GpuProfiler::getTimings() const {
+  std::vector<GpuScopeTiming> timings;
+  timings.reserve(histories.size());
+  for (const History &history : histories) {
+    GpuScopeTiming timing;
+    timing.name = history.name;
+    if (history.sampleCount > 0) {
+      uint32_t last = (history.next + kAverageFrames - 1) % kAverageFrames;
+      timing.lastMs = history.samples[last];
+      double sum = 0.0;
+      for (uint32_t i = 0; i < history.sampleCount; i++) {
+        sum += history.samples[i];
+      }
+      timing.averageMs = sum / history.sampleCount;
+    }
+    timings.push_back(timing);
+  }
+  return timings;
+}
+
+bool GpuProfiler::writeTrace(const std::string &path) const {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+
+  // One track per queue, each timed from its own first traced scope since
+  // the queues' clocks are not related
+  out << "{\"traceEvents\":[\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+         "\"args\":{\"name\":\"Graphics queue\"}},\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+         "\"args\":{\"name\":\"Compute queue\"}}";
+
+  // Microseconds since the first traced frame
+  out << std::fixed << std::setprecision(3);
+  for (const std::vector<TraceEvent> &events : trace) {
+    for (const TraceEvent &event : events) {
+      size_t track = static_cast<size_t>(event.queue);
+      int64_t ticks =
+          static_cast<int64_t>(event.begin - traceOrigins[track]);
+      out << ",\n{\"name\":";
+      writeJsonString(out, histories[event.history].name);
+      out << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << track
+          << ",\"ts\":" << ticks * nsPerTick * 1e-3
+          << ",\"dur\":" << event.duration * nsPerTick * 1e-3 << "}";
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return static_cast<bool>(out);
+}
+
+uint32_t GpuProfiler::findHistory(const char *name) {
+  for (uint32_t i = 0; i < histories.size(); i++) {
+    if (std::strcmp(histories[i].name.c_str(), name) == 0)
+      return i;
+  }
+  histories.emplace_back();
+  histories.back().name = name;
+  return static_cast<uint32_t>(histories.size() - 1);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "VulkanContext.hpp"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Timing of one named scope, averaged over the last kAverageFrames frames
+struct GpuScopeTiming {
+  std::string name;
+  double lastMs = 0.0;
+  double averageMs = 0.0;
+};
+
+// GPU timestamps around named scopes. Each frame in flight has its own query
+// pool, read back once that frame's fence has signaled, so results arrive
+// framesInFlight frames late but never stall the CPU. Per frame:
+//   wait for the fence -> beginFrame -> beginScope/endScope while recording
+// Scopes may be recorded on the graphics and the compute queue; both write
+// into the same pool, which is why it is reset from the host. The queues'
+// timestamps need not share a time domain, so frame times come from the
+// graphics scopes and the trace keeps each queue on its own track.
+class GpuProfiler {
+
+public:
+  enum class Queue { Graphics, Compute }; // trace track 0 and 1
+
+  static constexpr uint32_t kAverageFrames = 64;
+  // Frames kept for writeTrace
+  static constexpr uint32_t kTraceFrames = 256;
+  static constexpr uint32_t kInvalidScope = UINT32_MAX;
+
+  // Stays disabled (every call a no-op) without host query reset or
+  // timestamp support on the graphics queue
+  void create(VulkanContext &context, uint32_t framesInFlight,
+              uint32_t maxScopes = 64);
+  void cleanup(VkDevice device);
+
+  // Collects the results last recorded with frameIndex and frees its
+  // queries. The frame's fence must have signaled. Returns true when a
+  // frame with graphics scopes resolved, updating getLastFrameMs
+  bool beginFrame(uint32_t frameIndex);
+
+  // name must outlive the frame (a string literal). Returns the handle for
+  // endScope, or kInvalidScope once the pool is full
+  uint32_t beginScope(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                      const char *name, Queue queue = Queue::Graphics);
+  void endScope(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                uint32_t scope);
+
+  // Scopes in the order they were first seen
+  std::vector<GpuScopeTiming> getTimings() const;
+  // First graphics scope begin to last graphics scope end of the latest
+  // resolved frame
+  double getLastFrameMs() const { return lastFrameMs; }
+
+  // Chrome trace event JSON of the retained frames, loadable in
+  // chrome://tracing and ui.perfetto.dev
+  bool writeTrace(const std::string &path) const;
+
+  bool isEnabled() const { return enabled; }
+
+private:
+  struct Scope {
+    const char *name;
+    Queue queue;
+    bool ended;
+  };
+
+  struct Frame {
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    std::vector<Scope> scopes; // scope i owns queries 2i and 2i + 1
+  };
+
+  struct History {
+    std::string name;
+    std::array<double, kAverageFrames> samples{};
+    uint32_t sampleCount = 0;
+    uint32_t next = 0;
+    double frameMs = 0.0; // summed over the scopes of the frame
+    bool seen = false;
+  };
+
+  struct TraceEvent {
+    uint32_t history; // index into histories, for the name
+    Queue queue;
+    uint64_t begin; // ticks
+    uint64_t duration;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  bool enabled = false;
+  uint32_t maxScopes = 0;
+  double nsPerTick = 1.0;
+  uint64_t graphicsMask = 0;
+  uint64_t computeMask = 0; // zero when compute timestamps are unsupported
+
+  std::vector<Frame> frames;
+  std::vector<History> histories;
+  std::deque<std::vector<TraceEvent>> trace;
+  std::array<bool, 2> hasTraceOrigin{}; // by queue
+  std::array<uint64_t, 2> traceOrigins{};
+  double lastFrameMs = 0.0;
+
+  uint32_t findHistory(const char *name);
+};
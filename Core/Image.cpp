@@ -0,0 +1,359 @@
+#include "Image.hpp"
+
+#include "Buffer.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+static constexpr VkAccessFlags2 kWriteAccess =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+Image::Image(Image &&other) noexcept
+    : image(other.image), memory(other.memory), view(other.view),
+      format(other.format), extent(other.extent), mipLevels(other.mipLevels),
+      arrayLayers(other.arrayLayers), aspect(other.aspect),
+      states(std::move(other.states)),
+      lastBarriers(std::move(other.lastBarriers)) {
+  other.image = VK_NULL_HANDLE;
+  other.memory = VK_NULL_HANDLE;
+  other.view = VK_NULL_HANDLE;
+}
+
+Image &Image::operator=(Image &&other) noexcept {
+  if (this != &other) {
+    image = other.image;
+    memory = other.memory;
+    view = other.view;
+    format = other.format;
+    extent = other.extent;
+    mipLevels = other.mipLevels;
+    arrayLayers = other.arrayLayers;
+    aspect = other.aspect;
+    states = std::move(other.states);
+    lastBarriers = std::move(other.lastBarriers);
+
+    other.image = VK_NULL_HANDLE;
+    other.memory = VK_NULL_HANDLE;
+    other.view = VK_NULL_HANDLE;
+  }
+  return *this;
+}
+
+void Image::create(VulkanContext &context, const VkImageCreateInfo &imageInfo,
+                   VkImageAspectFlags aspect,
+                   VkMemoryPropertyFlags properties) {
+  VkDevice device = context.getDevice();
+  format = imageInfo.format;
+  extent = imageInfo.extent;
+  mipLevels = imageInfo.mipLevels;
+  arrayLayers = imageInfo.arrayLayers;
+  this->aspect = aspect;
+
+  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create image!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex = Buffer::findMemoryType(
+      context, memRequirements.memoryTypeBits, properties);
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate image memory!");
+  }
+  vkBindImageMemory(device, image, memory, 0);
+
+  VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  viewInfo.image = image;
+  switch (imageInfo.imageType) {
+  case VK_IMAGE_TYPE_1D:
+    viewInfo.viewType =
+        arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D;
+    break;
+  case VK_IMAGE_TYPE_3D:
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+    break;
+  default:
+    viewInfo.viewType =
+        arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    break;
+  }
+  viewInfo.format = format;
+  viewInfo.subresourceRange = getFullRange();
+  if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create image view!");
+  }
+
+  ImageState initial;
+  initial.layout = imageInfo.initialLayout;
+  states.assign(size_t(mipLevels) * arrayLayers, initial);
+  lastBarriers = states;
+}
+
+void Image::cleanup(VkDevice device) {
+  if (view != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+  if (image != VK_NULL_HANDLE) {
+    vkDestroyImage(device, image, nullptr);
+  }
+  if (memory != VK_NULL_HANDLE) {
+    vkFreeMemory(device, memory, nullptr);
+  }
+  view = VK_NULL_HANDLE;
+  image = VK_NULL_HANDLE;
+  memory = VK_NULL_HANDLE;
+  states.clear();
+  lastBarriers.clear();
+}
+
+void Image::cleanup(DeletionQueue &deletionQueue) {
+  deletionQueue.destroy(view);
+  deletionQueue.destroy(image);
+  deletionQueue.destroy(memory);
+  view = VK_NULL_HANDLE;
+  image = VK_NULL_HANDLE;
+  memory = VK_NULL_HANDLE;
+  states.clear();
+  lastBarriers.clear();
+}
+
+void Image::assumeState(const ImageState &state,
+                        VkImageSubresourceRange range) {
+  range = resolveRange(range);
+  for (uint32_t level = 0; level < range.levelCount; level++) {
+    for (uint32_t layer = 0; layer < range.layerCount; layer++) {
+      size_t index = (range.baseMipLevel + level) * arrayLayers +
+                     range.baseArrayLayer + layer;
+      states[index] = state;
+      lastBarriers[index] = state;
+    }
+  }
+}
+
+VkImageUsageFlags Image::supportedUsage(const VulkanContext &context,
+                                       VkFormat format,
+                                       VkImageUsageFlags usage) {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(context.getPhysicalDevice(), format,
+                                      &properties);
+  VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+
+  // Format feature each usage needs
+  static constexpr std::pair<VkImageUsageFlagBits, VkFormatFeatureFlags>
+      kRequirements[] = {
+          {VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_FORMAT_FEATURE_TRANSFER_SRC_BIT},
+          {VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_FORMAT_FEATURE_TRANSFER_DST_BIT},
+          {VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT},
+          {VK_IMAGE_USAGE_STORAGE_BIT, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT},
+          {VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+           VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT},
+          {VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+           VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT},
+      };
+  for (const auto &[bit, feature] : kRequirements) {
+    if ((usage & bit) && !(features & feature)) {
+      usage &= ~static_cast<VkImageUsageFlags>(bit);
+    }
+  }
+  return usage;
+}
+
+VkImageSubresourceRange
+Image::resolveRange(VkImageSubresourceRange range) const {
+  if (range.aspectMask == 0) {
+    range.aspectMask = aspect;
+  }
+  if (range.baseMipLevel >= mipLevels || range.baseArrayLayer >= arrayLayers) {
+    throw std::runtime_error("Image subresource range out of bounds!");
+  }
+  uint32_t levelsLeft = mipLevels - range.baseMipLevel;
+  uint32_t layersLeft = arrayLayers - range.baseArrayLayer;
+  if (range.levelCount == 0 || range.levelCount > levelsLeft) {
+    range.levelCount = levelsLeft;
+  }
+  if (range.layerCount == 0 || range.layerCount > layersLeft) {
+    range.layerCount = layersLeft;
+  }
+  return range;
+}
+
+void ImageBarrierBatch::transition(Image &image, const ImageState &next,
+                                   VkImageSubresourceRange range) {
+  range = image.resolveRange(range);
+  for (uint32_t level = range.baseMipLevel;
+       level < range.baseMipLevel + range.levelCount; level++) {
+    // Consecutive layers leaving the same state share a barrier
+    uint32_t runStart = 0;
+    ImageState runState{};
+    bool inRun = false;
+    for (uint32_t layer = range.baseArrayLayer;
+         layer < range.baseArrayLayer + range.layerCount; layer++) {
+      size_t index = level * image.arrayLayers + layer;
+      ImageState &state = image.states[index];
+      ImageState &lastBarrier = image.lastBarriers[index];
+
+      // Reads after reads in the same layout need no barrier when the next
+      // stages and accesses already waited for the last write. Other new
+      // readers wait for the last barrier, while later writers must wait
+      // for every reader
+      bool reads = state.layout == next.layout &&
+                   ((state.access | next.access) & kWriteAccess) == 0;
+      bool covered = (next.stages & ~state.stages) == 0 &&
+                     (next.access & ~state.access) == 0;
+      bool needed = !reads || !covered;
+      ImageState source = reads ? lastBarrier : state;
+
+      bool sameRun = inRun && needed && source.layout == runState.layout &&
+                     source.stages == runState.stages &&
+                     source.access == runState.access;
+      if (inRun && !sameRun) {
+        add(image.image, image.aspect, runState, next, level, runStart,
+            layer - runStart);
+        inRun = false;
+      }
+      if (needed && !inRun) {
+        runStart = layer;
+        runState = source;
+        inRun = true;
+      }
+      if (reads) {
+        state.stages |= next.stages;
+        state.access |= next.access;
+      } else {
+        state = next;
+        lastBarrier = next;
+      }
+    }
+    if (inRun) {
+      add(image.image, image.aspect, runState, next, level, runStart,
+          range.baseArrayLayer + range.layerCount - runStart);
+    }
+  }
+}
+
+void ImageBarrierBatch::transition(VkImage image, VkImageAspectFlags aspect,
+                                   const ImageState &previous,
+                                   const ImageState &next) {
+  add(image, aspect, previous, next, 0, 0, 1);
+}
+
+void ImageBarrierBatch::add(VkImage image, VkImageAspectFlags aspect,
+                            const ImageState &previous,
+                            const ImageState &next, uint32_t mipLevel,
+                            uint32_t baseLayer, uint32_t layerCount) {
+  // Extends the previous barrier when this is the next level of the same
+  // transition
+  if (!barriers.empty()) {
+    VkImageMemoryBarrier2 &last = barriers.back();
+    VkImageSubresourceRange &lastRange = last.subresourceRange;
+    if (last.image == image && last.oldLayout == previous.layout &&
+        last.srcStageMask == previous.stages &&
+        last.srcAccessMask == (previous.access & kWriteAccess) &&
+        last.newLayout == next.layout && last.dstStageMask == next.stages &&
+        last.dstAccessMask == next.access &&
+        lastRange.baseArrayLayer == baseLayer &&
+        lastRange.layerCount == layerCount &&
+        lastRange.baseMipLevel + lastRange.levelCount == mipLevel) {
+      lastRange.levelCount++;
+      return;
+    }
+  }
+
+  VkImageMemoryBarrier2 barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+  barrier.srcStageMask = previous.stages;
+  barrier.srcAccessMask = previous.access & kWriteAccess;
+  barrier.dstStageMask = next.stages;
+  barrier.dstAccessMask = next.access;
+  barrier.oldLayout = previous.layout;
+  barrier.newLayout = next.layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {aspect, mipLevel, 1, baseLayer, layerCount};
+  barriers.push_back(barrier);
+}
+
+// synchronization2 stages and accesses without a legacy bit map onto the
+// legacy bits that include them
+static VkPipelineStageFlags toLegacyStages(VkPipelineStageFlags2 stages) {
+  VkPipelineStageFlags legacy =
+      static_cast<VkPipelineStageFlags>(stages & 0xffffffffull);
+  if (stages & (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT |
+                VK_PIPELINE_STAGE_2_RESOLVE_BIT |
+                VK_PIPELINE_STAGE_2_CLEAR_BIT)) {
+    legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+  }
+  if (stages & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT |
+                VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT)) {
+    legacy |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  }
+  if (stages & VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT) {
+    legacy |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+              VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT |
+              VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT |
+              VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+  }
+  return legacy;
+}
+
+static VkAccessFlags toLegacyAccess(VkAccessFlags2 access) {
+  VkAccessFlags legacy = static_cast<VkAccessFlags>(access & 0xffffffffull);
+  if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT |
+                VK_ACCESS_2_SHADER_STORAGE_READ_BIT)) {
+    legacy |= VK_ACCESS_SHADER_READ_BIT;
+  }
+  if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) {
+    legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+  }
+  return legacy;
+}
+
+void ImageBarrierBatch::record(VkCommandBuffer commandBuffer,
+                               const VulkanContext &context) {
+  if (barriers.empty())
+    return;
+
+  if (context.hasSynchronization2()) {
+    VkDependencyInfo dependency{VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dependency.imageMemoryBarrierCount =
+        static_cast<uint32_t>(barriers.size());
+    dependency.pImageMemoryBarriers = barriers.data();
+    vkCmdPipelineBarrier2(commandBuffer, &dependency);
+    barriers.clear();
+    return;
+  }
+
+  VkPipelineStageFlags srcStages = 0;
+  VkPipelineStageFlags dstStages = 0;
+  std::vector<VkImageMemoryBarrier> legacyBarriers;
+  legacyBarriers.reserve(barriers.size());
+  for (const VkImageMemoryBarrier2 &barrier : barriers) {
+    srcStages |= toLegacyStages(barrier.srcStageMask);
+    dstStages |= toLegacyStages(barrier.dstStageMask);
+
+    VkImageMemoryBarrier legacy{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    legacy.srcAccessMask = toLegacyAccess(barrier.srcAccessMask);
+    legacy.dstAccessMask = toLegacyAccess(barrier.dstAccessMask);
+    legacy.oldLayout = barrier.oldLayout;
+    legacy.newLayout = barrier.newLayout;
+    legacy.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+    legacy.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+    legacy.image = barrier.image;
+    legacy.subresourceRange = barrier.subresourceRange;
+    legacyBarriers.push_back(legacy);
+  }
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      dstStages ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+      nullptr, 0, nullptr, static_cast<uint32_t>(legacyBarriers.size()),
+      legacyBarriers.data());
+  barriers.clear();
+}
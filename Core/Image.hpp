@@ -0,0 +1,124 @@
+#pragma once
+
+#include "DeletionQueue.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// How a subresource was last used: its layout, and the stages and accesses
+// a following barrier has to wait for
+struct ImageState {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 access = VK_ACCESS_2_NONE;
+};
+
+// An image with its memory and a view of every subresource. The state of
+// each mip level and array layer is tracked as barriers are recorded
+// through ImageBarrierBatch, so callers only say how the image is used
+// next. Tracking follows recording order: images used by several command
+// buffers must have them recorded in submission order
+class Image {
+
+public:
+  Image() = default;
+  ~Image() = default;
+
+  // Delete copy constructor and copy assignment
+  Image(const Image &) = delete;
+  Image &operator=(const Image &) = delete;
+
+  // Allow move semantics
+  Image(Image &&other) noexcept;
+  Image &operator=(Image &&other) noexcept;
+
+  // The view covers aspect over every level and layer; the view type
+  // follows imageType and arrayLayers
+  void create(VulkanContext &context, const VkImageCreateInfo &imageInfo,
+              VkImageAspectFlags aspect,
+              VkMemoryPropertyFlags properties =
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  void cleanup(VkDevice device);
+  // Hands the image, view and memory to the queue, for images that frames
+  // in flight may still use
+  void cleanup(DeletionQueue &deletionQueue);
+
+  VkImage getImage() const { return image; }
+  VkImageView getView() const { return view; }
+  VkFormat getFormat() const { return format; }
+  VkExtent3D getExtent() const { return extent; }
+  uint32_t getMipLevels() const { return mipLevels; }
+  uint32_t getArrayLayers() const { return arrayLayers; }
+  VkImageAspectFlags getAspect() const { return aspect; }
+  VkImageSubresourceRange getFullRange() const {
+    return {aspect, 0, mipLevels, 0, arrayLayers};
+  }
+
+  const ImageState &getState(uint32_t mipLevel, uint32_t arrayLayer) const {
+    return states[mipLevel * arrayLayers + arrayLayer];
+  }
+  // Records a state reached without a barrier, e.g. a render pass's
+  // finalLayout. Levels and layers default to the whole image
+  void assumeState(const ImageState &state,
+                   VkImageSubresourceRange range = {});
+
+  // The bits of usage that optimal-tiling images of format can have
+  static VkImageUsageFlags supportedUsage(const VulkanContext &context,
+                                          VkFormat format,
+                                          VkImageUsageFlags usage);
+
+private:
+  friend class ImageBarrierBatch;
+
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent3D extent{};
+  uint32_t mipLevels = 0;
+  uint32_t arrayLayers = 0;
+  VkImageAspectFlags aspect = 0;
+  std::vector<ImageState> states; // level-major
+  // Destination of each subresource's last barrier. Readers joining in the
+  // same layout wait for it, which orders them after the last write or
+  // layout change
+  std::vector<ImageState> lastBarriers;
+
+  // Clamps range to the image, with a zero count meaning the rest of it
+  VkImageSubresourceRange resolveRange(VkImageSubresourceRange range) const;
+};
+
+// Image transitions gathered over a sync point and recorded as one
+// vkCmdPipelineBarrier2. Subresources already in the requested layout are
+// skipped when neither the last use nor the next one writes and the next
+// stages and accesses already waited for the last write, and neighbouring
+// levels sharing a state are merged into one barrier. Without
+// synchronization2 a single vkCmdPipelineBarrier with the combined stages
+// is recorded instead
+class ImageBarrierBatch {
+
+public:
+  // Levels and layers default to the whole image. The new state is
+  // tracked right away, so transition a subresource once per batch
+  void transition(Image &image, const ImageState &next,
+                  VkImageSubresourceRange range = {});
+  // Single-level, single-layer images without tracking, e.g. swapchain
+  // images; previous is the caller's knowledge of their last use
+  void transition(VkImage image, VkImageAspectFlags aspect,
+                  const ImageState &previous, const ImageState &next);
+
+  // Records the pending barriers, if any, and clears the batch
+  void record(VkCommandBuffer commandBuffer, const VulkanContext &context);
+
+  bool empty() const { return barriers.empty(); }
+  size_t size() const { return barriers.size(); }
+
+private:
+  std::vector<VkImageMemoryBarrier2> barriers;
+
+  void add(VkImage image, VkImageAspectFlags aspect,
+           const ImageState &previous, const ImageState &next,
+           uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount);
+};
@@ -0,0 +1,56 @@
+#include "LodSelector.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Distance clamp so objects around the camera always get LOD 0
+static constexpr float kMinDistance = 1e-3f;
+
+void LodSelector::setCamera(const glm::vec3 &position, float fovY,
+                            float viewportHeight) {
+  cameraPosition = position;
+  projectionScale = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+float LodSelector::projectError(float error, const glm::vec3 &center,
+                                float radius, float scale) const {
+  // Use the nearest point of the bounding sphere so large objects are not
+  // simplified while the camera is close to their surface
+  float distance = glm::length(center - cameraPosition) - radius;
+  distance = std::max(distance, kMinDistance);
+  return error * scale * projectionScale / distance;
+}
+
+uint32_t LodSelector::select(const std::vector<MeshLod> &lods,
+                             const glm::vec3 &center, float radius,
+                             float scale, uint32_t &currentLod) const {
+  if (lods.empty()) {
+    currentLod = 0;
+    return 0;
+  }
+
+  // Coarsest LODs under the threshold, and under the stricter threshold
+  // required to switch to a coarser LOD. Errors grow along the chain
+  uint32_t acceptable = 0;
+  uint32_t preferred = 0;
+  const float strictThreshold = errorThreshold * (1.0f - hysteresis);
+  for (uint32_t i = 1; i < lods.size(); i++) {
+    float projected = projectError(lods[i].error, center, radius, scale);
+    if (projected > errorThreshold)
+      break;
+
+    acceptable = i;
+    if (projected <= strictThreshold) {
+      preferred = i;
+    }
+  }
+
+  currentLod = std::min<uint32_t>(currentLod, lods.size() - 1);
+  if (currentLod > acceptable) {
+    // Refine immediately when the current LOD became too coarse
+    currentLod = acceptable;
+  } else if (preferred > currentLod) {
+    currentLod = preferred;
+  }
+  return currentLod;
+}
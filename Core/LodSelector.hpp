@@ -0,0 +1,37 @@
+#pragma once
+
+#include "MeshImporter.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+class LodSelector {
+
+public:
+  // fovY in radians, viewportHeight in pixels
+  void setCamera(const glm::vec3 &position, float fovY, float viewportHeight);
+
+  // Largest acceptable projected error in pixels
+  void setErrorThreshold(float pixels) { errorThreshold = pixels; }
+
+  // Fraction below the threshold a coarser LOD must reach before switching
+  // to it, so objects near a transition distance do not pop back and forth
+  void setHysteresis(float fraction) { hysteresis = fraction; }
+
+  // Picks the coarsest LOD whose projected error stays under the threshold.
+  // center/radius are the world-space bounding sphere and scale the object's
+  // uniform scale. currentLod holds the LOD used last frame and is updated
+  uint32_t select(const std::vector<MeshLod> &lods, const glm::vec3 &center,
+                  float radius, float scale, uint32_t &currentLod) const;
+
+  // Projects an object-space error to pixels at the bounding sphere distance
+  float projectError(float error, const glm::vec3 &center, float radius,
+                     float scale) const;
+
+private:
+  glm::vec3 cameraPosition{0.0f};
+  float projectionScale = 1.0f;
+  float errorThreshold = 1.0f;
+  float hysteresis = 0.25f;
+};
@@ -0,0 +1,156 @@
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+static char levelLetter(LogLevel level) {
+  switch (level) {
+  case LogLevel::Debug:
+    return 'D';
+  case LogLevel::Info:
+    return 'I';
+  case LogLevel::Warning:
+    return 'W';
+  default:
+    return 'E';
+  }
+}
+
+Logger::Logger() : startTime(now()) {
+  writer = std::thread(&Logger::writerLoop, this);
+}
+
+Logger::~Logger() {
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    running = false;
+  }
+  writerCondition.notify_one();
+  writer.join();
+
+  // Whatever was logged after the last pass
+  drain();
+}
+
+Logger &Logger::instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::ThreadBuffer &Logger::threadBuffer() {
+  // The logger owns the ring, so messages of a finished thread are still
+  // written
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (!buffer) {
+    Logger &logger = instance();
+    std::lock_guard<std::mutex> lock(logger.buffersMutex);
+    logger.buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffer = logger.buffers.back().get();
+    buffer->threadIndex = static_cast<uint32_t>(logger.buffers.size() - 1);
+  }
+  return *buffer;
+}
+
+uint64_t Logger::now() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void Logger::write(LogLevel level, const char *format, ...) {
+  Logger &logger = instance();
+  ThreadBuffer &buffer = threadBuffer();
+  uint32_t head = buffer.head.load(std::memory_order_relaxed);
+  if (head - buffer.tail.load(std::memory_order_acquire) >= kRingSize) {
+    buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  Record &record = buffer.records[head & (kRingSize - 1)];
+  record.sequence =
+      logger.nextSequence.fetch_add(1, std::memory_order_relaxed);
+  record.time = now() - logger.startTime;
+  record.level = level;
+  record.threadIndex = buffer.threadIndex;
+  va_list args;
+  va_start(args, format);
+  std::vsnprintf(record.text, kMessageSize, format, args);
+  va_end(args);
+  buffer.head.store(head + 1, std::memory_order_release);
+
+  // Warnings and errors should not wait for the next pass
+  if (level >= LogLevel::Warning) {
+    logger.writerCondition.notify_one();
+  }
+}
+
+void Logger::flush() { instance().drain(); }
+
+void Logger::writerLoop() {
+  std::unique_lock<std::mutex> lock(writerMutex);
+  while (running) {
+    writerCondition.wait_for(lock, std::chrono::milliseconds(5));
+    lock.unlock();
+    drain();
+    lock.lock();
+  }
+}
+
+void Logger::drain() {
+  std::lock_guard<std::mutex> drainLock(drainMutex);
+
+  std::vector<ThreadBuffer *> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    snapshot.reserve(buffers.size());
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers) {
+      snapshot.push_back(buffer.get());
+    }
+  }
+
+  // Slots stay owned by the writer until the tails move below
+  pending.clear();
+  std::vector<uint32_t> heads(snapshot.size());
+  for (size_t i = 0; i < snapshot.size(); i++) {
+    ThreadBuffer *buffer = snapshot[i];
+    uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+    heads[i] = buffer->head.load(std::memory_order_acquire);
+    for (; tail != heads[i]; tail++) {
+      pending.push_back(&buffer->records[tail & (kRingSize - 1)]);
+    }
+
+    uint32_t dropped = buffer->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+      std::fprintf(stderr, "Logger: %u messages dropped on thread %u\n",
+                   dropped, buffer->threadIndex);
+    }
+  }
+  std::sort(pending.begin(), pending.end(),
+            [](const Record *a, const Record *b) {
+              return a->sequence < b->sequence;
+            });
+
+  // Flushing on every switch between the streams keeps a terminal showing
+  // both in order
+  FILE *current = nullptr;
+  for (const Record *record : pending) {
+    FILE *stream = record->level >= LogLevel::Warning ? stderr : stdout;
+    if (current && stream != current) {
+      std::fflush(current);
+    }
+    current = stream;
+    std::fprintf(stream, "[%10.3f] %c T%u %s\n", record->time * 1e-9,
+                 levelLetter(record->level), record->threadIndex,
+                 record->text);
+  }
+  if (current) {
+    std::fflush(current);
+  }
+
+  for (size_t i = 0; i < snapshot.size(); i++) {
+    snapshot[i]->tail.store(heads[i], std::memory_order_release);
+  }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class LogLevel : int { Debug = 0, Info, Warning, Error, Off };
+
+// Lowest level compiled in at all (CMake cache variable VALKEON_LOG_LEVEL);
+// calls below it vanish, arguments included
+#ifndef VALKEON_LOG_MIN_LEVEL
+#define VALKEON_LOG_MIN_LEVEL 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VALKEON_PRINTF_FORMAT(formatIndex, firstArg)                           \
+  __attribute__((format(printf, formatIndex, firstArg)))
+#else
+#define VALKEON_PRINTF_FORMAT(formatIndex, firstArg)
+#endif
+
+// printf-style logging, e.g. LOG_INFO("%u meshlets", count). Arguments are
+// only evaluated when the level is enabled at compile time and at runtime.
+#define VALKEON_LOG(level, ...)                                                \
+  do {                                                                         \
+    if constexpr (static_cast<int>(level) >= VALKEON_LOG_MIN_LEVEL) {          \
+      if (Logger::isEnabled(level))                                            \
+        Logger::write(level, __VA_ARGS__);                                     \
+    }                                                                          \
+  } while (0)
+#define LOG_DEBUG(...) VALKEON_LOG(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) VALKEON_LOG(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) VALKEON_LOG(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) VALKEON_LOG(LogLevel::Error, __VA_ARGS__)
+
+// Each thread formats its messages into its own fixed-size ring, written
+// only by that thread and read only by the writer thread, so logging never
+// allocates, locks or touches stdio on the calling thread. The writer
+// drains every ring every few milliseconds, orders records by sequence
+// number and writes them with one flush per pass: Debug and Info to
+// stdout, Warning and Error to stderr. Messages are dropped and counted,
+// not blocked on, when a ring is full.
+class Logger {
+
+public:
+  static constexpr uint32_t kRingSize = 512; // records per thread
+  static constexpr size_t kMessageSize = 232; // bytes, truncated beyond
+
+  // Runtime filter, Info by default
+  static void setLevel(LogLevel level) {
+    minimumLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+  }
+  static LogLevel getLevel() {
+    return static_cast<LogLevel>(minimumLevel.load(std::memory_order_relaxed));
+  }
+  static bool isEnabled(LogLevel level) {
+    return static_cast<int>(level) >=
+           minimumLevel.load(std::memory_order_relaxed);
+  }
+
+  static void write(LogLevel level, const char *format, ...)
+      VALKEON_PRINTF_FORMAT(2, 3);
+
+  // Blocks until everything logged so far has been written, e.g. before
+  // printing a fatal error directly
+  static void flush();
+
+private:
+  struct Record {
+    uint64_t sequence;
+    uint64_t time; // nanoseconds since the logger started
+    LogLevel level;
+    uint32_t threadIndex;
+    char text[kMessageSize];
+  };
+
+  // Single producer, single consumer
+  struct ThreadBuffer {
+    Record records[kRingSize];
+    std::atomic<uint32_t> head{0}; // written by the owning thread
+    std::atomic<uint32_t> tail{0}; // written by the writer
+    std::atomic<uint32_t> dropped{0};
+    uint32_t threadIndex = 0;
+  };
+
+  static inline std::atomic<int> minimumLevel{
+      static_cast<int>(LogLevel::Info)};
+
+  std::atomic<uint64_t> nextSequence{0};
+  uint64_t startTime = 0;
+
+  std::mutex buffersMutex; // guards the list, not the rings
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+  std::thread writer;
+  std::mutex writerMutex;
+  std::condition_variable writerCondition;
+  bool running = true;
+
+  std::mutex drainMutex; // one consumer at a time
+  std::vector<const Record *> pending;
+
+  Logger();
+  ~Logger();
+
+  static Logger &instance();
+  static ThreadBuffer &threadBuffer();
+  static uint64_t now();
+
+  void writerLoop();
+  void drain();
+};
@@ -0,0 +1,53 @@
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void Mesh::create(VulkanContext &context, CommandPool &commandPool,
+                  const MeshData &data) {
+  if (data.vertices.empty() || data.indices.empty() || data.lods.empty()) {
+    throw std::runtime_error("Cannot create a mesh without geometry!");
+  }
+
+  vertexBuffer.createDeviceLocal(context, commandPool, data.vertices.data(),
+                                 sizeof(data.vertices[0]) *
+                                     data.vertices.size(),
+                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  indexBuffer.createDeviceLocal(context, commandPool, data.indices.data(),
+                                sizeof(data.indices[0]) * data.indices.size(),
+                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+  lods = data.lods;
+  vertexCount = static_cast<uint32_t>(data.vertices.size());
+  std::copy(data.boundsCenter, data.boundsCenter + 3, boundsCenter);
+  boundsRadius = data.boundsRadius;
+}
+
+void Mesh::cleanup(VkDevice device) {
+  vertexBuffer.cleanup(device);
+  indexBuffer.cleanup(device);
+  lods.clear();
+  vertexCount = 0;
+}
+
+void Mesh::bind(VkCommandBuffer commandBuffer) const {
+  VkBuffer vertexBuffers[] = {vertexBuffer.getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer.getBuffer(), 0,
+                       VK_INDEX_TYPE_UINT32);
+}
+
+void Mesh::bind(VkCommandBuffer commandBuffer, VkBuffer vertices,
+                VkDeviceSize offset) const {
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices, &offset);
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer.getBuffer(), 0,
+                       VK_INDEX_TYPE_UINT32);
+}
+
+void Mesh::draw(VkCommandBuffer commandBuffer, uint32_t lod,
+                uint32_t instanceCount, uint32_t firstInstance) const {
+  const MeshLod &range = lods[std::min<size_t>(lod, lods.size() - 1)];
+  vkCmdDrawIndexed(commandBuffer, range.indexCount, instanceCount,
+                   range.indexOffset, 0, firstInstance);
+}
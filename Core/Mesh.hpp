@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "CommandPool.hpp"
+#include "MeshImporter.hpp"
+#include "VulkanContext.hpp"
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class Mesh {
+
+public:
+  // Uploads the vertices and the indices of the whole LOD chain into one
+  // device-local vertex buffer and one index buffer
+  void create(VulkanContext &context, CommandPool &commandPool,
+              const MeshData &data);
+  void cleanup(VkDevice device);
+
+  // Binds the vertex and index buffers shared by every LOD
+  void bind(VkCommandBuffer commandBuffer) const;
+  // Binds vertices from another buffer, in this mesh's vertex order (e.g.
+  // skinned ones), with the index buffer
+  void bind(VkCommandBuffer commandBuffer, VkBuffer vertices,
+            VkDeviceSize offset) const;
+
+  // Draws one LOD of the chain; the buffers must be bound
+  void draw(VkCommandBuffer commandBuffer, uint32_t lod,
+            uint32_t instanceCount = 1, uint32_t firstInstance = 0) const;
+
+  const std::vector<MeshLod> &getLods() const { return lods; }
+  uint32_t getVertexCount() const { return vertexCount; }
+  const float *getBoundsCenter() const { return boundsCenter; }
+  float getBoundsRadius() const { return boundsRadius; }
+
+private:
+  Buffer vertexBuffer;
+  Buffer indexBuffer;
+  std::vector<MeshLod> lods;
+  uint32_t vertexCount = 0;
+  float boundsCenter[3] = {0.0f, 0.0f, 0.0f};
+  float boundsRadius = 0.0f;
+};
@@ -0,0 +1,428 @@
+#include "MeshImporter.hpp"
+
+#include "MeshSimplifier.hpp"
+#include "Logger.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+using JointIndices = std::unordered_map<std::string, uint32_t>;
+
+// Assimp matrices are row-major
+static glm::mat4 toMat4(const aiMatrix4x4 &matrix) {
+  glm::mat4 result;
+  for (unsigned int row = 0; row < 4; row++) {
+    for (unsigned int column = 0; column < 4; column++) {
+      result[column][row] = matrix[row][column];
+    }
+  }
+  return result;
+}
+
+static JointPose toPose(const aiMatrix4x4 &matrix) {
+  aiVector3D scale, position;
+  aiQuaternion rotation;
+  matrix.Decompose(scale, rotation, position);
+
+  JointPose pose;
+  pose.translation = glm::vec3(position.x, position.y, position.z);
+  pose.rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+  pose.scale = glm::vec3(scale.x, scale.y, scale.z);
+  return pose;
+}
+
+// Depth-first, so parents precede their children. meshJoints receives the
+// joint of the node each mesh hangs from
+static void addJoints(const aiNode *node, int32_t parent, Skeleton &skeleton,
+                      JointIndices &jointIndices,
+                      std::vector<uint32_t> &meshJoints) {
+  uint32_t joint = skeleton.getJointCount();
+  skeleton.names.push_back(node->mName.C_Str());
+  skeleton.parents.push_back(parent);
+  skeleton.inverseBindMatrices.push_back(glm::mat4(1.0f));
+  skeleton.bindPose.push_back(toPose(node->mTransformation));
+  jointIndices.emplace(skeleton.names.back(), joint);
+
+  for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+    meshJoints[node->mMeshes[i]] = joint;
+  }
+  for (unsigned int i = 0; i < node->mNumChildren; i++) {
+    addJoints(node->mChildren[i], static_cast<int32_t>(joint), skeleton,
+              jointIndices, meshJoints);
+  }
+}
+
+// Keeps the four strongest influences of every vertex of source, which
+// start at baseVertex. Vertices without any follow meshJoint
+static void readSkin(const aiMesh *source, uint32_t baseVertex,
+                     uint32_t meshJoint, const JointIndices &jointIndices,
+                     MeshData &mesh) {
+  mesh.skin.resize(mesh.vertices.size(), VertexSkin{});
+
+  for (unsigned int b = 0; b < source->mNumBones; b++) {
+    const aiBone *bone = source->mBones[b];
+    auto found = jointIndices.find(bone->mName.C_Str());
+    if (found == jointIndices.end()) {
+      LOG_WARNING("Bone %s has no node; ignoring it", bone->mName.C_Str());
+      continue;
+    }
+    mesh.skeleton.inverseBindMatrices[found->second] =
+        toMat4(bone->mOffsetMatrix);
+
+    for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+      const aiVertexWeight &weight = bone->mWeights[w];
+      VertexSkin &skin = mesh.skin[baseVertex + weight.mVertexId];
+      float *weakest = std::min_element(skin.weights, skin.weights + 4);
+      if (weight.mWeight > *weakest) {
+        *weakest = weight.mWeight;
+        skin.joints[weakest - skin.weights] = found->second;
+      }
+    }
+  }
+
+  for (size_t v = baseVertex; v < mesh.skin.size(); v++) {
+    VertexSkin &skin = mesh.skin[v];
+    float total = skin.weights[0] + skin.weights[1] + skin.weights[2] +
+                  skin.weights[3];
+    if (total <= 0.0f) {
+      skin = {{meshJoint, 0, 0, 0}, {1.0f, 0.0f, 0.0f, 0.0f}};
+      continue;
+    }
+    for (float &weight : skin.weights) {
+      weight /= total;
+    }
+  }
+}
+
+// Index of the last key at or before tick, and the blend factor towards
+// the one after it
+template <typename Key>
+static float findKey(const Key *keys, unsigned int count, double tick,
+                     unsigned int &index) {
+  const Key *next =
+      std::upper_bound(keys, keys + count, tick,
+                       [](double t, const Key &key) { return t < key.mTime; });
+  if (next == keys) {
+    index = 0;
+    return 0.0f;
+  }
+  index = static_cast<unsigned int>(next - keys) - 1;
+  if (next == keys + count)
+    return 0.0f;
+  return static_cast<float>((tick - keys[index].mTime) /
+                            (next->mTime - keys[index].mTime));
+}
+
+static aiVector3D sampleKeys(const aiVectorKey *keys, unsigned int count,
+                             double tick) {
+  unsigned int index;
+  float factor = findKey(keys, count, tick, index);
+  if (factor == 0.0f)
+    return keys[index].mValue;
+  return keys[index].mValue +
+         (keys[index + 1].mValue - keys[index].mValue) * factor;
+}
+
+static aiQuaternion sampleKeys(const aiQuatKey *keys, unsigned int count,
+                               double tick) {
+  unsigned int index;
+  float factor = findKey(keys, count, tick, index);
+  if (factor == 0.0f)
+    return keys[index].mValue;
+  aiQuaternion rotation;
+  aiQuaternion::Interpolate(rotation, keys[index].mValue,
+                            keys[index + 1].mValue, factor);
+  return rotation.Normalize();
+}
+
+// Resamples an animation at AnimationClip::kSampleRate. Joints without a
+// channel, and channels without keys of a kind, keep the bind pose
+static AnimationClip readClip(const aiAnimation *animation,
+                              const Skeleton &skeleton,
+                              const JointIndices &jointIndices) {
+  // Assimp leaves the rate unset for formats without one
+  double ticksPerSecond =
+      animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+
+  AnimationClip clip;
+  clip.create(animation->mName.C_Str(),
+              static_cast<float>(animation->mDuration / ticksPerSecond),
+              skeleton);
+
+  for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+    const aiNodeAnim *channel = animation->mChannels[c];
+    auto found = jointIndices.find(channel->mNodeName.C_Str());
+    if (found == jointIndices.end())
+      continue;
+
+    JointPose pose = skeleton.bindPose[found->second];
+    for (uint32_t frame = 0; frame < clip.getFrameCount(); frame++) {
+      double tick =
+          std::min(frame / AnimationClip::kSampleRate * ticksPerSecond,
+                   animation->mDuration);
+      if (channel->mNumPositionKeys > 0) {
+        aiVector3D position = sampleKeys(channel->mPositionKeys,
+                                         channel->mNumPositionKeys, tick);
+        pose.translation = glm::vec3(position.x, position.y, position.z);
+      }
+      if (channel->mNumRotationKeys > 0) {
+        aiQuaternion rotation = sampleKeys(channel->mRotationKeys,
+                                           channel->mNumRotationKeys, tick);
+        pose.rotation =
+            glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+      }
+      if (channel->mNumScalingKeys > 0) {
+        aiVector3D scale = sampleKeys(channel->mScalingKeys,
+                                      channel->mNumScalingKeys, tick);
+        pose.scale = glm::vec3(scale.x, scale.y, scale.z);
+      }
+      clip.setPose(frame, found->second, pose);
+    }
+  }
+
+  clip.alignRotations();
+  return clip;
+}
+
+MeshData MeshImporter::load(const std::string &filename,
+                            const MeshImportOptions &options) {
+  // Flattening the hierarchy would drop the bones and animations
+  unsigned int flags = aiProcess_Triangulate |
+                       aiProcess_JoinIdenticalVertices |
+                       aiProcess_GenSmoothNormals;
+  flags |= options.importSkin ? aiProcess_LimitBoneWeights
+                              : aiProcess_PreTransformVertices;
+
+  Assimp::Importer importer;
+  const aiScene *scene = importer.ReadFile(filename, flags);
+
+  if (!scene || !scene->HasMeshes()) {
+    throw std::runtime_error("Failed to load mesh file: " + filename + " (" +
+                             importer.GetErrorString() + ")");
+  }
+
+  MeshData mesh;
+  // The skeleton comes first, so skin weights can refer to its joints
+  JointIndices jointIndices;
+  std::vector<uint32_t> meshJoints(scene->mNumMeshes, 0);
+  if (options.importSkin) {
+    addJoints(scene->mRootNode, Skeleton::kNoParent, mesh.skeleton,
+              jointIndices, meshJoints);
+  }
+
+  for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+    const aiMesh *source = scene->mMeshes[m];
+    uint32_t baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+
+    for (unsigned int v = 0; v < source->mNumVertices; v++) {
+      Vertex vertex{};
+      vertex.position[0] = source->mVertices[v].x;
+      vertex.position[1] = source->mVertices[v].y;
+      vertex.position[2] = source->mVertices[v].z;
+
+      if (source->HasVertexColors(0)) {
+        vertex.color[0] = source->mColors[0][v].r;
+        vertex.color[1] = source->mColors[0][v].g;
+        vertex.color[2] = source->mColors[0][v].b;
+      } else {
+        vertex.color[0] = vertex.color[1] = vertex.color[2] = 1.0f;
+      }
+
+      if (source->HasNormals()) {
+        vertex.normal[0] = source->mNormals[v].x;
+        vertex.normal[1] = source->mNormals[v].y;
+        vertex.normal[2] = source->mNormals[v].z;
+      }
+
+      mesh.vertices.push_back(vertex);
+    }
+
+    for (unsigned int f = 0; f < source->mNumFaces; f++) {
+      const aiFace &face = source->mFaces[f];
+      // Points and lines are left over after triangulation; skip them
+      if (face.mNumIndices != 3)
+        continue;
+
+      for (int k = 0; k < 3; k++) {
+        mesh.indices.push_back(baseVertex + face.mIndices[k]);
+      }
+    }
+
+    if (options.importSkin) {
+      readSkin(source, baseVertex, meshJoints[m], jointIndices, mesh);
+    }
+  }
+
+  if (options.importSkin) {
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+      mesh.clips.push_back(
+          readClip(scene->mAnimations[a], mesh.skeleton, jointIndices));
+    }
+  }
+
+  optimize(mesh, options);
+  logReport(filename, mesh);
+  return mesh;
+}
+
+void MeshImporter::optimize(MeshData &mesh, const MeshImportOptions &options) {
+  MeshOptimizationReport &report = mesh.report;
+  computeBounds(mesh);
+
+  report.vertexCacheBefore =
+      MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+  report.vertexFetchBefore = MeshOptimizer::analyzeVertexFetch(
+      mesh.indices, mesh.vertices.size(), sizeof(Vertex));
+  if (options.optimizeOverdraw) {
+    report.overdrawBefore =
+        MeshOptimizer::analyzeOverdraw(mesh.indices, mesh.vertices);
+  }
+
+  // Order matters: overdraw sorts clusters produced by the cache order, and
+  // the fetch remap must follow the final index order
+  if (options.optimizeVertexCache) {
+    MeshOptimizer::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+  }
+  if (options.optimizeOverdraw) {
+    MeshOptimizer::optimizeOverdraw(mesh.indices, mesh.vertices,
+                                    options.overdrawThreshold);
+  }
+  if (options.optimizeVertexFetch) {
+    std::vector<uint32_t> remap;
+    MeshOptimizer::optimizeVertexFetch(mesh.indices, mesh.vertices, &remap);
+    if (!mesh.skin.empty()) {
+      std::vector<VertexSkin> skin(mesh.vertices.size());
+      for (size_t v = 0; v < remap.size(); v++) {
+        if (remap[v] != UINT32_MAX) {
+          skin[remap[v]] = mesh.skin[v];
+        }
+      }
+      mesh.skin.swap(skin);
+    }
+  }
+
+  report.vertexCacheAfter =
+      MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+  report.vertexFetchAfter = MeshOptimizer::analyzeVertexFetch(
+      mesh.indices, mesh.vertices.size(), sizeof(Vertex));
+  if (options.optimizeOverdraw) {
+    report.overdrawAfter =
+        MeshOptimizer::analyzeOverdraw(mesh.indices, mesh.vertices);
+  }
+
+  if (options.buildMeshlets) {
+    MeshOptimizer::buildMeshlets(mesh.indices, mesh.vertices.size(),
+                                 options.maxMeshletVertices,
+                                 options.maxMeshletTriangles, mesh.meshlets,
+                                 mesh.meshletVertices, mesh.meshletTriangles);
+
+    mesh.meshletBounds.clear();
+    mesh.meshletBounds.reserve(mesh.meshlets.size());
+    for (const Meshlet &meshlet : mesh.meshlets) {
+      mesh.meshletBounds.push_back(MeshOptimizer::computeMeshletBounds(
+          meshlet, mesh.meshletVertices, mesh.meshletTriangles,
+          mesh.vertices));
+    }
+  }
+
+  mesh.lods.clear();
+  mesh.lods.push_back({0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+  if (options.generateLods) {
+    generateLods(mesh, options);
+  }
+}
+
+void MeshImporter::computeBounds(MeshData &mesh) {
+  if (mesh.vertices.empty())
+    return;
+
+  float minimum[3], maximum[3];
+  for (int k = 0; k < 3; k++) {
+    minimum[k] = maximum[k] = mesh.vertices[0].position[k];
+  }
+  for (const Vertex &vertex : mesh.vertices) {
+    for (int k = 0; k < 3; k++) {
+      minimum[k] = std::min(minimum[k], vertex.position[k]);
+      maximum[k] = std::max(maximum[k], vertex.position[k]);
+    }
+  }
+  for (int k = 0; k < 3; k++) {
+    mesh.boundsCenter[k] = (minimum[k] + maximum[k]) * 0.5f;
+  }
+
+  float radiusSquared = 0.0f;
+  for (const Vertex &vertex : mesh.vertices) {
+    float dx = vertex.position[0] - mesh.boundsCenter[0];
+    float dy = vertex.position[1] - mesh.boundsCenter[1];
+    float dz = vertex.position[2] - mesh.boundsCenter[2];
+    radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+  }
+  mesh.boundsRadius = std::sqrt(radiusSquared);
+}
+
+void MeshImporter::generateLods(MeshData &mesh,
+                                const MeshImportOptions &options) {
+  // Each LOD is simplified from the previous one, so its error is bounded by
+  // the sum of the collapse errors along the chain
+  std::vector<uint32_t> previous = mesh.indices;
+  const float maxError = options.maxLodError * mesh.boundsRadius;
+  float error = 0.0f;
+
+  while (mesh.lods.size() < options.maxLods && error < maxError) {
+    size_t targetTriangles =
+        static_cast<size_t>(previous.size() / 3 * options.lodReduction);
+    if (targetTriangles < options.minLodTriangles)
+      break;
+
+    float lodError = 0.0f;
+    std::vector<uint32_t> lod = MeshSimplifier::simplify(
+        previous, mesh.vertices, targetTriangles * 3, maxError - error,
+        lodError);
+
+    // Stop once the simplifier cannot make meaningful progress
+    if (lod.empty() || lod.size() > previous.size() * 9 / 10)
+      break;
+
+    error += lodError;
+    MeshOptimizer::optimizeVertexCache(lod, mesh.vertices.size());
+
+    mesh.lods.push_back({static_cast<uint32_t>(mesh.indices.size()),
+                         static_cast<uint32_t>(lod.size()), error});
+    mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+    previous.swap(lod);
+  }
+}
+
+void MeshImporter::logReport(const std::string &name, const MeshData &mesh) {
+  const MeshOptimizationReport &report = mesh.report;
+
+  LOG_INFO("%s: %zu vertices, %u triangles, %zu meshlets", name.c_str(),
+           mesh.vertices.size(), mesh.lods.front().indexCount / 3,
+           mesh.meshlets.size());
+  LOG_INFO("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+           report.vertexCacheBefore.acmr, report.vertexCacheAfter.acmr,
+           report.vertexCacheBefore.atvr, report.vertexCacheAfter.atvr);
+  LOG_INFO("  Overfetch %.3f -> %.3f", report.vertexFetchBefore.overfetch,
+           report.vertexFetchAfter.overfetch);
+
+  if (!mesh.skin.empty()) {
+    LOG_INFO("  Skeleton: %u joints, %zu clips",
+             mesh.skeleton.getJointCount(), mesh.clips.size());
+  }
+
+  if (report.overdrawBefore.pixelsCovered > 0) {
+    LOG_INFO("  Overdraw %.3f -> %.3f", report.overdrawBefore.overdraw,
+             report.overdrawAfter.overdraw);
+  }
+
+  for (size_t i = 1; i < mesh.lods.size(); i++) {
+    LOG_INFO("  LOD %zu: %u triangles, error %.5f", i,
+             mesh.lods[i].indexCount / 3, mesh.lods[i].error);
+  }
+}
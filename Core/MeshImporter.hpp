@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Animation.hpp"
+#include "MeshOptimizer.hpp"
+#include "Types.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MeshImportOptions {
+  bool optimizeVertexCache = true;
+  bool optimizeOverdraw = false;
+  float overdrawThreshold = 1.05f;
+  bool optimizeVertexFetch = true;
+  bool buildMeshlets = true;
+  uint32_t maxMeshletVertices = 64;
+  uint32_t maxMeshletTriangles = 124;
+
+  bool generateLods = true;
+  uint32_t maxLods = 6;
+  float lodReduction = 0.5f;    // triangle ratio between consecutive LODs
+  float maxLodError = 0.1f;     // relative to the mesh bounding radius
+  uint32_t minLodTriangles = 64;
+
+  // Keeps the node hierarchy instead of flattening it, and reads bones,
+  // skin weights and animations. Every node becomes a joint; vertices of
+  // meshes without bones follow their node rigidly
+  bool importSkin = false;
+};
+
+// A range of MeshData::indices; LOD 0 is the full-resolution mesh. error is
+// the object-space deviation from LOD 0
+struct MeshLod {
+  uint32_t indexOffset = 0;
+  uint32_t indexCount = 0;
+  float error = 0.0f;
+};
+
+// Before/after statistics of the optimization stage
+struct MeshOptimizationReport {
+  VertexCacheStatistics vertexCacheBefore;
+  VertexCacheStatistics vertexCacheAfter;
+  VertexFetchStatistics vertexFetchBefore;
+  VertexFetchStatistics vertexFetchAfter;
+  OverdrawStatistics overdrawBefore;
+  OverdrawStatistics overdrawAfter;
+};
+
+struct MeshData {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<MeshLod> lods;
+
+  float boundsCenter[3] = {0.0f, 0.0f, 0.0f};
+  float boundsRadius = 0.0f;
+
+  std::vector<Meshlet> meshlets;
+  std::vector<uint32_t> meshletVertices;
+  std::vector<uint8_t> meshletTriangles;
+  std::vector<MeshletBounds> meshletBounds;
+
+  // With MeshImportOptions::importSkin: one entry per vertex, in the
+  // skeleton's bind pose
+  std::vector<VertexSkin> skin;
+  Skeleton skeleton;
+  std::vector<AnimationClip> clips;
+
+  MeshOptimizationReport report;
+};
+
+class MeshImporter {
+
+public:
+  // Loads every mesh of a model file through Assimp into a single MeshData
+  // and runs the optimization stage on it
+  MeshData load(const std::string &filename,
+                const MeshImportOptions &options = {});
+
+  // Optimizes index/vertex order, builds meshlets and appends the LOD chain
+  // to the index buffer in place
+  void optimize(MeshData &mesh, const MeshImportOptions &options);
+
+private:
+  void computeBounds(MeshData &mesh);
+  void generateLods(MeshData &mesh, const MeshImportOptions &options);
+  void logReport(const std::string &name, const MeshData &mesh);
+};
@@ -0,0 +1,772 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// Forsyth's linear-speed vertex cache optimization parameters
+static constexpr size_t kForsythCacheSize = 32;
+static constexpr float kCacheDecayPower = 1.5f;
+static constexpr float kLastTriangleScore = 0.75f;
+static constexpr float kValenceBoostScale = 2.0f;
+static constexpr float kValenceBoostPower = 0.5f;
+
+// Cache size used when splitting clusters for overdraw optimization
+static constexpr uint32_t kOverdrawCacheSize = 16;
+
+// Resolution of the software rasterizer used by analyzeOverdraw
+static constexpr int kOverdrawViewport = 256;
+
+static constexpr size_t kFetchCacheLine = 64;
+static constexpr size_t kFetchCacheSize = 16 * 1024;
+
+static float forsythVertexScore(int32_t cachePosition,
+                                uint32_t liveTriangles) {
+  // Vertices without remaining triangles are never picked
+  if (liveTriangles == 0)
+    return -1.0f;
+
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // The last triangle's vertices get a fixed score so that the optimizer
+      // does not simply repeat the same triangle's edge
+      score = kLastTriangleScore;
+    } else {
+      const float scaler = 1.0f / (kForsythCacheSize - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+    }
+  }
+
+  // Boost vertices with few remaining triangles so that they get finished
+  score += kValenceBoostScale *
+           std::pow(static_cast<float>(liveTriangles), -kValenceBoostPower);
+  return score;
+}
+
+// Simulates a FIFO cache using insertion timestamps; returns the miss count
+static uint32_t updateCache(const uint32_t *triangle,
+                            std::vector<uint32_t> &timestamps,
+                            uint32_t &timestamp, uint32_t cacheSize) {
+  uint32_t misses = 0;
+  for (int k = 0; k < 3; k++) {
+    uint32_t vertex = triangle[k];
+    if (timestamp - timestamps[vertex] > cacheSize) {
+      timestamps[vertex] = timestamp++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+static void triangleNormal(const Vertex &a, const Vertex &b, const Vertex &c,
+                           float normal[3], float &area) {
+  float e1[3] = {b.position[0] - a.position[0], b.position[1] - a.position[1],
+                 b.position[2] - a.position[2]};
+  float e2[3] = {c.position[0] - a.position[0], c.position[1] - a.position[1],
+                 c.position[2] - a.position[2]};
+
+  normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+  area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                   normal[2] * normal[2]);
+  if (area > 0.0f) {
+    normal[0] /= area;
+    normal[1] /= area;
+    normal[2] /= area;
+  }
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices,
+                                        size_t vertexCount) {
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  // Build vertex -> triangle adjacency. The first liveTriangles[v] entries of
+  // a vertex's range are the triangles that have not been emitted yet
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (uint32_t index : indices) {
+    liveTriangles[index]++;
+  }
+
+  std::vector<uint32_t> adjacencyOffsets(vertexCount, 0);
+  uint32_t offset = 0;
+  for (size_t v = 0; v < vertexCount; v++) {
+    adjacencyOffsets[v] = offset;
+    offset += liveTriangles[v];
+  }
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> fill(vertexCount, 0);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[t * 3 + k];
+      adjacency[adjacencyOffsets[v] + fill[v]++] = static_cast<uint32_t>(t);
+    }
+  }
+
+  std::vector<int32_t> cachePositions(vertexCount, -1);
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    vertexScores[v] = forsythVertexScore(-1, liveTriangles[v]);
+  }
+
+  std::vector<float> triangleScores(triangleCount);
+  for (size_t t = 0; t < triangleCount; t++) {
+    triangleScores[t] = vertexScores[indices[t * 3 + 0]] +
+                        vertexScores[indices[t * 3 + 1]] +
+                        vertexScores[indices[t * 3 + 2]];
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> newCache;
+  cache.reserve(kForsythCacheSize + 3);
+  newCache.reserve(kForsythCacheSize + 3);
+
+  size_t inputCursor = 0;
+  uint32_t current = 0;
+
+  while (current != UINT32_MAX) {
+    const uint32_t *triangle = &indices[current * 3];
+    emitted[current] = true;
+    result.insert(result.end(), triangle, triangle + 3);
+
+    // Remove the triangle from its vertices' live lists
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = triangle[k];
+      uint32_t *list = &adjacency[adjacencyOffsets[v]];
+      uint32_t &live = liveTriangles[v];
+      for (uint32_t j = 0; j < live; j++) {
+        if (list[j] == current) {
+          list[j] = list[live - 1];
+          live--;
+          break;
+        }
+      }
+    }
+
+    // The triangle's vertices move to the front of the cache
+    newCache.clear();
+    for (int k = 0; k < 3; k++) {
+      if (std::find(newCache.begin(), newCache.end(), triangle[k]) ==
+          newCache.end()) {
+        newCache.push_back(triangle[k]);
+      }
+    }
+    for (uint32_t v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        newCache.push_back(v);
+      }
+    }
+
+    // Rescore every vertex whose cache position changed, including the ones
+    // pushed out of the cache, and propagate the delta to their triangles
+    for (size_t i = 0; i < newCache.size(); i++) {
+      uint32_t v = newCache[i];
+      int32_t position =
+          i < kForsythCacheSize ? static_cast<int32_t>(i) : -1;
+      cachePositions[v] = position;
+
+      float score = forsythVertexScore(position, liveTriangles[v]);
+      float delta = score - vertexScores[v];
+      vertexScores[v] = score;
+
+      const uint32_t *list = &adjacency[adjacencyOffsets[v]];
+      for (uint32_t j = 0; j < liveTriangles[v]; j++) {
+        triangleScores[list[j]] += delta;
+      }
+    }
+
+    if (newCache.size() > kForsythCacheSize) {
+      newCache.resize(kForsythCacheSize);
+    }
+    std::swap(cache, newCache);
+
+    // The next triangle is the best scoring one touching the cache
+    uint32_t best = UINT32_MAX;
+    float bestScore = -std::numeric_limits<float>::max();
+    for (uint32_t v : cache) {
+      const uint32_t *list = &adjacency[adjacencyOffsets[v]];
+      for (uint32_t j = 0; j < liveTriangles[v]; j++) {
+        if (triangleScores[list[j]] > bestScore) {
+          bestScore = triangleScores[list[j]];
+          best = list[j];
+        }
+      }
+    }
+
+    // Dead end: continue with the next triangle in input order
+    if (best == UINT32_MAX) {
+      while (inputCursor < triangleCount && emitted[inputCursor]) {
+        inputCursor++;
+      }
+      if (inputCursor < triangleCount) {
+        best = static_cast<uint32_t>(inputCursor);
+      }
+    }
+
+    current = best;
+  }
+
+  indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices,
+                                     const std::vector<Vertex> &vertices,
+                                     float threshold) {
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  std::vector<uint32_t> timestamps(vertices.size(), 0);
+  uint32_t timestamp = kOverdrawCacheSize + 1;
+
+  // Hard boundaries are where the cache was effectively flushed (a triangle
+  // with three misses); reordering there does not hurt vertex reuse
+  std::vector<uint32_t> hardClusters;
+  for (size_t t = 0; t < triangleCount; t++) {
+    uint32_t misses =
+        updateCache(&indices[t * 3], timestamps, timestamp, kOverdrawCacheSize);
+    if (t == 0 || misses == 3) {
+      hardClusters.push_back(static_cast<uint32_t>(t));
+    }
+  }
+
+  // Split hard clusters further as long as each piece keeps its ACMR within
+  // threshold of the whole hard cluster's ACMR
+  std::vector<uint32_t> clusters;
+  for (size_t c = 0; c < hardClusters.size(); c++) {
+    uint32_t start = hardClusters[c];
+    uint32_t end = c + 1 < hardClusters.size()
+                       ? hardClusters[c + 1]
+                       : static_cast<uint32_t>(triangleCount);
+
+    timestamp += kOverdrawCacheSize + 1;
+    uint32_t clusterMisses = 0;
+    for (uint32_t t = start; t < end; t++) {
+      clusterMisses += updateCache(&indices[t * 3], timestamps, timestamp,
+                                   kOverdrawCacheSize);
+    }
+    float clusterThreshold =
+        threshold * static_cast<float>(clusterMisses) / (end - start);
+
+    clusters.push_back(start);
+    timestamp += kOverdrawCacheSize + 1;
+    uint32_t runningMisses = 0;
+    uint32_t runningTriangles = 0;
+    for (uint32_t t = start; t < end; t++) {
+      runningMisses += updateCache(&indices[t * 3], timestamps, timestamp,
+                                   kOverdrawCacheSize);
+      runningTriangles++;
+
+      if (t + 1 < end && static_cast<float>(runningMisses) /
+                                 runningTriangles <=
+                             clusterThreshold) {
+        clusters.push_back(t + 1);
+        timestamp += kOverdrawCacheSize + 1;
+        runningMisses = 0;
+        runningTriangles = 0;
+      }
+    }
+  }
+
+  // Mesh centroid, used as the reference point for the cluster sort
+  float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+  for (const Vertex &vertex : vertices) {
+    meshCentroid[0] += vertex.position[0];
+    meshCentroid[1] += vertex.position[1];
+    meshCentroid[2] += vertex.position[2];
+  }
+  if (!vertices.empty()) {
+    for (float &component : meshCentroid) {
+      component /= static_cast<float>(vertices.size());
+    }
+  }
+
+  // Clusters that face away from the mesh center are likely to occlude the
+  // rest of the mesh, so they are drawn first
+  std::vector<float> sortKeys(clusters.size());
+  for (size_t c = 0; c < clusters.size(); c++) {
+    uint32_t start = clusters[c];
+    uint32_t end = c + 1 < clusters.size()
+                       ? clusters[c + 1]
+                       : static_cast<uint32_t>(triangleCount);
+
+    float centroid[3] = {0.0f, 0.0f, 0.0f};
+    float normal[3] = {0.0f, 0.0f, 0.0f};
+    float totalArea = 0.0f;
+
+    for (uint32_t t = start; t < end; t++) {
+      const Vertex &a = vertices[indices[t * 3 + 0]];
+      const Vertex &b = vertices[indices[t * 3 + 1]];
+      const Vertex &c2 = vertices[indices[t * 3 + 2]];
+
+      float triangleNormalValue[3];
+      float area;
+      triangleNormal(a, b, c2, triangleNormalValue, area);
+
+      for (int k = 0; k < 3; k++) {
+        centroid[k] +=
+            area * (a.position[k] + b.position[k] + c2.position[k]) / 3.0f;
+        normal[k] += area * triangleNormalValue[k];
+      }
+      totalArea += area;
+    }
+
+    if (totalArea > 0.0f) {
+      for (float &component : centroid) {
+        component /= totalArea;
+      }
+    }
+
+    float normalLength = std::sqrt(normal[0] * normal[0] +
+                                   normal[1] * normal[1] +
+                                   normal[2] * normal[2]);
+    float invLength = normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+
+    sortKeys[c] = ((centroid[0] - meshCentroid[0]) * normal[0] +
+                   (centroid[1] - meshCentroid[1]) * normal[1] +
+                   (centroid[2] - meshCentroid[2]) * normal[2]) *
+                  invLength;
+  }
+
+  std::vector<uint32_t> order(clusters.size());
+  for (size_t c = 0; c < order.size(); c++) {
+    order[c] = static_cast<uint32_t>(c);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return sortKeys[a] > sortKeys[b];
+  });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (uint32_t c : order) {
+    uint32_t start = clusters[c];
+    uint32_t end = c + 1 < clusters.size()
+                       ? clusters[c + 1]
+                       : static_cast<uint32_t>(triangleCount);
+    result.insert(result.end(), indices.begin() + start * 3,
+                  indices.begin() + end * 3);
+  }
+
+  indices.swap(result);
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(std::vector<uint32_t> &indices,
+                                          std::vector<Vertex> &vertices,
+                                          std::vector<uint32_t> *remapOut) {
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<Vertex> result;
+  result.reserve(vertices.size());
+
+  for (uint32_t &index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = static_cast<uint32_t>(result.size());
+      result.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices.swap(result);
+  if (remapOut) {
+    remapOut->swap(remap);
+  }
+  return vertices.size();
+}
+
+void MeshOptimizer::buildMeshlets(const std::vector<uint32_t> &indices,
+                                  size_t vertexCount, size_t maxVertices,
+                                  size_t maxTriangles,
+                                  std::vector<Meshlet> &meshlets,
+                                  std::vector<uint32_t> &meshletVertices,
+                                  std::vector<uint8_t> &meshletTriangles) {
+  if (maxVertices < 3 || maxVertices > 255 || maxTriangles < 1) {
+    throw std::runtime_error("Invalid meshlet limits!");
+  }
+
+  meshlets.clear();
+  meshletVertices.clear();
+  meshletTriangles.clear();
+
+  // Local index of each vertex in the current meshlet, 0xff if not present
+  std::vector<uint8_t> localIndices(vertexCount, 0xff);
+  Meshlet current{};
+
+  auto flush = [&]() {
+    for (uint32_t i = 0; i < current.vertexCount; i++) {
+      localIndices[meshletVertices[current.vertexOffset + i]] = 0xff;
+    }
+    meshlets.push_back(current);
+
+    current = {};
+    current.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+    current.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+  };
+
+  for (size_t t = 0; t < indices.size() / 3; t++) {
+    uint32_t a = indices[t * 3 + 0];
+    uint32_t b = indices[t * 3 + 1];
+    uint32_t c = indices[t * 3 + 2];
+
+    // Degenerate triangles never produce pixels
+    if (a == b || b == c || a == c)
+      continue;
+
+    uint32_t newVertices = (localIndices[a] == 0xff) +
+                           (localIndices[b] == 0xff) +
+                           (localIndices[c] == 0xff);
+
+    if (current.vertexCount + newVertices > maxVertices ||
+        current.triangleCount + 1 > maxTriangles) {
+      flush();
+    }
+
+    for (uint32_t v : {a, b, c}) {
+      if (localIndices[v] == 0xff) {
+        localIndices[v] = static_cast<uint8_t>(current.vertexCount++);
+        meshletVertices.push_back(v);
+      }
+      meshletTriangles.push_back(localIndices[v]);
+    }
+    current.triangleCount++;
+  }
+
+  if (current.triangleCount > 0) {
+    flush();
+  }
+}
+
+MeshletBounds MeshOptimizer::computeMeshletBounds(
+    const Meshlet &meshlet, const std::vector<uint32_t> &meshletVertices,
+    const std::vector<uint8_t> &meshletTriangles,
+    const std::vector<Vertex> &vertices) {
+  MeshletBounds bounds{};
+
+  auto positionOf = [&](uint32_t localIndex) -> const float * {
+    return vertices[meshletVertices[meshlet.vertexOffset + localIndex]]
+        .position;
+  };
+
+  if (meshlet.vertexCount == 0) {
+    bounds.coneCutoff = 1.0f;
+    return bounds;
+  }
+
+  // Ritter's bounding sphere: start from the most distant pair of axis
+  // extremes, then grow the sphere to include every remaining point
+  uint32_t minPoint[3] = {0, 0, 0};
+  uint32_t maxPoint[3] = {0, 0, 0};
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    const float *p = positionOf(i);
+    for (int axis = 0; axis < 3; axis++) {
+      if (p[axis] < positionOf(minPoint[axis])[axis])
+        minPoint[axis] = i;
+      if (p[axis] > positionOf(maxPoint[axis])[axis])
+        maxPoint[axis] = i;
+    }
+  }
+
+  float bestDistance = -1.0f;
+  int bestAxis = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    const float *p0 = positionOf(minPoint[axis]);
+    const float *p1 = positionOf(maxPoint[axis]);
+    float dx = p1[0] - p0[0], dy = p1[1] - p0[1], dz = p1[2] - p0[2];
+    float distance = dx * dx + dy * dy + dz * dz;
+    if (distance > bestDistance) {
+      bestDistance = distance;
+      bestAxis = axis;
+    }
+  }
+
+  const float *p0 = positionOf(minPoint[bestAxis]);
+  const float *p1 = positionOf(maxPoint[bestAxis]);
+  float center[3] = {(p0[0] + p1[0]) * 0.5f, (p0[1] + p1[1]) * 0.5f,
+                     (p0[2] + p1[2]) * 0.5f};
+  float radius = std::sqrt(bestDistance) * 0.5f;
+
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    const float *p = positionOf(i);
+    float d[3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+    float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    if (distance > radius) {
+      float shift = (distance - radius) * 0.5f;
+      for (int k = 0; k < 3; k++) {
+        center[k] += d[k] / distance * shift;
+      }
+      radius = (radius + distance) * 0.5f;
+    }
+  }
+
+  for (int k = 0; k < 3; k++) {
+    bounds.center[k] = center[k];
+    bounds.coneApex[k] = center[k];
+  }
+  bounds.radius = radius;
+
+  // Normal cone: average of the triangle normals, with the cutoff given by
+  // the widest deviation from that average
+  std::vector<float> normals;
+  normals.reserve(meshlet.triangleCount * 3);
+  std::vector<uint32_t> corners;
+  corners.reserve(meshlet.triangleCount);
+
+  float axis[3] = {0.0f, 0.0f, 0.0f};
+  for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+    const uint8_t *triangle = &meshletTriangles[meshlet.triangleOffset + t * 3];
+    const Vertex &a =
+        vertices[meshletVertices[meshlet.vertexOffset + triangle[0]]];
+    const Vertex &b =
+        vertices[meshletVertices[meshlet.vertexOffset + triangle[1]]];
+    const Vertex &c =
+        vertices[meshletVertices[meshlet.vertexOffset + triangle[2]]];
+
+    float normal[3];
+    float area;
+    triangleNormal(a, b, c, normal, area);
+    if (area == 0.0f)
+      continue;
+
+    normals.insert(normals.end(), normal, normal + 3);
+    corners.push_back(triangle[0]);
+    for (int k = 0; k < 3; k++) {
+      axis[k] += normal[k];
+    }
+  }
+
+  float axisLength =
+      std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  if (axisLength == 0.0f) {
+    bounds.coneCutoff = 1.0f;
+    return bounds;
+  }
+  for (float &component : axis) {
+    component /= axisLength;
+  }
+
+  float minDot = 1.0f;
+  for (size_t i = 0; i < corners.size(); i++) {
+    const float *n = &normals[i * 3];
+    minDot = std::min(minDot, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+  }
+
+  for (int k = 0; k < 3; k++) {
+    bounds.coneAxis[k] = axis[k];
+  }
+
+  // Cones wider than ~84 degrees cannot reject anything useful
+  if (minDot <= 0.1f) {
+    bounds.coneCutoff = 1.0f;
+    return bounds;
+  }
+
+  // Move the apex back along the axis until it lies behind every triangle
+  // plane, so the cone test is conservative for any camera position
+  float maxT = 0.0f;
+  for (size_t i = 0; i < corners.size(); i++) {
+    const float *n = &normals[i * 3];
+    const float *corner = positionOf(corners[i]);
+    float dc = (center[0] - corner[0]) * n[0] +
+               (center[1] - corner[1]) * n[1] + (center[2] - corner[2]) * n[2];
+    float dn = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+    maxT = std::max(maxT, dc / dn);
+  }
+
+  for (int k = 0; k < 3; k++) {
+    bounds.coneApex[k] = center[k] - axis[k] * maxT;
+  }
+  bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  return bounds;
+}
+
+VertexCacheStatistics
+MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t> &indices,
+                                  size_t vertexCount, uint32_t cacheSize) {
+  VertexCacheStatistics statistics{};
+  if (indices.empty())
+    return statistics;
+
+  std::vector<uint32_t> timestamps(vertexCount, 0);
+  uint32_t timestamp = cacheSize + 1;
+  std::vector<bool> used(vertexCount, false);
+  uint32_t uniqueVertices = 0;
+
+  for (size_t t = 0; t < indices.size() / 3; t++) {
+    statistics.verticesTransformed +=
+        updateCache(&indices[t * 3], timestamps, timestamp, cacheSize);
+  }
+  for (uint32_t index : indices) {
+    if (!used[index]) {
+      used[index] = true;
+      uniqueVertices++;
+    }
+  }
+
+  statistics.acmr = static_cast<float>(statistics.verticesTransformed) /
+                    static_cast<float>(indices.size() / 3);
+  statistics.atvr = static_cast<float>(statistics.verticesTransformed) /
+                    static_cast<float>(uniqueVertices);
+  return statistics;
+}
+
+VertexFetchStatistics
+MeshOptimizer::analyzeVertexFetch(const std::vector<uint32_t> &indices,
+                                  size_t vertexCount, size_t vertexSize) {
+  VertexFetchStatistics statistics{};
+  if (indices.empty())
+    return statistics;
+
+  const uint32_t cacheLines = kFetchCacheSize / kFetchCacheLine;
+  std::vector<uint32_t> timestamps(
+      (vertexCount * vertexSize + kFetchCacheLine - 1) / kFetchCacheLine, 0);
+  uint32_t timestamp = cacheLines + 1;
+  std::vector<bool> used(vertexCount, false);
+  uint32_t uniqueVertices = 0;
+
+  for (uint32_t index : indices) {
+    if (!used[index]) {
+      used[index] = true;
+      uniqueVertices++;
+    }
+
+    size_t firstLine = index * vertexSize / kFetchCacheLine;
+    size_t lastLine = ((index + 1) * vertexSize - 1) / kFetchCacheLine;
+    for (size_t line = firstLine; line <= lastLine; line++) {
+      if (timestamp - timestamps[line] > cacheLines) {
+        timestamps[line] = timestamp++;
+        statistics.bytesFetched += kFetchCacheLine;
+      }
+    }
+  }
+
+  statistics.overfetch = static_cast<float>(statistics.bytesFetched) /
+                         static_cast<float>(uniqueVertices * vertexSize);
+  return statistics;
+}
+
+struct OverdrawBuffer {
+  std::vector<float> depth;
+  uint32_t covered = 0;
+  uint32_t shaded = 0;
+};
+
+static void rasterizeTriangle(OverdrawBuffer &buffer, const float *v1,
+                              const float *v2, const float *v3) {
+  float area =
+      (v2[0] - v1[0]) * (v3[1] - v1[1]) - (v2[1] - v1[1]) * (v3[0] - v1[0]);
+
+  // Back faces and degenerate triangles are culled
+  if (area <= 0.0f)
+    return;
+
+  int minX = std::max(0, static_cast<int>(std::floor(
+                             std::min({v1[0], v2[0], v3[0]}))));
+  int maxX = std::min(kOverdrawViewport - 1,
+                      static_cast<int>(std::ceil(
+                          std::max({v1[0], v2[0], v3[0]}))));
+  int minY = std::max(0, static_cast<int>(std::floor(
+                             std::min({v1[1], v2[1], v3[1]}))));
+  int maxY = std::min(kOverdrawViewport - 1,
+                      static_cast<int>(std::ceil(
+                          std::max({v1[1], v2[1], v3[1]}))));
+
+  auto edge = [](const float *a, const float *b, float px, float py) {
+    return (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+  };
+
+  for (int y = minY; y <= maxY; y++) {
+    for (int x = minX; x <= maxX; x++) {
+      float px = x + 0.5f;
+      float py = y + 0.5f;
+
+      float w1 = edge(v2, v3, px, py);
+      float w2 = edge(v3, v1, px, py);
+      float w3 = edge(v1, v2, px, py);
+      if (w1 < 0.0f || w2 < 0.0f || w3 < 0.0f)
+        continue;
+
+      float z = (w1 * v1[2] + w2 * v2[2] + w3 * v3[2]) / area;
+      float &depth = buffer.depth[y * kOverdrawViewport + x];
+
+      if (depth == std::numeric_limits<float>::max())
+        buffer.covered++;
+      if (z < depth) {
+        depth = z;
+        buffer.shaded++;
+      }
+    }
+  }
+}
+
+OverdrawStatistics
+MeshOptimizer::analyzeOverdraw(const std::vector<uint32_t> &indices,
+                               const std::vector<Vertex> &vertices) {
+  OverdrawStatistics statistics{};
+  if (indices.empty())
+    return statistics;
+
+  // Normalize the mesh into the unit cube
+  float minimum[3] = {std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max()};
+  float maximum[3] = {-std::numeric_limits<float>::max(),
+                      -std::numeric_limits<float>::max(),
+                      -std::numeric_limits<float>::max()};
+  for (uint32_t index : indices) {
+    for (int k = 0; k < 3; k++) {
+      minimum[k] = std::min(minimum[k], vertices[index].position[k]);
+      maximum[k] = std::max(maximum[k], vertices[index].position[k]);
+    }
+  }
+  float extent = std::max({maximum[0] - minimum[0], maximum[1] - minimum[1],
+                           maximum[2] - minimum[2]});
+  float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+  OverdrawBuffer buffer;
+  buffer.depth.resize(kOverdrawViewport * kOverdrawViewport);
+
+  // Render along each axis, from both directions
+  for (int axis = 0; axis < 3; axis++) {
+    for (int direction = 0; direction < 2; direction++) {
+      std::fill(buffer.depth.begin(), buffer.depth.end(),
+                std::numeric_limits<float>::max());
+
+      for (size_t t = 0; t < indices.size() / 3; t++) {
+        float projected[3][3];
+        for (int k = 0; k < 3; k++) {
+          const float *p = vertices[indices[t * 3 + k]].position;
+          float normalized[3] = {(p[0] - minimum[0]) * scale,
+                                 (p[1] - minimum[1]) * scale,
+                                 (p[2] - minimum[2]) * scale};
+
+          projected[k][0] = normalized[(axis + 1) % 3] * kOverdrawViewport;
+          projected[k][1] = normalized[(axis + 2) % 3] * kOverdrawViewport;
+          projected[k][2] = direction == 0 ? normalized[axis]
+                                           : 1.0f - normalized[axis];
+        }
+
+        if (direction == 0) {
+          rasterizeTriangle(buffer, projected[0], projected[1], projected[2]);
+        } else {
+          rasterizeTriangle(buffer, projected[0], projected[2], projected[1]);
+        }
+      }
+    }
+  }
+
+  statistics.pixelsCovered = buffer.covered;
+  statistics.pixelsShaded = buffer.shaded;
+  statistics.overdraw =
+      buffer.covered > 0
+          ? static_cast<float>(buffer.shaded) / static_cast<float>(buffer.covered)
+          : 0.0f;
+  return statistics;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A cluster of up to maxVertices vertices / maxTriangles triangles.
+// Vertices index into the meshletVertices array, triangles are stored as
+// three local (8-bit) indices into that meshlet's vertex range.
+struct Meshlet {
+  uint32_t vertexOffset = 0;
+  uint32_t triangleOffset = 0;
+  uint32_t vertexCount = 0;
+  uint32_t triangleCount = 0;
+};
+
+// Culling data for a meshlet. The meshlet can be rejected when it is outside
+// the frustum (sphere test) or when
+// dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff.
+struct MeshletBounds {
+  float center[3];
+  float radius;
+  float coneApex[3];
+  float coneAxis[3];
+  float coneCutoff; // 1.0 disables cone culling for this meshlet
+};
+
+struct VertexCacheStatistics {
+  uint32_t verticesTransformed = 0;
+  float acmr = 0.0f; // transformed vertices per triangle (best ~0.5)
+  float atvr = 0.0f; // transformed vertices per unique vertex (best 1.0)
+};
+
+struct VertexFetchStatistics {
+  uint32_t bytesFetched = 0;
+  float overfetch = 0.0f; // fetched bytes per vertex buffer byte (best 1.0)
+};
+
+struct OverdrawStatistics {
+  uint32_t pixelsCovered = 0;
+  uint32_t pixelsShaded = 0;
+  float overdraw = 0.0f; // shaded pixels per covered pixel (best 1.0)
+};
+
+class MeshOptimizer {
+
+public:
+  // Reorders triangles for post-transform vertex cache locality (Forsyth)
+  static void optimizeVertexCache(std::vector<uint32_t> &indices,
+                                  size_t vertexCount);
+
+  // Reorders clusters of a cache-optimized index buffer front-to-back to
+  // reduce overdraw. threshold bounds the allowed ACMR regression (1.05 = 5%)
+  static void optimizeOverdraw(std::vector<uint32_t> &indices,
+                               const std::vector<Vertex> &vertices,
+                               float threshold);
+
+  // Reorders vertices in order of first use and rewrites the indices.
+  // Unreferenced vertices are dropped. Returns the new vertex count; remap,
+  // if given, receives the new index of every old vertex (UINT32_MAX when
+  // dropped) for reordering other per-vertex data
+  static size_t optimizeVertexFetch(std::vector<uint32_t> &indices,
+                                    std::vector<Vertex> &vertices,
+                                    std::vector<uint32_t> *remap = nullptr);
+
+  // Splits the index buffer into meshlets, in index buffer order
+  static void buildMeshlets(const std::vector<uint32_t> &indices,
+                            size_t vertexCount, size_t maxVertices,
+                            size_t maxTriangles, std::vector<Meshlet> &meshlets,
+                            std::vector<uint32_t> &meshletVertices,
+                            std::vector<uint8_t> &meshletTriangles);
+
+  // Computes the bounding sphere and normal cone of a meshlet
+  static MeshletBounds
+  computeMeshletBounds(const Meshlet &meshlet,
+                       const std::vector<uint32_t> &meshletVertices,
+                       const std::vector<uint8_t> &meshletTriangles,
+                       const std::vector<Vertex> &vertices);
+
+  // Simulates a FIFO post-transform cache of cacheSize entries
+  static VertexCacheStatistics
+  analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount,
+                     uint32_t cacheSize = 16);
+
+  // Simulates vertex fetch through 64-byte cache lines
+  static VertexFetchStatistics
+  analyzeVertexFetch(const std::vector<uint32_t> &indices, size_t vertexCount,
+                     size_t vertexSize);
+
+  // Rasterizes the mesh from six axis-aligned views and counts shaded pixels
+  static OverdrawStatistics
+  analyzeOverdraw(const std::vector<uint32_t> &indices,
+                  const std::vector<Vertex> &vertices);
+};
@@ -0,0 +1,269 @@
+#include "MeshSimplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Symmetric 4x4 matrix accumulating squared distances to a set of planes
+struct Quadric {
+  double a2 = 0, ab = 0, ac = 0, ad = 0;
+  double b2 = 0, bc = 0, bd = 0;
+  double c2 = 0, cd = 0;
+  double d2 = 0;
+
+  void addPlane(double a, double b, double c, double d) {
+    a2 += a * a, ab += a * b, ac += a * c, ad += a * d;
+    b2 += b * b, bc += b * c, bd += b * d;
+    c2 += c * c, cd += c * d;
+    d2 += d * d;
+  }
+
+  void add(const Quadric &other) {
+    a2 += other.a2, ab += other.ab, ac += other.ac, ad += other.ad;
+    b2 += other.b2, bc += other.bc, bd += other.bd;
+    c2 += other.c2, cd += other.cd;
+    d2 += other.d2;
+  }
+
+  double evaluate(const float *p) const {
+    double x = p[0], y = p[1], z = p[2];
+    double error = a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+                   2.0 * (ab * x * y + ac * x * z + ad * x + bc * y * z +
+                          bd * y + cd * z);
+    return error > 0.0 ? error : 0.0;
+  }
+};
+
+struct Collapse {
+  uint32_t source;
+  uint32_t target;
+  double cost;
+};
+
+static void triangleCross(const float *p0, const float *p1, const float *p2,
+                          double normal[3]) {
+  double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+  return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+// Builds a vertex -> triangle adjacency in CSR form
+static void buildAdjacency(const std::vector<uint32_t> &indices,
+                           size_t vertexCount, std::vector<uint32_t> &offsets,
+                           std::vector<uint32_t> &triangles) {
+  offsets.assign(vertexCount + 1, 0);
+  for (uint32_t index : indices) {
+    offsets[index + 1]++;
+  }
+  for (size_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+
+  triangles.resize(indices.size());
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) {
+    triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+}
+
+// Returns true if moving source onto target flips any remaining triangle
+static bool collapseFlipsTriangle(const Collapse &collapse,
+                                  const std::vector<uint32_t> &indices,
+                                  const std::vector<Vertex> &vertices,
+                                  const std::vector<uint32_t> &offsets,
+                                  const std::vector<uint32_t> &triangles) {
+  const float *targetPosition = vertices[collapse.target].position;
+
+  for (uint32_t i = offsets[collapse.source]; i < offsets[collapse.source + 1];
+       i++) {
+    const uint32_t *triangle = &indices[triangles[i] * 3];
+
+    // Triangles on the collapsed edge disappear
+    if (triangle[0] == collapse.target || triangle[1] == collapse.target ||
+        triangle[2] == collapse.target)
+      continue;
+
+    const float *before[3];
+    const float *after[3];
+    for (int k = 0; k < 3; k++) {
+      before[k] = vertices[triangle[k]].position;
+      after[k] = triangle[k] == collapse.source ? targetPosition : before[k];
+    }
+
+    double n0[3], n1[3];
+    triangleCross(before[0], before[1], before[2], n0);
+    triangleCross(after[0], after[1], after[2], n1);
+    if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0)
+      return true;
+  }
+  return false;
+}
+
+std::vector<uint32_t>
+MeshSimplifier::simplify(const std::vector<uint32_t> &indices,
+                         const std::vector<Vertex> &vertices,
+                         size_t targetIndexCount, float targetError,
+                         float &resultError) {
+  const size_t vertexCount = vertices.size();
+  std::vector<uint32_t> result = indices;
+  resultError = 0.0f;
+
+  // Plane quadrics of every triangle, accumulated on its vertices
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t t = 0; t < indices.size() / 3; t++) {
+    const float *p0 = vertices[indices[t * 3 + 0]].position;
+    const float *p1 = vertices[indices[t * 3 + 1]].position;
+    const float *p2 = vertices[indices[t * 3 + 2]].position;
+
+    double normal[3];
+    triangleCross(p0, p1, p2, normal);
+    double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                              normal[2] * normal[2]);
+    if (length == 0.0)
+      continue;
+
+    double a = normal[0] / length, b = normal[1] / length,
+           c = normal[2] / length;
+    double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+    for (int k = 0; k < 3; k++) {
+      quadrics[indices[t * 3 + k]].addPlane(a, b, c, d);
+    }
+  }
+
+  // Vertices on open or non-manifold edges are locked so silhouettes and
+  // attribute seams stay in place
+  std::vector<uint64_t> edges;
+  edges.reserve(indices.size());
+  for (size_t t = 0; t < indices.size() / 3; t++) {
+    for (int k = 0; k < 3; k++) {
+      edges.push_back(
+          edgeKey(indices[t * 3 + k], indices[t * 3 + (k + 1) % 3]));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  std::vector<bool> locked(vertexCount, false);
+  for (size_t i = 0; i < edges.size();) {
+    size_t j = i;
+    while (j < edges.size() && edges[j] == edges[i]) {
+      j++;
+    }
+    if (j - i != 2) {
+      locked[edges[i] >> 32] = true;
+      locked[edges[i] & 0xffffffff] = true;
+    }
+    i = j;
+  }
+
+  const double maxCost = double(targetError) * double(targetError);
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> adjacency;
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<bool> touched(vertexCount);
+
+  // Each pass collapses an independent set of the cheapest edges
+  while (result.size() > targetIndexCount) {
+    buildAdjacency(result, vertexCount, offsets, adjacency);
+
+    edges.clear();
+    for (size_t t = 0; t < result.size() / 3; t++) {
+      for (int k = 0; k < 3; k++) {
+        edges.push_back(edgeKey(result[t * 3 + k], result[t * 3 + (k + 1) % 3]));
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    collapses.clear();
+    for (uint64_t edge : edges) {
+      uint32_t a = static_cast<uint32_t>(edge >> 32);
+      uint32_t b = static_cast<uint32_t>(edge & 0xffffffff);
+
+      Quadric combined = quadrics[a];
+      combined.add(quadrics[b]);
+
+      Collapse best{UINT32_MAX, UINT32_MAX, 0.0};
+      if (!locked[a]) {
+        best = {a, b, combined.evaluate(vertices[b].position)};
+      }
+      if (!locked[b]) {
+        double cost = combined.evaluate(vertices[a].position);
+        if (best.source == UINT32_MAX || cost < best.cost) {
+          best = {b, a, cost};
+        }
+      }
+      if (best.source != UINT32_MAX && best.cost <= maxCost) {
+        collapses.push_back(best);
+      }
+    }
+
+    if (collapses.empty())
+      break;
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &a, const Collapse &b) {
+                return a.cost < b.cost;
+              });
+
+    // An interior collapse removes two triangles
+    size_t collapseGoal =
+        std::max<size_t>(1, (result.size() - targetIndexCount) / 6);
+    size_t applied = 0;
+
+    for (size_t v = 0; v < vertexCount; v++) {
+      remap[v] = static_cast<uint32_t>(v);
+    }
+    std::fill(touched.begin(), touched.end(), false);
+
+    for (const Collapse &collapse : collapses) {
+      if (touched[collapse.source] || touched[collapse.target])
+        continue;
+      if (collapseFlipsTriangle(collapse, result, vertices, offsets, adjacency))
+        continue;
+
+      remap[collapse.source] = collapse.target;
+      quadrics[collapse.target].add(quadrics[collapse.source]);
+      resultError = std::max(resultError,
+                             static_cast<float>(std::sqrt(collapse.cost)));
+
+      // Freeze the source's one-ring so the flip test stays valid for the
+      // rest of this pass
+      for (uint32_t i = offsets[collapse.source];
+           i < offsets[collapse.source + 1]; i++) {
+        const uint32_t *triangle = &result[adjacency[i] * 3];
+        touched[triangle[0]] = true;
+        touched[triangle[1]] = true;
+        touched[triangle[2]] = true;
+      }
+
+      if (++applied >= collapseGoal)
+        break;
+    }
+
+    if (applied == 0)
+      break;
+
+    // Apply the remap and drop the triangles that became degenerate
+    size_t write = 0;
+    for (size_t t = 0; t < result.size() / 3; t++) {
+      uint32_t a = remap[result[t * 3 + 0]];
+      uint32_t b = remap[result[t * 3 + 1]];
+      uint32_t c = remap[result[t * 3 + 2]];
+      if (a == b || b == c || a == c)
+        continue;
+
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MeshSimplifier {
+
+public:
+  // Reduces the triangle count with quadric-error edge collapses towards
+  // targetIndexCount, never exceeding targetError (object-space distance).
+  // Vertices are only collapsed onto existing vertices, so the result indexes
+  // the same vertex buffer. Border and non-manifold vertices are kept fixed.
+  // resultError receives the largest collapse error that was accepted
+  static std::vector<uint32_t> simplify(const std::vector<uint32_t> &indices,
+                                        const std::vector<Vertex> &vertices,
+                                        size_t targetIndexCount,
+                                        float targetError, float &resultError);
+};
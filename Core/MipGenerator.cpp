@@ -0,0 +1,332 @@
+#include "MipGenerator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Source texels reduced by one workgroup along each axis
+static constexpr uint32_t kTileSize = 64;
+// Levels produced per pass: by every tile, then by the last workgroup
+static constexpr uint32_t kLevelsPerPass = 6;
+
+struct MipPushConstants {
+  int32_t sourceSize[2];
+  uint32_t levelCount;
+  uint32_t workGroupCount;
+  uint32_t tilesX;
+};
+
+static uint32_t tileCount(uint32_t size) {
+  return (size + kTileSize - 1) / kTileSize;
+}
+
+void MipGenerator::create(VulkanContext &context, uint32_t maxTargets) {
+  VkDevice device = context.getDevice();
+
+  const VkPhysicalDeviceSubgroupProperties &subgroupProperties =
+      context.getCapabilities().subgroup;
+
+  if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) ||
+      !(subgroupProperties.supportedOperations &
+        VK_SUBGROUP_FEATURE_QUAD_BIT)) {
+    throw std::runtime_error(
+        "Mip generation requires subgroup quad operations in compute!");
+  }
+
+  const VkPhysicalDeviceFeatures &features = context.getEnabledFeatures();
+  if (!features.shaderStorageImageWriteWithoutFormat ||
+      !features.shaderStorageImageArrayDynamicIndexing) {
+    throw std::runtime_error(
+        "Mip generation requires format-less storage image writes!");
+  }
+
+  VkDescriptorSetLayoutBinding bindings[3]{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = kMaxLevels;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[2].binding = 2;
+  bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[2].descriptorCount = 1;
+  bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  layoutInfo.bindingCount = 3;
+  layoutInfo.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr,
+                                  &descriptorSetLayout) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create mip descriptor set layout!");
+  }
+
+  // The reduction is a specialization constant so each variant compiles
+  // without branches
+  for (uint32_t i = 0; i < pipelines.size(); i++) {
+    VkSpecializationMapEntry entry{0, 0, sizeof(uint32_t)};
+    VkSpecializationInfo specialization{1, &entry, sizeof(uint32_t), &i};
+    pipelines[i].create(device, "Shaders/downsample.comp.spv",
+                        {descriptorSetLayout}, sizeof(MipPushConstants),
+                        &specialization);
+  }
+
+  VkDescriptorPoolSize poolSizes[3] = {
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTargets},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxTargets * kMaxLevels},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxTargets},
+  };
+  VkDescriptorPoolCreateInfo poolInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  poolInfo.maxSets = maxTargets;
+  poolInfo.poolSizeCount = 3;
+  poolInfo.pPoolSizes = poolSizes;
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create mip descriptor pool!");
+  }
+
+  VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create mip sampler!");
+  }
+}
+
+void MipGenerator::cleanup(VkDevice device) {
+  if (sampler != VK_NULL_HANDLE) {
+    vkDestroySampler(device, sampler, nullptr);
+    sampler = VK_NULL_HANDLE;
+  }
+  if (descriptorPool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+  }
+  for (ComputePipeline &pipeline : pipelines) {
+    pipeline.cleanup(device);
+  }
+  if (descriptorSetLayout != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    descriptorSetLayout = VK_NULL_HANDLE;
+  }
+}
+
+MipTarget MipGenerator::createChainTarget(
+    VulkanContext &context, CommandPool &commandPool, VkImage image,
+    VkFormat format, VkFormat storageFormat, VkExtent2D extent,
+    uint32_t mipLevels, MipReduction reduction) {
+  if (mipLevels < 2) {
+    throw std::runtime_error("Mip chain needs at least two levels!");
+  }
+
+  MipTarget target;
+  target.destination = image;
+  target.destinationBaseLevel = 1;
+  target.levelCount = mipLevels - 1;
+  target.sourceExtent = extent;
+  target.reduction = reduction;
+
+  VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  if (vkCreateImageView(context.getDevice(), &viewInfo, nullptr,
+                        &target.sourceView) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create mip source view!");
+  }
+  target.ownsSourceView = true;
+
+  createTarget(context, commandPool, target, storageFormat);
+  return target;
+}
+
+MipTarget MipGenerator::createPyramidTarget(
+    VulkanContext &context, CommandPool &commandPool, VkImageView sourceView,
+    VkExtent2D sourceExtent, VkImage pyramid, VkFormat pyramidFormat,
+    uint32_t pyramidLevels, MipReduction reduction) {
+  MipTarget target;
+  target.destination = pyramid;
+  target.destinationBaseLevel = 0;
+  target.levelCount = pyramidLevels;
+  target.sourceExtent = sourceExtent;
+  target.reduction = reduction;
+  target.sourceView = sourceView;
+
+  createTarget(context, commandPool, target, pyramidFormat);
+  return target;
+}
+
+void MipGenerator::createTarget(VulkanContext &context,
+                                CommandPool &commandPool, MipTarget &target,
+                                VkFormat storageFormat) {
+  VkDevice device = context.getDevice();
+  uint32_t tilesX = tileCount(target.sourceExtent.width);
+  uint32_t tilesY = tileCount(target.sourceExtent.height);
+
+  if (target.levelCount == 0 || target.levelCount > kMaxLevels) {
+    throw std::runtime_error("Unsupported mip level count!");
+  }
+  // The last workgroup reduces all tile results at once
+  if (target.levelCount > kLevelsPerPass &&
+      (tilesX > kTileSize || tilesY > kTileSize)) {
+    throw std::runtime_error("Mip source too large for a single dispatch!");
+  }
+
+  for (uint32_t i = 0; i < target.levelCount; i++) {
+    VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    viewInfo.image = target.destination;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = storageFormat;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT,
+                                 target.destinationBaseLevel + i, 1, 0, 1};
+
+    VkImageView view;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+      destroyTarget(device, target);
+      throw std::runtime_error("Failed to create mip level view!");
+    }
+    target.levelViews.push_back(view);
+  }
+
+  // Counter, padded to 16 bytes, followed by one vec4 per tile
+  VkDeviceSize intermediateSize =
+      16 + VkDeviceSize(tilesX) * tilesY * 4 * sizeof(float);
+  target.intermediate.create(context, intermediateSize,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // The shader resets the counter after every dispatch, so it only needs
+  // clearing once
+  VkCommandBuffer commandBuffer = commandPool.beginSingleTimeCommands(device);
+  vkCmdFillBuffer(commandBuffer, target.intermediate.getBuffer(), 0,
+                  sizeof(uint32_t), 0);
+  commandPool.endSingleTimeCommands(device, context.getGraphicsQueue(),
+                                    commandBuffer);
+
+  VkDescriptorSetAllocateInfo allocInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &descriptorSetLayout;
+  if (vkAllocateDescriptorSets(device, &allocInfo, &target.descriptorSet) !=
+      VK_SUCCESS) {
+    destroyTarget(device, target);
+    throw std::runtime_error("Failed to allocate mip descriptor set!");
+  }
+
+  VkDescriptorImageInfo sourceInfo{sampler, target.sourceView,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+  // Unused array slots repeat the last level; the shader never writes them
+  VkDescriptorImageInfo levelInfos[kMaxLevels];
+  for (uint32_t i = 0; i < kMaxLevels; i++) {
+    uint32_t level = std::min(i, target.levelCount - 1);
+    levelInfos[i] = {VK_NULL_HANDLE, target.levelViews[level],
+                     VK_IMAGE_LAYOUT_GENERAL};
+  }
+
+  VkDescriptorBufferInfo intermediateInfo{target.intermediate.getBuffer(), 0,
+                                          VK_WHOLE_SIZE};
+
+  VkWriteDescriptorSet writes[3]{};
+  for (VkWriteDescriptorSet &write : writes) {
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = target.descriptorSet;
+    write.descriptorCount = 1;
+  }
+  writes[0].dstBinding = 0;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[0].pImageInfo = &sourceInfo;
+  writes[1].dstBinding = 1;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  writes[1].descriptorCount = kMaxLevels;
+  writes[1].pImageInfo = levelInfos;
+  writes[2].dstBinding = 2;
+  writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  writes[2].pBufferInfo = &intermediateInfo;
+
+  vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+}
+
+void MipGenerator::destroyTarget(VkDevice device, MipTarget &target) {
+  if (target.descriptorSet != VK_NULL_HANDLE) {
+    vkFreeDescriptorSets(device, descriptorPool, 1, &target.descriptorSet);
+    target.descriptorSet = VK_NULL_HANDLE;
+  }
+  target.intermediate.cleanup(device);
+
+  for (VkImageView view : target.levelViews) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+  target.levelViews.clear();
+
+  if (target.ownsSourceView && target.sourceView != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, target.sourceView, nullptr);
+  }
+  target.sourceView = VK_NULL_HANDLE;
+  target.ownsSourceView = false;
+}
+
+void MipGenerator::generate(VkCommandBuffer commandBuffer,
+                            const MipTarget &target) {
+  uint32_t tilesX = tileCount(target.sourceExtent.width);
+  uint32_t tilesY = tileCount(target.sourceExtent.height);
+
+  // Every generated level is overwritten, so the old contents are discarded
+  VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = target.destination;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT,
+                              target.destinationBaseLevel, target.levelCount,
+                              0, 1};
+
+  // Orders the counter and tile results against a previous dispatch
+  VkMemoryBarrier memoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 1, &barrier);
+
+  MipPushConstants constants{};
+  constants.sourceSize[0] = static_cast<int32_t>(target.sourceExtent.width);
+  constants.sourceSize[1] = static_cast<int32_t>(target.sourceExtent.height);
+  constants.levelCount = target.levelCount;
+  constants.workGroupCount = tilesX * tilesY;
+  constants.tilesX = tilesX;
+
+  const ComputePipeline &pipeline =
+      pipelines[static_cast<uint32_t>(target.reduction)];
+  pipeline.bind(commandBuffer);
+  pipeline.bindDescriptorSet(commandBuffer, target.descriptorSet);
+  pipeline.pushConstants(commandBuffer, &constants, sizeof(constants));
+  vkCmdDispatch(commandBuffer, tilesX, tilesY, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
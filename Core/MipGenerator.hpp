@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "CommandPool.hpp"
+#include "ComputePipeline.hpp"
+#include "VulkanContext.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum class MipReduction : uint32_t {
+  Average = 0,
+  Min = 1,  // Hi-Z pyramid for reversed-Z depth (farthest depth)
+  Max = 2,  // Hi-Z pyramid for standard depth
+  AverageSrgb = 3,
+};
+
+// Image views, descriptor set and scratch memory for one source/destination
+// pair. Destination level i holds the source reduced by 2^(i + 1)
+struct MipTarget {
+  VkImage destination = VK_NULL_HANDLE;
+  uint32_t destinationBaseLevel = 0;
+  uint32_t levelCount = 0;
+  VkExtent2D sourceExtent{};
+  MipReduction reduction = MipReduction::Average;
+
+  VkImageView sourceView = VK_NULL_HANDLE;
+  bool ownsSourceView = false;
+  std::vector<VkImageView> levelViews;
+  Buffer intermediate; // workgroup counter and per-tile results
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+};
+
+// Generates up to 12 mip levels in a single compute dispatch. Each workgroup
+// reduces a 64x64 tile with subgroup quad operations and shared memory, and
+// the last workgroup to finish builds the remaining levels
+class MipGenerator {
+
+public:
+  static constexpr uint32_t kMaxLevels = 12;
+
+  void create(VulkanContext &context, uint32_t maxTargets = 32);
+  void cleanup(VkDevice device);
+
+  // Mip chain of an image whose level 0 is the source. The image needs
+  // SAMPLED and STORAGE usage; sRGB images are written through a UNORM alias
+  // (storageFormat) and need MUTABLE_FORMAT and EXTENDED_USAGE
+  MipTarget createChainTarget(VulkanContext &context, CommandPool &commandPool,
+                              VkImage image, VkFormat format,
+                              VkFormat storageFormat, VkExtent2D extent,
+                              uint32_t mipLevels, MipReduction reduction);
+
+  // Separate pyramid image built from sourceView, e.g. a Hi-Z pyramid from a
+  // depth buffer; level 0 of the pyramid is half the source resolution
+  MipTarget createPyramidTarget(VulkanContext &context,
+                                CommandPool &commandPool,
+                                VkImageView sourceView,
+                                VkExtent2D sourceExtent, VkImage pyramid,
+                                VkFormat pyramidFormat, uint32_t pyramidLevels,
+                                MipReduction reduction);
+
+  void destroyTarget(VkDevice device, MipTarget &target);
+
+  // Records the dispatch with one barrier before and one after. The source
+  // must be in SHADER_READ_ONLY_OPTIMAL; the generated levels are left in
+  // SHADER_READ_ONLY_OPTIMAL for fragment and compute shaders
+  void generate(VkCommandBuffer commandBuffer, const MipTarget &target);
+
+private:
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  std::array<ComputePipeline, 4> pipelines; // one per MipReduction
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+
+  void createTarget(VulkanContext &context, CommandPool &commandPool,
+                    MipTarget &target, VkFormat storageFormat);
+};
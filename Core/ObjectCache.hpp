@@ -0,0 +1,196 @@
+#pragma once
+
+#include "DeletionQueue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Flattened create-info: its fields followed by the arrays it points to,
+// so two keys are equal exactly when the create-infos describe the same
+// object. Only structures without padding may be added whole. The handles
+// the object refers to are recorded too, so entries can be dropped when
+// one of them is destroyed and its value could be reused
+class ObjectKey {
+
+public:
+  template <typename... T> void add(const T &...values) {
+    (addBytes(values), ...);
+  }
+  template <typename T> void addArray(const T *values, uint32_t count) {
+    addBytes(values ? count : 0u);
+    for (uint32_t i = 0; values && i < count; i++) {
+      addBytes(values[i]);
+    }
+  }
+  template <typename Handle> void addReference(Handle handle) {
+    uint64_t bits;
+    if constexpr (std::is_pointer_v<Handle>) {
+      bits = reinterpret_cast<uintptr_t>(handle);
+    } else {
+      bits = static_cast<uint64_t>(handle);
+    }
+    references.push_back(bits);
+  }
+
+  const std::vector<uint64_t> &getReferences() const { return references; }
+
+  bool operator==(const ObjectKey &other) const {
+    return bytes == other.bytes;
+  }
+
+  // FNV-1a
+  size_t hash() const {
+    uint64_t value = 14695981039346656037ull;
+    for (uint8_t byte : bytes) {
+      value = (value ^ byte) * 1099511628211ull;
+    }
+    return static_cast<size_t>(value);
+  }
+
+private:
+  std::vector<uint8_t> bytes;
+  std::vector<uint64_t> references;
+
+  template <typename T> void addBytes(const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(&value);
+    bytes.insert(bytes.end(), begin, begin + sizeof(T));
+  }
+};
+
+// Deduplicated, reference counted Vulkan objects of one type. acquire
+// returns the existing object for an equal key or creates one; release
+// drops a reference. Unreferenced objects stay cached until evict hands
+// them to a DeletionQueue, which destroys them once frames in flight are
+// done with them. Thread-safe
+template <typename Handle> class ObjectCache {
+
+public:
+  using Clock = std::chrono::steady_clock;
+
+  template <typename Create>
+  Handle acquire(const ObjectKey &key, Create &&create) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = byKey.find(key);
+    if (found != byKey.end()) {
+      entries[found->second].references++;
+      hits++;
+      return found->second;
+    }
+    // Created under the lock so racing misses cannot both create
+    Handle handle = create();
+    Entry &entry = entries[handle];
+    entry.key = key;
+    entry.references = 1;
+    byKey.emplace(key, handle);
+    misses++;
+    return handle;
+  }
+
+  void release(Handle handle, DeletionQueue &deletionQueue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(handle);
+    if (found == entries.end() || found->second.references == 0)
+      return;
+    Entry &entry = found->second;
+    entry.lastUsed = Clock::now();
+    if (--entry.references == 0 && entry.orphaned) {
+      deletionQueue.destroy(handle);
+      entries.erase(found);
+    }
+  }
+
+  // Queues the objects unreferenced for at least idle for destruction and
+  // returns them
+  std::vector<Handle> evict(DeletionQueue &deletionQueue,
+                            Clock::duration idle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::time_point now = Clock::now();
+    std::vector<Handle> evicted;
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (it->second.references == 0 && now - it->second.lastUsed >= idle) {
+        byKey.erase(it->second.key);
+        deletionQueue.destroy(it->first);
+        evicted.push_back(it->first);
+        it = entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    return evicted;
+  }
+
+  // Stops returning the objects whose key refers to handle, which is about
+  // to be destroyed. Unreferenced ones are queued now, the others on their
+  // last release. Returns them
+  std::vector<Handle> invalidate(uint64_t reference,
+                                 DeletionQueue &deletionQueue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Handle> invalidated;
+    for (auto it = entries.begin(); it != entries.end();) {
+      const std::vector<uint64_t> &references =
+          it->second.key.getReferences();
+      if (it->second.orphaned ||
+          std::find(references.begin(), references.end(), reference) ==
+              references.end()) {
+        ++it;
+        continue;
+      }
+      byKey.erase(it->second.key);
+      invalidated.push_back(it->first);
+      if (it->second.references == 0) {
+        deletionQueue.destroy(it->first);
+        it = entries.erase(it);
+      } else {
+        it->second.orphaned = true;
+        ++it;
+      }
+    }
+    return invalidated;
+  }
+
+  // Queues every object, referenced or not
+  void clear(DeletionQueue &deletionQueue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &[handle, entry] : entries) {
+      deletionQueue.destroy(handle);
+    }
+    entries.clear();
+    byKey.clear();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+  uint64_t getHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+  }
+  uint64_t getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+  }
+
+private:
+  struct Entry {
+    ObjectKey key;
+    uint32_t references = 0;
+    Clock::time_point lastUsed;
+    bool orphaned = false; // no longer found by key
+  };
+  struct KeyHash {
+    size_t operator()(const ObjectKey &key) const { return key.hash(); }
+  };
+
+  mutable std::mutex mutex;
+  std::unordered_map<ObjectKey, Handle, KeyHash> byKey;
+  std::unordered_map<Handle, Entry> entries;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
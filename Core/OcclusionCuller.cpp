@@ -0,0 +1,422 @@
+#include "OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr uint32_t kGroupSize = 64;
+// Largest source the mip generator reduces past six levels in one dispatch
+static constexpr uint32_t kMaxFullPyramidSource = 4096;
+
+struct CullPushConstants {
+  glm::mat4 viewProj;
+  int32_t depthSize[2];
+  uint32_t candidateCount;
+  uint32_t pyramidLevels;
+  uint32_t drawOffset;
+};
+
+void OcclusionCuller::create(VulkanContext &context, CommandPool &commandPool,
+                             MipGenerator &mipGenerator,
+                             const DepthBuffer &depthBuffer,
+                             uint32_t maxCandidates, uint32_t framesInFlight,
+                             DescriptorLayoutCache &layoutCache,
+                             DescriptorAllocator &descriptors) {
+  VkDevice device = context.getDevice();
+
+  const VkPhysicalDeviceFeatures &features = context.getEnabledFeatures();
+  // Draw commands address the instance buffer through firstInstance
+  if (!features.drawIndirectFirstInstance) {
+    throw std::runtime_error(
+        "Occlusion culling requires drawIndirectFirstInstance!");
+  }
+  multiDrawIndirect = features.multiDrawIndirect;
+
+  this->mipGenerator = &mipGenerator;
+  this->maxCandidates = maxCandidates;
+  depthImage = depthBuffer.getImage();
+  depthExtent = depthBuffer.getExtent();
+  depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (DepthBuffer::hasStencil(depthBuffer.getFormat())) {
+    depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+
+  createPyramid(context);
+  pyramidTarget = mipGenerator.createPyramidTarget(
+      context, commandPool, depthBuffer.getDepthView(), depthExtent, pyramid,
+      VK_FORMAT_R32_SFLOAT, pyramidLevels, MipReduction::Min);
+
+  // Nothing has been drawn yet, so everything starts in the late phase
+  visibility.create(context, VkDeviceSize(maxCandidates) * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  VkCommandBuffer commandBuffer = commandPool.beginSingleTimeCommands(device);
+  vkCmdFillBuffer(commandBuffer, visibility.getBuffer(), 0, VK_WHOLE_SIZE, 0);
+  commandPool.endSingleTimeCommands(device, context.getGraphicsQueue(),
+                                    commandBuffer);
+
+  frames.resize(framesInFlight);
+  for (Frame &frame : frames) {
+    VkDeviceSize candidatesSize =
+        VkDeviceSize(maxCandidates) * sizeof(OcclusionCandidate);
+    frame.candidates.create(context, candidatesSize,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void *data;
+    if (vkMapMemory(device, frame.candidates.getMemory(), 0, candidatesSize, 0,
+                    &data) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map occlusion candidates!");
+    }
+    frame.mappedCandidates = static_cast<OcclusionCandidate *>(data);
+
+    frame.draws.create(context,
+                       2 * VkDeviceSize(maxCandidates) *
+                           sizeof(VkDrawIndexedIndirectCommand),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    frame.stats.create(context, sizeof(OcclusionStats),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (vkMapMemory(device, frame.stats.getMemory(), 0, sizeof(OcclusionStats),
+                    0, &data) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map occlusion statistics!");
+    }
+    frame.mappedStats = static_cast<OcclusionStats *>(data);
+    *frame.mappedStats = {};
+  }
+
+  createDescriptors(device, layoutCache, descriptors);
+
+  // The phase is a specialization constant, like the mip reduction
+  for (uint32_t late = 0; late < 2; late++) {
+    VkSpecializationMapEntry entry{0, 0, sizeof(uint32_t)};
+    VkSpecializationInfo specialization{1, &entry, sizeof(uint32_t), &late};
+    ComputePipeline &pipeline = late ? latePipeline : earlyPipeline;
+    pipeline.create(device, "Shaders/occlusion_cull.comp.spv",
+                    {descriptorSetLayout}, sizeof(CullPushConstants),
+                    &specialization);
+  }
+}
+
+void OcclusionCuller::createPyramid(VulkanContext &context) {
+  VkDevice device = context.getDevice();
+
+  // Level i is the depth buffer reduced by 2^(i + 1), down to 1x1
+  uint32_t largest = std::max(depthExtent.width, depthExtent.height);
+  pyramidLevels = 0;
+  while ((largest >> (pyramidLevels + 1)) > 0) {
+    pyramidLevels++;
+  }
+  pyramidLevels = std::clamp(pyramidLevels, 1u, MipGenerator::kMaxLevels);
+  if (largest > kMaxFullPyramidSource) {
+    pyramidLevels = std::min(pyramidLevels, 6u);
+  }
+
+  VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.extent = {std::max(depthExtent.width / 2, 1u),
+                      std::max(depthExtent.height / 2, 1u), 1};
+  imageInfo.mipLevels = pyramidLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (vkCreateImage(device, &imageInfo, nullptr, &pyramid) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth pyramid!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, pyramid, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+      Buffer::findMemoryType(context, memRequirements.memoryTypeBits,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &pyramidMemory) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate depth pyramid memory!");
+  }
+  vkBindImageMemory(device, pyramid, pyramidMemory, 0);
+
+  VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  viewInfo.image = pyramid;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0,
+                               1};
+  if (vkCreateImageView(device, &viewInfo, nullptr, &pyramidView) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth pyramid view!");
+  }
+
+  VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth pyramid sampler!");
+  }
+}
+
+void OcclusionCuller::createDescriptors(VkDevice device,
+                                        DescriptorLayoutCache &layoutCache,
+                                        DescriptorAllocator &descriptors) {
+  std::vector<VkDescriptorSetLayoutBinding> bindings(5);
+  for (uint32_t i = 0; i < 5; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorSetLayout = layoutCache.getLayout(bindings);
+
+  VkDescriptorImageInfo pyramidInfo{sampler, pyramidView,
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  VkDescriptorBufferInfo visibilityInfo{visibility.getBuffer(), 0,
+                                        VK_WHOLE_SIZE};
+
+  for (Frame &frame : frames) {
+    frame.descriptorSet = descriptors.allocate(descriptorSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[4] = {
+        {frame.candidates.getBuffer(), 0, VK_WHOLE_SIZE},
+        {frame.draws.getBuffer(), 0, VK_WHOLE_SIZE},
+        visibilityInfo,
+        {frame.stats.getBuffer(), 0, VK_WHOLE_SIZE},
+    };
+
+    VkWriteDescriptorSet writes[5]{};
+    for (uint32_t binding = 0; binding < 5; binding++) {
+      writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[binding].dstSet = frame.descriptorSet;
+      writes[binding].dstBinding = binding;
+      writes[binding].descriptorCount = 1;
+      writes[binding].descriptorType = bindings[binding].descriptorType;
+      if (binding == 0) {
+        writes[binding].pImageInfo = &pyramidInfo;
+      } else {
+        writes[binding].pBufferInfo = &bufferInfos[binding - 1];
+      }
+    }
+    vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+  }
+}
+
+void OcclusionCuller::cleanup(VkDevice device) {
+  earlyPipeline.cleanup(device);
+  latePipeline.cleanup(device);
+  descriptorSetLayout = VK_NULL_HANDLE;
+
+  for (Frame &frame : frames) {
+    if (frame.mappedCandidates) {
+      vkUnmapMemory(device, frame.candidates.getMemory());
+    }
+    if (frame.mappedStats) {
+      vkUnmapMemory(device, frame.stats.getMemory());
+    }
+    frame.candidates.cleanup(device);
+    frame.draws.cleanup(device);
+    frame.stats.cleanup(device);
+  }
+  frames.clear();
+  visibility.cleanup(device);
+
+  if (mipGenerator) {
+    mipGenerator->destroyTarget(device, pyramidTarget);
+    mipGenerator = nullptr;
+  }
+  if (sampler != VK_NULL_HANDLE) {
+    vkDestroySampler(device, sampler, nullptr);
+    sampler = VK_NULL_HANDLE;
+  }
+  if (pyramidView != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, pyramidView, nullptr);
+    pyramidView = VK_NULL_HANDLE;
+  }
+  if (pyramid != VK_NULL_HANDLE) {
+    vkDestroyImage(device, pyramid, nullptr);
+    pyramid = VK_NULL_HANDLE;
+  }
+  if (pyramidMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(device, pyramidMemory, nullptr);
+    pyramidMemory = VK_NULL_HANDLE;
+  }
+}
+
+void OcclusionCuller::setCandidates(
+    uint32_t frameIndex, const std::vector<OcclusionCandidate> &candidates) {
+  if (candidates.size() > maxCandidates) {
+    throw std::runtime_error("Too many occlusion culling candidates!");
+  }
+  Frame &frame = frames[frameIndex];
+  std::copy(candidates.begin(), candidates.end(), frame.mappedCandidates);
+  frame.candidateCount = static_cast<uint32_t>(candidates.size());
+}
+
+void OcclusionCuller::recordEarlyCull(VkCommandBuffer commandBuffer,
+                                      uint32_t frameIndex) {
+  const Frame &frame = frames[frameIndex];
+
+  vkCmdFillBuffer(commandBuffer, frame.stats.getBuffer(), 0, VK_WHOLE_SIZE,
+                  0);
+
+  // Covers the cleared counters, the previous frame's visibility writes and
+  // its indirect reads of this frame's draw buffer
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask =
+      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  // The early phase never samples the pyramid
+  dispatch(commandBuffer, frame, earlyPipeline, glm::mat4(1.0f), depthExtent,
+           0);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+}
+
+void OcclusionCuller::recordLateCull(VkCommandBuffer commandBuffer,
+                                     uint32_t frameIndex,
+                                     const glm::mat4 &viewProjection,
+                                     VkExtent2D renderExtent) {
+  const Frame &frame = frames[frameIndex];
+
+  // The early pass's depth becomes the pyramid source
+  VkImageMemoryBarrier depthBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depthBarrier.image = depthImage;
+  depthBarrier.subresourceRange = {depthAspect, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &depthBarrier);
+
+  // Reversed-Z: each texel keeps the farthest depth it covers
+  mipGenerator->generate(commandBuffer, pyramidTarget);
+
+  // The early draws have consumed their commands before these are written
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  // Bounds are projected onto the rendered part; pyramid texels on its
+  // edge also cover stale depth beyond it, which only lowers their
+  // farthest depth, so the test stays conservative
+  if (renderExtent.width == 0 || renderExtent.height == 0) {
+    renderExtent = depthExtent;
+  }
+  renderExtent.width = std::min(renderExtent.width, depthExtent.width);
+  renderExtent.height = std::min(renderExtent.height, depthExtent.height);
+  dispatch(commandBuffer, frame, latePipeline, viewProjection, renderExtent,
+           maxCandidates);
+
+  // Late commands to the indirect draws, counters to the host
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+
+  depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_HOST_BIT |
+                           VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       0, 1, &barrier, 0, nullptr, 1, &depthBarrier);
+}
+
+void OcclusionCuller::dispatch(VkCommandBuffer commandBuffer,
+                               const Frame &frame,
+                               const ComputePipeline &pipeline,
+                               const glm::mat4 &viewProjection,
+                               VkExtent2D viewportExtent,
+                               uint32_t drawOffset) {
+  if (frame.candidateCount == 0) {
+    return;
+  }
+
+  CullPushConstants constants{};
+  constants.viewProj = viewProjection;
+  constants.depthSize[0] = static_cast<int32_t>(viewportExtent.width);
+  constants.depthSize[1] = static_cast<int32_t>(viewportExtent.height);
+  constants.candidateCount = frame.candidateCount;
+  constants.pyramidLevels = pyramidLevels;
+  constants.drawOffset = drawOffset;
+
+  pipeline.bind(commandBuffer);
+  pipeline.bindDescriptorSet(commandBuffer, frame.descriptorSet);
+  pipeline.pushConstants(commandBuffer, &constants, sizeof(constants));
+  vkCmdDispatch(commandBuffer,
+                ComputePipeline::groupCount(frame.candidateCount, kGroupSize),
+                1, 1);
+}
+
+void OcclusionCuller::drawEarly(VkCommandBuffer commandBuffer,
+                                uint32_t frameIndex) const {
+  draw(commandBuffer, frames[frameIndex], 0);
+}
+
+void OcclusionCuller::drawLate(VkCommandBuffer commandBuffer,
+                               uint32_t frameIndex) const {
+  draw(commandBuffer, frames[frameIndex], maxCandidates);
+}
+
+void OcclusionCuller::draw(VkCommandBuffer commandBuffer, const Frame &frame,
+                           uint32_t drawOffset) const {
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  VkDeviceSize offset = VkDeviceSize(drawOffset) * stride;
+
+  if (multiDrawIndirect) {
+    if (frame.candidateCount > 0) {
+      vkCmdDrawIndexedIndirect(commandBuffer, frame.draws.getBuffer(), offset,
+                               frame.candidateCount, stride);
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < frame.candidateCount; i++) {
+    vkCmdDrawIndexedIndirect(commandBuffer, frame.draws.getBuffer(),
+                             offset + VkDeviceSize(i) * stride, 1, stride);
+  }
+}
+
+OcclusionStats OcclusionCuller::getStats(uint32_t frameIndex) const {
+  return *frames[frameIndex].mappedStats;
+}
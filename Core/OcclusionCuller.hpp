@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "CommandPool.hpp"
+#include "ComputePipeline.hpp"
+#include "DepthBuffer.hpp"
+#include "DescriptorAllocator.hpp"
+#include "MipGenerator.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One frustum-visible draw; matches the shader's std430 layout
+struct OcclusionCandidate {
+  float bounds[4]; // world-space sphere: center, radius
+  uint32_t indexCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+  uint32_t objectIndex; // instance index, also the visibility slot
+};
+
+// Counts of one frame, written by the GPU
+struct OcclusionStats {
+  uint32_t earlyDrawn; // visible last frame, drawn before the pyramid
+  uint32_t lateDrawn;  // newly visible, drawn after the pyramid
+  uint32_t visible;
+  uint32_t occluded;
+};
+
+// Two-phase Hi-Z occlusion culling. Objects visible last frame are drawn
+// first; a depth pyramid is built from the result and every candidate is
+// tested against it, and the newly visible ones are drawn in a second pass.
+// Disocclusions are therefore drawn in the same frame instead of popping in
+// a frame late. Per frame:
+//   setCandidates -> recordEarlyCull -> render pass (drawEarly)
+//   -> recordLateCull -> render pass loading color and depth (drawLate)
+class OcclusionCuller {
+
+public:
+  // The pyramid is sized for depthBuffer; the culler owns its transitions
+  // between the two render passes. The set layout comes from layoutCache
+  // and the per-frame sets from descriptors, which must not be reset while
+  // the sets are in use
+  void create(VulkanContext &context, CommandPool &commandPool,
+              MipGenerator &mipGenerator, const DepthBuffer &depthBuffer,
+              uint32_t maxCandidates, uint32_t framesInFlight,
+              DescriptorLayoutCache &layoutCache,
+              DescriptorAllocator &descriptors);
+  void cleanup(VkDevice device);
+
+  // Writes this frame's candidates; the frame's fence must have signaled
+  void setCandidates(uint32_t frameIndex,
+                     const std::vector<OcclusionCandidate> &candidates);
+
+  // Outside a render pass, before the first one
+  void recordEarlyCull(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+  // Outside a render pass, after the first one. Leaves the depth buffer in
+  // DEPTH_STENCIL_ATTACHMENT_OPTIMAL for the second pass. renderExtent is
+  // the top-left part of the depth buffer the viewport covered; zero means
+  // all of it
+  void recordLateCull(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                      const glm::mat4 &viewProjection,
+                      VkExtent2D renderExtent = {});
+
+  // Indirect draws of each phase; the mesh and instance buffers must be
+  // bound
+  void drawEarly(VkCommandBuffer commandBuffer, uint32_t frameIndex) const;
+  void drawLate(VkCommandBuffer commandBuffer, uint32_t frameIndex) const;
+
+  // Counts of the last frame recorded with frameIndex, valid once its fence
+  // has signaled
+  OcclusionStats getStats(uint32_t frameIndex) const;
+
+private:
+  struct Frame {
+    Buffer candidates; // host-visible, written by setCandidates
+    OcclusionCandidate *mappedCandidates = nullptr;
+    uint32_t candidateCount = 0;
+    Buffer draws; // early commands, then late commands
+    Buffer stats; // host-visible, read back by getStats
+    OcclusionStats *mappedStats = nullptr;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  };
+
+  MipGenerator *mipGenerator = nullptr;
+  uint32_t maxCandidates = 0;
+  bool multiDrawIndirect = false;
+
+  VkImage depthImage = VK_NULL_HANDLE;
+  VkImageAspectFlags depthAspect = 0;
+  VkExtent2D depthExtent{};
+
+  VkImage pyramid = VK_NULL_HANDLE;
+  VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+  VkImageView pyramidView = VK_NULL_HANDLE;
+  uint32_t pyramidLevels = 0;
+  MipTarget pyramidTarget;
+  VkSampler sampler = VK_NULL_HANDLE;
+
+  Buffer visibility; // one uint per object, persists across frames
+  std::vector<Frame> frames;
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE; // cached
+  ComputePipeline earlyPipeline;
+  ComputePipeline latePipeline;
+
+  void createPyramid(VulkanContext &context);
+  void createDescriptors(VkDevice device, DescriptorLayoutCache &layoutCache,
+                         DescriptorAllocator &descriptors);
+  void dispatch(VkCommandBuffer commandBuffer, const Frame &frame,
+                const ComputePipeline &pipeline,
+                const glm::mat4 &viewProjection, VkExtent2D viewportExtent,
+                uint32_t drawOffset);
+  void draw(VkCommandBuffer commandBuffer, const Frame &frame,
+            uint32_t drawOffset) const;
+};
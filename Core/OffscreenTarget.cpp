@@ -0,0 +1,40 @@
+#include "OffscreenTarget.hpp"
+
+#include <stdexcept>
+
+void OffscreenTarget::create(VulkanContext &context, uint32_t width,
+                             uint32_t height, uint32_t imageCount,
+                             VkImageUsageFlags extraUsage) {
+  extent = {width, height};
+  // Copied out for captures and readback
+  usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+          VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+          Image::supportedUsage(context, kFormat, extraUsage);
+
+  VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = kFormat;
+  imageInfo.extent = {width, height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = usage;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  images.resize(imageCount);
+  imageViews.resize(imageCount);
+  for (uint32_t i = 0; i < imageCount; i++) {
+    images[i].create(context, imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+    imageViews[i] = images[i].getView();
+  }
+}
+
+void OffscreenTarget::cleanup(VkDevice device) {
+  for (Image &image : images) {
+    image.cleanup(device);
+  }
+  images.clear();
+  imageViews.clear();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Image.hpp"
+#include "VulkanContext.hpp"
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Color images rendered into in place of a swapchain, for headless runs.
+// Mirrors the Swapchain getters so the same render pass and framebuffers
+// work with either; images end each frame in kFinalLayout
+class OffscreenTarget {
+
+public:
+  static constexpr VkFormat kFormat = VK_FORMAT_B8G8R8A8_UNORM;
+  static constexpr VkImageLayout kFinalLayout =
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+  // Images are color attachments and transfer sources, plus the bits of
+  // extraUsage kFormat supports; see getUsage
+  void create(VulkanContext &context, uint32_t width, uint32_t height,
+              uint32_t imageCount, VkImageUsageFlags extraUsage = 0);
+  void cleanup(VkDevice device);
+
+  VkFormat getFormat() const { return kFormat; }
+  VkExtent2D getExtent() const { return extent; }
+  VkImageUsageFlags getUsage() const { return usage; }
+  // The render pass leaves it in kFinalLayout; record that with assumeState
+  Image &getImage(uint32_t index) { return images[index]; }
+  const std::vector<VkImageView> &getImageViews() const {
+    return imageViews;
+  }
+
+private:
+  VkExtent2D extent{};
+  VkImageUsageFlags usage = 0;
+  std::vector<Image> images;
+  std::vector<VkImageView> imageViews; // of images, for the framebuffers
+};
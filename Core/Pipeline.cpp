@@ -1,17 +1,25 @@
 #include "Pipeline.hpp"
 
+#include "DepthBuffer.hpp"
+#include "Logger.hpp"
 #include "Types.hpp"
 
 #include <array>
 #include <filesystem>
 #include <fstream>
-#include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
-static std::vector<char> readFile(const std::string &filename) {
-  std::cout << "Current Working Directory: " << std::filesystem::current_path()
-            << std::endl;
+
+// SPIR-V read ahead by prefetchShaderFiles
+static std::mutex shaderFilesMutex;
+static std::unordered_map<std::string, std::vector<char>> shaderFiles;
+
+static std::vector<char> readFileFromDisk(const std::string &filename) {
+  LOG_DEBUG("Reading %s from %s", filename.c_str(),
+            std::filesystem::current_path().string().c_str());
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
   if (!file.is_open())
     throw std::runtime_error("Failed to open shader file!");
@@ -23,6 +31,29 @@ static std::vector<char> readFile(const std::string &filename) {
   return buffer;
 }
 
+static std::vector<char> readFile(const std::string &filename) {
+  {
+    std::lock_guard<std::mutex> lock(shaderFilesMutex);
+    auto it = shaderFiles.find(filename);
+    if (it != shaderFiles.end())
+      return it->second;
+  }
+  return readFileFromDisk(filename);
+}
+
+void Pipeline::prefetchShaderFiles(const std::vector<std::string> &filenames) {
+  for (const std::string &filename : filenames) {
+    std::vector<char> code = readFileFromDisk(filename);
+    std::lock_guard<std::mutex> lock(shaderFilesMutex);
+    shaderFiles[filename] = std::move(code);
+  }
+}
+
+void Pipeline::releaseShaderFiles() {
+  std::lock_guard<std::mutex> lock(shaderFilesMutex);
+  shaderFiles.clear();
+}
+
 VkShaderModule Pipeline::createShaderModule(VkDevice device,
                                             const std::vector<char> &code) {
   VkShaderModuleCreateInfo createInfo{
@@ -37,10 +68,16 @@ VkShaderModule Pipeline::createShaderModule(VkDevice device,
   return shaderModule;
 }
 
-void Pipeline::createBasicPipeline(VkDevice device, VkRenderPass renderPass,
-                                   VkExtent2D extent,
-                                   VkPipelineLayout &pipelineLayout,
-                                   VkPipeline &pipeline) {
+VkShaderModule Pipeline::loadShaderModule(VkDevice device,
+                                          const std::string &filename) {
+  return createShaderModule(device, readFile(filename));
+}
+
+void Pipeline::createBasicPipeline(
+    VkDevice device, VkRenderPass renderPass,
+    VkPipelineLayout &pipelineLayout, VkPipeline &pipeline, uint32_t subpass,
+    bool depthTest, bool depthWrite,
+    const std::vector<VkDescriptorSetLayout> &setLayouts) {
   auto vertShaderCode = readFile("Shaders/triangle.vert.spv");
   auto fragShaderCode = readFile("Shaders/triangle.frag.spv");
 
@@ -62,12 +99,67 @@ void Pipeline::createBasicPipeline(VkDevice device, VkRenderPass renderPass,
   VkPipelineShaderStageCreateInfo shaderStages[] = {vertStageInfo,
                                                     fragStageInfo};
 
-  VkVertexInputBindingDescription bindingDescription{};
-  bindingDescription.binding = 0;             // Binding index
-  bindingDescription.stride = sizeof(Vertex); // Size of one vertex
-  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; // Per-vertex data
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.size = sizeof(CameraConstants);
 
-  std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create pipeline layout!");
+
+  createGraphicsPipeline(device, renderPass, subpass, pipelineLayout,
+                         shaderStages, 2, depthTest, depthWrite, true,
+                         pipelineCache, pipeline);
+
+  vkDestroyShaderModule(device, fragShaderModule, nullptr);
+  vkDestroyShaderModule(device, vertShaderModule, nullptr);
+}
+
+void Pipeline::createDepthOnlyPipeline(VkDevice device,
+                                       VkRenderPass renderPass,
+                                       VkPipelineLayout pipelineLayout,
+                                       VkPipeline &pipeline,
+                                       uint32_t subpass) {
+  // Same vertex shader as the main pass, so both produce identical depth
+  VkShaderModule vertShaderModule =
+      loadShaderModule(device, "Shaders/triangle.vert.spv");
+
+  VkPipelineShaderStageCreateInfo vertStageInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+  vertStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vertStageInfo.module = vertShaderModule;
+  vertStageInfo.pName = "main";
+
+  createGraphicsPipeline(device, renderPass, subpass, pipelineLayout,
+                         &vertStageInfo, 1, true, true, false, pipelineCache,
+                         pipeline);
+
+  vkDestroyShaderModule(device, vertShaderModule, nullptr);
+}
+
+void Pipeline::createGraphicsPipeline(
+    VkDevice device, VkRenderPass renderPass, uint32_t subpass,
+    VkPipelineLayout pipelineLayout,
+    const VkPipelineShaderStageCreateInfo *stages, uint32_t stageCount,
+    bool depthTest, bool depthWrite, bool colorOutput, VkPipelineCache cache,
+    VkPipeline &pipeline) {
+  std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
+  bindingDescriptions[0].binding = 0;             // Binding index
+  bindingDescriptions[0].stride = sizeof(Vertex); // Size of one vertex
+  bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  // Per-instance data from the scene's instance buffer
+  bindingDescriptions[1].binding = 1;
+  bindingDescriptions[1].stride = sizeof(InstanceData);
+  bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  std::array<VkVertexInputAttributeDescription, 7> attributeDescriptions{};
 
   // Position attribute at Location 0
   attributeDescriptions[0].binding = 0;
@@ -81,36 +173,50 @@ void Pipeline::createBasicPipeline(VkDevice device, VkRenderPass renderPass,
   attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT; // vec3
   attributeDescriptions[1].offset = offsetof(Vertex, color);
 
+  // Normal attribute at Location 2
+  attributeDescriptions[2].binding = 0;
+  attributeDescriptions[2].location = 2;
+  attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT; // vec3
+  attributeDescriptions[2].offset = offsetof(Vertex, normal);
+
+  // Model matrix columns at Locations 3-6
+  for (uint32_t column = 0; column < 4; column++) {
+    VkVertexInputAttributeDescription &attribute =
+        attributeDescriptions[3 + column];
+    attribute.binding = 1;
+    attribute.location = 3 + column;
+    attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT; // vec4
+    attribute.offset =
+        offsetof(InstanceData, model) + column * 4 * sizeof(float);
+  }
+
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+  vertexInputInfo.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(bindingDescriptions.size());
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-  vertexInputInfo.vertexAttributeDescriptionCount = 2;
+  vertexInputInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(attributeDescriptions.size());
 
   VkPipelineInputAssemblyStateCreateInfo inputAssembly{
       VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
   inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)extent.width;
-  viewport.height = (float)extent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = extent;
-
+  // Set when recording, so one pipeline serves any render extent
   VkPipelineViewportStateCreateInfo viewportState{
       VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+
+  std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
+                                                 VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState{
+      VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+  dynamicState.dynamicStateCount =
+      static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
 
   VkPipelineRasterizationStateCreateInfo rasterizer{
       VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
@@ -136,33 +242,35 @@ void Pipeline::createBasicPipeline(VkDevice device, VkRenderPass renderPass,
   VkPipelineColorBlendStateCreateInfo colorBlending{
       VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
   colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.attachmentCount = 1;
+  colorBlending.attachmentCount = colorOutput ? 1 : 0;
   colorBlending.pAttachments = &colorBlendAttachment;
 
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
-                             &pipelineLayout) != VK_SUCCESS)
-    throw std::runtime_error("Failed to create pipeline layout!");
+  // Reversed-Z: nearer fragments have greater depth
+  VkPipelineDepthStencilStateCreateInfo depthStencil{
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+  depthStencil.depthTestEnable = depthTest ? VK_TRUE : VK_FALSE;
+  depthStencil.depthWriteEnable = depthWrite ? VK_TRUE : VK_FALSE;
+  depthStencil.depthCompareOp = DepthBuffer::kCompareOp;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.stencilTestEnable = VK_FALSE;
 
   VkGraphicsPipelineCreateInfo pipelineInfo{
       VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.stageCount = stageCount;
+  pipelineInfo.pStages = stages;
   pipelineInfo.pVertexInputState = &vertexInputInfo;
   pipelineInfo.pInputAssemblyState = &inputAssembly;
   pipelineInfo.pViewportState = &viewportState;
   pipelineInfo.pRasterizationState = &rasterizer;
   pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
   pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = pipelineLayout;
   pipelineInfo.renderPass = renderPass;
-  pipelineInfo.subpass = 0;
+  pipelineInfo.subpass = subpass;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
+  if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo,
                                 nullptr, &pipeline) != VK_SUCCESS)
     throw std::runtime_error("Failed to create graphics pipeline!");
-
-  vkDestroyShaderModule(device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
\ No newline at end of file
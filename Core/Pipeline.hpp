@@ -1,16 +1,50 @@
 #pragma once
 
+#include <string>
 #include <vector>
 #include <vulkan/vulkan.h>
 
 class Pipeline {
 
 public:
-  void createBasicPipeline(VkDevice device, VkRenderPass renderPass,
-                           VkExtent2D extent, VkPipelineLayout &pipelineLayout,
-                           VkPipeline &pipeline);
+  // With depthTest the pipeline tests against reversed-Z depth; after a
+  // depth pre-pass, pass depthWrite = false since depth is already final.
+  // The layout has setLayouts plus CameraConstants as push constants.
+  // Viewport and scissor are dynamic and must be set before drawing
+  void createBasicPipeline(
+      VkDevice device, VkRenderPass renderPass,
+      VkPipelineLayout &pipelineLayout, VkPipeline &pipeline,
+      uint32_t subpass = 0, bool depthTest = false, bool depthWrite = false,
+      const std::vector<VkDescriptorSetLayout> &setLayouts = {});
+
+  // Vertex-only pipeline writing depth for a pre-pass, sharing the layout
+  // created by createBasicPipeline
+  void createDepthOnlyPipeline(VkDevice device, VkRenderPass renderPass,
+                               VkPipelineLayout pipelineLayout,
+                               VkPipeline &pipeline, uint32_t subpass = 0);
+
+  // Reads a SPIR-V file and creates a shader module from it
+  static VkShaderModule loadShaderModule(VkDevice device,
+                                         const std::string &filename);
+
+  // Reads SPIR-V files ahead of pipeline creation, e.g. while the device is
+  // still being created; later loads of them skip the disk. Thread-safe
+  static void prefetchShaderFiles(const std::vector<std::string> &filenames);
+  // Frees the prefetched files once no more pipelines need them
+  static void releaseShaderFiles();
+
+  // Pipeline cache used by later creations; the caller owns it
+  void setPipelineCache(VkPipelineCache cache) { pipelineCache = cache; }
 
 private:
-  VkShaderModule createShaderModule(VkDevice device,
-                                    const std::vector<char> &code);
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+  static void createGraphicsPipeline(
+      VkDevice device, VkRenderPass renderPass, uint32_t subpass,
+      VkPipelineLayout pipelineLayout,
+      const VkPipelineShaderStageCreateInfo *stages, uint32_t stageCount,
+      bool depthTest, bool depthWrite, bool colorOutput,
+      VkPipelineCache cache, VkPipeline &pipeline);
+  static VkShaderModule createShaderModule(VkDevice device,
+                                           const std::vector<char> &code);
 };
\ No newline at end of file
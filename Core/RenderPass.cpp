@@ -1,7 +1,16 @@
 #include "RenderPass.hpp"
+#include "ResourceCache.hpp"
+#include <array>
 #include <stdexcept>
+#include <vector>
+
+void RenderPass::create(VkDevice device, VkFormat swapChainImageFormat,
+                        VkFormat depthFormat, bool depthPrePass,
+                        bool loadContents, VkImageLayout colorLayout,
+                        ResourceCache *cache) {
+  depth = depthFormat != VK_FORMAT_UNDEFINED;
+  this->depthPrePass = depth && depthPrePass;
 
-void RenderPass::create(VkDevice device, VkFormat swapChainImageFormat) {
   VkAttachmentDescription colorAttachment{};
   colorAttachment.format = swapChainImageFormat;
   colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -14,37 +23,132 @@ void RenderPass::create(VkDevice device, VkFormat swapChainImageFormat) {
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.initialLayout =
       VK_IMAGE_LAYOUT_UNDEFINED; // Don't care about previous layout
-  colorAttachment.finalLayout =
-      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Layout for presentation
+  colorAttachment.finalLayout = colorLayout; // Presentation by default
+  if (loadContents) {
+    // Left for presentation by the previous pass
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.initialLayout = colorLayout;
+  }
 
   VkAttachmentReference colorAttachmentRef{};
   colorAttachmentRef.attachment = 0; // Attachment index
   colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+  // Cleared to DepthBuffer::kClearDepth and kept for later passes (Hi-Z)
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = depthFormat;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  if (loadContents) {
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.initialLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  }
+
+  VkAttachmentReference depthWriteRef{};
+  depthWriteRef.attachment = 1;
+  depthWriteRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  // The color subpass after a pre-pass only tests depth
+  VkAttachmentReference depthReadRef{};
+  depthReadRef.attachment = 1;
+  depthReadRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  std::vector<VkSubpassDescription> subpasses;
+
+  if (this->depthPrePass) {
+    VkSubpassDescription prePass{};
+    prePass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    prePass.pDepthStencilAttachment = &depthWriteRef;
+    subpasses.push_back(prePass);
+  }
+
   VkSubpassDescription subpass{};
   subpass.pipelineBindPoint =
       VK_PIPELINE_BIND_POINT_GRAPHICS; // Graphics pipeline
   subpass.colorAttachmentCount = 1;
   subpass.pColorAttachments = &colorAttachmentRef; // Color attachment
+  if (depth) {
+    subpass.pDepthStencilAttachment =
+        this->depthPrePass ? &depthReadRef : &depthWriteRef;
+  }
+  subpasses.push_back(subpass);
+
+  std::vector<VkSubpassDependency> dependencies;
 
   VkSubpassDependency dependency{};
   dependency.srcSubpass =
-      VK_SUBPASS_EXTERNAL;   // Implicit subpass before render pass
-  dependency.dstSubpass = 0; // Our subpass
+      VK_SUBPASS_EXTERNAL; // Implicit subpass before render pass
+  dependency.dstSubpass = getColorSubpass(); // First subpass writing color
   dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
   dependency.srcAccessMask = 0;
   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  if (loadContents) {
+    // The previous pass's color writes are loaded
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+  }
+  dependencies.push_back(dependency);
+
+  if (depth) {
+    // Earlier depth tests must finish before the clear or load
+    VkSubpassDependency depthDependency{};
+    depthDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    depthDependency.dstSubpass = 0;
+    depthDependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    depthDependency.srcAccessMask =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    depthDependency.dstAccessMask =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies.push_back(depthDependency);
+  }
+
+  if (this->depthPrePass) {
+    // Pre-pass depth writes are visible to the color subpass's tests
+    VkSubpassDependency prePassDependency{};
+    prePassDependency.srcSubpass = 0;
+    prePassDependency.dstSubpass = 1;
+    prePassDependency.srcStageMask =
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    prePassDependency.srcAccessMask =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    prePassDependency.dstStageMask =
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    prePassDependency.dstAccessMask =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    prePassDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies.push_back(prePassDependency);
+  }
+
+  std::array<VkAttachmentDescription, 2> attachments = {colorAttachment,
+                                                        depthAttachment};
 
   VkRenderPassCreateInfo renderPassInfo{
       VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
-  renderPassInfo.attachmentCount = 1;
-  renderPassInfo.pAttachments = &colorAttachment;
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.attachmentCount = depth ? 2 : 1;
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
 
+  this->cache = cache;
+  if (cache) {
+    renderPass = cache->acquireRenderPass(renderPassInfo);
+    return;
+  }
   if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) !=
       VK_SUCCESS) {
     throw std::runtime_error("Failed to create render pass!");
@@ -52,8 +156,12 @@ void RenderPass::create(VkDevice device, VkFormat swapChainImageFormat) {
 }
 
 void RenderPass::cleanup(VkDevice device) {
-  if (renderPass != VK_NULL_HANDLE) {
+  if (renderPass == VK_NULL_HANDLE)
+    return;
+  if (cache) {
+    cache->release(renderPass);
+  } else {
     vkDestroyRenderPass(device, renderPass, nullptr);
-    renderPass = VK_NULL_HANDLE;
   }
+  renderPass = VK_NULL_HANDLE;
 }
\ No newline at end of file
@@ -1,14 +1,36 @@
 #pragma once
+#include <cstdint>
 #include <vulkan/vulkan.h>
 
+class ResourceCache; // forward declaration
+
 class RenderPass {
 
 public:
-  void create(VkDevice device, VkFormat swapChainImageFormat);
+  // depthFormat adds a depth attachment at index 1. With depthPrePass the
+  // pass gets a depth-only subpass first, and the color subpass then tests
+  // against the finished depth without writing it, so only visible
+  // fragments are shaded. loadContents continues from a previous pass with
+  // the same attachments instead of clearing, e.g. to draw objects found
+  // visible by occlusion culling. colorLayout is the layout color is left
+  // in (and loaded from), e.g. TRANSFER_SRC_OPTIMAL for offscreen targets.
+  // With a cache, equal passes share one VkRenderPass
+  void create(VkDevice device, VkFormat swapChainImageFormat,
+              VkFormat depthFormat = VK_FORMAT_UNDEFINED,
+              bool depthPrePass = false, bool loadContents = false,
+              VkImageLayout colorLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+              ResourceCache *cache = nullptr);
   void cleanup(VkDevice device);
 
   VkRenderPass getRenderPass() const { return renderPass; }
+  bool hasDepth() const { return depth; }
+  bool hasDepthPrePass() const { return depthPrePass; }
+  uint32_t getDepthPrePassSubpass() const { return 0; }
+  uint32_t getColorSubpass() const { return depthPrePass ? 1 : 0; }
 
 private:
   VkRenderPass renderPass = VK_NULL_HANDLE;
-};
\ No newline at end of file
+  ResourceCache *cache = nullptr;
+  bool depth = false;
+  bool depthPrePass = false;
+};
@@ -0,0 +1,181 @@
+#include "ResourceCache.hpp"
+
+#include <stdexcept>
+
+// Extension structures are not part of the keys
+static void requireNoChain(const void *next) {
+  if (next != nullptr) {
+    throw std::runtime_error("Cached objects cannot have a pNext chain!");
+  }
+}
+
+template <typename Handle> static uint64_t toReference(Handle handle) {
+  ObjectKey key;
+  key.addReference(handle);
+  return key.getReferences().front();
+}
+
+void ResourceCache::create(VkDevice device, DeletionQueue &deletionQueue,
+                           double idleSeconds) {
+  this->device = device;
+  this->deletionQueue = &deletionQueue;
+  idle = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(idleSeconds));
+  stopping = false;
+  evictionThread = std::thread(&ResourceCache::evictionLoop, this);
+}
+
+void ResourceCache::cleanup() {
+  if (evictionThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(evictionMutex);
+      stopping = true;
+    }
+    evictionCondition.notify_all();
+    evictionThread.join();
+  }
+  if (!deletionQueue)
+    return;
+  framebuffers.clear(*deletionQueue);
+  renderPasses.clear(*deletionQueue);
+  imageViews.clear(*deletionQueue);
+  samplers.clear(*deletionQueue);
+}
+
+VkSampler ResourceCache::acquireSampler(const VkSamplerCreateInfo &info) {
+  requireNoChain(info.pNext);
+  ObjectKey key;
+  key.add(info.flags, info.magFilter, info.minFilter, info.mipmapMode,
+          info.addressModeU, info.addressModeV, info.addressModeW,
+          info.mipLodBias, info.anisotropyEnable, info.maxAnisotropy,
+          info.compareEnable, info.compareOp, info.minLod, info.maxLod,
+          info.borderColor, info.unnormalizedCoordinates);
+  return samplers.acquire(key, [&] {
+    VkSampler sampler;
+    if (vkCreateSampler(device, &info, nullptr, &sampler) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create sampler!");
+    }
+    return sampler;
+  });
+}
+
+VkImageView
+ResourceCache::acquireImageView(const VkImageViewCreateInfo &info) {
+  requireNoChain(info.pNext);
+  ObjectKey key;
+  key.add(info.flags, info.image, info.viewType, info.format, info.components,
+          info.subresourceRange);
+  key.addReference(info.image);
+  return imageViews.acquire(key, [&] {
+    VkImageView view;
+    if (vkCreateImageView(device, &info, nullptr, &view) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create image view!");
+    }
+    return view;
+  });
+}
+
+VkRenderPass
+ResourceCache::acquireRenderPass(const VkRenderPassCreateInfo &info) {
+  requireNoChain(info.pNext);
+  ObjectKey key;
+  key.add(info.flags);
+  key.addArray(info.pAttachments, info.attachmentCount);
+  key.add(info.subpassCount);
+  for (uint32_t i = 0; i < info.subpassCount; i++) {
+    const VkSubpassDescription &subpass = info.pSubpasses[i];
+    key.add(subpass.flags, subpass.pipelineBindPoint);
+    key.addArray(subpass.pInputAttachments, subpass.inputAttachmentCount);
+    key.addArray(subpass.pColorAttachments, subpass.colorAttachmentCount);
+    key.addArray(subpass.pResolveAttachments, subpass.colorAttachmentCount);
+    key.addArray(subpass.pDepthStencilAttachment, 1);
+    key.addArray(subpass.pPreserveAttachments,
+                 subpass.preserveAttachmentCount);
+  }
+  key.addArray(info.pDependencies, info.dependencyCount);
+  return renderPasses.acquire(key, [&] {
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(device, &info, nullptr, &renderPass) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to create render pass!");
+    }
+    return renderPass;
+  });
+}
+
+VkFramebuffer
+ResourceCache::acquireFramebuffer(const VkFramebufferCreateInfo &info) {
+  requireNoChain(info.pNext);
+  ObjectKey key;
+  key.add(info.flags, info.renderPass);
+  key.addArray(info.pAttachments, info.attachmentCount);
+  key.add(info.width, info.height, info.layers);
+  key.addReference(info.renderPass);
+  for (uint32_t i = 0; i < info.attachmentCount; i++) {
+    key.addReference(info.pAttachments[i]);
+  }
+  return framebuffers.acquire(key, [&] {
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device, &info, nullptr, &framebuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to create framebuffer!");
+    }
+    return framebuffer;
+  });
+}
+
+void ResourceCache::release(VkSampler sampler) {
+  samplers.release(sampler, *deletionQueue);
+}
+
+void ResourceCache::release(VkImageView view) {
+  imageViews.release(view, *deletionQueue);
+}
+
+void ResourceCache::release(VkRenderPass renderPass) {
+  renderPasses.release(renderPass, *deletionQueue);
+}
+
+void ResourceCache::release(VkFramebuffer framebuffer) {
+  framebuffers.release(framebuffer, *deletionQueue);
+}
+
+void ResourceCache::forgetImage(VkImage image) {
+  for (VkImageView view :
+       imageViews.invalidate(toReference(image), *deletionQueue)) {
+    forgetFramebuffers(toReference(view));
+  }
+}
+
+void ResourceCache::forgetImageView(VkImageView view) {
+  forgetFramebuffers(toReference(view));
+}
+
+void ResourceCache::forgetFramebuffers(uint64_t reference) {
+  framebuffers.invalidate(reference, *deletionQueue);
+}
+
+void ResourceCache::evictionLoop() {
+  std::unique_lock<std::mutex> lock(evictionMutex);
+  while (!stopping) {
+    // Rarely enough to cost nothing, often enough to bound idle objects
+    evictionCondition.wait_for(lock, std::chrono::seconds(1),
+                               [this] { return stopping; });
+    if (stopping)
+      break;
+    lock.unlock();
+    evictUnused();
+    lock.lock();
+  }
+}
+
+void ResourceCache::evictUnused() {
+  samplers.evict(*deletionQueue, idle);
+  framebuffers.evict(*deletionQueue, idle);
+  for (VkImageView view : imageViews.evict(*deletionQueue, idle)) {
+    forgetFramebuffers(toReference(view));
+  }
+  for (VkRenderPass renderPass : renderPasses.evict(*deletionQueue, idle)) {
+    forgetFramebuffers(toReference(renderPass));
+  }
+}
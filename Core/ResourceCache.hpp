@@ -0,0 +1,80 @@
+#pragma once
+
+#include "DeletionQueue.hpp"
+#include "ObjectCache.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vulkan/vulkan.h>
+
+// Cache statistics of one object type
+struct ObjectCacheStats {
+  size_t objects = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+// Shared samplers, image views, render passes and framebuffers, keyed by
+// their create-info. Every acquire is paired with a release; objects then
+// unused for idleSeconds are evicted by a background thread into the
+// deletion queue. Thread-safe
+class ResourceCache {
+
+public:
+  void create(VkDevice device, DeletionQueue &deletionQueue,
+              double idleSeconds = 5.0);
+  // Stops eviction and queues every object; none may be used afterwards
+  void cleanup();
+
+  VkSampler acquireSampler(const VkSamplerCreateInfo &info);
+  VkImageView acquireImageView(const VkImageViewCreateInfo &info);
+  VkRenderPass acquireRenderPass(const VkRenderPassCreateInfo &info);
+  VkFramebuffer acquireFramebuffer(const VkFramebufferCreateInfo &info);
+
+  void release(VkSampler sampler);
+  void release(VkImageView view);
+  void release(VkRenderPass renderPass);
+  void release(VkFramebuffer framebuffer);
+
+  // Call before destroying an image so its views, and framebuffers using
+  // them, are not handed out again should the handle be reused
+  void forgetImage(VkImage image);
+  // Likewise for views created outside the cache that framebuffers use
+  void forgetImageView(VkImageView view);
+
+  ObjectCacheStats getSamplerStats() const { return statsOf(samplers); }
+  ObjectCacheStats getImageViewStats() const { return statsOf(imageViews); }
+  ObjectCacheStats getRenderPassStats() const {
+    return statsOf(renderPasses);
+  }
+  ObjectCacheStats getFramebufferStats() const {
+    return statsOf(framebuffers);
+  }
+
+private:
+  VkDevice device = VK_NULL_HANDLE;
+  DeletionQueue *deletionQueue = nullptr;
+  ObjectCache<VkSampler> samplers;
+  ObjectCache<VkImageView> imageViews;
+  ObjectCache<VkRenderPass> renderPasses;
+  ObjectCache<VkFramebuffer> framebuffers;
+
+  std::chrono::steady_clock::duration idle{};
+  std::thread evictionThread;
+  std::mutex evictionMutex;
+  std::condition_variable evictionCondition;
+  bool stopping = false;
+
+  void evictionLoop();
+  void evictUnused();
+  // Framebuffers referring to a view or render pass that is going away
+  void forgetFramebuffers(uint64_t reference);
+
+  template <typename Handle>
+  static ObjectCacheStats statsOf(const ObjectCache<Handle> &cache) {
+    return {cache.size(), cache.getHits(), cache.getMisses()};
+  }
+};
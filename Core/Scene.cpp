@@ -0,0 +1,222 @@
+#include "Scene.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Reorders v so that v[i] becomes the old v[order[i]]
+template <typename T>
+static void permute(std::vector<T> &v, const std::vector<uint32_t> &order) {
+  std::vector<T> result(v.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    result[i] = v[order[i]];
+  }
+  v.swap(result);
+}
+
+void Scene::createInstanceBuffer(VulkanContext &context, uint32_t maxNodes,
+                                 uint32_t framesInFlight) {
+  this->framesInFlight = framesInFlight;
+  maxInstances = maxNodes;
+
+  VkDeviceSize size =
+      VkDeviceSize(maxNodes) * framesInFlight * sizeof(InstanceData);
+  instanceBuffer.create(context, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  void *data;
+  if (vkMapMemory(context.getDevice(), instanceBuffer.getMemory(), 0, size, 0,
+                  &data) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to map instance buffer!");
+  }
+  mappedInstances = static_cast<InstanceData *>(data);
+
+  // Every existing node still has to reach every region
+  std::fill(pendingWrites.begin(), pendingWrites.end(),
+            static_cast<uint8_t>(framesInFlight));
+}
+
+void Scene::cleanup(VkDevice device) {
+  if (mappedInstances) {
+    vkUnmapMemory(device, instanceBuffer.getMemory());
+    mappedInstances = nullptr;
+  }
+  instanceBuffer.cleanup(device);
+}
+
+uint32_t Scene::addNode(uint32_t parent, const glm::mat4 &localTransform) {
+  uint32_t index = getNodeCount();
+  if (mappedInstances && index >= maxInstances) {
+    throw std::runtime_error("Scene exceeds its instance buffer capacity!");
+  }
+
+  uint32_t parentIndex = kNoParent;
+  uint32_t depth = 0;
+  if (parent != kNoParent) {
+    parentIndex = nodeIndices[parent];
+    depth = depths[parentIndex] + 1;
+  }
+
+  hierarchyDirty = true;
+
+  parents.push_back(parentIndex);
+  depths.push_back(depth);
+  localTransforms.push_back(localTransform);
+  worldTransforms.push_back(glm::mat4(1.0f));
+  localBounds.push_back(glm::vec4(0.0f));
+  worldBounds.push_back(glm::vec4(0.0f));
+  meshes.push_back(0);
+  materials.push_back(0);
+  currentLods.push_back(0);
+  localDirty.push_back(1);
+  worldChanged.push_back(0);
+  pendingWrites.push_back(0);
+
+  uint32_t handle = static_cast<uint32_t>(nodeIndices.size());
+  nodeHandles.push_back(handle);
+  nodeIndices.push_back(index);
+  return handle;
+}
+
+void Scene::setLocalTransform(uint32_t node, const glm::mat4 &localTransform) {
+  uint32_t index = nodeIndices[node];
+  localTransforms[index] = localTransform;
+  localDirty[index] = 1;
+}
+
+void Scene::setBounds(uint32_t node, const glm::vec3 &center, float radius) {
+  uint32_t index = nodeIndices[node];
+  localBounds[index] = glm::vec4(center, radius);
+  localDirty[index] = 1;
+}
+
+void Scene::setMesh(uint32_t node, uint32_t mesh) {
+  meshes[nodeIndices[node]] = mesh;
+}
+
+void Scene::setMaterial(uint32_t node, uint32_t material) {
+  materials[nodeIndices[node]] = material;
+}
+
+void Scene::sortByDepth() {
+  const size_t count = parents.size();
+  uint32_t levelCount = 0;
+  for (uint32_t depth : depths) {
+    levelCount = std::max(levelCount, depth + 1);
+  }
+
+  // Counting sort; stable, so siblings keep their insertion order
+  levelOffsets.assign(levelCount + 1, 0);
+  for (uint32_t depth : depths) {
+    levelOffsets[depth + 1]++;
+  }
+  for (uint32_t level = 0; level < levelCount; level++) {
+    levelOffsets[level + 1] += levelOffsets[level];
+  }
+
+  // Nodes appended in depth order need no reordering
+  if (std::is_sorted(depths.begin(), depths.end()))
+    return;
+
+  std::vector<uint32_t> order(count);
+  std::vector<uint32_t> fill(levelOffsets.begin(), levelOffsets.end() - 1);
+  for (size_t i = 0; i < count; i++) {
+    order[fill[depths[i]]++] = static_cast<uint32_t>(i);
+  }
+
+  std::vector<uint32_t> newIndices(count);
+  for (size_t i = 0; i < count; i++) {
+    newIndices[order[i]] = static_cast<uint32_t>(i);
+  }
+
+  permute(parents, order);
+  permute(depths, order);
+  permute(localTransforms, order);
+  permute(worldTransforms, order);
+  permute(localBounds, order);
+  permute(worldBounds, order);
+  permute(meshes, order);
+  permute(materials, order);
+  permute(currentLods, order);
+  permute(nodeHandles, order);
+
+  for (size_t i = 0; i < count; i++) {
+    if (parents[i] != kNoParent) {
+      parents[i] = newIndices[parents[i]];
+    }
+    nodeIndices[nodeHandles[i]] = static_cast<uint32_t>(i);
+  }
+
+  // Instance indices moved, so everything is rewritten
+  std::fill(localDirty.begin(), localDirty.end(), 1);
+}
+
+void Scene::update(uint32_t frameIndex, ThreadPool *threadPool,
+                   FrustumCuller *culler) {
+  if (hierarchyDirty) {
+    sortByDepth();
+    hierarchyDirty = false;
+  }
+  if (culler && culler->getObjectCount() != getNodeCount()) {
+    culler->resize(getNodeCount());
+  }
+
+  InstanceData *instances = nullptr;
+  if (mappedInstances) {
+    instances = mappedInstances + size_t(frameIndex) * maxInstances;
+  }
+
+  // Levels run in order; nodes within a level are independent
+  for (size_t level = 0; level + 1 < levelOffsets.size(); level++) {
+    size_t levelBegin = levelOffsets[level];
+    size_t levelSize = levelOffsets[level + 1] - levelBegin;
+
+    auto job = [&](size_t begin, size_t end) {
+      updateRange(levelBegin + begin, levelBegin + end, instances, culler);
+    };
+    if (threadPool) {
+      threadPool->parallelFor(levelSize, kChunkSize, job);
+    } else {
+      job(0, levelSize);
+    }
+  }
+}
+
+void Scene::updateRange(size_t begin, size_t end, InstanceData *instances,
+                        FrustumCuller *culler) {
+  for (size_t i = begin; i < end; i++) {
+    uint32_t parent = parents[i];
+    bool changed =
+        localDirty[i] || (parent != kNoParent && worldChanged[parent]);
+    worldChanged[i] = changed;
+
+    if (changed) {
+      localDirty[i] = 0;
+      worldTransforms[i] = parent == kNoParent
+                               ? localTransforms[i]
+                               : worldTransforms[parent] * localTransforms[i];
+
+      // The sphere scales with the largest axis of the transform
+      const glm::mat4 &world = worldTransforms[i];
+      glm::vec3 center =
+          glm::vec3(world * glm::vec4(glm::vec3(localBounds[i]), 1.0f));
+      float scale = std::max({glm::length(glm::vec3(world[0])),
+                              glm::length(glm::vec3(world[1])),
+                              glm::length(glm::vec3(world[2]))});
+      worldBounds[i] = glm::vec4(center, localBounds[i].w * scale);
+
+      if (culler) {
+        culler->setSphere(static_cast<uint32_t>(i), center,
+                          worldBounds[i].w);
+      }
+      pendingWrites[i] = static_cast<uint8_t>(framesInFlight);
+    }
+
+    if (instances && pendingWrites[i] > 0) {
+      std::memcpy(instances[i].model, &worldTransforms[i][0][0],
+                  sizeof(InstanceData));
+      pendingWrites[i]--;
+    }
+  }
+}
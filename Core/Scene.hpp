@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "FrustumCuller.hpp"
+#include "ThreadPool.hpp"
+#include "Types.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Data-oriented scene storage. Node data lives in structure-of-arrays pools
+// sorted by hierarchy depth, so world transforms are recomputed level by
+// level with every parent finished before its children, and a node's pool
+// index doubles as its GPU instance index. Nodes are referred to by stable
+// handles; pool indices change whenever the hierarchy is re-sorted
+class Scene {
+
+public:
+  static constexpr uint32_t kNoParent = UINT32_MAX;
+
+  // Host-visible instance buffer with one region per frame in flight
+  void createInstanceBuffer(VulkanContext &context, uint32_t maxNodes,
+                            uint32_t framesInFlight);
+  void cleanup(VkDevice device);
+
+  // Parents must be added before their children
+  uint32_t addNode(uint32_t parent = kNoParent,
+                   const glm::mat4 &localTransform = glm::mat4(1.0f));
+  void setLocalTransform(uint32_t node, const glm::mat4 &localTransform);
+  // Object-space bounding sphere
+  void setBounds(uint32_t node, const glm::vec3 &center, float radius);
+  void setMesh(uint32_t node, uint32_t mesh);
+  void setMaterial(uint32_t node, uint32_t material);
+
+  // Recomputes dirty world transforms and bounds, writes them to this
+  // frame's instance region and to culler (indexed by instance). The
+  // frame's previous GPU work must have completed
+  void update(uint32_t frameIndex, ThreadPool *threadPool = nullptr,
+              FrustumCuller *culler = nullptr);
+
+  uint32_t getNodeCount() const {
+    return static_cast<uint32_t>(parents.size());
+  }
+  // Valid until the next update that re-sorts the hierarchy
+  uint32_t getInstanceIndex(uint32_t node) const { return nodeIndices[node]; }
+
+  // Accessors by instance index, for the draw recorder
+  const glm::mat4 &getWorldTransform(uint32_t instance) const {
+    return worldTransforms[instance];
+  }
+  // World-space sphere: xyz center, w radius
+  const glm::vec4 &getWorldBounds(uint32_t instance) const {
+    return worldBounds[instance];
+  }
+  uint32_t getMesh(uint32_t instance) const { return meshes[instance]; }
+  uint32_t getMaterial(uint32_t instance) const {
+    return materials[instance];
+  }
+  // LOD the instance was last drawn with, kept for LodSelector::select's
+  // hysteresis
+  uint32_t &getCurrentLod(uint32_t instance) { return currentLods[instance]; }
+
+  VkBuffer getInstanceBuffer() const { return instanceBuffer.getBuffer(); }
+  VkDeviceSize getInstanceBufferOffset(uint32_t frameIndex) const {
+    return VkDeviceSize(frameIndex) * maxInstances * sizeof(InstanceData);
+  }
+
+private:
+  static constexpr size_t kChunkSize = 1024;
+
+  // Pools, indexed by depth-sorted instance index
+  std::vector<uint32_t> parents; // instance index or kNoParent
+  std::vector<uint32_t> depths;
+  std::vector<glm::mat4> localTransforms;
+  std::vector<glm::mat4> worldTransforms;
+  std::vector<glm::vec4> localBounds;
+  std::vector<glm::vec4> worldBounds;
+  std::vector<uint32_t> meshes;
+  std::vector<uint32_t> materials;
+  std::vector<uint32_t> currentLods;
+  std::vector<uint8_t> localDirty;
+  std::vector<uint8_t> worldChanged;
+  // Instance regions that still hold an outdated transform
+  std::vector<uint8_t> pendingWrites;
+  std::vector<uint32_t> nodeHandles;
+
+  std::vector<uint32_t> nodeIndices; // handle -> instance index
+  std::vector<uint32_t> levelOffsets;
+  bool hierarchyDirty = false;
+
+  Buffer instanceBuffer;
+  InstanceData *mappedInstances = nullptr;
+  uint32_t maxInstances = 0;
+  uint32_t framesInFlight = 1;
+
+  // Rebuilds the level ranges, re-sorting the pools if needed
+  void sortByDepth();
+  void updateRange(size_t begin, size_t end, InstanceData *instances,
+                   FrustumCuller *culler);
+};
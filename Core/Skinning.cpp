@@ -0,0 +1,200 @@
+#include "Skinning.hpp"
+
+#include "Types.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Matches PushConstants in Shaders/skinning.comp
+struct SkinningConstants {
+  uint32_t vertexCount;
+  uint32_t jointCount;
+  uint32_t instanceCount;
+};
+
+// Instances per parallelFor chunk; each samples a whole skeleton
+static constexpr size_t kChunkSize = 4;
+
+void Skinning::create(VulkanContext &context, CommandPool &commandPool,
+                      const MeshData &data, uint32_t maxInstances,
+                      uint32_t framesInFlight,
+                      DescriptorLayoutCache &layoutCache,
+                      DescriptorAllocator &descriptors) {
+  if (data.skin.size() != data.vertices.size() ||
+      data.skeleton.getJointCount() == 0) {
+    throw std::runtime_error("Skinning needs skin weights and a skeleton!");
+  }
+
+  VkDevice device = context.getDevice();
+  skeleton = data.skeleton;
+  clips = data.clips;
+  if (clips.empty()) {
+    // A single frame of the bind pose
+    clips.emplace_back();
+    clips.back().create("Bind pose", 0.0f, skeleton);
+  }
+  vertexCount = static_cast<uint32_t>(data.vertices.size());
+  this->maxInstances = maxInstances;
+
+  std::vector<uint32_t> queueFamilies = {
+      context.getGraphicsQueueFamilyIndex(),
+      context.getComputeQueueFamilyIndex()};
+
+  bindPose.createDeviceLocal(context, commandPool, data.vertices.data(),
+                             sizeof(Vertex) * data.vertices.size(),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             queueFamilies);
+  skin.createDeviceLocal(context, commandPool, data.skin.data(),
+                         sizeof(VertexSkin) * data.skin.size(),
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueFamilies);
+
+  InstanceData identity{};
+  for (int i = 0; i < 4; i++) {
+    identity.model[i * 5] = 1.0f;
+  }
+  identityInstance.createDeviceLocal(context, commandPool, &identity,
+                                     sizeof(identity),
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+  VkDeviceSize paletteSize =
+      VkDeviceSize(maxInstances) * getJointCount() * sizeof(glm::mat4);
+  VkDeviceSize skinnedSize =
+      VkDeviceSize(maxInstances) * vertexCount * sizeof(Vertex);
+
+  frames.resize(framesInFlight);
+  for (Frame &frame : frames) {
+    frame.palettes.create(context, paletteSize,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          queueFamilies);
+    void *mapped;
+    if (vkMapMemory(device, frame.palettes.getMemory(), 0, paletteSize, 0,
+                    &mapped) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map joint palettes!");
+    }
+    frame.mappedPalettes = static_cast<glm::mat4 *>(mapped);
+
+    frame.skinned.create(context, skinnedSize,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilies);
+  }
+
+  createDescriptors(device, layoutCache, descriptors);
+  skinPipeline.create(device, "Shaders/skinning.comp.spv",
+                      {descriptorSetLayout}, sizeof(SkinningConstants));
+}
+
+void Skinning::createDescriptors(VkDevice device,
+                                 DescriptorLayoutCache &layoutCache,
+                                 DescriptorAllocator &descriptors) {
+  std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+  for (uint32_t i = 0; i < 4; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  descriptorSetLayout = layoutCache.getLayout(bindings);
+
+  for (Frame &frame : frames) {
+    frame.descriptorSet = descriptors.allocate(descriptorSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[4] = {
+        {bindPose.getBuffer(), 0, VK_WHOLE_SIZE},
+        {skin.getBuffer(), 0, VK_WHOLE_SIZE},
+        {frame.palettes.getBuffer(), 0, VK_WHOLE_SIZE},
+        {frame.skinned.getBuffer(), 0, VK_WHOLE_SIZE},
+    };
+
+    VkWriteDescriptorSet writes[4]{};
+    for (uint32_t binding = 0; binding < 4; binding++) {
+      writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[binding].dstSet = frame.descriptorSet;
+      writes[binding].dstBinding = binding;
+      writes[binding].descriptorCount = 1;
+      writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+  }
+}
+
+void Skinning::cleanup(VkDevice device) {
+  skinPipeline.cleanup(device);
+  descriptorSetLayout = VK_NULL_HANDLE;
+
+  for (Frame &frame : frames) {
+    if (frame.mappedPalettes) {
+      vkUnmapMemory(device, frame.palettes.getMemory());
+    }
+    frame.palettes.cleanup(device);
+    frame.skinned.cleanup(device);
+  }
+  frames.clear();
+  bindPose.cleanup(device);
+  skin.cleanup(device);
+  identityInstance.cleanup(device);
+}
+
+void Skinning::update(uint32_t frameIndex,
+                      const std::vector<SkinnedInstance> &instances,
+                      ThreadPool *threadPool) {
+  if (instances.size() > maxInstances) {
+    throw std::runtime_error("Too many skinned instances!");
+  }
+  Frame &frame = frames[frameIndex];
+  frame.instanceCount = static_cast<uint32_t>(instances.size());
+
+  uint32_t jointCount = getJointCount();
+  auto job = [&](size_t begin, size_t end) {
+    // Local transforms, then model-space ones
+    std::vector<glm::mat4> joints(jointCount);
+    for (size_t i = begin; i < end; i++) {
+      const SkinnedInstance &instance = instances[i];
+      const AnimationClip &clip =
+          clips[std::min<size_t>(instance.clip, clips.size() - 1)];
+      clip.sample(instance.time, true, joints.data());
+      skeleton.computePalette(joints.data(), instance.world,
+                              frame.mappedPalettes + i * jointCount);
+    }
+  };
+  if (threadPool) {
+    threadPool->parallelFor(instances.size(), kChunkSize, job);
+  } else {
+    job(0, instances.size());
+  }
+}
+
+void Skinning::recordSkinning(VkCommandBuffer commandBuffer,
+                              uint32_t frameIndex) const {
+  const Frame &frame = frames[frameIndex];
+  if (frame.instanceCount == 0)
+    return;
+
+  SkinningConstants constants{vertexCount, getJointCount(),
+                              frame.instanceCount};
+  skinPipeline.bind(commandBuffer);
+  skinPipeline.bindDescriptorSet(commandBuffer, frame.descriptorSet);
+  skinPipeline.pushConstants(commandBuffer, &constants, sizeof(constants));
+  vkCmdDispatch(commandBuffer,
+                ComputePipeline::groupCount(vertexCount, kGroupSize),
+                frame.instanceCount, 1);
+}
+
+void Skinning::draw(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                    const Mesh &mesh, uint32_t lod) const {
+  const Frame &frame = frames[frameIndex];
+  VkBuffer instanceBuffer = identityInstance.getBuffer();
+  VkDeviceSize instanceOffset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer,
+                         &instanceOffset);
+
+  // Each instance's vertices are a separate range of the output
+  for (uint32_t instance = 0; instance < frame.instanceCount; instance++) {
+    mesh.bind(commandBuffer, frame.skinned.getBuffer(),
+              VkDeviceSize(instance) * vertexCount * sizeof(Vertex));
+    mesh.draw(commandBuffer, lod);
+  }
+}
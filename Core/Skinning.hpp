@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Animation.hpp"
+#include "Buffer.hpp"
+#include "CommandPool.hpp"
+#include "ComputePipeline.hpp"
+#include "DescriptorAllocator.hpp"
+#include "Mesh.hpp"
+#include "MeshImporter.hpp"
+#include "ThreadPool.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One animated copy of a skinned mesh
+struct SkinnedInstance {
+  uint32_t clip = 0;
+  float time = 0.0f; // seconds; clips loop
+  glm::mat4 world{1.0f};
+};
+
+// GPU skinning of the instances of one mesh. Joint palettes are sampled on
+// the CPU every frame; a compute pass then skins each vertex of each
+// instance once, into a per-frame buffer in the vertex layout that every
+// pass draws as is. Palettes include the instance transforms, so skinned
+// vertices are in world space
+class Skinning {
+
+public:
+  static constexpr uint32_t kGroupSize = 64; // Shaders/skinning.comp
+
+  // data needs skin weights and a skeleton (MeshImportOptions::importSkin);
+  // without clips the instances hold the bind pose. Buffers are shared by
+  // the graphics and compute queue families, so skinning can run on
+  // either queue. Sets come from descriptors as in ClusteredLights
+  void create(VulkanContext &context, CommandPool &commandPool,
+              const MeshData &data, uint32_t maxInstances,
+              uint32_t framesInFlight, DescriptorLayoutCache &layoutCache,
+              DescriptorAllocator &descriptors);
+  void cleanup(VkDevice device);
+
+  // Samples the palettes of the frame's instances; the frame's fence must
+  // have signaled. Instances are spread over threadPool when given
+  void update(uint32_t frameIndex,
+              const std::vector<SkinnedInstance> &instances,
+              ThreadPool *threadPool = nullptr);
+
+  // Records skinning of the frame's instances. Submitted to another queue,
+  // the graphics submission must wait for it at the vertex input stage
+  void recordSkinning(VkCommandBuffer commandBuffer,
+                      uint32_t frameIndex) const;
+
+  // Draws one LOD of every skinned instance with mesh's index buffer,
+  // binding an identity instance transform; the pipeline must be bound
+  void draw(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+            const Mesh &mesh, uint32_t lod) const;
+
+  uint32_t getJointCount() const { return skeleton.getJointCount(); }
+  const std::vector<AnimationClip> &getClips() const { return clips; }
+
+private:
+  struct Frame {
+    Buffer palettes;
+    glm::mat4 *mappedPalettes = nullptr;
+    Buffer skinned;
+    uint32_t instanceCount = 0;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  };
+
+  Skeleton skeleton;
+  std::vector<AnimationClip> clips;
+  uint32_t vertexCount = 0;
+  uint32_t maxInstances = 0;
+
+  Buffer bindPose;         // storage copy of the mesh's vertices
+  Buffer skin;             // VertexSkin per vertex
+  Buffer identityInstance; // InstanceData for drawing world-space vertices
+  std::vector<Frame> frames;
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE; // cached
+  ComputePipeline skinPipeline;
+
+  void createDescriptors(VkDevice device, DescriptorLayoutCache &layoutCache,
+                         DescriptorAllocator &descriptors);
+};
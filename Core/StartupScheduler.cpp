@@ -0,0 +1,185 @@
+#include "StartupScheduler.hpp"
+
+#include "CpuProfiler.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+StartupScheduler::Stage
+StartupScheduler::addStage(const char *name, std::function<void()> work,
+                           const std::vector<Stage> &dependencies,
+                           bool deferred) {
+  Stage stage = static_cast<Stage>(stages.size());
+  StageInfo info;
+  info.name = name;
+  info.work = std::move(work);
+  info.deferred = deferred;
+
+  for (Stage dependency : dependencies) {
+    if (dependency >= stage) {
+      throw std::runtime_error("Startup stage depends on a later stage!");
+    }
+    StageInfo &other = stages[dependency];
+    if (other.deferred && !deferred) {
+      throw std::runtime_error("Startup stage depends on a deferred stage!");
+    }
+    // Stages of the earlier phase have finished by the time this one runs
+    if (other.deferred == deferred) {
+      other.dependents.push_back(stage);
+      info.dependencyCount++;
+    }
+  }
+  stages.push_back(std::move(info));
+  return stage;
+}
+
+void StartupScheduler::run(uint32_t helperThreads) {
+  PROFILE_ZONE("Startup");
+  runPhase(false, helperThreads);
+}
+
+void StartupScheduler::runDeferred(uint32_t helperThreads) {
+  PROFILE_ZONE("Deferred startup");
+  runPhase(true, helperThreads);
+}
+
+double StartupScheduler::getElapsedMs() const {
+  if (!started)
+    return 0.0;
+  return std::chrono::duration<double, std::milli>(Clock::now() - origin)
+      .count();
+}
+
+void StartupScheduler::runPhase(bool deferred, uint32_t helperThreads) {
+  if (!started) {
+    origin = Clock::now();
+    started = true;
+  }
+  Clock::time_point phaseBegin = Clock::now();
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<Stage> ready;
+  std::vector<uint32_t> remaining(stages.size());
+  size_t pendingCount = 0;
+  uint32_t runningCount = 0;
+  std::exception_ptr error;
+  const char *failedStage = nullptr;
+
+  for (Stage stage = 0; stage < stages.size(); stage++) {
+    if (stages[stage].deferred != deferred)
+      continue;
+    remaining[stage] = stages[stage].dependencyCount;
+    pendingCount++;
+    if (remaining[stage] == 0) {
+      ready.push_back(stage);
+    }
+  }
+  if (pendingCount == 0)
+    return;
+
+  auto worker = [&](uint32_t thread) {
+    if (thread > 0) {
+      PROFILE_THREAD("Startup");
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      condition.wait(lock, [&] {
+        return !ready.empty() || pendingCount == 0 ||
+               (error && runningCount == 0);
+      });
+      if (pendingCount == 0 || error)
+        return;
+
+      Stage stage = ready.front();
+      ready.pop_front();
+      runningCount++;
+      lock.unlock();
+
+      Clock::time_point begin = Clock::now();
+      std::exception_ptr stageError;
+      try {
+        PROFILE_ZONE(stages[stage].name);
+        stages[stage].work();
+      } catch (...) {
+        stageError = std::current_exception();
+      }
+      Clock::time_point end = Clock::now();
+
+      lock.lock();
+      runningCount--;
+      pendingCount--;
+      timings.push_back(
+          {stages[stage].name,
+           std::chrono::duration<double, std::milli>(begin - origin).count(),
+           std::chrono::duration<double, std::milli>(end - begin).count(),
+           thread, deferred});
+      if (stageError && !error) {
+        error = stageError;
+        failedStage = stages[stage].name;
+      }
+      for (Stage dependent : stages[stage].dependents) {
+        if (--remaining[dependent] == 0) {
+          ready.push_back(dependent);
+        }
+      }
+      condition.notify_all();
+    }
+  };
+
+  // A handful of stages at most can overlap, so a few threads are enough
+  if (helperThreads == 0) {
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    helperThreads = std::clamp(hardwareThreads, 2u, 4u) - 1;
+  }
+  helperThreads = std::min<uint32_t>(
+      helperThreads, static_cast<uint32_t>(pendingCount - 1));
+  std::vector<std::thread> helpers;
+  for (uint32_t i = 0; i < helperThreads; i++) {
+    helpers.emplace_back(worker, i + 1);
+  }
+  worker(0);
+  for (std::thread &helper : helpers) {
+    helper.join();
+  }
+
+  double phaseMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - phaseBegin)
+          .count();
+  (deferred ? deferredMs : immediateMs) = phaseMs;
+
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (const std::exception &e) {
+      throw std::runtime_error(std::string("Startup stage '") + failedStage +
+                               "' failed: " + e.what());
+    }
+  }
+}
+
+void StartupScheduler::logTimings() const {
+  std::vector<StageTiming> sorted = timings;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const StageTiming &a, const StageTiming &b) {
+                     return a.startMs < b.startMs;
+                   });
+
+  double busyMs = 0.0;
+  for (const StageTiming &timing : sorted) {
+    busyMs += timing.durationMs;
+    LOG_INFO("Startup %-26s at %8.2f ms, %8.2f ms on thread %u%s",
+             timing.name, timing.startMs, timing.durationMs, timing.thread,
+             timing.deferred ? " (deferred)" : "");
+  }
+  // Busy time above wall time is what running stages concurrently saved
+  LOG_INFO("Startup took %.2f ms (%.2f ms deferred) for %.2f ms of stages",
+           immediateMs, deferredMs, busyMs);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Named initialization stages, each started as soon as the stages it
+// depends on have finished. Independent stages run concurrently on a few
+// short-lived helper threads and the calling thread. Deferred stages are
+// held back until runDeferred, e.g. after the first frame, and may depend
+// on any earlier stage. Stages touching the same externally synchronized
+// Vulkan object (a command pool, a queue) must depend on one another.
+class StartupScheduler {
+
+public:
+  using Stage = uint32_t;
+
+  struct StageTiming {
+    const char *name;
+    double startMs; // since the first run
+    double durationMs;
+    uint32_t thread; // 0 is the calling thread
+    bool deferred;
+  };
+
+  // name must outlive the scheduler (a string literal). Dependencies must
+  // be stages added before this one
+  Stage addStage(const char *name, std::function<void()> work,
+                 const std::vector<Stage> &dependencies = {},
+                 bool deferred = false);
+
+  // Runs every stage that is not deferred, with up to helperThreads threads
+  // besides the caller (0 picks from the hardware). Once a stage throws no
+  // further stages start, and the first error is rethrown with the stage
+  // name after the running ones finish
+  void run(uint32_t helperThreads = 0);
+  // Runs the deferred stages the same way; run must have succeeded
+  void runDeferred(uint32_t helperThreads = 0);
+
+  const std::vector<StageTiming> &getTimings() const { return timings; }
+  // Milliseconds since the first run
+  double getElapsedMs() const;
+  // One line per finished stage in start order, then the totals
+  void logTimings() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct StageInfo {
+    const char *name;
+    std::function<void()> work;
+    std::vector<Stage> dependents;
+    uint32_t dependencyCount = 0; // within the same phase
+    bool deferred = false;
+  };
+
+  std::vector<StageInfo> stages;
+  std::vector<StageTiming> timings;
+  Clock::time_point origin;
+  bool started = false;
+  double immediateMs = 0.0; // wall time of run
+  double deferredMs = 0.0;  // wall time of runDeferred
+
+  void runPhase(bool deferred, uint32_t helperThreads);
+};
@@ -1,4 +1,6 @@
 #include "Swapchain.hpp"
+#include "Image.hpp"
+#include "ResourceCache.hpp"
 #include "VulkanContext.hpp"
 #include <stdexcept>
 
@@ -68,7 +70,9 @@ static VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &caps,
 }
 
 void Swapchain::create(VulkanContext &context, VkSurfaceKHR surface,
-                       uint32_t width, uint32_t height) {
+                       uint32_t width, uint32_t height,
+                       ResourceCache *cache, VkImageUsageFlags extraUsage) {
+  this->cache = cache;
   auto support = querySwapchainSupport(context.getPhysicalDevice(), surface);
   auto surfaceFormat = chooseSwapSurfaceFormat(support.formats);
   auto presentMode = chooseSwapPresentMode(support.presentModes);
@@ -88,7 +92,11 @@ void Swapchain::create(VulkanContext &context, VkSurfaceKHR surface,
   createInfo.imageColorSpace = surfaceFormat.colorSpace;
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
-  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  // Extra usage, e.g. storage writes by an upscaler, only where supported
+  extraUsage &= support.capabilities.supportedUsageFlags;
+  extraUsage = Image::supportedUsage(context, surfaceFormat.format, extraUsage);
+  imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | extraUsage;
+  createInfo.imageUsage = imageUsage;
 
   uint32_t queueFamilyIndices[] = {context.getGraphicsQueueFamilyIndex(),
                                    context.getGraphicsQueueFamilyIndex()};
@@ -115,6 +123,7 @@ void Swapchain::create(VulkanContext &context, VkSurfaceKHR surface,
   swapchainFormat = surfaceFormat.format;
   swapchainExtent = extent;
 
+  swapchainImages = images;
   createImageViews(device, images);
 }
 
@@ -135,6 +144,10 @@ void Swapchain::createImageViews(VkDevice device,
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
+    if (cache) {
+      swapchainImageViews[i] = cache->acquireImageView(viewInfo);
+      continue;
+    }
     if (vkCreateImageView(device, &viewInfo, nullptr,
                           &swapchainImageViews[i]) != VK_SUCCESS) {
       throw std::runtime_error(
@@ -145,8 +158,20 @@ void Swapchain::createImageViews(VkDevice device,
 
 void Swapchain::cleanup(VkDevice device) {
   for (auto iv : swapchainImageViews) {
-    vkDestroyImageView(device, iv, nullptr);
+    if (cache) {
+      cache->release(iv);
+    } else {
+      vkDestroyImageView(device, iv, nullptr);
+    }
+  }
+  swapchainImageViews.clear();
+  // The images go with the swapchain, and their handles may be reused
+  if (cache) {
+    for (VkImage image : swapchainImages) {
+      cache->forgetImage(image);
+    }
   }
+  swapchainImages.clear();
   if (swapchain) {
     vkDestroySwapchainKHR(device, swapchain, nullptr);
   }
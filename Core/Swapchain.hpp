@@ -4,18 +4,25 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 
+class ResourceCache; // forward declaration
 class VulkanContext; // forward declaration
 
 class Swapchain {
 
 public:
+  // With a cache the image views come from it, and are forgotten when the
+  // swapchain is destroyed. Images are color attachments plus the bits of
+  // extraUsage the surface and format support; see getUsage
   void create(VulkanContext &context, VkSurfaceKHR surface, uint32_t width,
-              uint32_t height);
+              uint32_t height, ResourceCache *cache = nullptr,
+              VkImageUsageFlags extraUsage = 0);
   void cleanup(VkDevice device);
 
   VkFormat getFormat() const { return swapchainFormat; }
   VkExtent2D getExtent() const { return swapchainExtent; }
   VkSwapchainKHR getSwapchain() const { return swapchain; }
+  VkImageUsageFlags getUsage() const { return imageUsage; }
+  const std::vector<VkImage> &getImages() const { return swapchainImages; }
   const std::vector<VkImageView> &getImageViews() const {
     return swapchainImageViews;
   }
@@ -24,7 +31,10 @@ private:
   VkSwapchainKHR swapchain = VK_NULL_HANDLE;
   VkFormat swapchainFormat;
   VkExtent2D swapchainExtent;
+  VkImageUsageFlags imageUsage = 0;
+  std::vector<VkImage> swapchainImages;
   std::vector<VkImageView> swapchainImageViews;
+  ResourceCache *cache = nullptr;
 
   void createImageViews(VkDevice device, const std::vector<VkImage> &images);
 };
\ No newline at end of file
@@ -19,8 +19,14 @@ public:
     VkFence& inFlightFence(uint32_t index) { return inFlightFences[index]; }
     const VkFence& inFlightFence(uint32_t index) const { return inFlightFences[index]; }
 
+    // Signaled by a frame's async compute submission, waited on by its
+    // graphics submission at the stages consuming the results
+    VkSemaphore& computeSemaphore(uint32_t index) { return computeFinishedSemaphores[index]; }
+    const VkSemaphore& computeSemaphore(uint32_t index) const { return computeFinishedSemaphores[index]; }
+
 private:
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
   std::vector<VkFence> inFlightFences;
+  std::vector<VkSemaphore> computeFinishedSemaphores;
 };
\ No newline at end of file
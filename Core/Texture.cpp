@@ -0,0 +1,316 @@
+#include "Texture.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// Levels at or below this size form the mip tail, which is never evicted
+static constexpr uint32_t kMipTailSize = 64;
+
+// Copy offsets must be a multiple of the block size (8 or 16 bytes)
+static constexpr VkDeviceSize kStagingAlignment = 16;
+
+static VkDeviceSize alignStaging(VkDeviceSize offset) {
+  return (offset + kStagingAlignment - 1) & ~(kStagingAlignment - 1);
+}
+
+// Every family that may copy or sample textures
+static std::vector<uint32_t> getQueueFamilies(const VulkanContext &context) {
+  std::vector<uint32_t> families = {context.getGraphicsQueueFamilyIndex(),
+                                    context.getComputeQueueFamilyIndex(),
+                                    context.getTransferQueueFamilyIndex()};
+  std::sort(families.begin(), families.end());
+  families.erase(std::unique(families.begin(), families.end()),
+                 families.end());
+  return families;
+}
+
+void Texture::create(VulkanContext &context, CommandPool &commandPool,
+                     const std::string &filename) {
+  file = TextureFile::open(filename);
+
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(context.getPhysicalDevice(),
+                                      file.getFormat(), &formatProperties);
+  if (!(formatProperties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+    throw std::runtime_error("Texture format not supported by the device: " +
+                             filename);
+  }
+
+  // Nothing is resident yet
+  firstResidentMip = file.getLevelCount();
+
+  // Memory of every resident range, for budgeting before it is created
+  std::vector<uint32_t> families = getQueueFamilies(context);
+  allocationSizes.assign(file.getLevelCount() + 1, 0);
+  for (uint32_t mip = 0; mip < file.getLevelCount(); mip++) {
+    VkImageCreateInfo imageInfo = getImageInfo(mip, families);
+    VkImage image;
+    if (vkCreateImage(context.getDevice(), &imageInfo, nullptr, &image) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to create texture image!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(context.getDevice(), image,
+                                 &memRequirements);
+    vkDestroyImage(context.getDevice(), image, nullptr);
+    allocationSizes[mip] = memRequirements.size;
+  }
+
+  uint32_t tailStart = getMipTailStart();
+  VkDeviceSize stagingSize = getStagingSize(tailStart);
+
+  Buffer staging;
+  staging.create(context, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  void *stagingData;
+  vkMapMemory(context.getDevice(), staging.getMemory(), 0, stagingSize, 0,
+              &stagingData);
+
+  VkCommandBuffer commandBuffer =
+      commandPool.beginSingleTimeCommands(context.getDevice());
+  VkDeviceSize stagingOffset = 0;
+  TextureAllocation tail =
+      changeResidency(context, commandBuffer, tailStart, staging,
+                      static_cast<char *>(stagingData), stagingOffset,
+                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  commandPool.endSingleTimeCommands(context.getDevice(),
+                                    context.getGraphicsQueue(), commandBuffer);
+  commitResidency(tail, tailStart);
+
+  vkUnmapMemory(context.getDevice(), staging.getMemory());
+  staging.cleanup(context.getDevice());
+}
+
+void Texture::cleanup(VkDevice device) {
+  destroyAllocation(device, allocation);
+  firstResidentMip = file.getLevelCount();
+}
+
+uint32_t Texture::getMipTailStart() const {
+  for (uint32_t level = 0; level < file.getLevelCount(); level++) {
+    const TextureLevel &info = file.getLevel(level);
+    if (std::max(info.width, info.height) <= kMipTailSize)
+      return level;
+  }
+  return file.getLevelCount() - 1;
+}
+
+VkDeviceSize Texture::getStagingSize(uint32_t newFirstMip) const {
+  VkDeviceSize size = 0;
+  for (uint32_t level = newFirstMip; level < firstResidentMip; level++) {
+    size = alignStaging(size) + file.getLevel(level).size;
+  }
+  return size;
+}
+
+VkImageCreateInfo
+Texture::getImageInfo(uint32_t firstMip,
+                      const std::vector<uint32_t> &families) const {
+  const TextureLevel &top = file.getLevel(firstMip);
+
+  VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = file.getFormat();
+  imageInfo.extent = {top.width, top.height, 1};
+  imageInfo.mipLevels = file.getLevelCount() - firstMip;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (families.size() > 1) {
+    imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+    imageInfo.pQueueFamilyIndices = families.data();
+  }
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  return imageInfo;
+}
+
+TextureAllocation Texture::createAllocation(VulkanContext &context,
+                                            uint32_t firstMip) {
+  VkDevice device = context.getDevice();
+  TextureAllocation result;
+
+  std::vector<uint32_t> families = getQueueFamilies(context);
+  VkImageCreateInfo imageInfo = getImageInfo(firstMip, families);
+  if (vkCreateImage(device, &imageInfo, nullptr, &result.image) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture image!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, result.image, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+      Buffer::findMemoryType(context, memRequirements.memoryTypeBits,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate texture memory!");
+  }
+  vkBindImageMemory(device, result.image, result.memory, 0);
+  result.size = memRequirements.size;
+
+  VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  viewInfo.image = result.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = file.getFormat();
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = imageInfo.mipLevels;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &result.view) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture image view!");
+  }
+
+  return result;
+}
+
+TextureAllocation Texture::changeResidency(VulkanContext &context,
+                                           VkCommandBuffer commandBuffer,
+                                           uint32_t newFirstMip,
+                                           const Buffer &staging,
+                                           char *stagingData,
+                                           VkDeviceSize &stagingOffset,
+                                           VkPipelineStageFlags readStages) {
+  const uint32_t levelCount = file.getLevelCount();
+  const uint32_t oldFirstMip = firstResidentMip;
+  const TextureAllocation &previous = allocation;
+
+  TextureAllocation next = createAllocation(context, newFirstMip);
+
+  // Only the new image changes layout; the previous one is read in kLayout,
+  // its writes made visible to the copy
+  VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+
+  barrier.image = next.image;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  VkMemoryBarrier previousBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  previousBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &previousBarrier,
+                       0, nullptr, 1, &barrier);
+
+  // Levels that stay resident are copied on the GPU
+  if (previous.image != VK_NULL_HANDLE) {
+    std::vector<VkImageCopy> copies;
+    for (uint32_t level = std::max(newFirstMip, oldFirstMip);
+         level < levelCount; level++) {
+      const TextureLevel &info = file.getLevel(level);
+
+      VkImageCopy copy{};
+      copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - oldFirstMip,
+                             0, 1};
+      copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - newFirstMip,
+                             0, 1};
+      copy.extent = {info.width, info.height, 1};
+      copies.push_back(copy);
+    }
+
+    vkCmdCopyImage(commandBuffer, previous.image, kLayout, next.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   static_cast<uint32_t>(copies.size()), copies.data());
+  }
+
+  // Levels that were not resident are streamed in from the file
+  std::vector<VkBufferImageCopy> uploads;
+  for (uint32_t level = newFirstMip; level < std::min(oldFirstMip, levelCount);
+       level++) {
+    const TextureLevel &info = file.getLevel(level);
+    stagingOffset = alignStaging(stagingOffset);
+    file.readLevel(level, stagingData + stagingOffset);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = stagingOffset;
+    region.bufferRowLength = 0; // Tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - newFirstMip,
+                               0, 1};
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {info.width, info.height, 1};
+    uploads.push_back(region);
+
+    stagingOffset += info.size;
+  }
+
+  if (!uploads.empty()) {
+    vkCmdCopyBufferToImage(commandBuffer, staging.getBuffer(), next.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(uploads.size()),
+                           uploads.data());
+  }
+
+  // Without shader stages the writes are only made available here, and
+  // recordAcquire makes them visible where they are read
+  bool visible = readStages != VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = kLayout;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = visible ? VK_ACCESS_SHADER_READ_BIT : 0;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       readStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+  return next;
+}
+
+void Texture::recordAcquire(VkCommandBuffer commandBuffer,
+                            VkPipelineStageFlags readStages) {
+  // The fence wait before this submission orders it after the writes
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       readStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+TextureAllocation
+Texture::commitResidency(const TextureAllocation &newAllocation,
+                         uint32_t newFirstMip) {
+  TextureAllocation previous = allocation;
+  allocation = newAllocation;
+  firstResidentMip = newFirstMip;
+  return previous;
+}
+
+void Texture::destroyAllocation(VkDevice device,
+                                TextureAllocation &allocation) {
+  if (allocation.view != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, allocation.view, nullptr);
+  }
+  if (allocation.image != VK_NULL_HANDLE) {
+    vkDestroyImage(device, allocation.image, nullptr);
+  }
+  if (allocation.memory != VK_NULL_HANDLE) {
+    vkFreeMemory(device, allocation.memory, nullptr);
+  }
+  allocation = {};
+}
+
+void Texture::destroyAllocation(DeletionQueue &deletionQueue,
+                                TextureAllocation &allocation) {
+  deletionQueue.destroy(allocation.view);
+  deletionQueue.destroy(allocation.image);
+  deletionQueue.destroy(allocation.memory);
+  allocation = {};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "CommandPool.hpp"
+#include "DeletionQueue.hpp"
+#include "TextureFile.hpp"
+#include "VulkanContext.hpp"
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Image, memory and view holding one resident mip range of a texture
+struct TextureAllocation {
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+};
+
+// A block-compressed texture of which only the levels
+// [firstResidentMip, levelCount) are in device memory. Changing the resident
+// range re-creates the image with the new level count, copying the levels
+// that stay resident and uploading new ones from the file. Images are
+// shared by the graphics, compute and transfer families and stay in
+// kLayout, so the copy can run on the transfer queue while frames still
+// sample the previous image
+class Texture {
+
+public:
+  static constexpr VkImageLayout kLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  // Opens a DDS/KTX2 file and uploads its mip tail through the staging path
+  void create(VulkanContext &context, CommandPool &commandPool,
+              const std::string &filename);
+  void cleanup(VkDevice device);
+
+  // Staging bytes needed to move the resident range to start at newFirstMip
+  VkDeviceSize getStagingSize(uint32_t newFirstMip) const;
+
+  // Device memory the image takes with levels [firstMip, levelCount)
+  // resident, as the driver reports it
+  VkDeviceSize getAllocationSize(uint32_t firstMip) const {
+    return allocationSizes[firstMip];
+  }
+
+  // Records filling a new image with [newFirstMip, levelCount), on a queue
+  // of any family. Missing levels are read from the file into stagingData
+  // (the mapped staging buffer) starting at stagingOffset, which is
+  // advanced. The texture keeps its current image until commitResidency is
+  // called with the returned one, once commandBuffer has completed. The
+  // writes are made visible to shader reads at readStages, which must be
+  // supported by commandBuffer's queue. Other queues pass
+  // VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, and the reading queue records
+  // recordAcquire before its first read
+  TextureAllocation changeResidency(VulkanContext &context,
+                                    VkCommandBuffer commandBuffer,
+                                    uint32_t newFirstMip,
+                                    const Buffer &staging, char *stagingData,
+                                    VkDeviceSize &stagingOffset,
+                                    VkPipelineStageFlags readStages);
+  // Makes images filled on another queue, whose submission has completed,
+  // visible to shader reads at readStages. Sharing is concurrent, so no
+  // ownership is transferred
+  static void recordAcquire(VkCommandBuffer commandBuffer,
+                            VkPipelineStageFlags readStages);
+  // Switches to an image filled by changeResidency. Returns the previous
+  // allocation, which frames in flight may still be sampling
+  TextureAllocation commitResidency(const TextureAllocation &newAllocation,
+                                    uint32_t newFirstMip);
+
+  static void destroyAllocation(VkDevice device,
+                                TextureAllocation &allocation);
+  // Destroys the allocation once the GPU is done with it
+  static void destroyAllocation(DeletionQueue &deletionQueue,
+                                TextureAllocation &allocation);
+
+  // First level of the mip tail, which always stays resident
+  uint32_t getMipTailStart() const;
+
+  VkImageView getImageView() const { return allocation.view; }
+  VkFormat getFormat() const { return file.getFormat(); }
+  uint32_t getFirstResidentMip() const { return firstResidentMip; }
+  uint32_t getLevelCount() const { return file.getLevelCount(); }
+  VkDeviceSize getMemorySize() const { return allocation.size; }
+  const TextureFile &getFile() const { return file; }
+
+private:
+  TextureFile file;
+  TextureAllocation allocation;
+  uint32_t firstResidentMip = 0;
+  std::vector<VkDeviceSize> allocationSizes; // by first resident level
+
+  VkImageCreateInfo getImageInfo(uint32_t firstMip,
+                                 const std::vector<uint32_t> &families) const;
+  TextureAllocation createAllocation(VulkanContext &context,
+                                     uint32_t firstMip);
+};
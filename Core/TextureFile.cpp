@@ -0,0 +1,252 @@
+#include "TextureFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static constexpr uint32_t kDdsMagic = 0x20534444; // "DDS "
+static constexpr size_t kDdsHeaderSize = 4 + 124;
+static constexpr size_t kDdsDx10HeaderSize = 20;
+static constexpr uint32_t kDdsCaps2Cubemap = 0x200;
+static constexpr uint32_t kDdsCaps2Volume = 0x200000;
+
+static const uint8_t kKtx2Identifier[12] = {0xAB, 'K',  'T',  'X',
+                                            ' ',  '2',  '0',  0xBB,
+                                            '\r', '\n', 0x1A, '\n'};
+static constexpr size_t kKtx2HeaderSize = 80;
+static constexpr size_t kKtx2LevelIndexEntrySize = 24;
+
+// Large enough for any header we parse, including a full KTX2 level index
+static constexpr size_t kMaxHeaderSize =
+    kKtx2HeaderSize + 16 * kKtx2LevelIndexEntrySize;
+
+static uint32_t fourCC(char a, char b, char c, char d) {
+  return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) |
+         (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+static uint32_t readU32(const std::vector<char> &data, size_t offset) {
+  if (offset + 4 > data.size())
+    throw std::runtime_error("Truncated texture header!");
+  uint32_t value;
+  memcpy(&value, data.data() + offset, 4);
+  return value;
+}
+
+static uint64_t readU64(const std::vector<char> &data, size_t offset) {
+  if (offset + 8 > data.size())
+    throw std::runtime_error("Truncated texture header!");
+  uint64_t value;
+  memcpy(&value, data.data() + offset, 8);
+  return value;
+}
+
+// Levels of a full mip chain down to 1x1
+static uint32_t fullMipCount(uint32_t width, uint32_t height) {
+  uint32_t count = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+    count++;
+  }
+  return count;
+}
+
+static VkFormat formatFromDxgi(uint32_t dxgiFormat) {
+  switch (dxgiFormat) {
+  case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+  case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+  case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+  case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+  case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+  case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+  case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+  case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+  case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+  case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+  case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+  case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+  case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+  default: return VK_FORMAT_UNDEFINED;
+  }
+}
+
+static VkFormat formatFromFourCC(uint32_t code) {
+  if (code == fourCC('D', 'X', 'T', '1'))
+    return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  if (code == fourCC('D', 'X', 'T', '2') || code == fourCC('D', 'X', 'T', '3'))
+    return VK_FORMAT_BC2_UNORM_BLOCK;
+  if (code == fourCC('D', 'X', 'T', '4') || code == fourCC('D', 'X', 'T', '5'))
+    return VK_FORMAT_BC3_UNORM_BLOCK;
+  if (code == fourCC('A', 'T', 'I', '1') || code == fourCC('B', 'C', '4', 'U'))
+    return VK_FORMAT_BC4_UNORM_BLOCK;
+  if (code == fourCC('B', 'C', '4', 'S'))
+    return VK_FORMAT_BC4_SNORM_BLOCK;
+  if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U'))
+    return VK_FORMAT_BC5_UNORM_BLOCK;
+  if (code == fourCC('B', 'C', '5', 'S'))
+    return VK_FORMAT_BC5_SNORM_BLOCK;
+  return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t TextureFile::getBlockSize(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+  case VK_FORMAT_BC4_UNORM_BLOCK:
+  case VK_FORMAT_BC4_SNORM_BLOCK:
+    return 8;
+  case VK_FORMAT_BC2_UNORM_BLOCK:
+  case VK_FORMAT_BC2_SRGB_BLOCK:
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+  case VK_FORMAT_BC5_UNORM_BLOCK:
+  case VK_FORMAT_BC5_SNORM_BLOCK:
+  case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+  case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+TextureFile TextureFile::open(const std::string &filename) {
+  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Failed to open texture file: " + filename);
+
+  uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+  std::vector<char> header(
+      static_cast<size_t>(std::min<uint64_t>(fileSize, kMaxHeaderSize)));
+  file.seekg(0);
+  file.read(header.data(), header.size());
+
+  TextureFile texture;
+  texture.filename = filename;
+
+  if (header.size() >= sizeof(kKtx2Identifier) &&
+      memcmp(header.data(), kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+    texture.parseKtx2(header);
+  } else if (header.size() >= 4 && readU32(header, 0) == kDdsMagic) {
+    texture.parseDds(header);
+  } else {
+    throw std::runtime_error("Unknown texture container: " + filename);
+  }
+
+  if (getBlockSize(texture.format) == 0) {
+    throw std::runtime_error("Texture is not block-compressed: " + filename);
+  }
+  for (const TextureLevel &level : texture.levels) {
+    if (level.offset + level.size > fileSize) {
+      throw std::runtime_error("Truncated texture file: " + filename);
+    }
+  }
+  return texture;
+}
+
+void TextureFile::parseDds(const std::vector<char> &header) {
+  // DDS_HEADER follows the magic. Its DDS_PIXELFORMAT starts at byte 72,
+  // with the fourCC at 80
+  uint32_t height = readU32(header, 4 + 8);
+  uint32_t width = readU32(header, 4 + 12);
+  uint32_t depth = readU32(header, 4 + 20);
+  uint32_t mipCount = std::max(1u, readU32(header, 4 + 24));
+  uint32_t code = readU32(header, 4 + 80);
+  uint32_t caps2 = readU32(header, 4 + 108);
+
+  // Levels past 1x1 are never read; open() rejects levels past the file
+  if (width == 0 || height == 0) {
+    throw std::runtime_error("Empty DDS texture: " + filename);
+  }
+  mipCount = std::min(mipCount, fullMipCount(width, height));
+
+  if ((caps2 & (kDdsCaps2Cubemap | kDdsCaps2Volume)) != 0 || depth > 1) {
+    throw std::runtime_error("Cube maps and volume DDS files are not "
+                             "supported: " + filename);
+  }
+
+  uint64_t offset = kDdsHeaderSize;
+  if (code == fourCC('D', 'X', '1', '0')) {
+    format = formatFromDxgi(readU32(header, kDdsHeaderSize));
+    uint32_t arraySize = readU32(header, kDdsHeaderSize + 12);
+    if (arraySize > 1) {
+      throw std::runtime_error("DDS texture arrays are not supported: " +
+                               filename);
+    }
+    offset += kDdsDx10HeaderSize;
+  } else {
+    format = formatFromFourCC(code);
+  }
+
+  if (format == VK_FORMAT_UNDEFINED)
+    return;
+
+  for (uint32_t level = 0; level < mipCount; level++) {
+    addLevel(offset, std::max(1u, width >> level),
+             std::max(1u, height >> level));
+    offset += levels.back().size;
+  }
+}
+
+void TextureFile::parseKtx2(const std::vector<char> &header) {
+  format = static_cast<VkFormat>(readU32(header, 12));
+  uint32_t width = readU32(header, 20);
+  uint32_t height = readU32(header, 24);
+  uint32_t depth = readU32(header, 28);
+  uint32_t layerCount = readU32(header, 32);
+  uint32_t faceCount = readU32(header, 36);
+  uint32_t levelCount = std::max(1u, readU32(header, 40));
+  uint32_t supercompression = readU32(header, 44);
+
+  if (supercompression != 0) {
+    throw std::runtime_error("Supercompressed KTX2 files are not supported: " +
+                             filename);
+  }
+  if (depth > 1 || layerCount > 1 || faceCount != 1) {
+    throw std::runtime_error("Only 2D KTX2 textures are supported: " +
+                             filename);
+  }
+  if (width == 0 || height == 0 ||
+      levelCount > fullMipCount(width, height)) {
+    throw std::runtime_error("Invalid KTX2 dimensions: " + filename);
+  }
+  if (getBlockSize(format) == 0)
+    return;
+
+  // The level index lists level 0 (the largest) first
+  for (uint32_t level = 0; level < levelCount; level++) {
+    size_t entry = kKtx2HeaderSize + level * kKtx2LevelIndexEntrySize;
+    uint64_t offset = readU64(header, entry);
+    addLevel(offset, std::max(1u, width >> level),
+             std::max(1u, height >> level));
+
+    if (readU64(header, entry + 8) != levels.back().size) {
+      throw std::runtime_error("Unexpected KTX2 level size: " + filename);
+    }
+  }
+}
+
+void TextureFile::addLevel(uint64_t offset, uint32_t width, uint32_t height) {
+  TextureLevel level;
+  level.offset = offset;
+  level.width = width;
+  level.height = height;
+  level.size = uint64_t((width + 3) / 4) * ((height + 3) / 4) *
+               getBlockSize(format);
+  levels.push_back(level);
+}
+
+void TextureFile::readLevel(uint32_t level, char *destination) const {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Failed to open texture file: " + filename);
+
+  file.seekg(static_cast<std::streamoff>(levels[level].offset));
+  file.read(destination, static_cast<std::streamsize>(levels[level].size));
+  if (!file)
+    throw std::runtime_error("Failed to read texture level: " + filename);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Location of one mip level inside a texture file
+struct TextureLevel {
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+// Header of a block-compressed (BC1-BC7) DDS or KTX2 file. Level data is
+// read on demand so only resident mips are ever held in memory
+class TextureFile {
+
+public:
+  // Parses the header and mip layout; throws on unsupported files
+  static TextureFile open(const std::string &filename);
+
+  // Reads one mip level's data into destination (getLevel(level).size bytes)
+  void readLevel(uint32_t level, char *destination) const;
+
+  VkFormat getFormat() const { return format; }
+  uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+  const TextureLevel &getLevel(uint32_t level) const { return levels[level]; }
+  const std::string &getFilename() const { return filename; }
+
+  // Returns the byte size of a 4x4 block, or 0 for non-BC formats
+  static uint32_t getBlockSize(VkFormat format);
+
+private:
+  std::string filename;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  std::vector<TextureLevel> levels;
+
+  void parseDds(const std::vector<char> &header);
+  void parseKtx2(const std::vector<char> &header);
+  void addLevel(uint64_t offset, uint32_t width, uint32_t height);
+};
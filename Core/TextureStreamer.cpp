@@ -0,0 +1,290 @@
+#include "TextureStreamer.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+void TextureStreamer::create(VulkanContext &context,
+                             DeletionQueue &deletionQueue,
+                             VkDeviceSize memoryBudget,
+                             VkDeviceSize uploadBudgetPerUpdate) {
+  VkDevice device = context.getDevice();
+  this->deletionQueue = &deletionQueue;
+  this->memoryBudget = memoryBudget;
+  uploadBudget = uploadBudgetPerUpdate;
+
+  commandPool.create(device, context.getTransferQueueFamilyIndex());
+  transferQueue = context.getTransferQueue();
+
+  VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  if (vkCreateFence(device, &fenceInfo, nullptr, &uploadFence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture upload fence!");
+  }
+
+  VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture sampler!");
+  }
+}
+
+void TextureStreamer::cleanup(VkDevice device) {
+  if (uploadPending) {
+    vkWaitForFences(device, 1, &uploadFence, VK_TRUE, UINT64_MAX);
+    for (TextureAllocation &allocation : pending.allocations) {
+      Texture::destroyAllocation(device, allocation);
+    }
+    pending.staging.cleanup(device);
+    pending = {};
+    uploadPending = false;
+  }
+  commandPool.cleanup(device);
+
+  for (Entry &entry : entries) {
+    entry.texture.cleanup(device);
+  }
+  entries.clear();
+
+  if (uploadFence != VK_NULL_HANDLE) {
+    vkDestroyFence(device, uploadFence, nullptr);
+    uploadFence = VK_NULL_HANDLE;
+  }
+  if (sampler != VK_NULL_HANDLE) {
+    vkDestroySampler(device, sampler, nullptr);
+    sampler = VK_NULL_HANDLE;
+  }
+}
+
+uint32_t TextureStreamer::addTexture(VulkanContext &context,
+                                     CommandPool &commandPool,
+                                     const std::string &filename) {
+  Entry entry;
+  entry.texture.create(context, commandPool, filename);
+  entries.push_back(entry);
+
+  statistics.residentBytes += entry.texture.getMemorySize();
+  return static_cast<uint32_t>(entries.size() - 1);
+}
+
+void TextureStreamer::requestMip(uint32_t texture, uint32_t mip) {
+  Entry &entry = entries[texture];
+  entry.requestedMip = std::min(entry.requestedMip, mip);
+  entry.lastUsedFrame = frame;
+}
+
+uint32_t TextureStreamer::getEvictionLimit(const Entry &entry) const {
+  uint32_t tail = entry.texture.getMipTailStart();
+  // Textures used this frame keep the levels they asked for
+  if (entry.lastUsedFrame == frame)
+    return std::min(entry.requestedMip, tail);
+  return tail;
+}
+
+bool TextureStreamer::retirePending(VkDevice device) {
+  if (!uploadPending)
+    return true;
+
+  VkResult status = vkGetFenceStatus(device, uploadFence);
+  if (status == VK_NOT_READY)
+    return false;
+  if (status != VK_SUCCESS) {
+    throw std::runtime_error("Failed to wait for texture uploads!");
+  }
+
+  for (size_t i = 0; i < pending.textures.size(); i++) {
+    TextureAllocation previous =
+        entries[pending.textures[i]].texture.commitResidency(
+            pending.allocations[i], pending.firstMips[i]);
+    Texture::destroyAllocation(*deletionQueue, previous);
+  }
+  vkFreeCommandBuffers(device, commandPool.getCommandPool(), 1,
+                       &pending.commandBuffer);
+  pending.staging.cleanup(device);
+  pending = {};
+  uploadPending = false;
+  acquirePending = true;
+
+  statistics.residentBytes = 0;
+  for (const Entry &entry : entries) {
+    statistics.residentBytes += entry.texture.getMemorySize();
+  }
+  return true;
+}
+
+void TextureStreamer::update(VulkanContext &context) {
+  statistics.uploadedBytes = 0;
+  statistics.levelsStreamedIn = 0;
+  statistics.levelsEvicted = 0;
+
+  // New decisions wait for the changes in flight; textures still in use
+  // request their levels again next frame
+  if (retirePending(context.getDevice())) {
+    streamRequests(context);
+  }
+
+  for (Entry &entry : entries) {
+    entry.requestedMip = UINT32_MAX;
+  }
+  frame++;
+}
+
+void TextureStreamer::recordAcquire(VkCommandBuffer commandBuffer) {
+  if (!acquirePending)
+    return;
+  Texture::recordAcquire(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  acquirePending = false;
+}
+
+void TextureStreamer::streamRequests(VulkanContext &context) {
+  std::vector<uint32_t> newFirstMips(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    newFirstMips[i] = entries[i].texture.getFirstResidentMip();
+  }
+
+  // Textures wanting a finer level; coarser next levels first, since they
+  // are cheap and give the largest visible improvement
+  std::vector<uint32_t> wanted;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const Entry &entry = entries[i];
+    if (entry.lastUsedFrame == frame &&
+        entry.requestedMip < entry.texture.getFirstResidentMip()) {
+      wanted.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  std::sort(wanted.begin(), wanted.end(), [&](uint32_t a, uint32_t b) {
+    uint32_t levelA = entries[a].texture.getFirstResidentMip() - 1;
+    uint32_t levelB = entries[b].texture.getFirstResidentMip() - 1;
+    return entries[a].texture.getFile().getLevel(levelA).size <
+           entries[b].texture.getFile().getLevel(levelB).size;
+  });
+
+  // Eviction candidates, least recently used first
+  std::vector<uint32_t> leastRecentlyUsed(entries.size());
+  std::iota(leastRecentlyUsed.begin(), leastRecentlyUsed.end(), 0);
+  std::sort(leastRecentlyUsed.begin(), leastRecentlyUsed.end(),
+            [&](uint32_t a, uint32_t b) {
+              return entries[a].lastUsedFrame < entries[b].lastUsedFrame;
+            });
+
+  VkDeviceSize projectedBytes = statistics.residentBytes;
+  VkDeviceSize uploadBytes = 0;
+  // Victims and the first levels they would keep, for one wanted level
+  std::vector<std::pair<uint32_t, uint32_t>> evictions;
+
+  for (uint32_t index : wanted) {
+    const Texture &texture = entries[index].texture;
+    uint32_t level = newFirstMips[index] - 1;
+    VkDeviceSize levelBytes = texture.getFile().getLevel(level).size;
+    VkDeviceSize growth = texture.getAllocationSize(level) -
+                          texture.getAllocationSize(newFirstMips[index]);
+
+    // Candidates are sorted by size, so nothing after this fits either
+    if (uploadBytes + levelBytes > uploadBudget)
+      break;
+
+    // Drop the highest levels of the least recently used textures until the
+    // new level fits. The drops only happen if it does
+    VkDeviceSize freedBytes = 0;
+    auto fits = [&] {
+      return projectedBytes + growth <= memoryBudget + freedBytes;
+    };
+    evictions.clear();
+    for (uint32_t victim : leastRecentlyUsed) {
+      if (fits())
+        break;
+      if (victim == index)
+        continue;
+
+      const Entry &entry = entries[victim];
+      uint32_t limit = getEvictionLimit(entry);
+      uint32_t firstMip = newFirstMips[victim];
+      while (!fits() && firstMip < limit) {
+        freedBytes += entry.texture.getAllocationSize(firstMip) -
+                      entry.texture.getAllocationSize(firstMip + 1);
+        firstMip++;
+      }
+      if (firstMip != newFirstMips[victim]) {
+        evictions.emplace_back(victim, firstMip);
+      }
+    }
+
+    if (!fits())
+      continue;
+
+    for (const auto &[victim, firstMip] : evictions) {
+      statistics.levelsEvicted += firstMip - newFirstMips[victim];
+      newFirstMips[victim] = firstMip;
+    }
+    newFirstMips[index] = level;
+    projectedBytes = projectedBytes + growth - freedBytes;
+    uploadBytes += levelBytes;
+    statistics.levelsStreamedIn++;
+  }
+
+  submit(context, newFirstMips, uploadBytes);
+  statistics.uploadedBytes = uploadBytes;
+}
+
+void TextureStreamer::submit(VulkanContext &context,
+                             const std::vector<uint32_t> &newFirstMips,
+                             VkDeviceSize uploadBytes) {
+  // Every residency change goes into one command buffer
+  VkDeviceSize stagingSize = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (newFirstMips[i] != entries[i].texture.getFirstResidentMip()) {
+      pending.textures.push_back(static_cast<uint32_t>(i));
+      pending.firstMips.push_back(newFirstMips[i]);
+      // Keep room for the per-level alignment padding
+      stagingSize += entries[i].texture.getStagingSize(newFirstMips[i]) + 16;
+    }
+  }
+  if (pending.textures.empty())
+    return;
+
+  VkDevice device = context.getDevice();
+  void *stagingData = nullptr;
+  if (uploadBytes > 0) {
+    pending.staging.create(context, stagingSize,
+                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkMapMemory(device, pending.staging.getMemory(), 0, stagingSize, 0,
+                &stagingData);
+  }
+
+  pending.commandBuffer = commandPool.beginSingleTimeCommands(device);
+  VkDeviceSize stagingOffset = 0;
+  for (size_t i = 0; i < pending.textures.size(); i++) {
+    pending.allocations.push_back(
+        entries[pending.textures[i]].texture.changeResidency(
+            context, pending.commandBuffer, pending.firstMips[i],
+            pending.staging, static_cast<char *>(stagingData), stagingOffset,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
+  }
+  if (stagingData != nullptr) {
+    vkUnmapMemory(device, pending.staging.getMemory());
+  }
+
+  if (vkEndCommandBuffer(pending.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record texture uploads!");
+  }
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &pending.commandBuffer;
+  vkResetFences(device, 1, &uploadFence);
+  if (vkQueueSubmit(transferQueue, 1, &submitInfo, uploadFence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to submit texture uploads!");
+  }
+  uploadPending = true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "CommandPool.hpp"
+#include "DeletionQueue.hpp"
+#include "Texture.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Byte counts of device memory are allocation sizes as the driver reports
+// them; uploadedBytes counts file data copied through staging
+struct TextureStreamerStatistics {
+  VkDeviceSize residentBytes = 0;
+  VkDeviceSize uploadedBytes = 0; // submitted by the last update
+  uint32_t levelsStreamedIn = 0;  // submitted by the last update
+  uint32_t levelsEvicted = 0;     // submitted by the last update
+};
+
+// Streams texture mip levels in on demand under a fixed device memory
+// budget. Textures always keep their mip tail; finer levels are streamed in
+// one level per update, coarsest first, and the high levels of the least
+// recently used textures are evicted when the budget is exceeded. Changes
+// are submitted to the transfer queue with a fence and take effect at the
+// first update after it signals; no update waits for the GPU. Replaced
+// images go to the deletion queue, as frames in flight may still sample
+// them
+class TextureStreamer {
+
+public:
+  void create(VulkanContext &context, DeletionQueue &deletionQueue,
+              VkDeviceSize memoryBudget,
+              VkDeviceSize uploadBudgetPerUpdate = 16 * 1024 * 1024);
+  // Waits for the uploads still in flight
+  void cleanup(VkDevice device);
+
+  // Registers a DDS/KTX2 texture and uploads its mip tail. Returns its handle
+  uint32_t addTexture(VulkanContext &context, CommandPool &commandPool,
+                      const std::string &filename);
+
+  // Marks a texture as used this frame, needing levels down to mip
+  void requestMip(uint32_t texture, uint32_t mip);
+
+  // Switches textures to the images of completed uploads, then submits
+  // the streaming decisions for this frame's requests unless earlier ones
+  // are still in flight. Call once per frame; textures' views may change
+  void update(VulkanContext &context);
+  // Makes the images switched to by update visible to fragment shaders;
+  // record it in the frame's graphics commands before they sample
+  void recordAcquire(VkCommandBuffer commandBuffer);
+
+  const Texture &getTexture(uint32_t texture) const {
+    return entries[texture].texture;
+  }
+  VkSampler getSampler() const { return sampler; }
+  const TextureStreamerStatistics &getStatistics() const {
+    return statistics;
+  }
+
+private:
+  struct Entry {
+    Texture texture;
+    uint32_t requestedMip = UINT32_MAX;
+    uint64_t lastUsedFrame = 0;
+  };
+
+  // One submission of residency changes, committed once fence signals
+  struct PendingUpload {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    Buffer staging;
+    std::vector<uint32_t> textures;
+    std::vector<uint32_t> firstMips;
+    std::vector<TextureAllocation> allocations;
+  };
+
+  std::vector<Entry> entries;
+  DeletionQueue *deletionQueue = nullptr;
+  CommandPool commandPool; // on the transfer family
+  VkQueue transferQueue = VK_NULL_HANDLE;
+  VkFence uploadFence = VK_NULL_HANDLE;
+  bool uploadPending = false;
+  bool acquirePending = false; // committed images not yet acquired
+  PendingUpload pending;
+  VkSampler sampler = VK_NULL_HANDLE;
+  VkDeviceSize memoryBudget = 0;
+  VkDeviceSize uploadBudget = 0;
+  uint64_t frame = 1;
+  TextureStreamerStatistics statistics;
+
+  // Lowest level an entry may be evicted down to this frame
+  uint32_t getEvictionLimit(const Entry &entry) const;
+  // Commits the pending upload if its fence has signaled. Returns whether
+  // nothing is in flight anymore
+  bool retirePending(VkDevice device);
+  void streamRequests(VulkanContext &context);
+  void submit(VulkanContext &context,
+              const std::vector<uint32_t> &newFirstMips,
+              VkDeviceSize uploadBytes);
+};
@@ -0,0 +1,103 @@
+#include "ThreadPool.hpp"
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+
+void ThreadPool::create(uint32_t threadCount) {
+  if (threadCount == 0) {
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+  }
+
+  stopping = false;
+  workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+void ThreadPool::cleanup() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+}
+
+void ThreadPool::parallelFor(
+    size_t count, size_t chunkSize,
+    const std::function<void(size_t, size_t)> &function) {
+  if (count == 0)
+    return;
+
+  chunkSize = std::max<size_t>(chunkSize, 1);
+  size_t chunks = (count + chunkSize - 1) / chunkSize;
+
+  // Not worth waking anyone for a single chunk
+  if (workers.empty() || chunks == 1) {
+    for (size_t begin = 0; begin < count; begin += chunkSize) {
+      function(begin, std::min(begin + chunkSize, count));
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job = &function;
+    jobCount = count;
+    jobChunkSize = chunkSize;
+    chunkCount = chunks;
+    nextChunk.store(0, std::memory_order_relaxed);
+    pendingWorkers = static_cast<uint32_t>(workers.size());
+    generation++;
+  }
+  wakeCondition.notify_all();
+
+  runChunks();
+
+  // Workers reference the job until they check back in
+  std::unique_lock<std::mutex> lock(mutex);
+  doneCondition.wait(lock, [this] { return pendingWorkers == 0; });
+  job = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+  PROFILE_THREAD("Worker");
+  uint64_t seenGeneration = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeCondition.wait(lock, [&] {
+        return stopping || generation != seenGeneration;
+      });
+      if (stopping)
+        return;
+      seenGeneration = generation;
+    }
+
+    runChunks();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--pendingWorkers == 0) {
+      doneCondition.notify_one();
+    }
+  }
+}
+
+void ThreadPool::runChunks() {
+  PROFILE_ZONE("Thread pool chunks");
+  for (;;) {
+    size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+    if (chunk >= chunkCount)
+      return;
+
+    size_t begin = chunk * jobChunkSize;
+    (*job)(begin, std::min(begin + jobChunkSize, jobCount));
+  }
+}
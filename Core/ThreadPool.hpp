@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for data-parallel frame work. parallelFor splits
+// a range into chunks that the workers and the calling thread pull from a
+// shared counter, and returns once every chunk has run
+class ThreadPool {
+
+public:
+  // threadCount workers besides the caller; 0 uses one per hardware thread
+  void create(uint32_t threadCount = 0);
+  void cleanup();
+
+  // Calls function(begin, end) over [0, count) in chunks of chunkSize. Must
+  // not be called concurrently or from inside a job; function must not throw
+  void parallelFor(size_t count, size_t chunkSize,
+                   const std::function<void(size_t, size_t)> &function);
+
+  // Threads taking part in parallelFor, including the caller
+  uint32_t getThreadCount() const {
+    return static_cast<uint32_t>(workers.size()) + 1;
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeCondition;
+  std::condition_variable doneCondition;
+  uint64_t generation = 0;
+  uint32_t pendingWorkers = 0;
+  bool stopping = false;
+
+  const std::function<void(size_t, size_t)> *job = nullptr;
+  size_t jobCount = 0;
+  size_t jobChunkSize = 1;
+  size_t chunkCount = 0;
+  std::atomic<size_t> nextChunk{0};
+
+  void workerLoop();
+  void runChunks();
+};
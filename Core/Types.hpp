@@ -1,5 +1,27 @@
 #pragma once
+
+#include <cstdint>
+
 struct Vertex {
-  float position[2];
+  float position[3];
   float color[3];
+  float normal[3];
+};
+
+// Skin influences of one vertex, matching VertexSkin in
+// Shaders/skinning.comp. Weights sum to one; unused slots weigh zero
+struct VertexSkin {
+  uint32_t joints[4];
+  float weights[4];
+};
+
+// Per-instance vertex data (binding 1); model is column-major
+struct InstanceData {
+  float model[16];
+};
+
+// Push constants of the graphics pipeline (vertex stage); column-major
+struct CameraConstants {
+  float viewProj[16];
+  float view[16];
 };
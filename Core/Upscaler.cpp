@@ -0,0 +1,250 @@
+#include "Upscaler.hpp"
+
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Matches PushConstants in Shaders/upscale.comp
+struct UpscaleConstants {
+  float sourceScale[2]; // rendered part of the source, in texture coordinates
+  float sourceTexel[2]; // size of one source texel, likewise
+  int32_t targetSize[2];
+  float sharpness;
+  uint32_t padding;
+};
+
+void Upscaler::create(VulkanContext &context, VkExtent2D extent,
+                      VkFormat format, VkImageUsageFlags targetUsage,
+                      uint32_t framesInFlight, float sharpness,
+                      DescriptorLayoutCache &layoutCache,
+                      ResourceCache &cache) {
+  device = context.getDevice();
+  this->extent = extent;
+  this->sharpness = std::clamp(sharpness, 0.0f, 1.0f);
+  this->cache = &cache;
+
+  const VkPhysicalDeviceFeatures &features = context.getEnabledFeatures();
+  useCompute = (targetUsage & VK_IMAGE_USAGE_STORAGE_BIT) &&
+               features.shaderStorageImageWriteWithoutFormat;
+  if (!useCompute) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(context.getPhysicalDevice(), format,
+                                        &properties);
+    VkFormatFeatureFlags required =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if (!(targetUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+        (properties.optimalTilingFeatures & required) != required) {
+      throw std::runtime_error(
+          "Upscaling needs storage or linear blit support for the target!");
+    }
+    if (this->sharpness > 0.0f) {
+      LOG_WARNING("Target has no storage support; upscaling with a blit, "
+                  "without sharpening");
+    }
+  }
+
+  VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = format;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                    (useCompute ? VK_IMAGE_USAGE_SAMPLED_BIT
+                                : VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  sources.resize(framesInFlight);
+  sourceViews.resize(framesInFlight);
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+    sources[i].create(context, imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+    sourceViews[i] = sources[i].getView();
+  }
+
+  if (!useCompute)
+    return;
+
+  // Rendered texels only; recording clamps to their centers
+  VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler = cache.acquireSampler(samplerInfo);
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  descriptorSetLayout = layoutCache.getLayout(bindings);
+
+  // Sharpening is a specialization constant, so plain bilinear pays
+  // nothing for it
+  VkBool32 sharpen = this->sharpness > 0.0f ? VK_TRUE : VK_FALSE;
+  VkSpecializationMapEntry entry{0, 0, sizeof(VkBool32)};
+  VkSpecializationInfo specialization{1, &entry, sizeof(VkBool32), &sharpen};
+  upscalePipeline.create(device, "Shaders/upscale.comp.spv",
+                         {descriptorSetLayout}, sizeof(UpscaleConstants),
+                         &specialization);
+}
+
+void Upscaler::cleanup(VkDevice device) {
+  upscalePipeline.cleanup(device);
+  descriptorSetLayout = VK_NULL_HANDLE;
+  if (sampler != VK_NULL_HANDLE) {
+    cache->release(sampler);
+    sampler = VK_NULL_HANDLE;
+  }
+  for (Image &source : sources) {
+    source.cleanup(device);
+  }
+  sources.clear();
+  sourceViews.clear();
+}
+
+// How the compute pass and the blit use the source and the target
+static constexpr ImageState kComputeSource{
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_SAMPLED_READ_BIT};
+static constexpr ImageState kComputeTarget{
+    VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+static constexpr ImageState kBlitSource{VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                        VK_PIPELINE_STAGE_2_BLIT_BIT,
+                                        VK_ACCESS_2_TRANSFER_READ_BIT};
+static constexpr ImageState kBlitTarget{VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_PIPELINE_STAGE_2_BLIT_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT};
+
+void Upscaler::record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                      VkExtent2D renderExtent, const UpscaleTarget &target,
+                      DescriptorAllocator &frameDescriptors,
+                      const VulkanContext &context) {
+  renderExtent.width = std::min(renderExtent.width, extent.width);
+  renderExtent.height = std::min(renderExtent.height, extent.height);
+  const ImageState &targetState = useCompute ? kComputeTarget : kBlitTarget;
+  recordBeginBarriers(commandBuffer, frameIndex, target,
+                      useCompute ? kComputeSource : kBlitSource, targetState,
+                      context);
+  if (useCompute) {
+    recordCompute(commandBuffer, frameIndex, renderExtent, target,
+                  frameDescriptors);
+  } else {
+    recordBlit(commandBuffer, frameIndex, renderExtent, target);
+  }
+
+  // Hands the written target to its next user
+  ImageBarrierBatch barriers;
+  if (target.trackedImage) {
+    barriers.transition(*target.trackedImage, target.finalState);
+  } else {
+    barriers.transition(target.image, VK_IMAGE_ASPECT_COLOR_BIT, targetState,
+                        target.finalState);
+  }
+  barriers.record(commandBuffer, context);
+}
+
+void Upscaler::recordBeginBarriers(VkCommandBuffer commandBuffer,
+                                   uint32_t frameIndex,
+                                   const UpscaleTarget &target,
+                                   const ImageState &sourceState,
+                                   const ImageState &targetState,
+                                   const VulkanContext &context) {
+  // The source's color writes become visible to the upscale reads
+  Image &source = sources[frameIndex];
+  source.assumeState({kSourceLayout,
+                      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                      VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT});
+  ImageBarrierBatch barriers;
+  barriers.transition(source, sourceState);
+
+  // The target's old contents are discarded, though its last use is still
+  // waited for. An untracked target was acquired by a wait at the color
+  // attachment output stage, which the barrier chains with
+  if (target.trackedImage) {
+    ImageState discarded = target.trackedImage->getState(0, 0);
+    discarded.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    target.trackedImage->assumeState(discarded);
+    barriers.transition(*target.trackedImage, targetState);
+  } else {
+    barriers.transition(target.image, VK_IMAGE_ASPECT_COLOR_BIT,
+                        {VK_IMAGE_LAYOUT_UNDEFINED,
+                         VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_ACCESS_2_NONE},
+                        targetState);
+  }
+  barriers.record(commandBuffer, context);
+}
+
+void Upscaler::recordCompute(VkCommandBuffer commandBuffer,
+                             uint32_t frameIndex, VkExtent2D renderExtent,
+                             const UpscaleTarget &target,
+                             DescriptorAllocator &frameDescriptors) {
+  // The target changes with the acquired image, so the set is rewritten
+  // every frame
+  VkDescriptorSet descriptorSet =
+      frameDescriptors.allocate(descriptorSetLayout);
+  VkDescriptorImageInfo sourceInfo{sampler, sourceViews[frameIndex],
+                                   kComputeSource.layout};
+  VkDescriptorImageInfo targetInfo{VK_NULL_HANDLE, target.view,
+                                   kComputeTarget.layout};
+  VkWriteDescriptorSet writes[2]{};
+  for (uint32_t binding = 0; binding < 2; binding++) {
+    writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[binding].dstSet = descriptorSet;
+    writes[binding].dstBinding = binding;
+    writes[binding].descriptorCount = 1;
+  }
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[0].pImageInfo = &sourceInfo;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  writes[1].pImageInfo = &targetInfo;
+  vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+
+  UpscaleConstants constants{};
+  constants.sourceScale[0] =
+      static_cast<float>(renderExtent.width) / extent.width;
+  constants.sourceScale[1] =
+      static_cast<float>(renderExtent.height) / extent.height;
+  constants.sourceTexel[0] = 1.0f / extent.width;
+  constants.sourceTexel[1] = 1.0f / extent.height;
+  constants.targetSize[0] = static_cast<int32_t>(target.extent.width);
+  constants.targetSize[1] = static_cast<int32_t>(target.extent.height);
+  constants.sharpness = sharpness;
+
+  upscalePipeline.bind(commandBuffer);
+  upscalePipeline.bindDescriptorSet(commandBuffer, descriptorSet);
+  upscalePipeline.pushConstants(commandBuffer, &constants, sizeof(constants));
+  vkCmdDispatch(commandBuffer,
+                ComputePipeline::groupCount(target.extent.width, kGroupSize),
+                ComputePipeline::groupCount(target.extent.height, kGroupSize),
+                1);
+}
+
+void Upscaler::recordBlit(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                          VkExtent2D renderExtent,
+                          const UpscaleTarget &target) {
+  VkImageBlit region{};
+  region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.srcOffsets[1] = {static_cast<int32_t>(renderExtent.width),
+                          static_cast<int32_t>(renderExtent.height), 1};
+  region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.dstOffsets[1] = {static_cast<int32_t>(target.extent.width),
+                          static_cast<int32_t>(target.extent.height), 1};
+  vkCmdBlitImage(commandBuffer, sources[frameIndex].getImage(),
+                 kBlitSource.layout, target.image, kBlitTarget.layout, 1,
+                 &region, VK_FILTER_LINEAR);
+}
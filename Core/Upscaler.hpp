@@ -0,0 +1,90 @@
+#pragma once
+
+#include "ComputePipeline.hpp"
+#include "DescriptorAllocator.hpp"
+#include "Image.hpp"
+#include "ResourceCache.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Image the upscaled frame is written to and left in finalState. A
+// tracked image starts from its tracked state; otherwise image, e.g. a
+// swapchain image, is taken to be acquired by a wait at the color
+// attachment output stage, and its contents are discarded
+struct UpscaleTarget {
+  Image *trackedImage = nullptr;
+  VkImage image = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkExtent2D extent{};
+  ImageState finalState{VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+};
+
+// Scales a frame rendered at reduced resolution up to the full target.
+// The scene is rendered into the top-left corner of a full-size source
+// image, one per frame in flight, so changing the render size needs no new
+// images or framebuffers. A compute pass samples the rendered part
+// bilinearly, optionally sharpening it, and writes the target as a storage
+// image. Targets without storage support are blitted with linear
+// filtering instead, without sharpening
+class Upscaler {
+
+public:
+  // The render pass must leave the source images in this layout
+  static constexpr VkImageLayout kSourceLayout =
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  // Usage targets need, for the compute pass or the blit
+  static constexpr VkImageUsageFlags kTargetUsage =
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  static constexpr uint32_t kGroupSize = 8; // Shaders/upscale.comp
+
+  // Sources match the target's extent and format. targetUsage is what the
+  // targets were created with, and decides between the compute pass and
+  // the blit. sharpness goes from 0 (plain bilinear) to 1
+  void create(VulkanContext &context, VkExtent2D extent, VkFormat format,
+              VkImageUsageFlags targetUsage, uint32_t framesInFlight,
+              float sharpness, DescriptorLayoutCache &layoutCache,
+              ResourceCache &cache);
+  void cleanup(VkDevice device);
+
+  // Views to render the scene into, one per frame in flight
+  const std::vector<VkImageView> &getSourceViews() const {
+    return sourceViews;
+  }
+  bool usesCompute() const { return useCompute; }
+
+  // Scales renderExtent of the frame's source up to target, outside a
+  // render pass. The compute pass's set comes from frameDescriptors, which
+  // must be reset with the frame
+  void record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+              VkExtent2D renderExtent, const UpscaleTarget &target,
+              DescriptorAllocator &frameDescriptors,
+              const VulkanContext &context);
+
+private:
+  VkDevice device = VK_NULL_HANDLE;
+  VkExtent2D extent{};
+  std::vector<Image> sources;
+  std::vector<VkImageView> sourceViews; // of sources, for the framebuffers
+  bool useCompute = false;
+  float sharpness = 0.0f;
+
+  ResourceCache *cache = nullptr;
+  VkSampler sampler = VK_NULL_HANDLE; // from the cache
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE; // cached
+  ComputePipeline upscalePipeline;
+
+  // The frame's source and target as the compute pass or blit uses them
+  void recordBeginBarriers(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                           const UpscaleTarget &target,
+                           const ImageState &sourceState,
+                           const ImageState &targetState,
+                           const VulkanContext &context);
+  void recordCompute(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                     VkExtent2D renderExtent, const UpscaleTarget &target,
+                     DescriptorAllocator &frameDescriptors);
+  void recordBlit(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                  VkExtent2D renderExtent, const UpscaleTarget &target);
+};
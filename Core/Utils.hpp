@@ -1,12 +1,15 @@
 #pragma once
 
-#include <iostream>
+#include "Logger.hpp"
+
 #include <string>
 
+// Convenience wrappers for callers holding a std::string; LOG_ERROR and
+// LOG_INFO avoid the string entirely
 inline void logError(const std::string &message) {
-  std::cerr << "Error: " << message << std::endl;
+  LOG_ERROR("%s", message.c_str());
 }
 
 inline void logInfo(const std::string &message) {
-  std::cout << "Info: " << message << std::endl;
-}
\ No newline at end of file
+  LOG_INFO("%s", message.c_str());
+}
@@ -1,9 +1,11 @@
 #define GLFW_INCLUDE_VULKAN
 #include "VulkanContext.hpp"
 #include "GLFW/glfw3.h"
+#include "Logger.hpp"
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <set>
 #include <stdexcept>
 #ifdef NDEBUG
@@ -37,14 +39,16 @@ bool VulkanContext::checkValidationLayerSupport() {
   return true;
 }
 
-std::vector<const char *> VulkanContext::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
+std::vector<const char *>
+VulkanContext::getRequiredExtensions(bool headless) {
+  std::vector<const char *> extensions;
+  if (!headless) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
 
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions,
-                                       glfwExtensions + glfwExtensionCount);
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -86,11 +90,11 @@ void VulkanContext::createInstance(
 
   // Debug Messenger (optional, requires additional setup)
 
-  std::cout << "Creating Vulkan Instance..." << std::endl;
+  LOG_DEBUG("Creating Vulkan instance");
   if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
     throw std::runtime_error("Failed to create Vulkan instance!");
   }
-  std::cout << "Vulkan Instance Created Successfully." << std::endl;
+  LOG_INFO("Vulkan Instance Created Successfully.");
 }
 
 void VulkanContext::createSurface(VkInstance instance, GLFWwindow *window,
@@ -101,94 +105,326 @@ void VulkanContext::createSurface(VkInstance instance, GLFWwindow *window,
   }
 }
 
-void VulkanContext::pickPhysicalDevice(VkSurfaceKHR surface) {
-  uint32_t deviceCount = 0;
-  vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+bool DeviceCapabilities::hasExtension(const char *name) const {
+  for (const std::string &extension : extensions) {
+    if (extension == name)
+      return true;
+  }
+  return false;
+}
 
-  if (deviceCount == 0) {
-    throw std::runtime_error("Failed to find GPUs with Vulkan support!");
+VkDeviceSize DeviceCapabilities::getDeviceLocalBytes() const {
+  VkDeviceSize largest = 0;
+  for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+    if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      largest = std::max(largest, memory.memoryHeaps[i].size);
+    }
   }
+  return largest;
+}
 
-  std::vector<VkPhysicalDevice> devices(deviceCount);
-  vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+DeviceCapabilities VulkanContext::queryCapabilities(VkPhysicalDevice device) {
+  DeviceCapabilities capabilities;
+
+  VkPhysicalDeviceProperties2 properties2{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+  properties2.pNext = &capabilities.subgroup;
+  vkGetPhysicalDeviceProperties2(device, &properties2);
+  capabilities.properties = properties2.properties;
+  capabilities.subgroup.pNext = nullptr;
+
+  vkGetPhysicalDeviceMemoryProperties(device, &capabilities.memory);
+  vkGetPhysicalDeviceFeatures(device, &capabilities.features);
+
+  if (capabilities.properties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceVulkan12Features features12{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceVulkan13Features features13{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+    VkPhysicalDeviceFeatures2 features2{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features2.pNext = &features12;
+    if (capabilities.properties.apiVersion >= VK_API_VERSION_1_3) {
+      features12.pNext = &features13;
+    }
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    capabilities.hostQueryReset = features12.hostQueryReset == VK_TRUE;
+    capabilities.synchronization2 = features13.synchronization2 == VK_TRUE;
+  }
 
-  for (const auto &device : devices) {
-    // Check if the device is suitable (has required queues and extensions)
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
-                                             nullptr);
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+  capabilities.queueFamilies.resize(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                           capabilities.queueFamilies.data());
+
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       extensions.data());
+  for (const VkExtensionProperties &extension : extensions) {
+    capabilities.extensions.push_back(extension.extensionName);
+  }
+  return capabilities;
+}
 
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
-                                             queueFamilies.data());
+bool VulkanContext::findQueueFamilies(VkPhysicalDevice device,
+                                      const DeviceCapabilities &capabilities,
+                                      VkSurfaceKHR surface,
+                                      QueueFamilies &families) {
+  const std::vector<VkQueueFamilyProperties> &queueFamilies =
+      capabilities.queueFamilies;
+  uint32_t count = static_cast<uint32_t>(queueFamilies.size());
+  std::vector<VkBool32> presentSupport(count, VK_FALSE);
+  if (surface != VK_NULL_HANDLE) {
+    for (uint32_t i = 0; i < count; i++) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface,
+                                           &presentSupport[i]);
+    }
+  }
 
-    bool foundGraphics = false;
-    bool foundPresent = false;
+  // The first graphics family, preferring one that can also present
+  families = {};
+  for (uint32_t i = 0; i < count; i++) {
+    if (!(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+      continue;
+    if (families.graphics == UINT32_MAX) {
+      families.graphics = i;
+    }
+    if (presentSupport[i]) {
+      families.graphics = i;
+      break;
+    }
+  }
+  if (families.graphics == UINT32_MAX)
+    return false;
 
-    for (uint32_t i = 0; i < queueFamilies.size(); i++) {
-      if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-        graphicsQueueFamilyIndex = i;
-        foundGraphics = true;
+  // Never presented to when headless; the queue is only there for uniform
+  // access
+  if (surface == VK_NULL_HANDLE || presentSupport[families.graphics]) {
+    families.present = families.graphics;
+  } else {
+    for (uint32_t i = 0; i < count && families.present == UINT32_MAX; i++) {
+      if (presentSupport[i]) {
+        families.present = i;
       }
+    }
+    if (families.present == UINT32_MAX)
+      return false;
+  }
 
-      VkBool32 presentSupport = false;
-      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-      if (presentSupport) {
-        presentQueueFamilyIndex = i;
-        foundPresent = true;
-      }
+  // A compute family without graphics runs on the async compute engines.
+  // Otherwise a second queue of the graphics family still lets submissions
+  // overlap; with a single queue, compute shares the graphics queue
+  families.compute = families.graphics;
+  for (uint32_t i = 0; i < count; i++) {
+    if ((queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+        !(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+      families.compute = i;
+      break;
+    }
+  }
+  if (families.compute == families.graphics &&
+      queueFamilies[families.graphics].queueCount > 1) {
+    families.computeQueueIndex = 1;
+  }
 
-      if (foundGraphics && foundPresent) {
-        break;
-      }
+  // A family that only transfers runs on the copy engines; otherwise
+  // transfers share the compute queue (graphics and compute families
+  // implicitly support transfer)
+  families.transfer = families.compute;
+  families.transferQueueIndex = families.computeQueueIndex;
+  for (uint32_t i = 0; i < count; i++) {
+    VkQueueFlags flags = queueFamilies[i].queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      families.transfer = i;
+      families.transferQueueIndex = 0;
+      break;
     }
+  }
+  return true;
+}
+
+int64_t VulkanContext::scoreDevice(const DeviceCapabilities &capabilities,
+                                   const QueueFamilies &families) {
+  int64_t score = 0;
+  switch (capabilities.properties.deviceType) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    score += 100000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    score += 50000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    score += 20000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_CPU: // lavapipe, SwiftShader
+    score += 0;
+    break;
+  default:
+    score += 10000;
+    break;
+  }
+
+  // Within a type, more device-local memory; a point per MiB up to 64 GiB
+  score += static_cast<int64_t>(
+      std::min<VkDeviceSize>(capabilities.getDeviceLocalBytes() >> 20, 65536));
+
+  // Optional features some passes need or run faster with
+  const VkPhysicalDeviceFeatures &features = capabilities.features;
+  VkBool32 optionalFeatures[] = {
+      features.textureCompressionBC,
+      features.shaderStorageImageWriteWithoutFormat,
+      features.shaderStorageImageArrayDynamicIndexing,
+      features.multiDrawIndirect, features.drawIndirectFirstInstance};
+  for (VkBool32 supported : optionalFeatures) {
+    score += supported ? 1000 : 0;
+  }
+  score += capabilities.hostQueryReset ? 1000 : 0;
+  if (capabilities.properties.apiVersion >= VK_API_VERSION_1_2) {
+    score += 1000;
+  }
 
-    // Check for required device extensions
-    uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
-                                         nullptr);
-    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
-                                         availableExtensions.data());
+  if (families.compute != families.graphics) {
+    score += 2000;
+  }
+  if (families.transfer != families.compute &&
+      families.transfer != families.graphics) {
+    score += 1000;
+  }
+  return score;
+}
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                             deviceExtensions.end());
+static std::string toLower(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return text;
+}
 
-    for (const auto &extension : availableExtensions) {
-      requiredExtensions.erase(extension.extensionName);
-    }
+void VulkanContext::pickPhysicalDevice(VkSurfaceKHR surface) {
+  headless = surface == VK_NULL_HANDLE;
+  if (headless) {
+    deviceExtensions.erase(
+        std::remove_if(deviceExtensions.begin(), deviceExtensions.end(),
+                       [](const char *name) {
+                         return strcmp(name,
+                                       VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+                       }),
+        deviceExtensions.end());
+  }
 
-    if (!requiredExtensions.empty() || !foundGraphics || !foundPresent) {
-      continue; // Try next device
+  uint32_t deviceCount = 0;
+  vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+  if (deviceCount == 0) {
+    throw std::runtime_error("Failed to find GPUs with Vulkan support!");
+  }
+
+  std::vector<VkPhysicalDevice> devices(deviceCount);
+  vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+  std::string selector = deviceSelector;
+  if (selector.empty()) {
+    const char *environment = std::getenv("VALKEON_DEVICE");
+    selector = environment ? environment : "";
+  }
+  bool selectByIndex =
+      !selector.empty() &&
+      std::all_of(selector.begin(), selector.end(),
+                  [](unsigned char c) { return std::isdigit(c) != 0; });
+
+  int64_t bestScore = -1;
+  for (uint32_t index = 0; index < deviceCount; index++) {
+    VkPhysicalDevice candidate = devices[index];
+    DeviceCapabilities candidateCapabilities = queryCapabilities(candidate);
+    const char *name = candidateCapabilities.properties.deviceName;
+
+    // Required: the device extensions, graphics, and present when windowed
+    QueueFamilies families;
+    bool suitable = findQueueFamilies(candidate, candidateCapabilities,
+                                      surface, families);
+    for (const char *extension : deviceExtensions) {
+      suitable = suitable && candidateCapabilities.hasExtension(extension);
+    }
+    if (!suitable) {
+      LOG_INFO("GPU %u: %s (unsuitable)", index, name);
+      continue;
     }
 
-    physicalDevice = device;
-    break;
+    int64_t score = scoreDevice(candidateCapabilities, families);
+    LOG_INFO("GPU %u: %s, score %lld", index, name,
+             static_cast<long long>(score));
+
+    if (!selector.empty()) {
+      bool selected =
+          selectByIndex
+              ? std::strtoul(selector.c_str(), nullptr, 10) == index
+              : toLower(name).find(toLower(selector)) != std::string::npos;
+      // The selected device wins over any score
+      score = selected ? INT64_MAX : -1;
+    }
+    if (score <= bestScore)
+      continue;
+
+    bestScore = score;
+    physicalDevice = candidate;
+    capabilities = std::move(candidateCapabilities);
+    graphicsQueueFamilyIndex = families.graphics;
+    presentQueueFamilyIndex = families.present;
+    computeQueueFamilyIndex = families.compute;
+    transferQueueFamilyIndex = families.transfer;
+    computeQueueIndex = families.computeQueueIndex;
+    transferQueueIndex = families.transferQueueIndex;
   }
 
   if (physicalDevice == VK_NULL_HANDLE) {
-    throw std::runtime_error("Failed to find a suitable GPU!");
+    throw std::runtime_error(
+        selector.empty() ? "Failed to find a suitable GPU!"
+                         : "Failed to find a suitable GPU matching " +
+                               selector + "!");
   }
+  LOG_INFO("Selected %s (graphics family %u, compute %u, transfer %u)",
+           capabilities.properties.deviceName, graphicsQueueFamilyIndex,
+           computeQueueFamilyIndex, transferQueueFamilyIndex);
 }
 
 void VulkanContext::createLogicalDevice() {
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {graphicsQueueFamilyIndex,
-                                            presentQueueFamilyIndex};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      graphicsQueueFamilyIndex, presentQueueFamilyIndex,
+      computeQueueFamilyIndex, transferQueueFamilyIndex};
 
-  float queuePriority = 1.0f;
+  float queuePriorities[] = {1.0f, 1.0f};
   for (uint32_t queueFamily : uniqueQueueFamilies) {
     VkDeviceQueueCreateInfo queueCreateInfo{};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queueCreateInfo.queueFamilyIndex = queueFamily;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    queueCreateInfo.queueCount =
+        queueFamily == computeQueueFamilyIndex ? computeQueueIndex + 1 : 1;
+    queueCreateInfo.pQueuePriorities = queuePriorities;
 
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  const VkPhysicalDeviceFeatures &supportedFeatures = capabilities.features;
+
   VkPhysicalDeviceFeatures deviceFeatures{};
+  // Block-compressed (BC1-BC7) textures, when the device can sample them
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  // Compute passes writing arbitrary formats through arrays of storage images
+  deviceFeatures.shaderStorageImageWriteWithoutFormat =
+      supportedFeatures.shaderStorageImageWriteWithoutFormat;
+  deviceFeatures.shaderStorageImageArrayDynamicIndexing =
+      supportedFeatures.shaderStorageImageArrayDynamicIndexing;
+  // GPU-generated draws: one indirect call per batch, each addressing its
+  // instance data through firstInstance
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance =
+      supportedFeatures.drawIndirectFirstInstance;
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -198,6 +434,27 @@ void VulkanContext::createLogicalDevice() {
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
+  enabledFeatures = deviceFeatures;
+
+  // Query pools reset from the host, so timestamps can be written first by
+  // whichever queue runs first in a frame
+  VkPhysicalDeviceVulkan12Features features12{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  if (capabilities.properties.apiVersion >= VK_API_VERSION_1_2) {
+    features12.hostQueryReset =
+        capabilities.hostQueryReset ? VK_TRUE : VK_FALSE;
+    createInfo.pNext = &features12;
+  }
+  hostQueryReset = features12.hostQueryReset == VK_TRUE;
+
+  // Image barriers are batched into vkCmdPipelineBarrier2 calls
+  VkPhysicalDeviceVulkan13Features features13{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+  if (capabilities.synchronization2) {
+    features13.synchronization2 = VK_TRUE;
+    features12.pNext = &features13;
+  }
+  synchronization2 = features13.synchronization2 == VK_TRUE;
 
   // Device extensions
   createInfo.enabledExtensionCount =
@@ -214,15 +471,18 @@ void VulkanContext::createLogicalDevice() {
     createInfo.enabledLayerCount = 0;
   }
 
-  std::cout << "Creating Logical Device..." << std::endl;
+  LOG_DEBUG("Creating logical device");
   if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) !=
       VK_SUCCESS) {
     throw std::runtime_error("Failed to create logical device!");
   }
-  std::cout << "Logical Device Created Successfully." << std::endl;
 
   vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
   vkGetDeviceQueue(device, presentQueueFamilyIndex, 0, &presentQueue);
+  vkGetDeviceQueue(device, computeQueueFamilyIndex, computeQueueIndex,
+                   &computeQueue);
+  vkGetDeviceQueue(device, transferQueueFamilyIndex, transferQueueIndex,
+                   &transferQueue);
 }
 
 void VulkanContext::cleanup() {
@@ -1,17 +1,39 @@
 #pragma once
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include "GLFW/glfw3.h"
 
 #include <string>
 #include <vector>
 #include <vulkan/vulkan.h>
 
+// What the physical device supports, queried once when it is picked so
+// later code need not ask the driver again
+struct DeviceCapabilities {
+  VkPhysicalDeviceProperties properties{};
+  VkPhysicalDeviceMemoryProperties memory{};
+  VkPhysicalDeviceFeatures features{};
+  VkPhysicalDeviceSubgroupProperties subgroup{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES};
+  bool hostQueryReset = false;   // Vulkan 1.2 feature
+  bool synchronization2 = false; // Vulkan 1.3 feature
+  std::vector<VkQueueFamilyProperties> queueFamilies;
+  std::vector<std::string> extensions;
+
+  bool hasExtension(const char *name) const;
+  // Largest DEVICE_LOCAL heap, in bytes
+  VkDeviceSize getDeviceLocalBytes() const;
+};
+
 class VulkanContext {
 public:
   void createInstance(const std::vector<const char *> &extensions);
   void createSurface(VkInstance instance, GLFWwindow *window,
                      VkSurfaceKHR *surface);
+  // Picks the highest scoring suitable device: discrete over integrated
+  // over virtual over CPU, then by device-local memory, optional features
+  // and dedicated queue families. A null surface selects a device for
+  // headless rendering, which needs neither present support nor the
+  // swapchain extension
   void pickPhysicalDevice(VkSurfaceKHR surface);
   void createLogicalDevice();
   void cleanup();
@@ -21,9 +43,44 @@ public:
   VkPhysicalDevice getPhysicalDevice() const { return physicalDevice; }
   VkQueue getGraphicsQueue() const { return graphicsQueue; }
   VkQueue getPresentQueue() const { return presentQueue; }
+  VkQueue getComputeQueue() const { return computeQueue; }
   uint32_t getGraphicsQueueFamilyIndex() const { return graphicsQueueFamilyIndex; }
   uint32_t getPresentQueueFamilyIndex() const { return presentQueueFamilyIndex; }
-  std::vector<const char *> getRequiredExtensions();
+  uint32_t getComputeQueueFamilyIndex() const { return computeQueueFamilyIndex; }
+  // A transfer-only family (the copy engines) when there is one, otherwise
+  // the compute or graphics queue
+  VkQueue getTransferQueue() const { return transferQueue; }
+  uint32_t getTransferQueueFamilyIndex() const {
+    return transferQueueFamilyIndex;
+  }
+  bool hasDedicatedTransfer() const {
+    return transferQueueFamilyIndex != graphicsQueueFamilyIndex &&
+           transferQueueFamilyIndex != computeQueueFamilyIndex;
+  }
+  // True when compute work can overlap graphics on a separate queue
+  bool hasAsyncCompute() const { return computeQueue != graphicsQueue; }
+  // vkResetQueryPool may be called from the host
+  bool hasHostQueryReset() const { return hostQueryReset; }
+  // vkCmdPipelineBarrier2 may be recorded
+  bool hasSynchronization2() const { return synchronization2; }
+  bool isHeadless() const { return headless; }
+  // Headless instances need no surface extensions, and GLFW is not queried
+  std::vector<const char *> getRequiredExtensions(bool headless = false);
+  // Before createInstance
+  void setValidationLayers(bool enable) { enableValidationLayers = enable; }
+  // Before pickPhysicalDevice: a device index or a case-insensitive part of
+  // its name, overriding the scores. When empty, the VALKEON_DEVICE
+  // environment variable is used if set
+  void setDeviceSelector(const std::string &selector) {
+    deviceSelector = selector;
+  }
+
+  // Valid after pickPhysicalDevice
+  const DeviceCapabilities &getCapabilities() const { return capabilities; }
+  // The subset of features the device was created with
+  const VkPhysicalDeviceFeatures &getEnabledFeatures() const {
+    return enabledFeatures;
+  }
 
 private:
   VkInstance instance = VK_NULL_HANDLE;
@@ -31,14 +88,41 @@ private:
   VkDevice device = VK_NULL_HANDLE;
   VkQueue graphicsQueue = VK_NULL_HANDLE;
   VkQueue presentQueue = VK_NULL_HANDLE;
+  VkQueue computeQueue = VK_NULL_HANDLE;
+  VkQueue transferQueue = VK_NULL_HANDLE;
   uint32_t graphicsQueueFamilyIndex = UINT32_MAX;
   uint32_t presentQueueFamilyIndex = UINT32_MAX;
+  uint32_t computeQueueFamilyIndex = UINT32_MAX;
+  uint32_t transferQueueFamilyIndex = UINT32_MAX;
+  uint32_t computeQueueIndex = 0;
+  uint32_t transferQueueIndex = 0;
+  bool hostQueryReset = false;
+  bool synchronization2 = false;
+  bool headless = false;
+  std::string deviceSelector;
+  DeviceCapabilities capabilities;
+  VkPhysicalDeviceFeatures enabledFeatures{};
 
   bool enableValidationLayers = true;
   std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   std::vector<const char *> deviceExtensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+  struct QueueFamilies {
+    uint32_t graphics = UINT32_MAX;
+    uint32_t present = UINT32_MAX;
+    uint32_t compute = UINT32_MAX;
+    uint32_t transfer = UINT32_MAX;
+    uint32_t computeQueueIndex = 0;
+    uint32_t transferQueueIndex = 0;
+  };
+
   bool checkValidationLayerSupport();
+  static DeviceCapabilities queryCapabilities(VkPhysicalDevice device);
+  static bool findQueueFamilies(VkPhysicalDevice device,
+                                const DeviceCapabilities &capabilities,
+                                VkSurfaceKHR surface, QueueFamilies &families);
+  static int64_t scoreDevice(const DeviceCapabilities &capabilities,
+                             const QueueFamilies &families);
 
 };
\ No newline at end of file
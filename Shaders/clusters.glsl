@@ -0,0 +1,41 @@
+// Cluster grid and light data shared by the light culling pass and the
+// shaders consuming it. Keep in sync with ClusteredLights.hpp.
+
+const uint CLUSTERS_X = 16;
+const uint CLUSTERS_Y = 9;
+const uint CLUSTERS_Z = 24;
+const uint CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+struct PointLight {
+    vec3 position; // world space
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout(set = 0, binding = 0) uniform LightingUniforms {
+    mat4 view;
+    mat4 inverseProjection;
+    vec2 screenSize;
+    float nearPlane;
+    float farPlane;
+    float sliceScale; // slice = log(depth) * sliceScale - sliceBias
+    float sliceBias;
+    uint lightCount;
+} frame;
+
+layout(set = 0, binding = 1, std430) readonly buffer Lights {
+    PointLight lights[];
+};
+
+// Cluster of a fragment from its window position and view-space depth.
+// Depths outside the near/far range fall into the first or last slice
+uint clusterIndex(vec2 fragCoord, float viewDepth) {
+    uvec2 tile = uvec2(fragCoord / frame.screenSize *
+                       vec2(CLUSTERS_X, CLUSTERS_Y));
+    tile = min(tile, uvec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+    float slice = log(max(viewDepth, frame.nearPlane)) * frame.sliceScale -
+                  frame.sliceBias;
+    uint z = min(uint(max(slice, 0.0)), CLUSTERS_Z - 1);
+    return tile.x + tile.y * CLUSTERS_X + z * CLUSTERS_X * CLUSTERS_Y;
+}
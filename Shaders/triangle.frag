@@ -1,8 +1,44 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "clusters.glsl"
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragWorldPosition;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in float fragViewDepth;
 layout(location = 0) out vec4 outColor;
 
+layout(set = 0, binding = 2, std430) readonly buffer Clusters {
+    uvec2 clusters[]; // offset and count into lightIndices
+};
+layout(set = 0, binding = 3, std430) readonly buffer LightIndices {
+    uint indexCount;
+    uint lightIndices[];
+};
+
+const vec3 AMBIENT = vec3(0.05);
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    vec3 normal = normalize(fragNormal);
+    vec3 lighting = AMBIENT;
+
+    // Only the lights assigned to this fragment's cluster
+    uvec2 range = clusters[clusterIndex(gl_FragCoord.xy, fragViewDepth)];
+    for (uint i = 0; i < range.y; i++) {
+        PointLight light = lights[lightIndices[range.x + i]];
+        vec3 toLight = light.position - fragWorldPosition;
+        float distance = length(toLight);
+        if (distance >= light.radius) {
+            continue;
+        }
+        // Inverse-square falloff windowed to reach zero at the radius
+        float window = distance / light.radius;
+        window = clamp(1.0 - window * window * window * window, 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        float diffuse = max(dot(normal, toLight / max(distance, 1e-4)), 0.0);
+        lighting += light.color * light.intensity * diffuse * attenuation;
+    }
+
+    outColor = vec4(fragColor * lighting, 1.0);
+}
@@ -1,11 +1,29 @@
 #version 450
 
-layout(location = 0) in vec2 inPosition;
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in mat4 inModel;
+
+layout(push_constant) uniform Camera {
+    mat4 viewProj;
+    mat4 view;
+} camera;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragWorldPosition;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out float fragViewDepth;
+
+// The depth pre-pass and the main pass must compute bit-identical depth
+invariant gl_Position;
 
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
+    vec4 worldPosition = inModel * vec4(inPosition, 1.0);
+    gl_Position = camera.viewProj * worldPosition;
     fragColor = inColor;
+    fragWorldPosition = worldPosition.xyz;
+    // Instances are scaled uniformly, so the model matrix transforms normals
+    fragNormal = mat3(inModel) * inNormal;
+    fragViewDepth = -(camera.view * worldPosition).z;
 }
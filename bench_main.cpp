@@ -0,0 +1,331 @@
+#include "Applications/HelloTriangleApplication.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Headless frame-time benchmark. Renders each synthetic scene offscreen for
+// a fixed number of frames and writes a JSON report of CPU and GPU frame
+// time percentiles and throughput (to stdout with --output -). With
+// --capture every frame is also written to disk, e.g. "out/%05u.png"; when
+// several scenes run, each one's files are prefixed with "sceneN_".
+// --skinned-model adds animated instances, skinned on the GPU, to every
+// scene. --frame-budget turns on dynamic resolution, which scales each
+// scene's render size to keep GPU frame time within the budget.
+// --depth-prepass renders depth in a subpass of its own before shading.
+// --gpu-trace writes a Chrome trace of each scene's last GPU frames, named
+// per scene like captures. Profiler builds likewise write the CPU zones
+// with --cpu-trace and a frame-time histogram with --frame-histogram.
+//
+//   valkeon_bench [--frames N] [--warmup N] [--width W] [--height H]
+//                 [--scene OBJECTS,INSTANCES,VERTICES]...
+//                 [--no-occlusion] [--depth-prepass] [--validation]
+//                 [--device GPU] [--capture PATTERN]
+//                 [--capture-format ppm|png|raw]
+//                 [--skinned-model FILE] [--skinned-instances N]
+//                 [--frame-budget MS] [--min-render-scale S]
+//                 [--upscale-sharpness S] [--gpu-trace FILE]
+//                 [--cpu-trace FILE] [--frame-histogram FILE]
+//                 [--output FILE]
+
+struct BenchScene {
+  uint32_t objects;
+  uint32_t instances;
+  uint32_t vertices;
+};
+
+// Used when no --scene is given: draw-call bound, instancing, vertex bound
+static const BenchScene kDefaultScenes[] = {
+    {1, 1, 3}, {1024, 1, 256}, {16, 64, 256}, {16, 1, 65536}};
+
+static void printUsage() {
+  std::cerr << "Usage: valkeon_bench [--frames N] [--warmup N] [--width W] "
+               "[--height H]\n"
+               "                     [--scene OBJECTS,INSTANCES,VERTICES]... "
+               "[--no-occlusion]\n"
+               "                     [--depth-prepass] [--validation] "
+               "[--device GPU]\n"
+               "                     [--capture PATTERN] "
+               "[--capture-format ppm|png|raw]\n"
+               "                     [--skinned-model FILE] "
+               "[--skinned-instances N]\n"
+               "                     [--frame-budget MS] "
+               "[--min-render-scale S]\n"
+               "                     [--upscale-sharpness S] "
+               "[--gpu-trace FILE]\n"
+               "                     [--cpu-trace FILE] "
+               "[--frame-histogram FILE] [--output FILE]"
+            << std::endl;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double> &sorted, double p) {
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static void writeStats(std::ostream &out, std::vector<double> samples) {
+  if (samples.empty()) {
+    out << "null";
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  out << "{\"mean\": " << sum / samples.size()
+      << ", \"p50\": " << percentile(samples, 0.50)
+      << ", \"p95\": " << percentile(samples, 0.95)
+      << ", \"p99\": " << percentile(samples, 0.99)
+      << ", \"max\": " << samples.back() << "}";
+}
+
+static bool parseCaptureFormat(const char *text, CaptureFormat &format) {
+  if (std::strcmp(text, "ppm") == 0) {
+    format = CaptureFormat::Ppm;
+  } else if (std::strcmp(text, "png") == 0) {
+    format = CaptureFormat::Png;
+  } else if (std::strcmp(text, "raw") == 0) {
+    format = CaptureFormat::Raw;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Keeps the scenes of one run from overwriting each other's captures
+static std::string scenePath(const std::string &path, size_t scene) {
+  size_t name = path.find_last_of("/\\");
+  name = name == std::string::npos ? 0 : name + 1;
+  return path.substr(0, name) + "scene" + std::to_string(scene) + "_" +
+         path.substr(name);
+}
+
+// Animation time never goes back and moves on over the run, so skinned
+// instances are measured in motion rather than in their first pose
+static bool animationAdvances(const std::vector<double> &times) {
+  if (times.size() < 2) {
+    return true;
+  }
+  return std::is_sorted(times.begin(), times.end()) &&
+         times.back() > times.front();
+}
+
+static bool parseScene(const char *text, BenchScene &scene) {
+  char separator1 = 0;
+  char separator2 = 0;
+  std::istringstream in(text);
+  in >> scene.objects >> separator1 >> scene.instances >> separator2 >>
+      scene.vertices;
+  return in && separator1 == ',' && separator2 == ',' && scene.objects > 0 &&
+         scene.instances > 0 && in.peek() == EOF;
+}
+
+int main(int argc, char **argv) {
+  // Keeps per-scene startup messages out of the report on stdout
+  Logger::setLevel(LogLevel::Warning);
+
+  AppOptions baseOptions;
+  baseOptions.headless = true;
+  baseOptions.validation = false;
+  baseOptions.width = 1920;
+  baseOptions.height = 1080;
+  uint32_t frames = 1000;
+  uint32_t warmup = 100;
+  std::vector<BenchScene> scenes;
+  std::string outputPath = "valkeon_bench.json";
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (std::strcmp(arg, "--frames") == 0 && hasValue) {
+      frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(arg, "--warmup") == 0 && hasValue) {
+      warmup = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(arg, "--width") == 0 && hasValue) {
+      baseOptions.width =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(arg, "--height") == 0 && hasValue) {
+      baseOptions.height =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(arg, "--scene") == 0 && hasValue) {
+      BenchScene scene{};
+      if (!parseScene(argv[++i], scene)) {
+        std::cerr << "Invalid scene: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+      scenes.push_back(scene);
+    } else if (std::strcmp(arg, "--no-occlusion") == 0) {
+      baseOptions.occlusionCulling = false;
+    } else if (std::strcmp(arg, "--depth-prepass") == 0) {
+      baseOptions.depthPrePass = true;
+    } else if (std::strcmp(arg, "--validation") == 0) {
+      baseOptions.validation = true;
+    } else if (std::strcmp(arg, "--device") == 0 && hasValue) {
+      baseOptions.device = argv[++i];
+    } else if (std::strcmp(arg, "--capture") == 0 && hasValue) {
+      baseOptions.capturePath = argv[++i];
+    } else if (std::strcmp(arg, "--capture-format") == 0 && hasValue) {
+      if (!parseCaptureFormat(argv[++i], baseOptions.captureFormat)) {
+        std::cerr << "Invalid capture format: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(arg, "--skinned-model") == 0 && hasValue) {
+      baseOptions.skinnedModel = argv[++i];
+    } else if (std::strcmp(arg, "--skinned-instances") == 0 && hasValue) {
+      baseOptions.skinnedInstances =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(arg, "--frame-budget") == 0 && hasValue) {
+      baseOptions.frameBudgetMs = std::strtof(argv[++i], nullptr);
+    } else if (std::strcmp(arg, "--min-render-scale") == 0 && hasValue) {
+      baseOptions.minRenderScale = std::strtof(argv[++i], nullptr);
+    } else if (std::strcmp(arg, "--upscale-sharpness") == 0 && hasValue) {
+      baseOptions.upscaleSharpness = std::strtof(argv[++i], nullptr);
+    } else if (std::strcmp(arg, "--gpu-trace") == 0 && hasValue) {
+      baseOptions.gpuTracePath = argv[++i];
+    } else if (std::strcmp(arg, "--cpu-trace") == 0 && hasValue) {
+      baseOptions.cpuTracePath = argv[++i];
+    } else if (std::strcmp(arg, "--frame-histogram") == 0 && hasValue) {
+      baseOptions.frameHistogramPath = argv[++i];
+    } else if (std::strcmp(arg, "--output") == 0 && hasValue) {
+      outputPath = argv[++i];
+    } else {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (frames == 0 || baseOptions.width == 0 || baseOptions.height == 0) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+  if (scenes.empty()) {
+    scenes.assign(std::begin(kDefaultScenes), std::end(kDefaultScenes));
+  }
+
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(4);
+  report << "{\n  \"frames\": " << frames << ",\n  \"warmup\": " << warmup
+         << ",\n  \"width\": " << baseOptions.width
+         << ",\n  \"height\": " << baseOptions.height
+         << ",\n  \"occlusion_culling\": "
+         << (baseOptions.occlusionCulling ? "true" : "false")
+         << ",\n  \"depth_prepass\": "
+         << (baseOptions.depthPrePass ? "true" : "false")
+         << ",\n  \"skinned_instances\": "
+         << (baseOptions.skinnedModel.empty() ? 0
+                                              : baseOptions.skinnedInstances)
+         << ",\n  \"frame_budget_ms\": " << baseOptions.frameBudgetMs
+         << ",\n  \"scenes\": [";
+
+  for (size_t s = 0; s < scenes.size(); s++) {
+    const BenchScene &scene = scenes[s];
+    AppOptions options = baseOptions;
+    options.frameCount = warmup + frames;
+    options.objectCount = scene.objects;
+    options.instanceCount = scene.instances;
+    options.vertexCount = scene.vertices;
+    if (!options.capturePath.empty() && scenes.size() > 1) {
+      options.capturePath = scenePath(options.capturePath, s);
+    }
+    if (scenes.size() > 1) {
+      for (std::string *path : {&options.gpuTracePath, &options.cpuTracePath,
+                                &options.frameHistogramPath}) {
+        if (!path->empty()) {
+          *path = scenePath(*path, s);
+        }
+      }
+    }
+
+    HelloTriangleApplication app(options);
+    try {
+      app.run();
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Warm-up frames (pipeline caches, first uploads) are not measured
+    const FrameTimings &timings = app.getFrameTimings();
+    if (!animationAdvances(timings.animationTime)) {
+      std::cerr << "Skinned animation did not advance" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::vector<double> cpuMs(
+        timings.cpuMs.begin() +
+            std::min<size_t>(warmup, timings.cpuMs.size()),
+        timings.cpuMs.end());
+    std::vector<double> gpuMs(
+        timings.gpuMs.begin() +
+            std::min<size_t>(warmup, timings.gpuMs.size()),
+        timings.gpuMs.end());
+
+    double totalSeconds = 0.0;
+    for (double ms : timings.cpuMs) {
+      totalSeconds += ms * 1e-3;
+    }
+    double measuredSeconds = 0.0;
+    for (double ms : cpuMs) {
+      measuredSeconds += ms * 1e-3;
+    }
+
+    report << (s == 0 ? "\n" : ",\n") << "    {\"objects\": " << scene.objects
+           << ", \"instances\": " << scene.instances
+           << ", \"vertices\": " << scene.vertices << ",\n     \"cpu_ms\": ";
+    writeStats(report, cpuMs);
+    report << ",\n     \"gpu_ms\": ";
+    writeStats(report, gpuMs);
+    report << ",\n     \"frames_per_second\": "
+           << (measuredSeconds > 0.0 ? cpuMs.size() / measuredSeconds : 0.0)
+           << ",\n     \"visible_triangles_per_second\": "
+           << (totalSeconds > 0.0 ? timings.visibleTriangles / totalSeconds
+                                  : 0.0);
+    if (timings.drawCalls > 0) {
+      report << ",\n     \"draw_calls_per_frame\": "
+             << static_cast<double>(timings.drawCalls) /
+                    timings.cpuMs.size();
+    }
+    if (timings.occlusionFrames > 0) {
+      report << ",\n     \"occlusion_visible_per_frame\": "
+             << static_cast<double>(timings.occlusionVisible) /
+                    timings.occlusionFrames
+             << ", \"occlusion_culled_per_frame\": "
+             << static_cast<double>(timings.occlusionCulled) /
+                    timings.occlusionFrames;
+    }
+    if (options.frameBudgetMs > 0.0f) {
+      std::vector<double> renderScale(
+          timings.renderScale.begin() +
+              std::min<size_t>(warmup, timings.renderScale.size()),
+          timings.renderScale.end());
+      report << ",\n     \"render_scale\": ";
+      writeStats(report, renderScale);
+    }
+    if (!options.capturePath.empty()) {
+      report << ",\n     \"captured_frames\": " << timings.capturedFrames
+             << ", \"capture_stalls\": " << timings.captureStalls;
+    }
+    report << "}";
+  }
+  report << "\n  ]\n}\n";
+
+  if (outputPath == "-") {
+    std::cout << report.str();
+  } else {
+    std::ofstream out(outputPath);
+    out << report.str();
+    if (!out) {
+      std::cerr << "Failed to write " << outputPath << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "Report written to " << outputPath << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -2,6 +2,7 @@
 
 #include <cstdlib>
 #include <functional>
+#include <iostream>
 
 
 int main() {
@@ -10,6 +11,8 @@ int main() {
   try {
     app.run();
   } catch (const std::exception &e) {
+    // Earlier messages first
+    Logger::flush();
     std::cerr << e.what() << std::endl;
     return EXIT_FAILURE;
   }
@@ -0,0 +1,539 @@
+#include "Buffer.hpp"
+#include "CommandPool.hpp"
+#include "Pipeline.hpp"
+#include "RenderPass.hpp"
+#include "VulkanContext.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Microbenchmarks of the Core building blocks, run headless. Each result is
+// the mean over a number of samples with a 95% confidence interval, and can
+// be compared against a baseline saved by an earlier run.
+//
+//   valkeon_microbench [--samples N] [--baseline FILE] [--save-baseline FILE]
+//
+// Timings depend on the GPU and driver, so no baseline ships with the
+// sources. Save one on the machine to compare on, from a known-good build:
+//
+//   valkeon_microbench --samples 100 --save-baseline microbench_baseline.json
+//
+// Later runs compare against kDefaultBaseline in the working directory when
+// it exists, or against --baseline. The exit code is non-zero when a result
+// regressed by more than kRegressionThreshold beyond both confidence
+// intervals.
+
+static constexpr double kRegressionThreshold = 0.05;
+static constexpr const char *kDefaultBaseline = "microbench_baseline.json";
+
+struct BenchResult {
+  std::string name;
+  std::string unit;
+  bool higherIsBetter = false;
+  double mean = 0.0;
+  double ci95 = 0.0; // half-width
+  uint32_t samples = 0;
+};
+
+struct BaselineEntry {
+  double mean;
+  double ci95;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMicroseconds(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+// Two-sided 95% Student t quantiles for 1..30 degrees of freedom
+static double tQuantile95(uint32_t degreesOfFreedom) {
+  static const double table[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (degreesOfFreedom == 0)
+    return 0.0;
+  return degreesOfFreedom <= 30 ? table[degreesOfFreedom - 1] : 1.960;
+}
+
+static BenchResult summarize(const std::string &name, const std::string &unit,
+                             bool higherIsBetter,
+                             const std::vector<double> &samples) {
+  BenchResult result;
+  result.name = name;
+  result.unit = unit;
+  result.higherIsBetter = higherIsBetter;
+  result.samples = static_cast<uint32_t>(samples.size());
+  if (samples.empty())
+    return result;
+
+  double sum = 0.0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  result.mean = sum / samples.size();
+
+  double squares = 0.0;
+  for (double sample : samples) {
+    squares += (sample - result.mean) * (sample - result.mean);
+  }
+  if (samples.size() > 1) {
+    double stddev = std::sqrt(squares / (samples.size() - 1));
+    result.ci95 = tQuantile95(result.samples - 1) * stddev /
+                  std::sqrt(static_cast<double>(samples.size()));
+  }
+  return result;
+}
+
+// Samples of the average time per iteration, in microseconds; one warm-up
+// sample is discarded
+static std::vector<double>
+sampleTimes(uint32_t samples, uint32_t iterations,
+            const std::function<void()> &iteration) {
+  std::vector<double> times;
+  for (uint32_t sample = 0; sample <= samples; sample++) {
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+      iteration();
+    }
+    if (sample > 0) {
+      times.push_back(elapsedMicroseconds(start) / iterations);
+    }
+  }
+  return times;
+}
+
+static std::map<std::string, BaselineEntry>
+loadBaseline(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Failed to open baseline " + path + "!");
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::string text = contents.str();
+
+  // Entries as written by saveBaseline
+  static const std::regex entry(
+      "\"([^\"]+)\":\\s*\\{\"unit\":\\s*\"[^\"]*\",\\s*\"mean\":\\s*"
+      "([-+0-9.eE]+),\\s*\"ci95\":\\s*([-+0-9.eE]+)");
+  std::map<std::string, BaselineEntry> baseline;
+  for (std::sregex_iterator it(text.begin(), text.end(), entry), end;
+       it != end; ++it) {
+    baseline[(*it)[1]] = {std::stod((*it)[2]), std::stod((*it)[3])};
+  }
+  return baseline;
+}
+
+static void saveBaseline(const std::string &path,
+                         const std::vector<BenchResult> &results) {
+  std::ofstream file(path);
+  file << std::setprecision(6) << "{\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult &result = results[i];
+    file << "  \"" << result.name << "\": {\"unit\": \"" << result.unit
+         << "\", \"mean\": " << result.mean << ", \"ci95\": " << result.ci95
+         << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  file << "}\n";
+  if (!file) {
+    throw std::runtime_error("Failed to write baseline " + path + "!");
+  }
+}
+
+class MicroBenchmarks {
+
+public:
+  explicit MicroBenchmarks(uint32_t samples) : samples(samples) {}
+
+  void setUp();
+  void tearDown();
+
+  void bufferCreateDestroy(VkDeviceSize size, const std::string &name);
+  void stagingUpload(VkDeviceSize size, const std::string &name);
+  void pipelineCreation();
+  void commandBuffers();
+  void syncRoundTrips();
+  void submitOverhead();
+
+  const std::vector<BenchResult> &getResults() const { return results; }
+
+private:
+  uint32_t samples;
+  VulkanContext context;
+  CommandPool commandPool;
+  std::vector<BenchResult> results;
+
+  VkCommandBuffer beginCommands();
+};
+
+void MicroBenchmarks::setUp() {
+  context.setValidationLayers(false);
+  context.createInstance(context.getRequiredExtensions(true));
+  context.pickPhysicalDevice(VK_NULL_HANDLE);
+  context.createLogicalDevice();
+  commandPool.create(context.getDevice(),
+                     context.getGraphicsQueueFamilyIndex());
+
+  std::cout << "Device: "
+            << context.getCapabilities().properties.deviceName << std::endl;
+}
+
+void MicroBenchmarks::tearDown() {
+  vkDeviceWaitIdle(context.getDevice());
+  commandPool.cleanup(context.getDevice());
+  context.cleanup();
+}
+
+VkCommandBuffer MicroBenchmarks::beginCommands() {
+  std::vector<VkCommandBuffer> commandBuffers;
+  commandPool.allocateCommandBuffers(context.getDevice(), 1, commandBuffers);
+  VkCommandBufferBeginInfo beginInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  // Resubmitted while still pending by submitOverhead
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+  if (vkBeginCommandBuffer(commandBuffers[0], &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording command buffer!");
+  }
+  return commandBuffers[0];
+}
+
+void MicroBenchmarks::bufferCreateDestroy(VkDeviceSize size,
+                                          const std::string &name) {
+  VkDevice device = context.getDevice();
+  std::vector<double> times = sampleTimes(samples, 100, [&] {
+    Buffer buffer;
+    buffer.create(context, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    buffer.cleanup(device);
+  });
+  results.push_back(summarize(name, "us", false, times));
+}
+
+void MicroBenchmarks::stagingUpload(VkDeviceSize size,
+                                    const std::string &name) {
+  VkDevice device = context.getDevice();
+  Buffer staging;
+  staging.create(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  Buffer target;
+  target.create(context, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  void *mapped = nullptr;
+  if (vkMapMemory(device, staging.getMemory(), 0, size, 0, &mapped) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to map staging buffer!");
+  }
+  std::vector<char> source(static_cast<size_t>(size), 1);
+
+  // Host copy into staging, then the transfer and its wait
+  std::vector<double> times = sampleTimes(samples, 4, [&] {
+    std::memcpy(mapped, source.data(), source.size());
+    Buffer::copy(context, commandPool, staging.getBuffer(),
+                 target.getBuffer(), size);
+  });
+  std::vector<double> throughput;
+  for (double microseconds : times) {
+    throughput.push_back(static_cast<double>(size) / microseconds);
+  }
+  results.push_back(summarize(name, "MB/s", true, throughput));
+
+  vkUnmapMemory(device, staging.getMemory());
+  target.cleanup(device);
+  staging.cleanup(device);
+}
+
+void MicroBenchmarks::pipelineCreation() {
+  VkDevice device = context.getDevice();
+  RenderPass renderPass;
+  renderPass.create(device, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_UNDEFINED,
+                    false, false, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+  // Matches the lighting set the fragment shader reads
+  VkDescriptorSetLayoutBinding bindings[4]{};
+  for (uint32_t i = 0; i < 4; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                        : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo layoutInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  layoutInfo.bindingCount = 4;
+  layoutInfo.pBindings = bindings;
+  VkDescriptorSetLayout setLayout;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr,
+                                  &setLayout) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor set layout!");
+  }
+
+  Pipeline pipeline;
+  auto createOnce = [&] {
+    VkPipelineLayout layout;
+    VkPipeline handle;
+    pipeline.createBasicPipeline(device, renderPass.getRenderPass(), layout,
+                                 handle, 0, false, false, {setLayout});
+    vkDestroyPipeline(device, handle, nullptr);
+    vkDestroyPipelineLayout(device, layout, nullptr);
+  };
+
+  // Cold still benefits from any cache inside the driver itself
+  std::vector<double> cold = sampleTimes(samples, 1, createOnce);
+  results.push_back(summarize("pipeline_create_cold", "us", false, cold));
+
+  VkPipelineCacheCreateInfo cacheInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  VkPipelineCache cache;
+  if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline cache!");
+  }
+  pipeline.setPipelineCache(cache);
+  std::vector<double> cached = sampleTimes(samples, 1, createOnce);
+  results.push_back(summarize("pipeline_create_cached", "us", false, cached));
+
+  vkDestroyPipelineCache(device, cache, nullptr);
+  vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+  renderPass.cleanup(device);
+}
+
+void MicroBenchmarks::commandBuffers() {
+  static constexpr uint32_t kCommands = 1000;
+  VkDevice device = context.getDevice();
+  VkCommandPool pool = commandPool.getCommandPool();
+
+  std::vector<double> allocate = sampleTimes(samples, 100, [&] {
+    std::vector<VkCommandBuffer> commandBuffers;
+    commandPool.allocateCommandBuffers(device, 1, commandBuffers);
+    vkFreeCommandBuffers(device, pool, 1, commandBuffers.data());
+  });
+  results.push_back(
+      summarize("command_buffer_allocate_free", "us", false, allocate));
+
+  Buffer target;
+  target.create(context, 4096, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  std::vector<VkCommandBuffer> commandBuffers;
+  commandPool.allocateCommandBuffers(device, 1, commandBuffers);
+  VkCommandBuffer commandBuffer = commandBuffers[0];
+
+  auto record = [&] {
+    VkCommandBufferBeginInfo beginInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to begin recording command buffer!");
+    }
+    for (uint32_t i = 0; i < kCommands; i++) {
+      vkCmdFillBuffer(commandBuffer, target.getBuffer(), 0, 4096, i);
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to record command buffer!");
+    }
+  };
+
+  std::vector<double> recordTimes = sampleTimes(samples, 10, [&] {
+    record();
+    vkResetCommandBuffer(commandBuffer, 0);
+  });
+  std::vector<double> resetTimes;
+  for (uint32_t sample = 0; sample < samples; sample++) {
+    record();
+    Clock::time_point start = Clock::now();
+    vkResetCommandBuffer(commandBuffer, 0);
+    resetTimes.push_back(elapsedMicroseconds(start));
+  }
+  results.push_back(
+      summarize("command_buffer_record_1000_fills", "us", false, recordTimes));
+  results.push_back(summarize("command_buffer_reset", "us", false, resetTimes));
+
+  vkFreeCommandBuffers(device, pool, 1, &commandBuffer);
+  target.cleanup(device);
+}
+
+void MicroBenchmarks::syncRoundTrips() {
+  VkDevice device = context.getDevice();
+  VkQueue queue = context.getGraphicsQueue();
+
+  VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VkFence fence;
+  VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  VkSemaphore semaphore;
+  if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS ||
+      vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) !=
+          VK_SUCCESS) {
+    throw std::runtime_error("Failed to create synchronization objects!");
+  }
+
+  // An empty batch: submission to fence signal to host wake-up
+  std::vector<double> fenceTimes = sampleTimes(samples, 100, [&] {
+    if (vkQueueSubmit(queue, 0, nullptr, fence) != VK_SUCCESS ||
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX) !=
+            VK_SUCCESS) {
+      throw std::runtime_error("Failed to signal the fence!");
+    }
+    vkResetFences(device, 1, &fence);
+  });
+  results.push_back(summarize("fence_round_trip", "us", false, fenceTimes));
+
+  // One batch signals, the next waits on it and signals the fence
+  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  std::vector<double> semaphoreTimes = sampleTimes(samples, 100, [&] {
+    VkSubmitInfo submits[2] = {{VK_STRUCTURE_TYPE_SUBMIT_INFO},
+                               {VK_STRUCTURE_TYPE_SUBMIT_INFO}};
+    submits[0].signalSemaphoreCount = 1;
+    submits[0].pSignalSemaphores = &semaphore;
+    submits[1].waitSemaphoreCount = 1;
+    submits[1].pWaitSemaphores = &semaphore;
+    submits[1].pWaitDstStageMask = &waitStage;
+    if (vkQueueSubmit(queue, 2, submits, fence) != VK_SUCCESS ||
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX) !=
+            VK_SUCCESS) {
+      throw std::runtime_error("Failed to signal the semaphore!");
+    }
+    vkResetFences(device, 1, &fence);
+  });
+  results.push_back(
+      summarize("semaphore_round_trip", "us", false, semaphoreTimes));
+
+  vkDestroySemaphore(device, semaphore, nullptr);
+  vkDestroyFence(device, fence, nullptr);
+}
+
+void MicroBenchmarks::submitOverhead() {
+  VkDevice device = context.getDevice();
+  VkQueue queue = context.getGraphicsQueue();
+
+  VkCommandBuffer commandBuffer = beginCommands();
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record command buffer!");
+  }
+
+  // CPU cost of vkQueueSubmit alone; the queue drains between samples
+  std::vector<double> times;
+  for (uint32_t sample = 0; sample <= samples; sample++) {
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < 100; i++) {
+      VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &commandBuffer;
+      if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit command buffer!");
+      }
+    }
+    double elapsed = elapsedMicroseconds(start) / 100;
+    vkQueueWaitIdle(queue);
+    if (sample > 0) {
+      times.push_back(elapsed);
+    }
+  }
+  results.push_back(summarize("queue_submit_overhead", "us", false, times));
+
+  vkFreeCommandBuffers(device, commandPool.getCommandPool(), 1,
+                       &commandBuffer);
+}
+
+int main(int argc, char **argv) {
+  uint32_t samples = 30;
+  std::string baselinePath;
+  std::string saveBaselinePath;
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "--samples") == 0 && hasValue) {
+      samples = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(argv[i], "--baseline") == 0 && hasValue) {
+      baselinePath = argv[++i];
+    } else if (std::strcmp(argv[i], "--save-baseline") == 0 && hasValue) {
+      saveBaselinePath = argv[++i];
+    } else {
+      std::cerr << "Usage: valkeon_microbench [--samples N] [--baseline FILE] "
+                   "[--save-baseline FILE]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  samples = std::max<uint32_t>(samples, 2);
+
+  MicroBenchmarks benchmarks(samples);
+  std::map<std::string, BaselineEntry> baseline;
+  try {
+    if (baselinePath.empty() && std::ifstream(kDefaultBaseline)) {
+      baselinePath = kDefaultBaseline;
+    }
+    if (!baselinePath.empty()) {
+      baseline = loadBaseline(baselinePath);
+      std::cout << "Baseline: " << baselinePath << std::endl;
+    }
+
+    benchmarks.setUp();
+    benchmarks.bufferCreateDestroy(4 << 10, "buffer_create_destroy_4KiB");
+    benchmarks.bufferCreateDestroy(4 << 20, "buffer_create_destroy_4MiB");
+    benchmarks.stagingUpload(64 << 10, "staging_upload_64KiB");
+    benchmarks.stagingUpload(1 << 20, "staging_upload_1MiB");
+    benchmarks.stagingUpload(16 << 20, "staging_upload_16MiB");
+    benchmarks.stagingUpload(64 << 20, "staging_upload_64MiB");
+    benchmarks.pipelineCreation();
+    benchmarks.commandBuffers();
+    benchmarks.syncRoundTrips();
+    benchmarks.submitOverhead();
+    benchmarks.tearDown();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool regressed = false;
+  std::cout << std::fixed << std::setprecision(2);
+  for (const BenchResult &result : benchmarks.getResults()) {
+    std::cout << std::left << std::setw(36) << result.name << std::right
+              << std::setw(12) << result.mean << " +- " << std::setw(8)
+              << result.ci95 << " " << std::setw(5) << result.unit;
+
+    auto entry = baseline.find(result.name);
+    if (entry != baseline.end() && entry->second.mean != 0.0) {
+      double change = (result.mean - entry->second.mean) / entry->second.mean;
+      double worse = result.higherIsBetter ? -change : change;
+      // Beyond noise: outside both intervals and above the threshold
+      bool significant = std::abs(result.mean - entry->second.mean) >
+                         result.ci95 + entry->second.ci95;
+      std::cout << "  " << std::showpos << change * 100.0 << std::noshowpos
+                << "% vs baseline";
+      if (significant && worse > kRegressionThreshold) {
+        std::cout << "  REGRESSION";
+        regressed = true;
+      }
+    }
+    std::cout << "\n";
+  }
+  std::cout << std::flush;
+
+  if (!saveBaselinePath.empty()) {
+    try {
+      saveBaseline(saveBaselinePath, benchmarks.getResults());
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}